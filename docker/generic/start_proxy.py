@@ -431,6 +431,22 @@ environment variable or by passing "-k" flag to this script.
         action='store_true',
         help='''Enable fetching service name, service config ID and rollout
         strategy from the metadata service.''')
+    parser.add_argument(
+        '--xds_snapshot_dir',
+        default=None,
+        help='''Directory where the last applied proxy configuration is
+        persisted. On restart, it is served right away when it was generated
+        with the same flags, and the latest service config is fetched and
+        applied in the background, so startup does not wait for Service
+        Management.''')
+    parser.add_argument(
+        '--managed_jwks_dir',
+        default=None,
+        help='''Directory where the JWKS of the JWT providers are persisted.
+        When set, the JWKS are fetched before the proxy starts serving and
+        refreshed as their Cache-Control max-age expires, so JWTs are verified
+        from the first request, and the persisted JWKS are used on restart
+        even if the providers are down.''')
 
     parser.add_argument('--underscores_in_headers', action='store_true',
         help='''Allow headers contain underscores to pass through. By default
@@ -820,6 +836,16 @@ environment variable or by passing "-k" flag to this script.
         the location of the service account credentials JSON file. If the option is
         omitted, the proxy contacts the metadata service to fetch an access token.
         '''.format(creds_key=GOOGLE_CREDS_KEY))
+    parser.add_argument(
+        '--token_broker_socket',
+        default=None,
+        help='''
+        Unix domain socket of the node-local token broker (bin/tokenbroker).
+        If set, the proxy fetches the access and identity tokens of the
+        metadata server from the broker, so all the proxies of a node share
+        one fetch and one refresh of each token. Not used with
+        --service_account_key or with IAM credentials.
+        ''')
 
     parser.add_argument(
         '--dns_resolver_addresses',
@@ -938,6 +964,78 @@ environment variable or by passing "-k" flag to this script.
         help='''Enable both gzip and brotli compression for response data with
         default envoy compression settings. Please see envoy document for detail.
         https://www.envoyproxy.io/docs/envoy/latest/configuration/http/http_filters/compressor_filter.''')
+    parser.add_argument('--response_compression_min_size', default=None, type=int,
+        help='''Minimum response size in bytes to be compressed. Only takes
+        effect when --enable_response_compression is set. If not set, the envoy
+        default of 30 bytes is used.''')
+    parser.add_argument('--response_compression_content_types', default=None,
+        help='''Comma separated content types of the responses to compress,
+        e.g. "application/json,text/html". Only takes effect when
+        --enable_response_compression is set. If not set, the envoy default list
+        of text, json and xml types is used.''')
+    parser.add_argument('--response_compression_operations', default=None,
+        help='''Semicolon separated per-operation compression policies, in the
+        form of "selector=policy". The policy is "off" to not compress the
+        responses of the operation, or "gzip" or "br" to only compress them
+        with that algorithm, e.g. "pkg.Svc.Download=off;pkg.Svc.List=br".
+        Streaming gRPC operations are never compressed. Only takes effect when
+        --enable_response_compression is set.''')
+    parser.add_argument('--trusted_jwt_callers', default=None,
+        help='''Semicolon separated trusted JWT callers of the operations, in
+        the form of "selector=issuer,audience[,audience...]", e.g.
+        "pkg.Svc.Get=https://issuer.example.com,internal-audience". The requests
+        to the operation with a JWT verified from the issuer, for one of the
+        audiences, skip the Service Control check and quota calls, even without
+        an API key. They are still reported. The operation must require JWT
+        authentication.''')
+    parser.add_argument('--learn_api_key_restrictions', action='store_true',
+        help='''Learn which API keys have no IP or referer restriction, and
+        send their Service Control check and quota requests with a fixed client
+        IP and referer, so they are cached once per API key instead of once per
+        client IP and referer. The keys are learned by checking them once with
+        the fixed client IP and referer.''')
+    parser.add_argument('--check_cache_peers', default=None,
+        help='''Comma-separated host:port addresses of the ESPv2 replicas of
+        the service, including this one, to share the Service Control check
+        responses with. Each check response is owned by one replica, which
+        serves it to the others, so a check made by one replica is not made
+        again by the others. The list must be the same on all the replicas, and
+        the port must only be reachable by them. If a replica fails, the others
+        call Service Control. Requires --check_cache_peer_secret_file.''')
+    parser.add_argument('--check_cache_peer_address', default=None,
+        help='''The address the check responses owned by this replica are
+        served on to the --check_cache_peers, such as the pod IP. The default
+        is 127.0.0.1.''')
+    parser.add_argument('--check_cache_peer_port', default=None, type=int,
+        help='''The port the check responses owned by this replica are
+        served on to the --check_cache_peers. The default is 8792.''')
+    parser.add_argument('--check_cache_peer_secret_file', default=None,
+        help='''The path to the file of a secret shared by the
+        --check_cache_peers. The check responses they share are authenticated
+        with it, so only the replicas can publish them.''')
+    parser.add_argument('--pinned_check_api_key_sha256', default=None,
+        help='''Comma-separated hex encoded SHA-256 digests of the API keys of
+        priority consumers. Their Service Control check responses are held
+        outside of the check cache, so they are not evicted by the other
+        consumers, and are refreshed ahead of their expiry while they are
+        used.''')
+    parser.add_argument('--pinned_check_consumer_numbers', default=None,
+        help='''Comma-separated consumer project numbers of priority
+        consumers, whose check responses are pinned like the ones of
+        --pinned_check_api_key_sha256.''')
+    parser.add_argument('--pinned_check_ttl', default=None,
+        help='''How long a pinned check response is served, such as "5m".
+        It must be at least 20s. The default is 5m.''')
+    parser.add_argument('--denied_report_rollup_threshold', default=None,
+        type=int,
+        help='''The number of Service Control reports of denied requests each
+        Envoy worker sends as is per --denied_report_rollup_interval. Above
+        it, the reports are rolled up into one report per operation and denial
+        reason, without the API key, consumer or client IP of the requests.
+        The default is 100.''')
+    parser.add_argument('--denied_report_rollup_interval', default=None,
+        help='''The interval the Service Control reports of denied requests
+        are rolled up over, such as "1s". The default is 1s.''')
 
     # Start Deprecated Flags Section
 
@@ -1270,6 +1368,47 @@ def gen_proxy_config(args):
         proxy_conf.append("--enable_operation_name_header")
     if args.enable_response_compression:
         proxy_conf.append("--enable_response_compression")
+    if args.response_compression_min_size is not None:
+        proxy_conf.extend(["--response_compression_min_size",
+                           str(args.response_compression_min_size)])
+    if args.response_compression_content_types:
+        proxy_conf.extend(["--response_compression_content_types",
+                           args.response_compression_content_types])
+    if args.response_compression_operations:
+        proxy_conf.extend(["--response_compression_operations",
+                           args.response_compression_operations])
+    if args.trusted_jwt_callers:
+        proxy_conf.extend(["--trusted_jwt_callers", args.trusted_jwt_callers])
+    if args.learn_api_key_restrictions:
+        proxy_conf.append("--learn_api_key_restrictions")
+
+    if args.check_cache_peers:
+        proxy_conf.extend(["--check_cache_peers", args.check_cache_peers])
+    if args.check_cache_peer_address:
+        proxy_conf.extend(["--check_cache_peer_address",
+                           args.check_cache_peer_address])
+    if args.check_cache_peer_port:
+        proxy_conf.extend(["--check_cache_peer_port",
+                           str(args.check_cache_peer_port)])
+    if args.check_cache_peer_secret_file:
+        proxy_conf.extend(["--check_cache_peer_secret_file",
+                           args.check_cache_peer_secret_file])
+
+    if args.pinned_check_api_key_sha256:
+        proxy_conf.extend(["--pinned_check_api_key_sha256",
+                           args.pinned_check_api_key_sha256])
+    if args.pinned_check_consumer_numbers:
+        proxy_conf.extend(["--pinned_check_consumer_numbers",
+                           args.pinned_check_consumer_numbers])
+    if args.pinned_check_ttl:
+        proxy_conf.extend(["--pinned_check_ttl", args.pinned_check_ttl])
+
+    if args.denied_report_rollup_threshold:
+        proxy_conf.extend(["--denied_report_rollup_threshold",
+                           str(args.denied_report_rollup_threshold)])
+    if args.denied_report_rollup_interval:
+        proxy_conf.extend(["--denied_report_rollup_interval",
+                           args.denied_report_rollup_interval])
 
     # Generate self-signed cert if needed
     if args.generate_self_signed_cert:
@@ -1342,6 +1481,12 @@ def gen_proxy_config(args):
     if args.check_metadata:
         proxy_conf.append("--check_metadata")
 
+    if args.xds_snapshot_dir:
+        proxy_conf.extend(["--xds_snapshot_dir", args.xds_snapshot_dir])
+
+    if args.managed_jwks_dir:
+        proxy_conf.extend(["--managed_jwks_dir", args.managed_jwks_dir])
+
     if args.underscores_in_headers:
         proxy_conf.append("--underscores_in_headers")
     if args.disable_normalize_path:
@@ -1463,6 +1608,8 @@ def gen_proxy_config(args):
         proxy_conf.extend(["--service_account_key", args.service_account_key])
     if args.non_gcp:
         proxy_conf.append("--non_gcp")
+    if args.token_broker_socket:
+        proxy_conf.extend(["--token_broker_socket", args.token_broker_socket])
 
     if args.enable_debug:
         proxy_conf.append("--suppress_envoy_headers=false")
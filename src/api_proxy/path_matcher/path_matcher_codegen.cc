@@ -0,0 +1,309 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/api_proxy/path_matcher/path_matcher_codegen.h"
+
+#include <map>
+#include <memory>
+#include <set>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "src/api_proxy/path_matcher/http_template.h"
+#include "src/api_proxy/path_matcher/path_matcher.h"
+
+namespace espv2 {
+namespace api_proxy {
+namespace path_matcher {
+namespace {
+
+// Same as the HttpMethod_WILD_CARD of PathMatcherNode.
+constexpr char kHttpMethodWildCard[] = "*";
+
+// The same trie as PathMatcherNode, with the template indexes as results.
+struct CodegenNode {
+  int id = 0;
+  bool wildcard = false;
+  std::map<std::string, int> results;
+  std::map<std::string, std::unique_ptr<CodegenNode>> children;
+};
+
+std::string Quote(const std::string& s) {
+  return absl::StrCat("\"", absl::CEscape(s), "\"");
+}
+
+int NumberNodes(CodegenNode* node, int next_id) {
+  node->id = next_id++;
+  for (auto& child : node->children) {
+    next_id = NumberNodes(child.second.get(), next_id);
+  }
+  return next_id;
+}
+
+// Emits the returns for the results of the node, mirroring
+// PathMatcherNode::GetResultForHttpMethod. Returns true if the emitted code
+// always returns.
+bool EmitResults(const CodegenNode& node, const std::string& indent,
+                 std::string* out) {
+  for (const auto& result : node.results) {
+    if (result.first == kHttpMethodWildCard) {
+      continue;
+    }
+    absl::StrAppend(out, indent, "if (http_method == ", Quote(result.first),
+                    ") return ", result.second, ";\n");
+  }
+  const auto wildcard = node.results.find(kHttpMethodWildCard);
+  if (wildcard != node.results.end()) {
+    absl::StrAppend(out, indent, "return ", wildcard->second, ";\n");
+    return true;
+  }
+  return false;
+}
+
+// Returns true if the results of the node depend on the http method.
+bool HasMethodResults(const CodegenNode& node) {
+  for (const auto& result : node.results) {
+    if (result.first != kHttpMethodWildCard) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Emits the node function, mirroring PathMatcherNode::LookupPath.
+void EmitNode(const CodegenNode& node, std::string* out) {
+  absl::StrAppend(out, "inline int MatchNode", node.id,
+                  "(const Parts& parts, size_t i, "
+                  "absl::string_view http_method) {\n");
+  if (node.children.empty() && !node.wildcard && !HasMethodResults(node)) {
+    absl::StrAppend(out, "  static_cast<void>(http_method);\n");
+  }
+
+  absl::StrAppend(out, "  if (i == parts.size()) {\n");
+  bool returned = EmitResults(node, "    ", out);
+  const auto wildcard_path = node.children.find(HttpTemplate::kWildCardPathKey);
+  if (!returned && wildcard_path != node.children.end()) {
+    returned = EmitResults(*wildcard_path->second, "    ", out);
+  }
+  if (!returned) {
+    absl::StrAppend(out, "    return -1;\n");
+  }
+  absl::StrAppend(out, "  }\n");
+
+  if (node.children.empty() && !node.wildcard) {
+    absl::StrAppend(out, "  return -1;\n}\n\n");
+    return;
+  }
+
+  if (!node.children.empty()) {
+    // Any child, including the wildcard ones, is first looked up by the
+    // literal value of the part.
+    using Child = std::pair<const std::string, std::unique_ptr<CodegenNode>>;
+    std::map<size_t, std::vector<const Child*>> by_size;
+    for (const auto& child : node.children) {
+      by_size[child.first.size()].push_back(&child);
+    }
+    absl::StrAppend(out, "  int result = -1;\n",
+                    "  const absl::string_view part = parts[i];\n",
+                    "  switch (part.size()) {\n");
+    for (const auto& size : by_size) {
+      absl::StrAppend(out, "    case ", size.first, ":\n");
+      bool first = true;
+      for (const auto* child : size.second) {
+        absl::StrAppend(out, first ? "      if (" : "      } else if (");
+        if (size.first == 0) {
+          absl::StrAppend(out, "true");
+        } else {
+          absl::StrAppend(out, "memcmp(part.data(), ", Quote(child->first),
+                          ", ", size.first, ") == 0");
+        }
+        absl::StrAppend(out, ") {\n        result = MatchNode",
+                        child->second->id, "(parts, i + 1, http_method);\n");
+        first = false;
+      }
+      absl::StrAppend(out, "      }\n      break;\n");
+    }
+    absl::StrAppend(out, "  }\n  if (result >= 0) return result;\n");
+  }
+
+  if (node.wildcard) {
+    // A `**` keeps consuming parts until its children match the rest.
+    absl::StrAppend(out, "  return MatchNode", node.id,
+                    "(parts, i + 1, http_method);\n}\n\n");
+    return;
+  }
+
+  for (const char* key :
+       {HttpTemplate::kSingleParameterKey, HttpTemplate::kWildCardPathPartKey,
+        HttpTemplate::kWildCardPathKey}) {
+    const auto child = node.children.find(key);
+    if (child == node.children.end()) {
+      continue;
+    }
+    absl::StrAppend(out, "  result = MatchNode", child->second->id,
+                    "(parts, i + 1, http_method);\n",
+                    "  if (result >= 0) return result;\n");
+  }
+  absl::StrAppend(out, "  return -1;\n}\n\n");
+}
+
+void EmitNodes(const CodegenNode& node, std::string* out) {
+  EmitNode(node, out);
+  for (const auto& child : node.children) {
+    EmitNodes(*child.second, out);
+  }
+}
+
+void DeclareNodes(const CodegenNode& node, std::string* out) {
+  absl::StrAppend(out, "inline int MatchNode", node.id,
+                  "(const Parts& parts, size_t i, "
+                  "absl::string_view http_method);\n");
+  for (const auto& child : node.children) {
+    DeclareNodes(*child.second, out);
+  }
+}
+
+}  // namespace
+
+bool GeneratePathMatcherCode(const std::vector<CodegenTemplate>& templates,
+                             const std::string& cpp_namespace,
+                             std::string* code, std::string* error) {
+  if (templates.empty()) {
+    *error = "no url templates";
+    return false;
+  }
+
+  CodegenNode root;
+  std::set<std::string> custom_verbs;
+  for (size_t index = 0; index < templates.size(); ++index) {
+    const CodegenTemplate& tmpl = templates[index];
+    std::unique_ptr<HttpTemplate> ht(HttpTemplate::Parse(tmpl.url_template));
+    if (ht == nullptr) {
+      *error = absl::StrCat("invalid url template: ", tmpl.url_template);
+      return false;
+    }
+
+    const PathMatcherNode::PathInfo path_info = TransformHttpTemplate(*ht);
+    CodegenNode* node = &root;
+    for (const std::string& part : path_info.path_info()) {
+      std::unique_ptr<CodegenNode>& child = node->children[part];
+      if (child == nullptr) {
+        child.reset(new CodegenNode());
+        child->wildcard = part == HttpTemplate::kWildCardPathKey;
+      }
+      node = child.get();
+    }
+    if (!node->results.emplace(tmpl.http_method, index).second) {
+      *error = absl::StrCat("duplicate template: ", tmpl.http_method, " ",
+                            tmpl.url_template);
+      return false;
+    }
+    if (!ht->verb().empty()) {
+      custom_verbs.insert(ht->verb());
+    }
+  }
+  NumberNodes(&root, 0);
+
+  std::string out =
+      "// Generated by path_matcher_codegen, do not edit.\n\n"
+      "#pragma once\n\n"
+      "#include <cstring>\n\n"
+      "#include \"absl/container/inlined_vector.h\"\n"
+      "#include \"absl/strings/str_split.h\"\n"
+      "#include \"absl/strings/string_view.h\"\n\n";
+  const std::vector<std::string> namespaces =
+      absl::StrSplit(cpp_namespace, "::", absl::SkipEmpty());
+  for (const auto& ns : namespaces) {
+    absl::StrAppend(&out, "namespace ", ns, " {\n");
+  }
+
+  absl::StrAppend(&out,
+                  "\nstruct Template {\n"
+                  "  const char* http_method;\n"
+                  "  const char* url_template;\n"
+                  "};\n\n"
+                  "// The input templates, Match() returns indexes in it.\n"
+                  "constexpr Template kTemplates[] = {\n");
+  for (const auto& tmpl : templates) {
+    absl::StrAppend(&out, "    {", Quote(tmpl.http_method), ", ",
+                    Quote(tmpl.url_template), "},\n");
+  }
+  absl::StrAppend(&out, "};\n\nnamespace internal {\n\n",
+                  "using Parts = absl::InlinedVector<absl::string_view, 16>;"
+                  "\n\n");
+
+  // Same as ExtractRequestParts, without copies.
+  absl::StrAppend(&out,
+                  "inline bool IsCustomVerb(absl::string_view verb) {\n");
+  for (const auto& verb : custom_verbs) {
+    absl::StrAppend(&out, "  if (verb == ", Quote(verb), ") return true;\n");
+  }
+  if (custom_verbs.empty()) {
+    absl::StrAppend(&out, "  static_cast<void>(verb);\n");
+  }
+  absl::StrAppend(
+      &out,
+      "  return false;\n}\n\n"
+      "inline Parts ExtractRequestParts(absl::string_view path) {\n"
+      "  path = path.substr(0, path.find('?'));\n"
+      "  absl::string_view verb;\n"
+      "  const size_t last_colon_pos = path.find_last_of(':');\n"
+      "  const size_t last_slash_pos = path.find_last_of('/');\n"
+      "  if (last_colon_pos != absl::string_view::npos &&\n"
+      "      last_colon_pos > last_slash_pos &&\n"
+      "      IsCustomVerb(path.substr(last_colon_pos + 1))) {\n"
+      "    verb = path.substr(last_colon_pos + 1);\n"
+      "    path = path.substr(0, last_colon_pos);\n"
+      "  }\n"
+      "  Parts parts;\n"
+      "  if (!path.empty()) {\n"
+      "    for (absl::string_view part : absl::StrSplit(path.substr(1), "
+      "'/')) {\n"
+      "      parts.push_back(part);\n"
+      "    }\n"
+      "  }\n"
+      "  if (verb.data() != nullptr) {\n"
+      "    parts.push_back(verb);\n"
+      "  }\n"
+      "  while (!parts.empty() && parts.back().empty()) {\n"
+      "    parts.pop_back();\n"
+      "  }\n"
+      "  return parts;\n"
+      "}\n\n");
+
+  DeclareNodes(root, &out);
+  absl::StrAppend(&out, "\n");
+  EmitNodes(root, &out);
+
+  absl::StrAppend(
+      &out,
+      "}  // namespace internal\n\n"
+      "// Returns the index in kTemplates of the matched template, or -1.\n"
+      "inline int Match(absl::string_view http_method, "
+      "absl::string_view path) {\n"
+      "  return internal::MatchNode0(internal::ExtractRequestParts(path), 0,\n"
+      "                              http_method);\n"
+      "}\n\n");
+  for (auto it = namespaces.rbegin(); it != namespaces.rend(); ++it) {
+    absl::StrAppend(&out, "}  // namespace ", *it, "\n");
+  }
+
+  *code = std::move(out);
+  return true;
+}
+
+}  // namespace path_matcher
+}  // namespace api_proxy
+}  // namespace espv2
@@ -0,0 +1,55 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace espv2 {
+namespace api_proxy {
+namespace path_matcher {
+
+// A template to generate the matching code for, the same input as
+// PathMatcherBuilder::Register.
+struct CodegenTemplate {
+  std::string http_method;
+  std::string url_template;
+};
+
+// Generates a self-contained C++ header specialized to match `templates`
+// ahead of time, for service configs that are fixed at build time.
+//
+// The generated code walks the same trie PathMatcherBuilder would build and
+// follows the same matching precedence as PathMatcher::Lookup, but each trie
+// node becomes a function dispatching on the segment length with
+// compile-time constant segments, and the request path is split without
+// allocating. The header defines, in `cpp_namespace` ("a::b" is allowed):
+//
+//   // The input templates, in order.
+//   constexpr Template kTemplates[];
+//   // Returns the index in kTemplates of the matched template, or -1.
+//   int Match(absl::string_view http_method, absl::string_view path);
+//
+// Variable bindings are not extracted, use the runtime PathMatcher for them.
+//
+// Returns false and sets `error` if a template is invalid or registered
+// twice.
+bool GeneratePathMatcherCode(const std::vector<CodegenTemplate>& templates,
+                             const std::string& cpp_namespace,
+                             std::string* code, std::string* error);
+
+}  // namespace path_matcher
+}  // namespace api_proxy
+}  // namespace espv2
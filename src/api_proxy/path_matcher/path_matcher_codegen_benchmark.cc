@@ -0,0 +1,84 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the runtime PathMatcher trie with the generated matching code of
+// the same templates.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "src/api_proxy/path_matcher/codegen_templates_path_matcher.h"
+#include "src/api_proxy/path_matcher/path_matcher.h"
+
+namespace espv2 {
+namespace api_proxy {
+namespace path_matcher {
+namespace {
+
+using Generated = codegen_test::Template;
+
+// A mix of literal, variable, wildcard, custom verb and unmatched requests.
+const std::vector<std::pair<std::string, std::string>>& Requests() {
+  static const auto* requests =
+      new std::vector<std::pair<std::string, std::string>>{
+          {"GET", "/shelves"},
+          {"GET", "/shelves/123"},
+          {"GET", "/shelves/123/books/456?key=api-key"},
+          {"POST", "/shelves/123/books/456:checkout"},
+          {"GET", "/shelves/123/books/456/reviews/789"},
+          {"GET", "/authors/42/books/a/b/c"},
+          {"GET",
+           "/v1/projects/my-project/locations/us-central1/operations/op-1"},
+          {"GET", "/v1/projects/p/locations/l/catalogs/c/entries"},
+          {"GET", "/static/js/vendor/index.html"},
+          {"PUT", "/health"},
+          {"OPTIONS", "/any/path/at/all"},
+          {"GET", "/unknown/path"},
+      };
+  return *requests;
+}
+
+void BM_RuntimePathMatcher(benchmark::State& state) {
+  PathMatcherBuilder<const Generated*> builder;
+  for (const Generated& tmpl : codegen_test::kTemplates) {
+    builder.Register(tmpl.http_method, tmpl.url_template, "", &tmpl);
+  }
+  const PathMatcherPtr<const Generated*> matcher = builder.Build();
+
+  for (auto _ : state) {
+    for (const auto& request : Requests()) {
+      benchmark::DoNotOptimize(matcher->Lookup(request.first, request.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Requests().size());
+}
+BENCHMARK(BM_RuntimePathMatcher);
+
+void BM_GeneratedPathMatcher(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const auto& request : Requests()) {
+      benchmark::DoNotOptimize(
+          codegen_test::Match(request.first, request.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Requests().size());
+}
+BENCHMARK(BM_GeneratedPathMatcher);
+
+}  // namespace
+}  // namespace path_matcher
+}  // namespace api_proxy
+}  // namespace espv2
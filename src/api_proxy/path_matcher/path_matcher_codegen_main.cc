@@ -0,0 +1,82 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Generates the specialized path matching code of a fixed set of url
+// templates, see path_matcher_codegen.h.
+//
+// Usage: path_matcher_codegen <templates_file> <output_header> <namespace>
+//
+// The templates file has one "<http method> <url template>" per line, in the
+// order they would be registered. Empty lines and lines starting with '#'
+// are ignored.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_split.h"
+#include "src/api_proxy/path_matcher/path_matcher_codegen.h"
+
+using ::espv2::api_proxy::path_matcher::CodegenTemplate;
+using ::espv2::api_proxy::path_matcher::GeneratePathMatcherCode;
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <templates_file> <output_header> <namespace>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream input(argv[1]);
+  if (!input) {
+    std::cerr << "Failed to open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector<CodegenTemplate> templates;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(input, line)) {
+    ++line_number;
+    const absl::string_view stripped = absl::StripAsciiWhitespace(line);
+    if (stripped.empty() || stripped[0] == '#') {
+      continue;
+    }
+    const std::vector<std::string> fields =
+        absl::StrSplit(stripped, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    if (fields.size() != 2) {
+      std::cerr << argv[1] << ":" << line_number
+                << ": expected \"<http method> <url template>\"" << std::endl;
+      return 1;
+    }
+    templates.push_back({fields[0], fields[1]});
+  }
+
+  std::string code;
+  std::string error;
+  if (!GeneratePathMatcherCode(templates, argv[3], &code, &error)) {
+    std::cerr << argv[1] << ": " << error << std::endl;
+    return 1;
+  }
+
+  std::ofstream output(argv[2]);
+  output << code;
+  if (!output) {
+    std::cerr << "Failed to write " << argv[2] << std::endl;
+    return 1;
+  }
+  return 0;
+}
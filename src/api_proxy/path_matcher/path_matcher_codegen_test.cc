@@ -0,0 +1,159 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/api_proxy/path_matcher/path_matcher_codegen.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/api_proxy/path_matcher/codegen_templates_path_matcher.h"
+#include "src/api_proxy/path_matcher/path_matcher.h"
+
+namespace espv2 {
+namespace api_proxy {
+namespace path_matcher {
+namespace {
+
+using Generated = codegen_test::Template;
+
+class PathMatcherCodegenTest : public ::testing::Test {
+ protected:
+  PathMatcherCodegenTest() {
+    PathMatcherBuilder<const Generated*> builder;
+    for (const Generated& tmpl : codegen_test::kTemplates) {
+      EXPECT_TRUE(
+          builder.Register(tmpl.http_method, tmpl.url_template, "", &tmpl));
+    }
+    matcher_ = builder.Build();
+  }
+
+  // Returns the index of the template matched by the runtime matcher.
+  int RuntimeMatch(const std::string& http_method, const std::string& path) {
+    const Generated* tmpl = matcher_->Lookup(http_method, path);
+    return tmpl == nullptr ? -1 : tmpl - codegen_test::kTemplates;
+  }
+
+  PathMatcherPtr<const Generated*> matcher_;
+};
+
+TEST_F(PathMatcherCodegenTest, MatchesTemplates) {
+  struct {
+    std::string http_method;
+    std::string path;
+    std::string url_template;
+  } cases[] = {
+      {"GET", "/shelves", "/shelves"},
+      {"POST", "/shelves", "/shelves"},
+      {"GET", "/shelves/1", "/shelves/{shelf}"},
+      {"GET", "/shelves/1?key=abc", "/shelves/{shelf}"},
+      {"PATCH", "/shelves/1", "/shelves/{shelf.name}"},
+      {"GET", "/shelves/1/books/2", "/shelves/{shelf}/books/{book}"},
+      {"POST", "/shelves/1/books/2:checkout",
+       "/shelves/{shelf}/books/{book}:checkout"},
+      {"POST", "/shelves/1/books/2/checkout",
+       "/shelves/{shelf}/books/{book}:checkout"},
+      {"GET", "/shelves/1/archives/2019/01",
+       "/shelves/{shelf=*}/archives/{archive=**}"},
+      {"GET", "/authors/1/books/a/b/c", "/authors/{author}/books/**"},
+      {"GET", "/authors/1/books", "/authors/{author}/books/**"},
+      {"POST", "/v1/projects/p/locations/l/operations/o:cancel",
+       "/v1/projects/{project}/locations/{location}/operations/"
+       "{operation}:cancel"},
+      {"GET", "/v1/projects/p/locations/l/catalogs/c",
+       "/v1/{name=projects/*/locations/*/catalogs/*}"},
+      {"GET", "/static/css/site.css", "/static/**"},
+      {"GET", "/static/a/b/index.html", "/static/**/index.html"},
+      {"PUT", "/health", "/health"},
+      {"GET", "/debug/vars", "/debug/*"},
+      {"OPTIONS", "/any/path", "/**"},
+      {"GET", "/search:query", "/search:query"},
+      {"GET", "/a/b:export", "/**:export"},
+  };
+
+  for (const auto& c : cases) {
+    const int index = codegen_test::Match(c.http_method, c.path);
+    ASSERT_GE(index, 0) << c.http_method << " " << c.path;
+    EXPECT_EQ(codegen_test::kTemplates[index].url_template, c.url_template)
+        << c.http_method << " " << c.path;
+  }
+
+  EXPECT_EQ(codegen_test::Match("PUT", "/shelves"), -1);
+  EXPECT_EQ(codegen_test::Match("GET", "/shelves/1/books/2/pages"), -1);
+  EXPECT_EQ(codegen_test::Match("GET", "/unknown"), -1);
+}
+
+TEST_F(PathMatcherCodegenTest, SameAsRuntimeMatcher) {
+  const std::vector<std::string> methods = {"GET",    "POST", "PUT",
+                                            "DELETE", "PATCH", "OPTIONS"};
+  const std::vector<std::string> segments = {
+      "shelves", "books",    "1",         "reviews", "authors", "archives",
+      "static",  "v1",       "projects",  "locations", "operations", "catalogs",
+      "health",  "debug",    "index.html", "",       "*",       "**",
+      "2:checkout", "o:cancel", "search:query", "x:export", "b:unknown"};
+
+  // Every path of up to 4 segments, plus a few longer ones.
+  std::vector<std::string> paths = {"", "/", "//", "/?a=b"};
+  std::vector<std::string> prefixes = {""};
+  for (int depth = 0; depth < 4; ++depth) {
+    std::vector<std::string> next;
+    for (const auto& prefix : prefixes) {
+      for (const auto& segment : segments) {
+        next.push_back(prefix + "/" + segment);
+      }
+    }
+    paths.insert(paths.end(), next.begin(), next.end());
+    prefixes = std::move(next);
+  }
+  paths.push_back("/v1/projects/p/locations/l/operations/o");
+  paths.push_back("/v1/projects/p/locations/l/catalogs/c/entries");
+  paths.push_back("/publishers/p/series/s/volumes/v");
+  paths.push_back("/shelves/1/books/2/reviews/3?x=y");
+
+  for (const auto& method : methods) {
+    for (const auto& path : paths) {
+      EXPECT_EQ(codegen_test::Match(method, path), RuntimeMatch(method, path))
+          << method << " " << path;
+    }
+  }
+}
+
+TEST(PathMatcherCodegenErrorTest, InvalidTemplate) {
+  std::string code;
+  std::string error;
+  EXPECT_FALSE(GeneratePathMatcherCode({{"GET", "/shelves/{shelf"}}, "test",
+                                       &code, &error));
+  EXPECT_EQ(error, "invalid url template: /shelves/{shelf");
+}
+
+TEST(PathMatcherCodegenErrorTest, DuplicateTemplate) {
+  std::string code;
+  std::string error;
+  EXPECT_FALSE(GeneratePathMatcherCode(
+      {{"GET", "/shelves/{shelf}"}, {"GET", "/shelves/{id}"}}, "test", &code,
+      &error));
+  EXPECT_EQ(error, "duplicate template: GET /shelves/{id}");
+}
+
+TEST(PathMatcherCodegenErrorTest, NoTemplates) {
+  std::string code;
+  std::string error;
+  EXPECT_FALSE(GeneratePathMatcherCode({}, "test", &code, &error));
+  EXPECT_EQ(error, "no url templates");
+}
+
+}  // namespace
+}  // namespace path_matcher
+}  // namespace api_proxy
+}  // namespace espv2
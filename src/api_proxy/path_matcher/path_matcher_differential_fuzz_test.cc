@@ -0,0 +1,122 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Differential fuzz test of the path matching hot path. The reference
+// implementations are run side by side with the optimized ones on the same
+// input, and must produce the same output:
+//
+// - ExtractRequestParts vs the non-allocating one of the generated matcher.
+// - PathMatcher::Lookup vs the matcher generated by path_matcher_codegen.
+// - PathMatcher::Lookup with and without variable bindings.
+// - VariableBindingsToQueryParameters vs a plain join of the bindings.
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "src/api_proxy/path_matcher/codegen_templates_path_matcher.h"
+#include "src/api_proxy/path_matcher/path_matcher.h"
+#include "src/api_proxy/path_matcher/variable_binding_utils.h"
+#include "test/fuzz/fuzz_runner.h"
+#include "test/fuzz/utility.h"
+#include "tests/fuzz/differential_fuzz.h"
+#include "tests/fuzz/structured_inputs/path_matcher_differential.pb.validate.h"
+
+namespace espv2 {
+namespace api_proxy {
+namespace path_matcher {
+namespace fuzz {
+
+using Generated = codegen_test::Template;
+using ::espv2::tests::fuzz::ExecutionTimeTracker;
+
+struct Matchers {
+  Matchers() {
+    PathMatcherBuilder<const Generated*> builder;
+    for (const Generated& tmpl : codegen_test::kTemplates) {
+      FUZZ_ASSERT(
+          builder.Register(tmpl.http_method, tmpl.url_template, "", &tmpl));
+      std::unique_ptr<HttpTemplate> ht(HttpTemplate::Parse(tmpl.url_template));
+      if (!ht->verb().empty()) {
+        custom_verbs.insert(ht->verb());
+      }
+    }
+    runtime = builder.Build();
+  }
+
+  PathMatcherPtr<const Generated*> runtime;
+  std::set<std::string> custom_verbs;
+};
+
+// The reference of VariableBindingsToQueryParameters.
+std::string joinBindings(const std::vector<VariableBinding>& bindings) {
+  return absl::StrJoin(bindings, "&",
+                       [](std::string* out, const VariableBinding& binding) {
+                         absl::StrAppend(out,
+                                         absl::StrJoin(binding.field_path, "."),
+                                         "=", binding.value);
+                       });
+}
+
+DEFINE_PROTO_FUZZER(
+    const espv2::tests::fuzz::protos::PathMatcherDifferentialInput& input) {
+  static const Matchers* matchers = new Matchers();
+  static ExecutionTimeTracker* runtime_tracker =
+      new ExecutionTimeTracker("PathMatcher::Lookup");
+  static ExecutionTimeTracker* generated_tracker =
+      new ExecutionTimeTracker("codegen Match");
+
+  for (const auto& request : input.requests()) {
+    const std::string& method = request.http_method();
+    const std::string& path = request.path();
+
+    const std::vector<std::string> parts =
+        ExtractRequestParts(path, matchers->custom_verbs);
+    const auto generated_parts =
+        codegen_test::internal::ExtractRequestParts(path);
+    FUZZ_ASSERT(parts.size() == generated_parts.size());
+    for (size_t i = 0; i < parts.size(); ++i) {
+      FUZZ_ASSERT(parts[i] == generated_parts[i]);
+    }
+
+    const Generated* runtime = runtime_tracker->run(
+        path, [&]() { return matchers->runtime->Lookup(method, path); });
+    const int generated = generated_tracker->run(
+        path, [&]() { return codegen_test::Match(method, path); });
+    FUZZ_ASSERT(generated ==
+                (runtime == nullptr ? -1 : runtime - codegen_test::kTemplates));
+
+    std::vector<VariableBinding> bindings;
+    FUZZ_ASSERT(matchers->runtime->Lookup(method, path, &bindings) == runtime);
+    FUZZ_ASSERT(VariableBindingsToQueryParameters(bindings) ==
+                joinBindings(bindings));
+  }
+
+  std::vector<VariableBinding> bindings;
+  for (const auto& binding : input.bindings()) {
+    bindings.push_back(
+        {{binding.field_path().begin(), binding.field_path().end()},
+         binding.value()});
+  }
+  FUZZ_ASSERT(VariableBindingsToQueryParameters(bindings) ==
+              joinBindings(bindings));
+}
+
+}  // namespace fuzz
+}  // namespace path_matcher
+}  // namespace api_proxy
+}  // namespace espv2
@@ -15,10 +15,15 @@
 
 #include <time.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <functional>
+#include <utility>
 
 #include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
 #include "google/api/metric.pb.h"
 #include "google/protobuf/timestamp.pb.h"
 #include "google/protobuf/util/time_util.h"
@@ -56,6 +61,34 @@ namespace service_control {
 // It is used for the metric label "cloud.googleapis.com/location".
 const char kDefaultLocation[] = "global";
 
+// The distribution of each sample of a report. It is computed for the first
+// metric of the sample, and copied into the consumer, producer and by consumer
+// metrics of all the operations of the report.
+class SampleDistributions {
+ public:
+  enum Sample {
+    REQUEST_SIZE = 0,
+    RESPONSE_SIZE = 1,
+    REQUEST_TIME = 2,
+    BACKEND_TIME = 3,
+    OVERHEAD_TIME = 4,
+    SAMPLE_COUNT = 5,
+  };
+
+  // Returns nullptr if the distribution of the sample is not computed yet.
+  const Distribution* Find(Sample sample) const {
+    return distributions_[sample].has_value() ? &*distributions_[sample]
+                                              : nullptr;
+  }
+
+  const Distribution& Add(Sample sample, Distribution distribution) {
+    return distributions_[sample].emplace(std::move(distribution));
+  }
+
+ private:
+  std::array<absl::optional<Distribution>, SAMPLE_COUNT> distributions_;
+};
+
 struct SupportedMetric {
   const char* name;
   ::google::api::MetricDescriptor_MetricKind metric_kind;
@@ -66,7 +99,7 @@ struct SupportedMetric {
   Tag tag;
   Mark mark;
   Status (*set)(const SupportedMetric& m, const ReportRequestInfo& info,
-                Operation* operation);
+                SampleDistributions* distributions, Operation* operation);
 };
 
 struct SupportedLabel {
@@ -110,78 +143,90 @@ const DistributionHelperOptions size_distribution = {8, 10.0, 1};
 const double kMsToSecs = 1e-3;
 
 Status AddDistributionMetric(const DistributionHelperOptions& options,
+                             SampleDistributions::Sample sample,
                              const char* metric_name, double value,
+                             SampleDistributions* distributions,
                              Operation* operation) {
-  MetricValue* metric_value = AddMetricValue(metric_name, operation);
-  Distribution distribution;
-  Status status = DistributionHelper::InitExponential(
-      options.buckets, options.growth, options.scale, &distribution);
-  if (!status.ok()) return status;
-  status = DistributionHelper::AddSample(value, &distribution);
-  if (!status.ok()) return status;
-  *metric_value->mutable_distribution_value() = distribution;
+  const Distribution* distribution = distributions->Find(sample);
+  if (distribution == nullptr) {
+    Distribution computed;
+    Status status = DistributionHelper::InitExponential(
+        options.buckets, options.growth, options.scale, &computed);
+    if (!status.ok()) return status;
+    status = DistributionHelper::AddSample(value, &computed);
+    if (!status.ok()) return status;
+    distribution = &distributions->Add(sample, std::move(computed));
+  }
+  *AddMetricValue(metric_name, operation)->mutable_distribution_value() =
+      *distribution;
   return OkStatus();
 }
 
 // Metrics supported by ESPv2.
 
-Status set_int64_metric_to_constant_1(const SupportedMetric& m,
-                                      const ReportRequestInfo&,
-                                      Operation* operation) {
-  AddInt64Metric(m.name, 1l, operation);
+Status set_int64_metric_to_request_count(const SupportedMetric& m,
+                                         const ReportRequestInfo& info,
+                                         SampleDistributions*,
+                                         Operation* operation) {
+  AddInt64Metric(m.name, info.request_count, operation);
   return OkStatus();
 }
 
-Status set_distribution_metric_to_request_size(const SupportedMetric& m,
-                                               const ReportRequestInfo& info,
-                                               Operation* operation) {
+Status set_distribution_metric_to_request_size(
+    const SupportedMetric& m, const ReportRequestInfo& info,
+    SampleDistributions* distributions, Operation* operation) {
   if (info.request_size >= 0) {
-    return AddDistributionMetric(size_distribution, m.name, info.request_size,
-                                 operation);
+    return AddDistributionMetric(size_distribution,
+                                 SampleDistributions::REQUEST_SIZE, m.name,
+                                 info.request_size, distributions, operation);
   }
   return OkStatus();
 }
 
-Status set_distribution_metric_to_response_size(const SupportedMetric& m,
-                                                const ReportRequestInfo& info,
-                                                Operation* operation) {
+Status set_distribution_metric_to_response_size(
+    const SupportedMetric& m, const ReportRequestInfo& info,
+    SampleDistributions* distributions, Operation* operation) {
   if (info.response_size >= 0) {
-    return AddDistributionMetric(size_distribution, m.name, info.response_size,
-                                 operation);
+    return AddDistributionMetric(size_distribution,
+                                 SampleDistributions::RESPONSE_SIZE, m.name,
+                                 info.response_size, distributions, operation);
   }
   return OkStatus();
 }
 
 // TODO: Consider refactoring following 3 functions to avoid duplicate code
-Status set_distribution_metric_to_request_time(const SupportedMetric& m,
-                                               const ReportRequestInfo& info,
-                                               Operation* operation) {
+Status set_distribution_metric_to_request_time(
+    const SupportedMetric& m, const ReportRequestInfo& info,
+    SampleDistributions* distributions, Operation* operation) {
   if (info.latency.request_time_ms >= 0) {
     double request_time_secs = info.latency.request_time_ms * kMsToSecs;
-    return AddDistributionMetric(time_distribution, m.name, request_time_secs,
-                                 operation);
+    return AddDistributionMetric(time_distribution,
+                                 SampleDistributions::REQUEST_TIME, m.name,
+                                 request_time_secs, distributions, operation);
   }
   return OkStatus();
 }
 
-Status set_distribution_metric_to_backend_time(const SupportedMetric& m,
-                                               const ReportRequestInfo& info,
-                                               Operation* operation) {
+Status set_distribution_metric_to_backend_time(
+    const SupportedMetric& m, const ReportRequestInfo& info,
+    SampleDistributions* distributions, Operation* operation) {
   if (info.latency.backend_time_ms >= 0) {
     double backend_time_secs = info.latency.backend_time_ms * kMsToSecs;
-    return AddDistributionMetric(time_distribution, m.name, backend_time_secs,
-                                 operation);
+    return AddDistributionMetric(time_distribution,
+                                 SampleDistributions::BACKEND_TIME, m.name,
+                                 backend_time_secs, distributions, operation);
   }
   return OkStatus();
 }
 
-Status set_distribution_metric_to_overhead_time(const SupportedMetric& m,
-                                                const ReportRequestInfo& info,
-                                                Operation* operation) {
+Status set_distribution_metric_to_overhead_time(
+    const SupportedMetric& m, const ReportRequestInfo& info,
+    SampleDistributions* distributions, Operation* operation) {
   if (info.latency.overhead_time_ms >= 0) {
     double overhead_time_secs = info.latency.overhead_time_ms * kMsToSecs;
-    return AddDistributionMetric(time_distribution, m.name, overhead_time_secs,
-                                 operation);
+    return AddDistributionMetric(time_distribution,
+                                 SampleDistributions::OVERHEAD_TIME, m.name,
+                                 overhead_time_secs, distributions, operation);
   }
   return OkStatus();
 }
@@ -190,14 +235,14 @@ Status set_distribution_metric_to_overhead_time(const SupportedMetric& m,
 //
 //  "serviceruntime.googleapis.com/api/producer/by_consumer/quota_used_count"
 //
-const SupportedMetric supported_metrics[] = {
+constexpr SupportedMetric supported_metrics[] = {
     {
         "serviceruntime.googleapis.com/api/consumer/request_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::START,
         SupportedMetric::CONSUMER,
-        set_int64_metric_to_constant_1,
+        set_int64_metric_to_request_count,
     },
     {
         "serviceruntime.googleapis.com/api/producer/request_count",
@@ -205,7 +250,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::START,
         SupportedMetric::PRODUCER,
-        set_int64_metric_to_constant_1,
+        set_int64_metric_to_request_count,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/request_count",
@@ -213,7 +258,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::FINAL,
         SupportedMetric::PRODUCER_BY_CONSUMER,
-        set_int64_metric_to_constant_1,
+        set_int64_metric_to_request_count,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/request_sizes",
@@ -324,7 +369,7 @@ const SupportedMetric supported_metrics[] = {
     },
 };
 
-const int supported_metrics_count =
+constexpr size_t supported_metrics_count =
     sizeof(supported_metrics) / sizeof(supported_metrics[0]);
 
 constexpr char kServiceControlCallerIp[] =
@@ -530,7 +575,7 @@ Status set_user_agent(const SupportedLabel& l, const ReportRequestInfo&,
   return OkStatus();
 }
 
-const SupportedLabel supported_labels[] = {
+constexpr SupportedLabel supported_labels[] = {
     {
         "/credential_id",
         ::google::api::LabelDescriptor_ValueType_STRING,
@@ -743,9 +788,95 @@ const SupportedLabel supported_labels[] = {
     },
 };
 
-const int supported_labels_count =
+constexpr size_t supported_labels_count =
     sizeof(supported_labels) / sizeof(supported_labels[0]);
 
+// Compile-time index of the metric and label names, for the lookups done for
+// each descriptor of the service config.
+
+// FNV-1a, the same at compile time and at run time.
+constexpr uint64_t HashName(const char* name, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+constexpr size_t NameSize(const char* name) {
+  size_t size = 0;
+  while (name[size] != '\0') {
+    ++size;
+  }
+  return size;
+}
+
+constexpr bool NamesEqual(const char* a, const char* b) {
+  for (; *a != '\0' && *a == *b; ++a, ++b) {
+  }
+  return *a == *b;
+}
+
+// The table positions of the entries, sorted by the hash of their name.
+template <size_t N>
+struct NameIndex {
+  std::array<uint64_t, N> hashes;
+  std::array<size_t, N> positions;
+};
+
+template <class Entry, size_t N>
+constexpr NameIndex<N> BuildNameIndex(const Entry (&table)[N]) {
+  NameIndex<N> index{};
+  for (size_t i = 0; i < N; ++i) {
+    const uint64_t hash = HashName(table[i].name, NameSize(table[i].name));
+    size_t j = i;
+    for (; j > 0 && index.hashes[j - 1] > hash; --j) {
+      index.hashes[j] = index.hashes[j - 1];
+      index.positions[j] = index.positions[j - 1];
+    }
+    index.hashes[j] = hash;
+    index.positions[j] = i;
+  }
+  return index;
+}
+
+template <class Entry, size_t N>
+constexpr bool HasUniqueNames(const Entry (&table)[N]) {
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = i + 1; j < N; ++j) {
+      if (NamesEqual(table[i].name, table[j].name)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(HasUniqueNames(supported_metrics),
+              "A metric is supported twice.");
+static_assert(HasUniqueNames(supported_labels), "A label is supported twice.");
+
+constexpr NameIndex<supported_metrics_count> supported_metrics_index =
+    BuildNameIndex(supported_metrics);
+constexpr NameIndex<supported_labels_count> supported_labels_index =
+    BuildNameIndex(supported_labels);
+
+// Returns the entry of the table with the name, or nullptr. Only the entries
+// with the same name hash are compared.
+template <class Entry, size_t N>
+const Entry* FindByName(const Entry (&table)[N], const NameIndex<N>& index,
+                        const std::string& name) {
+  const uint64_t hash = HashName(name.data(), name.size());
+  auto it = std::lower_bound(index.hashes.begin(), index.hashes.end(), hash);
+  for (; it != index.hashes.end() && *it == hash; ++it) {
+    const Entry& entry = table[index.positions[it - index.hashes.begin()]];
+    if (name == entry.name) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
 // Supported intrinsic labels:
 // "servicecontrol.googleapis.com/operation_name": Operation.operation_name
 // "servicecontrol.googleapis.com/consumer_id": Operation.consumer_id
@@ -935,6 +1066,89 @@ void FillLogEntry(const ReportRequestInfo& info, const std::string& name,
   }
 }
 
+bool IsLabelSelected(const SupportedLabel& l, bool by_consumer) {
+  // The by consumer operation has all labels.
+  return by_consumer || !l.by_consumer_only;
+}
+
+bool IsMetricSelected(const SupportedMetric& m, bool by_consumer,
+                      bool send_consumer_metric) {
+  if (by_consumer) {
+    return m.mark == SupportedMetric::PRODUCER_BY_CONSUMER;
+  }
+  return m.mark != SupportedMetric::PRODUCER_BY_CONSUMER &&
+         (send_consumer_metric || m.mark != SupportedMetric::CONSUMER);
+}
+
+template <class Entry, size_t N>
+constexpr size_t CountSetters(const Entry (&table)[N]) {
+  size_t count = 0;
+  for (size_t i = 0; i < N; ++i) {
+    if (table[i].set != nullptr) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// The setters of all the supported labels and metrics, called in table order
+// with static dispatch, for the builders that report all of them. The
+// unsupported entries are skipped at compile time.
+template <size_t I>
+Status SetSupportedLabel(const ReportRequestInfo& info, bool by_consumer,
+                         Map<std::string, std::string>* labels) {
+  constexpr const SupportedLabel& l = supported_labels[I];
+  if constexpr (l.set == nullptr) {
+    return OkStatus();
+  } else {
+    if (!IsLabelSelected(l, by_consumer)) {
+      return OkStatus();
+    }
+    return l.set(l, info, labels);
+  }
+}
+
+template <size_t... I>
+Status SetAllLabels(const ReportRequestInfo& info, bool by_consumer,
+                    Map<std::string, std::string>* labels,
+                    std::index_sequence<I...>) {
+  Status status;
+  // Stops at the first error, as the loop over the selected labels does.
+  (void)((status = SetSupportedLabel<I>(info, by_consumer, labels)).ok() &&
+         ...);
+  return status;
+}
+
+template <size_t I>
+Status AddSupportedMetric(const ReportRequestInfo& info, bool by_consumer,
+                          bool send_consumer_metric,
+                          SampleDistributions* distributions,
+                          Operation* operation) {
+  constexpr const SupportedMetric& m = supported_metrics[I];
+  if constexpr (m.set == nullptr) {
+    return OkStatus();
+  } else {
+    if (!IsMetricSelected(m, by_consumer, send_consumer_metric)) {
+      return OkStatus();
+    }
+    return m.set(m, info, distributions, operation);
+  }
+}
+
+template <size_t... I>
+Status AddAllMetrics(const ReportRequestInfo& info, bool by_consumer,
+                     bool send_consumer_metric,
+                     SampleDistributions* distributions, Operation* operation,
+                     std::index_sequence<I...>) {
+  Status status;
+  (void)((status = AddSupportedMetric<I>(info, by_consumer,
+                                         send_consumer_metric, distributions,
+                                         operation))
+             .ok() &&
+         ...);
+  return status;
+}
+
 template <class Element>
 std::vector<const Element*> FilterPointers(
     const Element* first, const Element* last,
@@ -961,6 +1175,8 @@ RequestBuilder::RequestBuilder(const std::set<std::string>& logs,
       labels_(FilterPointers<SupportedLabel>(
           supported_labels, supported_labels + supported_labels_count,
           [](const struct SupportedLabel* l) { return l->set != nullptr; })),
+      all_metrics_(metrics_.size() == CountSetters(supported_metrics)),
+      all_labels_(labels_.size() == CountSetters(supported_labels)),
       service_name_(service_name),
       service_config_id_(service_config_id) {}
 
@@ -981,6 +1197,8 @@ RequestBuilder::RequestBuilder(const std::set<std::string>& logs,
             return l->set && (l->kind == SupportedLabel::SYSTEM ||
                               labels.find(l->name) != labels.end());
           })),
+      all_metrics_(metrics_.size() == CountSetters(supported_metrics)),
+      all_labels_(labels_.size() == CountSetters(supported_labels)),
       service_name_(service_name),
       service_config_id_(service_config_id) {}
 
@@ -1104,32 +1322,13 @@ Status RequestBuilder::FillReportRequest(const ReportRequestInfo& info,
   }
 
   // Only populate metrics if we can associate them with a method/operation.
+  SampleDistributions distributions;
   if (!info.operation_id.empty() && !info.operation_name.empty()) {
-    Map<std::string, std::string>* labels = op->mutable_labels();
-    // Set all labels with by_consumer_only is false
-    for (auto it = labels_.begin(), end = labels_.end(); it != end; it++) {
-      const SupportedLabel* l = *it;
-      if (l->set && !l->by_consumer_only) {
-        status = (l->set)(*l, info, labels);
-        if (!status.ok()) return status;
-      }
-    }
+    status = SetLabels(info, /*by_consumer=*/false, op->mutable_labels());
+    if (!status.ok()) return status;
 
-    // Report will reject consumer metric if it's based on a invalid/unknown api
-    // key, or if the service is not activated in the consumer project.
-    bool send_consumer_metric = info.check_response_info.api_key_state ==
-                                api_key::ApiKeyState::VERIFIED;
-
-    // Populate all metrics.
-    for (auto it = metrics_.begin(), end = metrics_.end(); it != end; it++) {
-      const SupportedMetric* m = *it;
-      if (send_consumer_metric || m->mark != SupportedMetric::CONSUMER) {
-        if (m->set && m->mark != SupportedMetric::PRODUCER_BY_CONSUMER) {
-          status = (m->set)(*m, info, op);
-          if (!status.ok()) return status;
-        }
-      }
-    }
+    status = AddMetrics(info, /*by_consumer=*/false, &distributions, op);
+    if (!status.ok()) return status;
   }
 
   // Fill log entries.
@@ -1139,7 +1338,8 @@ Status RequestBuilder::FillReportRequest(const ReportRequestInfo& info,
   }
 
   if (!info.check_response_info.consumer_project_number.empty()) {
-    return AppendByConsumerOperations(info, request, current_time);
+    return AppendByConsumerOperations(info, request, current_time,
+                                      &distributions);
   }
 
   return OkStatus();
@@ -1149,6 +1349,15 @@ Status RequestBuilder::AppendByConsumerOperations(
     const ReportRequestInfo& info,
     ::google::api::servicecontrol::v1::ReportRequest* request,
     Timestamp current_time) const {
+  SampleDistributions distributions;
+  return AppendByConsumerOperations(info, request, current_time,
+                                    &distributions);
+}
+
+Status RequestBuilder::AppendByConsumerOperations(
+    const ReportRequestInfo& info,
+    ::google::api::servicecontrol::v1::ReportRequest* request,
+    Timestamp current_time, SampleDistributions* distributions) const {
   Operation* op = request->add_operations();
   SetOperationCommonFields(info, current_time, op);
   if (info.check_response_info.api_key_state ==
@@ -1163,50 +1372,68 @@ Status RequestBuilder::AppendByConsumerOperations(
 
   // Only populate metrics if we can associate them with a method/operation.
   if (!info.operation_id.empty() && !info.operation_name.empty()) {
-    Map<std::string, std::string>* labels = op->mutable_labels();
-    // Set all labels.
-    for (auto it = labels_.begin(), end = labels_.end(); it != end; it++) {
-      const SupportedLabel* l = *it;
-      if (l->set) {
-        Status status = (l->set)(*l, info, labels);
-        if (!status.ok()) return status;
-      }
-    }
+    Status status = SetLabels(info, /*by_consumer=*/true, op->mutable_labels());
+    if (!status.ok()) return status;
 
-    // Populate all metrics.
-    for (auto it = metrics_.begin(), end = metrics_.end(); it != end; it++) {
-      const SupportedMetric* m = *it;
-      if (m->set && m->mark == SupportedMetric::PRODUCER_BY_CONSUMER) {
-        Status status = (m->set)(*m, info, op);
-        if (!status.ok()) return status;
-      }
+    status = AddMetrics(info, /*by_consumer=*/true, distributions, op);
+    if (!status.ok()) return status;
+  }
+
+  return OkStatus();
+}
+
+Status RequestBuilder::SetLabels(const ReportRequestInfo& info,
+                                 bool by_consumer,
+                                 Map<std::string, std::string>* labels) const {
+  if (all_labels_) {
+    return SetAllLabels(info, by_consumer, labels,
+                        std::make_index_sequence<supported_labels_count>());
+  }
+  for (const SupportedLabel* l : labels_) {
+    if (l->set && IsLabelSelected(*l, by_consumer)) {
+      Status status = (l->set)(*l, info, labels);
+      if (!status.ok()) return status;
     }
   }
+  return OkStatus();
+}
 
+Status RequestBuilder::AddMetrics(const ReportRequestInfo& info,
+                                  bool by_consumer,
+                                  SampleDistributions* distributions,
+                                  Operation* operation) const {
+  // Report will reject consumer metric if it's based on a invalid/unknown api
+  // key, or if the service is not activated in the consumer project.
+  const bool send_consumer_metric = info.check_response_info.api_key_state ==
+                                    api_key::ApiKeyState::VERIFIED;
+
+  if (all_metrics_) {
+    return AddAllMetrics(info, by_consumer, send_consumer_metric,
+                         distributions, operation,
+                         std::make_index_sequence<supported_metrics_count>());
+  }
+  for (const SupportedMetric* m : metrics_) {
+    if (m->set && IsMetricSelected(*m, by_consumer, send_consumer_metric)) {
+      Status status = (m->set)(*m, info, distributions, operation);
+      if (!status.ok()) return status;
+    }
+  }
   return OkStatus();
 }
 
 bool RequestBuilder::IsMetricSupported(
     const ::google::api::MetricDescriptor& metric) {
-  for (int i = 0; i < supported_metrics_count; i++) {
-    const SupportedMetric& m = supported_metrics[i];
-    if (metric.name() == m.name && metric.metric_kind() == m.metric_kind &&
-        metric.value_type() == m.value_type) {
-      return true;
-    }
-  }
-  return false;
+  const SupportedMetric* m = FindByName(
+      supported_metrics, supported_metrics_index, metric.name());
+  return m != nullptr && metric.metric_kind() == m->metric_kind &&
+         metric.value_type() == m->value_type;
 }
 
 bool RequestBuilder::IsLabelSupported(
     const ::google::api::LabelDescriptor& label) {
-  for (int i = 0; i < supported_labels_count; i++) {
-    const SupportedLabel& l = supported_labels[i];
-    if (label.key() == l.name && label.value_type() == l.value_type) {
-      return true;
-    }
-  }
-  return false;
+  const SupportedLabel* l =
+      FindByName(supported_labels, supported_labels_index, label.key());
+  return l != nullptr && label.value_type() == l->value_type;
 }
 
 }  // namespace service_control
@@ -28,6 +28,8 @@ namespace espv2 {
 namespace api_proxy {
 namespace service_control {
 
+class SampleDistributions;
+
 class RequestBuilder final {
  public:
   // Initializes RequestBuilder with all supported metrics and labels.
@@ -78,9 +80,32 @@ class RequestBuilder final {
   const std::string& service_config_id() const { return service_config_id_; }
 
  private:
+  // Same as above, with the sample distributions already computed for the
+  // first operation of the report.
+  ::google::protobuf::util::Status AppendByConsumerOperations(
+      const ReportRequestInfo& info,
+      ::google::api::servicecontrol::v1::ReportRequest* request,
+      ::google::protobuf::Timestamp current_time,
+      SampleDistributions* distributions) const;
+
+  // Sets the labels and adds the metrics of an operation, or of the by
+  // consumer one. The distributions are shared by all the operations of a
+  // report.
+  ::google::protobuf::util::Status SetLabels(
+      const ReportRequestInfo& info, bool by_consumer,
+      ::google::protobuf::Map<std::string, std::string>* labels) const;
+  ::google::protobuf::util::Status AddMetrics(
+      const ReportRequestInfo& info, bool by_consumer,
+      SampleDistributions* distributions,
+      ::google::api::servicecontrol::v1::Operation* operation) const;
+
   const std::vector<std::string> logs_;
   const std::vector<const struct SupportedMetric*> metrics_;
   const std::vector<const struct SupportedLabel*> labels_;
+  // Whether metrics_ and labels_ have all the supported entries. They are then
+  // set through a table known at compile time instead of the pointers.
+  const bool all_metrics_;
+  const bool all_labels_;
   const std::string service_name_;
   const std::string service_config_id_;
 };
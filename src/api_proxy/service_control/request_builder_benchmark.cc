@@ -0,0 +1,185 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the metric and label registry of the RequestBuilder: the lookups
+// done for each descriptor of a service config, and the filling of report
+// requests with all or some of the supported metrics and labels.
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "src/api_proxy/service_control/request_builder.h"
+#include "src/api_proxy/utils/version.h"
+
+namespace espv2 {
+namespace api_proxy {
+namespace service_control {
+namespace {
+
+using ::google::api::LabelDescriptor;
+using ::google::api::MetricDescriptor;
+using ::google::api::servicecontrol::v1::ReportRequest;
+
+// The descriptors of a service config: mostly the supported ones, and some
+// custom ones.
+const std::vector<MetricDescriptor>& Metrics() {
+  static const auto* metrics = [] {
+    auto* metrics = new std::vector<MetricDescriptor>;
+    for (const char* name : {
+             "serviceruntime.googleapis.com/api/consumer/request_count",
+             "serviceruntime.googleapis.com/api/producer/request_count",
+             "serviceruntime.googleapis.com/api/producer/by_consumer/"
+             "request_count",
+             "serviceruntime.googleapis.com/api/consumer/error_count",
+             "serviceruntime.googleapis.com/api/producer/error_count",
+             "example.googleapis.com/custom/request_count",
+         }) {
+      MetricDescriptor metric;
+      metric.set_name(name);
+      metric.set_metric_kind(MetricDescriptor::DELTA);
+      metric.set_value_type(MetricDescriptor::INT64);
+      metrics->push_back(metric);
+    }
+    for (const char* name : {
+             "serviceruntime.googleapis.com/api/consumer/request_sizes",
+             "serviceruntime.googleapis.com/api/producer/response_sizes",
+             "serviceruntime.googleapis.com/api/consumer/total_latencies",
+             "serviceruntime.googleapis.com/api/producer/backend_latencies",
+             "serviceruntime.googleapis.com/api/producer/by_consumer/"
+             "request_overhead_latencies",
+             "example.googleapis.com/custom/latencies",
+         }) {
+      MetricDescriptor metric;
+      metric.set_name(name);
+      metric.set_metric_kind(MetricDescriptor::DELTA);
+      metric.set_value_type(MetricDescriptor::DISTRIBUTION);
+      metrics->push_back(metric);
+    }
+    return metrics;
+  }();
+  return *metrics;
+}
+
+const std::vector<LabelDescriptor>& Labels() {
+  static const auto* labels = [] {
+    auto* labels = new std::vector<LabelDescriptor>;
+    for (const char* key : {
+             "/credential_id",
+             "/end_user",
+             "/error_type",
+             "/protocol",
+             "/response_code",
+             "/response_code_class",
+             "/status_code",
+             "cloud.googleapis.com/location",
+             "servicecontrol.googleapis.com/platform",
+             "servicecontrol.googleapis.com/service_agent",
+             "servicecontrol.googleapis.com/user_agent",
+             "serviceruntime.googleapis.com/api_method",
+             "serviceruntime.googleapis.com/api_version",
+             "example.googleapis.com/custom_label",
+         }) {
+      LabelDescriptor label;
+      label.set_key(key);
+      labels->push_back(label);
+    }
+    return labels;
+  }();
+  return *labels;
+}
+
+ReportRequestInfo Info() {
+  ReportRequestInfo info;
+  info.operation_id = "operation_id";
+  info.operation_name = "operation_name";
+  info.api_key = "api_key_x";
+  info.producer_project_id = "project_id";
+  info.current_time = std::chrono::system_clock::time_point(
+      std::chrono::microseconds(100000000100));
+  info.http_response_code = 200;
+  info.location = "us-central";
+  info.api_name = "api-name";
+  info.api_version = "api-version";
+  info.api_method = "api-method";
+  info.request_size = 100;
+  info.response_size = 1024 * 1024;
+  info.latency.request_time_ms = 123;
+  info.latency.backend_time_ms = 101;
+  info.latency.overhead_time_ms = 22;
+  info.frontend_protocol = protocol::HTTP;
+  info.compute_platform = "GKE";
+  info.check_response_info.api_key_state = api_key::ApiKeyState::VERIFIED;
+  info.check_response_info.consumer_project_number = "12345";
+  return info;
+}
+
+void BM_IsMetricSupported(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const MetricDescriptor& metric : Metrics()) {
+      benchmark::DoNotOptimize(RequestBuilder::IsMetricSupported(metric));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Metrics().size());
+}
+BENCHMARK(BM_IsMetricSupported);
+
+void BM_IsLabelSupported(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const LabelDescriptor& label : Labels()) {
+      benchmark::DoNotOptimize(RequestBuilder::IsLabelSupported(label));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Labels().size());
+}
+BENCHMARK(BM_IsLabelSupported);
+
+// The builder of a service config without metric and label descriptors
+// reports all the supported ones.
+void BM_FillReportRequestAll(benchmark::State& state) {
+  utils::Version::instance().set("TEST.0.0");
+  const RequestBuilder builder({}, "test_service", "2016-09-19r0");
+  const ReportRequestInfo info = Info();
+  for (auto _ : state) {
+    ReportRequest request;
+    benchmark::DoNotOptimize(builder.FillReportRequest(info, &request));
+  }
+}
+BENCHMARK(BM_FillReportRequestAll);
+
+void BM_FillReportRequestSelected(benchmark::State& state) {
+  utils::Version::instance().set("TEST.0.0");
+  std::set<std::string> metrics;
+  for (const MetricDescriptor& metric : Metrics()) {
+    metrics.insert(metric.name());
+  }
+  std::set<std::string> labels;
+  for (const LabelDescriptor& label : Labels()) {
+    labels.insert(label.key());
+  }
+  const RequestBuilder builder({}, metrics, labels, "test_service",
+                               "2016-09-19r0");
+  const ReportRequestInfo info = Info();
+  for (auto _ : state) {
+    ReportRequest request;
+    benchmark::DoNotOptimize(builder.FillReportRequest(info, &request));
+  }
+}
+BENCHMARK(BM_FillReportRequestSelected);
+
+}  // namespace
+}  // namespace service_control
+}  // namespace api_proxy
+}  // namespace espv2
@@ -20,6 +20,7 @@
 #include <fstream>
 #include <string>
 
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_replace.h"
 #include "google/protobuf/struct.pb.h"
@@ -158,6 +159,52 @@ TEST(RequestBuilder, TestRequestBuilderbufStruct) {
   ASSERT_FALSE(fields->empty());
 }
 
+TEST(RequestBuilder, IsMetricSupported) {
+  ::google::api::MetricDescriptor metric;
+  metric.set_name("serviceruntime.googleapis.com/api/producer/request_count");
+  metric.set_metric_kind(::google::api::MetricDescriptor::DELTA);
+  metric.set_value_type(::google::api::MetricDescriptor::INT64);
+  EXPECT_TRUE(RequestBuilder::IsMetricSupported(metric));
+
+  metric.set_value_type(::google::api::MetricDescriptor::DISTRIBUTION);
+  EXPECT_FALSE(RequestBuilder::IsMetricSupported(metric));
+  metric.set_name(
+      "serviceruntime.googleapis.com/api/producer/by_consumer/"
+      "request_overhead_latencies");
+  EXPECT_TRUE(RequestBuilder::IsMetricSupported(metric));
+  metric.set_metric_kind(::google::api::MetricDescriptor::GAUGE);
+  EXPECT_FALSE(RequestBuilder::IsMetricSupported(metric));
+
+  metric.set_metric_kind(::google::api::MetricDescriptor::DELTA);
+  for (const std::string& name :
+       {"", "serviceruntime.googleapis.com/api/producer/by_consumer/",
+        "serviceruntime.googleapis.com/api/producer/request_sizesX",
+        "example.googleapis.com/custom_metric"}) {
+    metric.set_name(name);
+    EXPECT_FALSE(RequestBuilder::IsMetricSupported(metric)) << name;
+  }
+}
+
+TEST(RequestBuilder, IsLabelSupported) {
+  ::google::api::LabelDescriptor label;
+  for (const std::string& key :
+       {"/credential_id", "/end_user",
+        "servicecontrol.googleapis.com/caller_ip",
+        "serviceruntime.googleapis.com/consumer_project"}) {
+    label.set_key(key);
+    EXPECT_TRUE(RequestBuilder::IsLabelSupported(label)) << key;
+  }
+
+  label.set_value_type(::google::api::LabelDescriptor::INT64);
+  EXPECT_FALSE(RequestBuilder::IsLabelSupported(label));
+
+  label.set_value_type(::google::api::LabelDescriptor::STRING);
+  for (const std::string& key : {"", "/", "/credential", "/credential_idX"}) {
+    label.set_key(key);
+    EXPECT_FALSE(RequestBuilder::IsLabelSupported(label)) << key;
+  }
+}
+
 TEST_F(RequestBuilderTest, FillGoodCheckRequestTest) {
   CheckRequestInfo info;
   FillOperationInfo(&info);
@@ -479,6 +526,25 @@ TEST_F(RequestBuilderTest, CredentailIdIssuerAudienceTest) {
             "jwtauth:issuer=YXV0aC1pc3N1ZXI&audience=YXV0aC1hdWRpZW5jZQ");
 }
 
+TEST_F(RequestBuilderTest, ReportRolledUpRequestCountTest) {
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  info.request_count = 42;
+
+  gasv1::ReportRequest request;
+  ASSERT_TRUE(scp_.FillReportRequest(info, &request).ok());
+
+  int request_count_metrics = 0;
+  for (const auto& metric_value_set :
+       request.operations(0).metric_value_sets()) {
+    if (absl::EndsWith(metric_value_set.metric_name(), "/request_count")) {
+      ++request_count_metrics;
+      ASSERT_EQ(metric_value_set.metric_values(0).int64_value(), 42);
+    }
+  }
+  ASSERT_GT(request_count_metrics, 0);
+}
+
 }  // namespace
 
 }  // namespace service_control
@@ -229,6 +229,10 @@ struct ReportRequestInfo : public OperationInfo {
   // per request latency.
   LatencyInfo latency;
 
+  // The number of requests this report stands for. Only greater than 1 for
+  // reports rolled up from many denied requests.
+  int64_t request_count;
+
   // The message to log as INFO log.
   std::string log_message;
 
@@ -274,6 +278,7 @@ struct ReportRequestInfo : public OperationInfo {
       : http_response_code(0),
         request_size(-1),
         response_size(-1),
+        request_count(1),
         frontend_protocol(protocol::UNKNOWN),
         backend_protocol(protocol::UNKNOWN),
         compute_platform("UNKNOWN(ESPv2)") {}
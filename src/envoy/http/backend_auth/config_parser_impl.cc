@@ -84,6 +84,22 @@ AudienceContext::AudienceContext(
           error_behavior, callback);
     }
       return;
+    case FilterConfig::IdTokenInfoCase::kTokenBroker: {
+      const std::string& uri = filter_config.token_broker().uri();
+      const std::string& cluster = filter_config.token_broker().cluster();
+      const std::chrono::seconds fetch_timeout(
+          TimeUtil::DurationToSeconds(filter_config.token_broker().timeout()));
+      const DependencyErrorBehavior error_behavior =
+          filter_config.dep_error_behavior();
+      const std::string real_uri =
+          absl::StrCat(uri, "?audience=", jwt_audience);
+
+      broker_token_sub_ptr_ =
+          token_subscriber_factory.createBrokerTokenSubscriber(
+              TokenType::IdentityToken, cluster, real_uri, fetch_timeout,
+              error_behavior, callback);
+    }
+      return;
     default:
       PANIC(absl::StrCat("invalid id token case: ",
                          filter_config.id_token_info_case()));
@@ -52,6 +52,7 @@ class AudienceContext {
   Envoy::ThreadLocal::TypedSlot<TokenCache> tls_;
   token::TokenSubscriberPtr iam_token_sub_ptr_;
   token::TokenSubscriberPtr imds_token_sub_ptr_;
+  token::TokenSubscriberPtr broker_token_sub_ptr_;
 };
 
 using AudienceContextPtr = std::unique_ptr<AudienceContext>;
@@ -96,6 +96,41 @@ imds_token {
   EXPECT_EQ(config_parser_->getJwtToken("audience-non-existent"), nullptr);
 }
 
+TEST_F(ConfigParserImplTest, GetIdTokenByTokenBroker) {
+  const char filter_config[] = R"(
+jwt_audience_list: ["audience-foo"]
+token_broker {
+  uri: "this-is-uri"
+  cluster: "this-is-cluster"
+  timeout: {
+    seconds: 20
+  }
+}
+)";
+  const std::string token_foo("token-foo");
+
+  EXPECT_CALL(mock_token_subscriber_factory_,
+              createImdsTokenSubscriber(_, _, _, _, _, _))
+      .Times(0);
+  EXPECT_CALL(mock_token_subscriber_factory_,
+              createBrokerTokenSubscriber(
+                  token::TokenType::IdentityToken, "this-is-cluster",
+                  "this-is-uri?audience=audience-foo",
+                  std::chrono::seconds(20), _, _))
+      .WillOnce(Invoke([&token_foo](const token::TokenType&, const std::string&,
+                                    const std::string&, std::chrono::seconds,
+                                    DependencyErrorBehavior,
+                                    token::UpdateTokenCallback callback)
+                           -> token::TokenSubscriberPtr {
+        callback(token_foo);
+        return nullptr;
+      }));
+
+  setUp(filter_config);
+
+  EXPECT_EQ(*config_parser_->getJwtToken("audience-foo"), "token-foo");
+}
+
 TEST_F(ConfigParserImplTest, GetIdTokenByIam) {
   const char filter_config[] = R"(
 jwt_audience_list: ["audience-foo","audience-bar"]
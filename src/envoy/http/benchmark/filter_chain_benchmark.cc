@@ -0,0 +1,605 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how the ESPv2 filter chain scales with the number of workers.
+//
+// Each worker is a thread running its own dispatcher, registered with a thread
+// local instance as in Envoy, which runs requests through the service_control,
+// backend_auth, path_rewrite and grpc_metadata_scrubber filters. The upstreams
+// are mocked: the Service Control calls succeed right away, and the backend
+// tokens are pushed by the benchmark.
+//
+// The second argument enables the paths shared by the workers:
+//   - 0: each worker has its own filter configs and stats, and the tokens are
+//     not updated. Only the per-worker ESPv2 code runs.
+//   - 1: the workers share the filter configs and stats as in Envoy, and the
+//     main thread updates the tokens every millisecond, which posts them to
+//     all the workers.
+//
+// Besides the time, each run reports:
+//   - req/s/core: the requests per second, per core in use.
+//   - chain_ns/req: the time in the filters, per request.
+//   - shared_ns/req: the time the workers spent out of the filters, running
+//     the tasks posted by the main thread such as the token updates.
+// The difference of chain_ns/req between the two modes is the cost of the
+// shared stats.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "api/envoy/v11/http/backend_auth/config.pb.h"
+#include "api/envoy/v11/http/path_rewrite/config.pb.h"
+#include "api/envoy/v11/http/service_control/config.pb.h"
+#include "benchmark/benchmark.h"
+#include "google/protobuf/text_format.h"
+#include "source/common/stats/isolated_store_impl.h"
+#include "source/common/thread_local/thread_local_impl.h"
+#include "source/common/tracing/http_tracer_impl.h"
+#include "src/envoy/http/backend_auth/config_parser_impl.h"
+#include "src/envoy/http/backend_auth/filter.h"
+#include "src/envoy/http/grpc_metadata_scrubber/filter.h"
+#include "src/envoy/http/path_rewrite/config_parser_impl.h"
+#include "src/envoy/http/path_rewrite/filter.h"
+#include "src/envoy/http/service_control/config_parser.h"
+#include "src/envoy/http/service_control/filter.h"
+#include "src/envoy/http/service_control/filter_stats.h"
+#include "src/envoy/http/service_control/handler_impl.h"
+#include "src/envoy/http/service_control/service_control_call.h"
+#include "src/envoy/token/token_subscriber_factory.h"
+#include "test/benchmark/main.h"
+#include "test/common/stream_info/test_util.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/router/mocks.h"
+#include "test/mocks/server/mocks.h"
+#include "test/test_common/utility.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace {
+
+using ::espv2::api::envoy::v11::http::common::DependencyErrorBehavior;
+using ::espv2::api_proxy::service_control::CheckRequestInfo;
+using ::espv2::api_proxy::service_control::CheckResponseInfo;
+using ::espv2::api_proxy::service_control::QuotaRequestInfo;
+using ::espv2::api_proxy::service_control::QuotaResponseInfo;
+using ::espv2::api_proxy::service_control::ReportRequestInfo;
+using ::google::protobuf::TextFormat;
+using ::testing::NiceMock;
+using ::testing::ReturnRef;
+using BackendAuthProtoConfig =
+    ::espv2::api::envoy::v11::http::backend_auth::FilterConfig;
+
+// The requests each worker runs per iteration.
+constexpr int kRequestsPerIteration = 1000;
+// The requests a worker runs before going back to its event loop.
+constexpr int kRequestsPerChunk = 50;
+// The interval between the token updates, when the shared paths are enabled.
+constexpr absl::Duration kTokenUpdateInterval = absl::Milliseconds(1);
+
+constexpr char kOperationName[] = "1.bookstore.GetBook";
+constexpr char kAudience[] = "https://bookstore-backend.example.com";
+
+constexpr char kServiceControlConfig[] = R"(
+services {
+  service_name: "bookstore.endpoints.example.com"
+  producer_project_id: "project-id"
+  backend_protocol: "http1"
+}
+requirements {
+  service_name: "bookstore.endpoints.example.com"
+  operation_name: "1.bookstore.GetBook"
+  api_name: "bookstore"
+  api_version: "v1"
+  api_key {
+    locations {
+      query: "key"
+    }
+  }
+}
+)";
+
+constexpr char kBackendAuthConfig[] = R"(
+jwt_audience_list: "https://bookstore-backend.example.com"
+imds_token {
+  uri: "http://metadata.google.internal/computeMetadata/v1/instance/service-accounts/default/identity"
+  cluster: "metadata-cluster"
+  timeout {
+    seconds: 5
+  }
+}
+)";
+
+template <class ProtoType>
+ProtoType parseProto(const char* text) {
+  ProtoType proto;
+  RELEASE_ASSERT(TextFormat::ParseFromString(text, &proto),
+                 absl::StrCat("invalid config: ", text));
+  return proto;
+}
+
+// The Service Control server: all the calls succeed right away.
+class FakeServiceControlCall : public service_control::ServiceControlCall {
+ public:
+  service_control::CancelFunc callCheck(
+      const CheckRequestInfo&, Envoy::Tracing::Span&,
+      service_control::CheckDoneFunc on_done) override {
+    on_done(::google::protobuf::util::OkStatus(), CheckResponseInfo());
+    return nullptr;
+  }
+
+  void callQuota(const QuotaRequestInfo&,
+                 service_control::QuotaDoneFunc on_done) override {
+    on_done(::google::protobuf::util::OkStatus(), QuotaResponseInfo());
+  }
+
+  void callReport(const ReportRequestInfo&) override {}
+
+  bool rollupDeniedReport(
+      absl::string_view, const service_control::LocalReply&,
+      const service_control::DeniedReportFillFunc&) override {
+    return false;
+  }
+};
+
+class FakeServiceControlCallFactory
+    : public service_control::ServiceControlCallFactory {
+ public:
+  service_control::ServiceControlCallPtr create(
+      const ::espv2::api::envoy::v11::http::service_control::Service&)
+      override {
+    return std::make_unique<FakeServiceControlCall>();
+  }
+};
+
+// The token servers: the token callbacks are kept, for the benchmark to push
+// the tokens.
+class FakeTokenSubscriberFactory : public token::TokenSubscriberFactory {
+ public:
+  token::TokenSubscriberPtr createImdsTokenSubscriber(
+      const token::TokenType&, const std::string&, const std::string&,
+      std::chrono::seconds, DependencyErrorBehavior,
+      token::UpdateTokenCallback callback) const override {
+    callbacks_.push_back(std::move(callback));
+    return nullptr;
+  }
+
+  token::TokenSubscriberPtr createBrokerTokenSubscriber(
+      const token::TokenType&, const std::string&, const std::string&,
+      std::chrono::seconds, DependencyErrorBehavior,
+      token::UpdateTokenCallback callback) const override {
+    callbacks_.push_back(std::move(callback));
+    return nullptr;
+  }
+
+  token::TokenSubscriberPtr createIamTokenSubscriber(
+      const token::TokenType&, const std::string&, const std::string&,
+      std::chrono::seconds, DependencyErrorBehavior,
+      token::UpdateTokenCallback callback,
+      const ::google::protobuf::RepeatedPtrField<std::string>&,
+      const ::google::protobuf::RepeatedPtrField<std::string>&,
+      token::GetTokenFunc) const override {
+    callbacks_.push_back(std::move(callback));
+    return nullptr;
+  }
+
+  // Must be called on the main thread, as the token fetches complete.
+  void updateTokens(absl::string_view token) const {
+    for (const auto& callback : callbacks_) {
+      callback(token);
+    }
+  }
+
+ private:
+  mutable std::vector<token::UpdateTokenCallback> callbacks_;
+};
+
+// The hot methods of the mocks below do not go through gmock, which would
+// serialize the workers on its global mutex.
+class BenchmarkRoute : public Envoy::Router::MockRoute {
+ public:
+  const Envoy::Router::RouteEntry* routeEntry() const override {
+    return &route_entry_;
+  }
+};
+
+// The decoder callbacks of a filter, on a worker.
+class BenchmarkDecoderFilterCallbacks
+    : public Envoy::Http::MockStreamDecoderFilterCallbacks {
+ public:
+  BenchmarkDecoderFilterCallbacks(
+      Envoy::Event::Dispatcher& dispatcher,
+      Envoy::Router::RouteConstSharedPtr route,
+      const Envoy::Router::RouteSpecificFilterConfig& per_route)
+      : worker_dispatcher_(dispatcher),
+        benchmark_route_(std::move(route)),
+        per_route_config_(per_route) {}
+
+  void setStreamInfo(Envoy::StreamInfo::StreamInfo& stream_info) {
+    current_stream_info_ = &stream_info;
+  }
+
+  Envoy::Event::Dispatcher& dispatcher() override { return worker_dispatcher_; }
+  Envoy::Router::RouteConstSharedPtr route() override {
+    return benchmark_route_;
+  }
+  Envoy::StreamInfo::StreamInfo& streamInfo() override {
+    return *current_stream_info_;
+  }
+  Envoy::Tracing::Span& activeSpan() override {
+    return Envoy::Tracing::NullSpan::instance();
+  }
+  const Envoy::Router::RouteSpecificFilterConfig* mostSpecificPerFilterConfig()
+      const override {
+    return &per_route_config_;
+  }
+
+ private:
+  Envoy::Event::Dispatcher& worker_dispatcher_;
+  const Envoy::Router::RouteConstSharedPtr benchmark_route_;
+  const Envoy::Router::RouteSpecificFilterConfig& per_route_config_;
+  Envoy::StreamInfo::StreamInfo* current_stream_info_{};
+};
+
+class BackendAuthFilterConfig : public backend_auth::FilterConfig {
+ public:
+  BackendAuthFilterConfig(
+      Envoy::Stats::Scope& scope,
+      Envoy::Server::Configuration::FactoryContext& context,
+      const token::TokenSubscriberFactory& token_subscriber_factory)
+      : proto_config_(
+            parseProto<BackendAuthProtoConfig>(kBackendAuthConfig)),
+        stats_{ALL_BACKEND_AUTH_FILTER_STATS(
+            POOL_COUNTER_PREFIX(scope, "backend_auth."))},
+        config_parser_(proto_config_, context, token_subscriber_factory) {}
+
+  backend_auth::FilterStats& stats() override { return stats_; }
+  const backend_auth::FilterConfigParser& cfg_parser() const override {
+    return config_parser_;
+  }
+
+ private:
+  const BackendAuthProtoConfig proto_config_;
+  backend_auth::FilterStats stats_;
+  backend_auth::FilterConfigParserImpl config_parser_;
+};
+
+// The configs of the filter chain and their stats, as created by the filter
+// factories on the main thread, with the per-route configs of the route.
+class FilterChainConfig {
+ public:
+  FilterChainConfig(Envoy::Api::Api& api, Envoy::ThreadLocal::Instance& tls,
+                    const token::TokenSubscriberFactory& token_factory)
+      : sc_proto_config_(parseProto<
+                         ::espv2::api::envoy::v11::http::service_control::
+                             FilterConfig>(kServiceControlConfig)),
+        sc_parser_(sc_proto_config_, sc_call_factory_),
+        sc_stats_(service_control::ServiceControlFilterStats::create(
+            Envoy::EMPTY_STRING, store_)),
+        sc_handler_factory_(api.randomGenerator(), sc_parser_,
+                            api.timeSource()) {
+    ON_CALL(context_, threadLocal()).WillByDefault(ReturnRef(tls));
+    ON_CALL(context_, scope()).WillByDefault(ReturnRef(store_));
+
+    backend_auth_ = std::make_shared<BackendAuthFilterConfig>(store_, context_,
+                                                              token_factory);
+    path_rewrite_ = std::make_shared<path_rewrite::FilterConfig>(
+        Envoy::EMPTY_STRING, store_);
+    scrubber_ = std::make_shared<grpc_metadata_scrubber::FilterConfig>(
+        Envoy::EMPTY_STRING, context_);
+
+    ::espv2::api::envoy::v11::http::service_control::PerRouteFilterConfig
+        sc_per_route;
+    sc_per_route.set_operation_name(kOperationName);
+    sc_per_route_ =
+        std::make_unique<service_control::PerRouteFilterConfig>(sc_per_route);
+
+    ::espv2::api::envoy::v11::http::backend_auth::PerRouteFilterConfig
+        backend_auth_per_route;
+    backend_auth_per_route.set_jwt_audience(kAudience);
+    backend_auth_per_route_ =
+        std::make_unique<backend_auth::PerRouteFilterConfig>(
+            backend_auth_per_route);
+
+    ::espv2::api::envoy::v11::http::path_rewrite::PerRouteFilterConfig
+        path_rewrite_per_route;
+    path_rewrite_per_route.set_path_prefix("/api");
+    path_rewrite_per_route_ =
+        std::make_unique<path_rewrite::PerRouteFilterConfig>(
+            std::make_unique<path_rewrite::ConfigParserImpl>(
+                path_rewrite_per_route));
+  }
+
+  service_control::ServiceControlFilterStats& sc_stats() { return sc_stats_; }
+  const service_control::ServiceControlHandlerFactory& sc_handler_factory()
+      const {
+    return sc_handler_factory_;
+  }
+  const backend_auth::FilterConfigSharedPtr& backend_auth() const {
+    return backend_auth_;
+  }
+  const path_rewrite::FilterConfigSharedPtr& path_rewrite() const {
+    return path_rewrite_;
+  }
+  const grpc_metadata_scrubber::FilterConfigSharedPtr& scrubber() const {
+    return scrubber_;
+  }
+
+  const Envoy::Router::RouteSpecificFilterConfig& sc_per_route() const {
+    return *sc_per_route_;
+  }
+  const Envoy::Router::RouteSpecificFilterConfig& backend_auth_per_route()
+      const {
+    return *backend_auth_per_route_;
+  }
+  const Envoy::Router::RouteSpecificFilterConfig& path_rewrite_per_route()
+      const {
+    return *path_rewrite_per_route_;
+  }
+
+ private:
+  Envoy::Stats::IsolatedStoreImpl store_;
+  NiceMock<Envoy::Server::Configuration::MockFactoryContext> context_;
+
+  const ::espv2::api::envoy::v11::http::service_control::FilterConfig
+      sc_proto_config_;
+  FakeServiceControlCallFactory sc_call_factory_;
+  const service_control::FilterConfigParser sc_parser_;
+  service_control::ServiceControlFilterStats sc_stats_;
+  const service_control::ServiceControlHandlerFactoryImpl sc_handler_factory_;
+
+  backend_auth::FilterConfigSharedPtr backend_auth_;
+  path_rewrite::FilterConfigSharedPtr path_rewrite_;
+  grpc_metadata_scrubber::FilterConfigSharedPtr scrubber_;
+
+  std::unique_ptr<service_control::PerRouteFilterConfig> sc_per_route_;
+  std::unique_ptr<backend_auth::PerRouteFilterConfig> backend_auth_per_route_;
+  std::unique_ptr<path_rewrite::PerRouteFilterConfig> path_rewrite_per_route_;
+};
+
+// A worker thread, running the filter chain in its event loop.
+class Worker {
+ public:
+  Worker(Envoy::Api::Api& api, int index)
+      : api_(api),
+        dispatcher_(api.allocateDispatcher(absl::StrCat("worker_", index))) {}
+
+  Envoy::Event::Dispatcher& dispatcher() { return *dispatcher_; }
+
+  // Starts the event loop, running the filter chain of the config.
+  void start(FilterChainConfig& config) {
+    config_ = &config;
+    auto route = std::make_shared<NiceMock<BenchmarkRoute>>();
+    sc_callbacks_ = std::make_unique<NiceMock<BenchmarkDecoderFilterCallbacks>>(
+        *dispatcher_, route, config.sc_per_route());
+    backend_auth_callbacks_ =
+        std::make_unique<NiceMock<BenchmarkDecoderFilterCallbacks>>(
+            *dispatcher_, route, config.backend_auth_per_route());
+    path_rewrite_callbacks_ =
+        std::make_unique<NiceMock<BenchmarkDecoderFilterCallbacks>>(
+            *dispatcher_, route, config.path_rewrite_per_route());
+    thread_ = api_.threadFactory().createThread([this]() {
+      dispatcher_->run(Envoy::Event::Dispatcher::RunType::RunUntilExit);
+    });
+  }
+
+  // Stops the event loop, once the thread local instance is shut down.
+  void stop(Envoy::ThreadLocal::InstanceImpl& tls) {
+    dispatcher_->post([this, &tls]() {
+      tls.shutdownThread();
+      dispatcher_->exit();
+    });
+    thread_->join();
+  }
+
+  // Runs the requests in chunks, so the tasks posted meanwhile, such as the
+  // token updates, run in between as in the event loop of an Envoy worker.
+  // Calls done on the worker thread once they all ran.
+  void runRequests(int remaining, std::function<void()> done) {
+    const auto chunk_start = std::chrono::steady_clock::now();
+    if (last_chunk_end_.has_value()) {
+      shared_time_ += chunk_start - *last_chunk_end_;
+    }
+    const int chunk = std::min(remaining, kRequestsPerChunk);
+    for (int i = 0; i < chunk; ++i) {
+      runRequest();
+    }
+    remaining -= chunk;
+    if (remaining == 0) {
+      last_chunk_end_.reset();
+      done();
+      return;
+    }
+    last_chunk_end_ = std::chrono::steady_clock::now();
+    dispatcher_->post([this, remaining, done = std::move(done)]() {
+      runRequests(remaining, done);
+    });
+  }
+
+  std::chrono::nanoseconds chainTime() const { return chain_time_; }
+  std::chrono::nanoseconds sharedTime() const { return shared_time_; }
+  int failures() const { return failures_; }
+
+ private:
+  // Runs a request through the filter chain as the connection manager does,
+  // timing the filters only.
+  void runRequest() {
+    Envoy::TestStreamInfo stream_info(api_.timeSource());
+    stream_info.setResponseCode(200);
+    Envoy::Http::TestRequestHeaderMapImpl request_headers{
+        {":method", "GET"},
+        {":path", "/v1/shelves/1/books/2?key=api-key"},
+        {":authority", "bookstore.example.com"},
+        {"authorization", "Bearer client-token"},
+        {"user-agent", "filter-chain-benchmark"}};
+    Envoy::Http::TestResponseHeaderMapImpl response_headers{
+        {":status", "200"},
+        {"content-type", "application/grpc"},
+        {"content-length", "128"}};
+    Envoy::Http::TestResponseTrailerMapImpl response_trailers{
+        {"grpc-status", "0"}};
+    sc_callbacks_->setStreamInfo(stream_info);
+    backend_auth_callbacks_->setStreamInfo(stream_info);
+    path_rewrite_callbacks_->setStreamInfo(stream_info);
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+      service_control::ServiceControlFilter sc_filter(
+          config_->sc_stats(), config_->sc_handler_factory());
+      backend_auth::Filter backend_auth_filter(config_->backend_auth());
+      path_rewrite::Filter path_rewrite_filter(config_->path_rewrite());
+      grpc_metadata_scrubber::Filter scrubber_filter(config_->scrubber());
+      sc_filter.setDecoderFilterCallbacks(*sc_callbacks_);
+      backend_auth_filter.setDecoderFilterCallbacks(*backend_auth_callbacks_);
+      path_rewrite_filter.setDecoderFilterCallbacks(*path_rewrite_callbacks_);
+
+      if (sc_filter.decodeHeaders(request_headers, true) !=
+              Envoy::Http::FilterHeadersStatus::Continue ||
+          backend_auth_filter.decodeHeaders(request_headers, true) !=
+              Envoy::Http::FilterHeadersStatus::Continue ||
+          path_rewrite_filter.decodeHeaders(request_headers, true) !=
+              Envoy::Http::FilterHeadersStatus::Continue) {
+        ++failures_;
+      }
+      scrubber_filter.encodeHeaders(response_headers, false);
+      sc_filter.log(&request_headers, &response_headers, &response_trailers,
+                    stream_info);
+
+      sc_filter.onDestroy();
+      backend_auth_filter.onDestroy();
+      path_rewrite_filter.onDestroy();
+      scrubber_filter.onDestroy();
+    }
+    chain_time_ += std::chrono::steady_clock::now() - start;
+  }
+
+  Envoy::Api::Api& api_;
+  Envoy::Event::DispatcherPtr dispatcher_;
+  Envoy::Thread::ThreadPtr thread_;
+  FilterChainConfig* config_{};
+  std::unique_ptr<BenchmarkDecoderFilterCallbacks> sc_callbacks_;
+  std::unique_ptr<BenchmarkDecoderFilterCallbacks> backend_auth_callbacks_;
+  std::unique_ptr<BenchmarkDecoderFilterCallbacks> path_rewrite_callbacks_;
+
+  // Only accessed on the worker thread while the requests run.
+  std::chrono::nanoseconds chain_time_{};
+  std::chrono::nanoseconds shared_time_{};
+  absl::optional<std::chrono::steady_clock::time_point> last_chunk_end_;
+  int failures_{};
+};
+
+// Args: the number of workers, and whether the shared paths are enabled.
+void BM_FilterChain(benchmark::State& state) {
+  const int num_workers = state.range(0);
+  const bool shared_paths = state.range(1) != 0;
+  if (Envoy::benchmark::skipExpensiveBenchmarks() && num_workers > 4) {
+    state.SkipWithError("Skipping expensive benchmark");
+    return;
+  }
+
+  Envoy::Api::ApiPtr api = Envoy::Api::createApiForTest();
+  Envoy::Event::DispatcherPtr main_dispatcher =
+      api->allocateDispatcher("main_thread");
+  Envoy::ThreadLocal::InstanceImpl tls;
+  tls.registerThread(*main_dispatcher, true);
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.push_back(std::make_unique<Worker>(*api, i));
+    tls.registerThread(workers.back()->dispatcher(), false);
+  }
+
+  FakeTokenSubscriberFactory token_factory;
+  std::vector<std::unique_ptr<FilterChainConfig>> configs;
+  for (int i = 0; i < (shared_paths ? 1 : num_workers); ++i) {
+    configs.push_back(
+        std::make_unique<FilterChainConfig>(*api, tls, token_factory));
+  }
+  token_factory.updateTokens("token-0");
+  for (int i = 0; i < num_workers; ++i) {
+    workers[i]->start(*configs[shared_paths ? 0 : i]);
+  }
+
+  int token_updates = 0;
+  for (auto _ : state) {
+    std::atomic<int> pending{num_workers};
+    absl::Notification done;
+    for (auto& worker : workers) {
+      Worker* w = worker.get();
+      w->dispatcher().post([w, &pending, &done]() {
+        w->runRequests(kRequestsPerIteration, [&pending, &done]() {
+          if (pending.fetch_sub(1) == 1) {
+            done.Notify();
+          }
+        });
+      });
+    }
+    while (!done.WaitForNotificationWithTimeout(kTokenUpdateInterval)) {
+      if (shared_paths) {
+        token_factory.updateTokens(absl::StrCat("token-", ++token_updates));
+      }
+    }
+  }
+
+  std::chrono::nanoseconds chain_time{};
+  std::chrono::nanoseconds shared_time{};
+  int failures = 0;
+  for (const auto& worker : workers) {
+    chain_time += worker->chainTime();
+    shared_time += worker->sharedTime();
+    failures += worker->failures();
+  }
+  if (failures > 0) {
+    state.SkipWithError(
+        absl::StrCat(failures, " requests were stopped by the filter chain")
+            .c_str());
+  }
+
+  const double requests = static_cast<double>(state.iterations()) *
+                          kRequestsPerIteration * num_workers;
+  const int cores = std::min<int>(
+      num_workers, std::max(1u, std::thread::hardware_concurrency()));
+  state.SetItemsProcessed(static_cast<int64_t>(requests));
+  state.counters["req/s/core"] =
+      benchmark::Counter(requests / cores, benchmark::Counter::kIsRate);
+  state.counters["chain_ns/req"] = chain_time.count() / requests;
+  state.counters["shared_ns/req"] = shared_time.count() / requests;
+  state.counters["token_updates"] = token_updates;
+
+  // The thread local slots are freed on the workers, which must still run.
+  configs.clear();
+  tls.shutdownGlobalThreading();
+  for (auto& worker : workers) {
+    worker->stop(tls);
+  }
+  tls.shutdownThread();
+}
+BENCHMARK(BM_FilterChain)
+    ->ArgsProduct({{1, 2, 4, 8, 16, 32, 64}, {0, 1}})
+    ->ArgNames({"workers", "shared_paths"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
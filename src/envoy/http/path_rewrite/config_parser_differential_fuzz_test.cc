@@ -0,0 +1,117 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Differential fuzz test of ConfigParserImpl::rewrite against a reference
+// implementation written from the PerRouteFilterConfig documentation.
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "src/api_proxy/path_matcher/path_matcher.h"
+#include "src/envoy/http/path_rewrite/config_parser_impl.h"
+#include "test/fuzz/fuzz_runner.h"
+#include "test/fuzz/utility.h"
+#include "tests/fuzz/differential_fuzz.h"
+#include "tests/fuzz/structured_inputs/path_rewrite_differential.pb.validate.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace path_rewrite {
+namespace fuzz {
+
+using ::espv2::api::envoy::v11::http::path_rewrite::PerRouteFilterConfig;
+using ::espv2::api_proxy::path_matcher::PathMatcherBuilder;
+using ::espv2::api_proxy::path_matcher::VariableBinding;
+using ::espv2::tests::fuzz::ExecutionTimeTracker;
+
+// Removes the trailing slash of the configured path, unless it is the root
+// and `keep_root` is set.
+std::string trimTrailingSlash(std::string path, bool keep_root) {
+  if (!path.empty() && path.back() == '/' && !(keep_root && path == "/")) {
+    path.pop_back();
+  }
+  return path;
+}
+
+bool referenceRewrite(const PerRouteFilterConfig& config,
+                      const std::string& path, std::string* new_path) {
+  if (!config.has_constant_path()) {
+    *new_path = absl::StrCat(
+        trimTrailingSlash(config.path_prefix(), /*keep_root=*/false), path);
+    return true;
+  }
+
+  const auto& constant_path = config.constant_path();
+  std::string extracted_query;
+  if (!constant_path.url_template().empty()) {
+    PathMatcherBuilder<const PerRouteFilterConfig*> builder;
+    builder.Register("GET", constant_path.url_template(), "", &config);
+    std::vector<VariableBinding> bindings;
+    if (builder.Build()->Lookup("GET", path, &bindings) == nullptr) {
+      return false;
+    }
+    extracted_query = absl::StrJoin(
+        bindings, "&", [](std::string* out, const VariableBinding& binding) {
+          absl::StrAppend(out, absl::StrJoin(binding.field_path, "."), "=",
+                          binding.value);
+        });
+  }
+
+  *new_path = trimTrailingSlash(constant_path.path(), /*keep_root=*/true);
+  const size_t query_pos = path.find('?');
+  if (query_pos != std::string::npos) {
+    absl::StrAppend(new_path, path.substr(query_pos));
+    if (!extracted_query.empty()) {
+      absl::StrAppend(new_path, "&", extracted_query);
+    }
+  } else if (!extracted_query.empty()) {
+    absl::StrAppend(new_path, "?", extracted_query);
+  }
+  return true;
+}
+
+DEFINE_PROTO_FUZZER(
+    const espv2::tests::fuzz::protos::PathRewriteDifferentialInput& input) {
+  try {
+    Envoy::TestUtility::validate(input);
+  } catch (const Envoy::ProtoValidationException& e) {
+    ENVOY_LOG_MISC(debug, "Controlled proto validation failure: {}", e.what());
+    return;
+  }
+
+  static ExecutionTimeTracker* tracker =
+      new ExecutionTimeTracker("ConfigParserImpl::rewrite");
+
+  const ConfigParserImpl parser(input.config());
+  for (const std::string& path : input.paths()) {
+    std::string new_path;
+    const bool ok = tracker->run(
+        path, [&]() { return parser.rewrite(path, new_path); });
+
+    std::string reference_path;
+    FUZZ_ASSERT(ok == referenceRewrite(input.config(), path, &reference_path));
+    if (ok) {
+      FUZZ_ASSERT(new_path == reference_path);
+    }
+  }
+}
+
+}  // namespace fuzz
+}  // namespace path_rewrite
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
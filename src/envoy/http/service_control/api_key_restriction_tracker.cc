@@ -0,0 +1,112 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/api_key_restriction_tracker.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::espv2::api_proxy::service_control::CheckResponseInfo;
+using ::espv2::api_proxy::service_control::OperationInfo;
+using ::google::protobuf::util::Status;
+
+namespace {
+
+bool isRestrictionError(const CheckResponseInfo& response_info) {
+  return response_info.error.name == "IP_ADDRESS_BLOCKED" ||
+         response_info.error.name == "REFERER_BLOCKED";
+}
+
+}  // namespace
+
+ApiKeyRestrictionTracker::ApiKeyRestrictionTracker(
+    size_t max_keys, const std::string& stats_prefix,
+    Envoy::Stats::Scope& scope)
+    : max_keys_(max_keys),
+      filter_stats_(ServiceControlFilterStats::create(stats_prefix, scope)) {}
+
+void ApiKeyRestrictionTracker::normalize(OperationInfo* info) {
+  info->client_ip = kNormalizedClientIp;
+  info->referer = kNormalizedReferer;
+}
+
+bool ApiKeyRestrictionTracker::normalizeIfUnrestricted(OperationInfo* info) {
+  auto it = keys_.find(info->api_key);
+  if (it == keys_.end() || it->second != Restrictions::kNone) {
+    return false;
+  }
+  normalize(info);
+  filter_stats_.filter_.api_key_request_normalized_.inc();
+  return true;
+}
+
+bool ApiKeyRestrictionTracker::onCheckDone(
+    absl::string_view api_key, const Status& status,
+    const CheckResponseInfo& response_info) {
+  if (isRestrictionError(response_info)) {
+    setRestricted(api_key);
+    return false;
+  }
+  if (!status.ok() || keys_.contains(api_key) || keys_.size() >= max_keys_) {
+    return false;
+  }
+  keys_.emplace(std::string(api_key), Restrictions::kProbing);
+  filter_stats_.filter_.api_key_restriction_probed_.inc();
+  return true;
+}
+
+bool ApiKeyRestrictionTracker::onNormalizedCheckDone(
+    absl::string_view api_key, const Status& status,
+    const CheckResponseInfo& response_info) {
+  if (isRestrictionError(response_info)) {
+    setRestricted(api_key);
+    return true;
+  }
+
+  auto it = keys_.find(api_key);
+  if (it == keys_.end() || it->second != Restrictions::kProbing) {
+    return false;
+  }
+  if (status.ok()) {
+    ENVOY_LOG(debug, "API key learned to have no IP or referer restriction");
+    it->second = Restrictions::kNone;
+    filter_stats_.filter_.api_key_unrestricted_.inc();
+  } else {
+    // The probe failed for another reason, such as a network error: the key
+    // is probed again after its next successful check.
+    keys_.erase(it);
+  }
+  return false;
+}
+
+void ApiKeyRestrictionTracker::setRestricted(absl::string_view api_key) {
+  auto it = keys_.find(api_key);
+  if (it == keys_.end()) {
+    if (keys_.size() >= max_keys_) {
+      return;
+    }
+    it = keys_.emplace(std::string(api_key), Restrictions::kProbing).first;
+  }
+  if (it->second != Restrictions::kIpOrReferer) {
+    it->second = Restrictions::kIpOrReferer;
+    filter_stats_.filter_.api_key_restricted_.inc();
+  }
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
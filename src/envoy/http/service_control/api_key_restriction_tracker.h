@@ -0,0 +1,99 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/stubs/status.h"
+#include "source/common/common/logger.h"
+#include "src/api_proxy/service_control/request_info.h"
+#include "src/envoy/http/service_control/filter_stats.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+// The client IP and referer sent for the API keys without IP or referer
+// restriction. They are reserved for documentation (RFC 5737 and RFC 2606),
+// so no actual restriction allows them.
+constexpr char kNormalizedClientIp[] = "192.0.2.1";
+constexpr char kNormalizedReferer[] = "https://normalized.invalid/";
+
+// The maximum number of API keys whose restrictions are tracked per worker.
+constexpr size_t kApiKeyRestrictionMaxKeys = 10000;
+
+// Learns which API keys have no IP or referer restriction, so their check
+// and quota requests are sent with a fixed client IP and referer, and are
+// cached once per key instead of once per client IP and referer.
+//
+// The restrictions of a key are not in the check response, so they are
+// probed: after a check of a key succeeds, the key is checked again with the
+// fixed client IP and referer, which a restricted key denies with
+// IP_ADDRESS_BLOCKED or REFERER_BLOCKED. Until the probe succeeds, the
+// requests keep the actual client IP and referer, so each new one is still
+// checked on first use.
+//
+// A key denied with IP_ADDRESS_BLOCKED or REFERER_BLOCKED is restricted for
+// good. A restriction added to an unrestricted key is found when its cached
+// check is refreshed.
+//
+// It is not thread-safe and is expected to be owned by a worker thread.
+class ApiKeyRestrictionTracker
+    : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+ public:
+  ApiKeyRestrictionTracker(size_t max_keys, const std::string& stats_prefix,
+                           Envoy::Stats::Scope& scope);
+
+  // Replaces the client IP and referer of the request with the fixed ones.
+  static void normalize(
+      ::espv2::api_proxy::service_control::OperationInfo* info);
+
+  // Normalizes the request if its API key is known to be unrestricted.
+  bool normalizeIfUnrestricted(
+      ::espv2::api_proxy::service_control::OperationInfo* info);
+
+  // Called with the result of a check with the actual client IP and referer.
+  // Returns true if the key should be probed.
+  bool onCheckDone(
+      absl::string_view api_key, const ::google::protobuf::util::Status& status,
+      const ::espv2::api_proxy::service_control::CheckResponseInfo&
+          response_info);
+
+  // Called with the result of a probe or of a normalized check. Returns true
+  // if the key is restricted, so the check must be sent again with the
+  // actual client IP and referer.
+  bool onNormalizedCheckDone(
+      absl::string_view api_key, const ::google::protobuf::util::Status& status,
+      const ::espv2::api_proxy::service_control::CheckResponseInfo&
+          response_info);
+
+ private:
+  // The keys not tracked have unknown restrictions.
+  enum class Restrictions { kProbing, kNone, kIpOrReferer };
+
+  void setRestricted(absl::string_view api_key);
+
+  const size_t max_keys_;
+  ServiceControlFilterStats filter_stats_;
+  absl::flat_hash_map<std::string, Restrictions> keys_;
+};
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
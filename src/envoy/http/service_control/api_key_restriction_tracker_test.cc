@@ -0,0 +1,256 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/api_key_restriction_tracker.h"
+
+#include <random>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test/mocks/stats/mocks.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::espv2::api_proxy::service_control::CheckRequestInfo;
+using ::espv2::api_proxy::service_control::CheckResponseInfo;
+using ::espv2::api_proxy::service_control::ScResponseErrorType;
+using ::google::protobuf::util::OkStatus;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+using ::testing::NiceMock;
+
+class ApiKeyRestrictionTrackerTest : public ::testing::Test {
+ protected:
+  ApiKeyRestrictionTrackerTest()
+      : stats_(ServiceControlFilterStats::create("", scope_)),
+        tracker_(/*max_keys=*/2, "", scope_) {
+    info_.api_key = "key";
+    info_.client_ip = "1.2.3.4";
+    info_.referer = "https://example.com/";
+  }
+
+  static CheckResponseInfo blocked(const std::string& name) {
+    CheckResponseInfo response_info;
+    response_info.error = {name, /*is_network_error=*/false,
+                           ScResponseErrorType::CONSUMER_BLOCKED};
+    return response_info;
+  }
+
+  const Status denied_{StatusCode::kPermissionDenied, "blocked"};
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope_;
+  ServiceControlFilterStats stats_;
+  ApiKeyRestrictionTracker tracker_;
+  CheckRequestInfo info_;
+};
+
+TEST_F(ApiKeyRestrictionTrackerTest, UnknownKeyNotNormalized) {
+  EXPECT_FALSE(tracker_.normalizeIfUnrestricted(&info_));
+  EXPECT_EQ(info_.client_ip, "1.2.3.4");
+  EXPECT_EQ(info_.referer, "https://example.com/");
+  EXPECT_EQ(stats_.filter_.api_key_request_normalized_.value(), 0);
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, UnrestrictedAfterProbeSucceeds) {
+  EXPECT_TRUE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  // The key is probed once.
+  EXPECT_FALSE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_FALSE(tracker_.normalizeIfUnrestricted(&info_));
+  EXPECT_EQ(stats_.filter_.api_key_restriction_probed_.value(), 1);
+
+  EXPECT_FALSE(
+      tracker_.onNormalizedCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_EQ(stats_.filter_.api_key_unrestricted_.value(), 1);
+
+  EXPECT_TRUE(tracker_.normalizeIfUnrestricted(&info_));
+  EXPECT_EQ(info_.client_ip, kNormalizedClientIp);
+  EXPECT_EQ(info_.referer, kNormalizedReferer);
+  EXPECT_EQ(stats_.filter_.api_key_request_normalized_.value(), 1);
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, RestrictedAfterProbeDenied) {
+  EXPECT_TRUE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_TRUE(tracker_.onNormalizedCheckDone("key", denied_,
+                                             blocked("REFERER_BLOCKED")));
+  EXPECT_EQ(stats_.filter_.api_key_restricted_.value(), 1);
+
+  // A restricted key is not probed again.
+  EXPECT_FALSE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_FALSE(tracker_.normalizeIfUnrestricted(&info_));
+  EXPECT_EQ(stats_.filter_.api_key_restriction_probed_.value(), 1);
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, RestrictedAfterCheckDenied) {
+  EXPECT_FALSE(
+      tracker_.onCheckDone("key", denied_, blocked("IP_ADDRESS_BLOCKED")));
+  EXPECT_EQ(stats_.filter_.api_key_restricted_.value(), 1);
+  EXPECT_FALSE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_EQ(stats_.filter_.api_key_restriction_probed_.value(), 0);
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, NotProbedAfterCheckFailed) {
+  EXPECT_FALSE(
+      tracker_.onCheckDone("key", denied_, blocked("CLIENT_APP_BLOCKED")));
+  EXPECT_FALSE(tracker_.onCheckDone(
+      "key", Status(StatusCode::kUnavailable, "unavailable"),
+      CheckResponseInfo()));
+  EXPECT_EQ(stats_.filter_.api_key_restriction_probed_.value(), 0);
+  EXPECT_EQ(stats_.filter_.api_key_restricted_.value(), 0);
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, ProbedAgainAfterProbeFailed) {
+  EXPECT_TRUE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_FALSE(tracker_.onNormalizedCheckDone(
+      "key", Status(StatusCode::kUnavailable, "unavailable"),
+      CheckResponseInfo()));
+  EXPECT_FALSE(tracker_.normalizeIfUnrestricted(&info_));
+
+  EXPECT_TRUE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_EQ(stats_.filter_.api_key_restriction_probed_.value(), 2);
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, RestrictionAddedToUnrestrictedKey) {
+  EXPECT_TRUE(tracker_.onCheckDone("key", OkStatus(), CheckResponseInfo()));
+  EXPECT_FALSE(
+      tracker_.onNormalizedCheckDone("key", OkStatus(), CheckResponseInfo()));
+
+  // The refreshed normalized check is denied: it is sent again with the
+  // client IP and referer, which are kept from now on.
+  EXPECT_TRUE(tracker_.onNormalizedCheckDone("key", denied_,
+                                             blocked("IP_ADDRESS_BLOCKED")));
+  EXPECT_FALSE(tracker_.normalizeIfUnrestricted(&info_));
+
+  // The other errors do not depend on the client IP and referer.
+  EXPECT_FALSE(tracker_.onNormalizedCheckDone(
+      "other", Status(StatusCode::kInvalidArgument, "invalid"),
+      CheckResponseInfo()));
+}
+
+TEST_F(ApiKeyRestrictionTrackerTest, MaxKeys) {
+  EXPECT_TRUE(tracker_.onCheckDone("key1", OkStatus(), CheckResponseInfo()));
+  EXPECT_TRUE(tracker_.onCheckDone("key2", OkStatus(), CheckResponseInfo()));
+  // Over the limit, the keys stay unknown.
+  EXPECT_FALSE(tracker_.onCheckDone("key3", OkStatus(), CheckResponseInfo()));
+  EXPECT_FALSE(
+      tracker_.onCheckDone("key3", denied_, blocked("IP_ADDRESS_BLOCKED")));
+  EXPECT_EQ(stats_.filter_.api_key_restricted_.value(), 0);
+}
+
+// Replays traffic through a check cache keyed like the Service Control
+// client cache, with and without learning the restrictions, to measure the
+// hit ratio change.
+class ReplayedTrafficTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumKeys = 20;
+  static constexpr int kNumClientIps = 500;
+  static constexpr int kNumReferers = 10;
+  static constexpr int kNumRequests = 20000;
+
+  ReplayedTrafficTest() : tracker_(kApiKeyRestrictionMaxKeys, "", scope_) {}
+
+  // Returns the status of the check, and counts the cache hits. key0 has an
+  // IP restriction, which allows all the client IPs of the traffic.
+  Status check(const CheckRequestInfo& info, CheckResponseInfo* response_info) {
+    ++calls_;
+    if (!cache_.insert(absl::StrCat(info.api_key, "|", info.client_ip, "|",
+                                    info.referer))
+             .second) {
+      ++hits_;
+    }
+    if (info.api_key == "key0" && info.client_ip == kNormalizedClientIp) {
+      response_info->error = {"IP_ADDRESS_BLOCKED", false,
+                              ScResponseErrorType::CONSUMER_BLOCKED};
+      return Status(StatusCode::kPermissionDenied, "IP address blocked.");
+    }
+    return OkStatus();
+  }
+
+  // Does what ServiceControlCallImpl::callCheck does.
+  Status callCheck(const CheckRequestInfo& info) {
+    CheckRequestInfo normalized_info = info;
+    CheckResponseInfo response_info;
+    if (tracker_.normalizeIfUnrestricted(&normalized_info)) {
+      Status status = check(normalized_info, &response_info);
+      if (!tracker_.onNormalizedCheckDone(info.api_key, status,
+                                          response_info)) {
+        return status;
+      }
+      response_info = CheckResponseInfo();
+      return check(info, &response_info);
+    }
+
+    Status status = check(info, &response_info);
+    if (tracker_.onCheckDone(info.api_key, status, response_info)) {
+      ApiKeyRestrictionTracker::normalize(&normalized_info);
+      CheckResponseInfo probe_response_info;
+      Status probe_status = check(normalized_info, &probe_response_info);
+      (void)tracker_.onNormalizedCheckDone(info.api_key, probe_status,
+                                           probe_response_info);
+    }
+    return status;
+  }
+
+  double replay(bool learn) {
+    cache_.clear();
+    hits_ = 0;
+    calls_ = 0;
+    // The same traffic is replayed each time.
+    std::mt19937 random(1);
+    for (int i = 0; i < kNumRequests; ++i) {
+      CheckRequestInfo info;
+      info.api_key = absl::StrCat("key", random() % kNumKeys);
+      const uint32_t ip = random() % kNumClientIps;
+      info.client_ip = absl::StrCat("10.0.", ip / 256, ".", ip % 256);
+      info.referer = absl::StrCat("https://site", random() % kNumReferers,
+                                  ".example.com/");
+      Status status;
+      if (learn) {
+        status = callCheck(info);
+      } else {
+        CheckResponseInfo response_info;
+        status = check(info, &response_info);
+      }
+      // The restricted key still allows the actual client IPs.
+      EXPECT_TRUE(status.ok()) << info.api_key;
+    }
+    // The probes and retries count as cache misses.
+    return static_cast<double>(hits_) / calls_;
+  }
+
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope_;
+  ApiKeyRestrictionTracker tracker_;
+  absl::flat_hash_set<std::string> cache_;
+  int hits_ = 0;
+  int calls_ = 0;
+};
+
+TEST_F(ReplayedTrafficTest, HitRatio) {
+  const double without_learning = replay(/*learn=*/false);
+  const double with_learning = replay(/*learn=*/true);
+  // There are more client IP and referer pairs per key than requests.
+  EXPECT_LT(without_learning, 0.5);
+  // Only the restricted key misses on new client IPs and referers.
+  EXPECT_GT(with_learning, 0.9);
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
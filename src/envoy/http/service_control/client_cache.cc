@@ -14,6 +14,8 @@
 
 #include "src/envoy/http/service_control/client_cache.h"
 
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "source/common/tracing/http_tracer_impl.h"
 #include "src/api_proxy/service_control/check_response_convert_utils.h"
 #include "src/api_proxy/service_control/request_builder.h"
@@ -85,6 +87,15 @@ constexpr uint32_t kAllocateQuotaDefaultNumberOfRetries = 1;
 // The default number of retries for report calls.
 constexpr uint32_t kReportDefaultNumberOfRetries = 5;
 
+// The backoff of the report retries. With the default number of retries, a
+// report is retried for about 3 seconds.
+constexpr std::chrono::milliseconds kReportRetryInitialBackoff{100};
+constexpr std::chrono::milliseconds kReportRetryMaxBackoff{10000};
+// The memory bound of the reports waiting for a retry, per worker.
+constexpr uint64_t kReportRetryMaxQueuedBytes = 8 * 1024 * 1024;
+// The bound of the reports merged into one report call.
+constexpr uint64_t kReportRetryMaxBatchBytes = 1024 * 1024;
+
 // The default value for network_fail_open flag.
 constexpr bool kDefaultNetworkFailOpen = true;
 
@@ -156,13 +167,23 @@ Status ClientCache::processScCallTransportStatus(const Status& status,
     callName = "report";
   }
 
+  std::string summary;
   if (!status.ok()) {
-    ENVOY_LOG(error, "Failed to call {}, error: {}, str body: {}", callName,
-              status.ToString(), body);
+    if (log_limiter_.allow(absl::StrCat("Failed to call ", callName,
+                                        " with code ",
+                                        static_cast<int>(status.code())),
+                           summary)) {
+      ENVOY_LOG(error, "Failed to call {}, error: {}, str body: {}{}",
+                callName, status.ToString(), body, summary);
+    }
   } else {
     if (!resp->ParseFromString(body)) {
-      ENVOY_LOG(error, "Failed to call {}, error: {}, str body: {}", callName,
-                "invalid response", body);
+      if (log_limiter_.allow(absl::StrCat("Failed to call ", callName,
+                                          " with invalid response"),
+                             summary)) {
+        ENVOY_LOG(error, "Failed to call {}, error: {}, str body: {}{}",
+                  callName, "invalid response", body, summary);
+      }
       return Status(StatusCode::kInvalidArgument,
                     std::string("Invalid response"));
     }
@@ -218,10 +239,18 @@ ClientCache::ClientCache(
     Envoy::Stats::Scope& scope, Envoy::Upstream::ClusterManager& cm,
     Envoy::TimeSource& time_source, Envoy::Event::Dispatcher& dispatcher,
     std::function<const std::string&()> sc_token_fn,
-    std::function<const std::string&()> quota_token_fn)
+    std::function<const std::string&()> quota_token_fn,
+    const std::string& peer_check_cache_secret,
+    PendingStateHandoffSharedPtr pending_state_handoff)
     : config_(config),
       filter_stats_(ServiceControlFilterStats::create(stats_prefix, scope)),
-      time_source_(time_source) {
+      time_source_(time_source),
+      log_limiter_(time_source),
+      pending_state_handoff_(std::move(pending_state_handoff)) {
+  log_summary_timer_ =
+      dispatcher.createTimer([this]() { logSuppressedErrors(); });
+  log_summary_timer_->enableTimer(utils::kLogRateLimitSummaryInterval);
+
   ServiceControlClientOptions options(getCheckAggregationOptions(),
                                       getQuotaAggregationOptions(),
                                       getReportAggregationOptions());
@@ -231,17 +260,54 @@ ClientCache::ClientCache(
       cm, dispatcher, filter_config.service_control_uri(),
       absl::StrCat("/", config_.service_name(), ":check"), sc_token_fn,
       check_timeout_ms_, check_retries_, time_source,
-      "Service Control remote call: Check");
+      "Service Control remote call: Check",
+      &filter_stats_.filter_.http_call_active_);
   quota_call_factory_ = std::make_unique<HttpCallFactoryImpl>(
       cm, dispatcher, filter_config.service_control_uri(),
       absl::StrCat("/", config_.service_name(), ":allocateQuota"),
       quota_token_fn, quota_timeout_ms_, quota_retries_, time_source,
-      "Service Control remote call: Allocate Quota");
+      "Service Control remote call: Allocate Quota",
+      &filter_stats_.filter_.http_call_active_);
+  if (filter_config.has_peer_check_cache()) {
+    peer_check_cache_ = std::make_unique<PeerCheckCache>(
+        filter_config.peer_check_cache(), cm, dispatcher, time_source,
+        stats_prefix, scope, peer_check_cache_secret);
+  }
   report_call_factory_ = std::make_unique<HttpCallFactoryImpl>(
       cm, dispatcher, filter_config.service_control_uri(),
       absl::StrCat("/", config_.service_name(), ":report"), sc_token_fn,
-      report_timeout_ms_, report_retries_, time_source,
-      "Service Control remote call: Report");
+      report_timeout_ms_, /*retries=*/0, time_source,
+      "Service Control remote call: Report",
+      &filter_stats_.filter_.http_call_active_);
+
+  if (filter_config.has_pinned_check_cache()) {
+    pinned_check_cache_ = std::make_unique<PinnedCheckCache>(
+        filter_config.pinned_check_cache(), dispatcher, time_source,
+        stats_prefix, scope,
+        [this](const CheckRequest& request,
+               PinnedCheckCache::DoneFunc on_done) {
+          sendPinnedCheck(request, on_done);
+        });
+  }
+
+  // Reports are retried with a backoff by the queue, instead of right away
+  // by the http call.
+  report_retry_queue_ = std::make_unique<ReportRetryQueue>(
+      dispatcher, time_source,
+      ReportRetryOptions{report_retries_, kReportRetryInitialBackoff,
+                         kReportRetryMaxBackoff, kReportRetryMaxQueuedBytes,
+                         kReportRetryMaxBatchBytes},
+      stats_prefix, scope,
+      [this](const ReportRequest& request,
+             ReportRetryQueue::DoneFunc on_done) {
+        sendReport(request, on_done);
+      },
+      [this](const ReportRequest& request) {
+        if (pending_state_handoff_) {
+          pending_state_handoff_->addReport(request);
+          filter_stats_.filter_.pending_state_handed_off_.inc();
+        }
+      });
 
   // Note: Check transport is also defined per request.
   // But this must be defined, it will be called on each flush of the cache
@@ -251,13 +317,22 @@ ClientCache::ClientCache(
                                    TransportDoneFunc on_done) {
     // Don't support tracing on this transport
     auto& null_span = Envoy::Tracing::NullSpan::instance();
+    // Kept to pin the refreshed response of a priority consumer.
+    std::shared_ptr<CheckRequest> pinned_request;
+    if (pinned_check_cache_) {
+      pinned_request = std::make_shared<CheckRequest>(request);
+    }
     auto* call = check_call_factory_->createHttpCall(
         request, null_span,
-        [this, response, on_done](const Status& status,
-                                  const std::string& body) {
+        [this, response, on_done, pinned_request](const Status& status,
+                                                  const std::string& body) {
           Status final_status = processScCallTransportStatus<CheckResponse>(
               status, response, body);
           collectCallStatus(filter_stats_.check_, final_status.code());
+          if (pinned_request && final_status.ok()) {
+            pinned_check_cache_->update(
+                *pinned_request, checkSignature(*pinned_request), *response);
+          }
           on_done(final_status);
         });
     call->call();
@@ -268,10 +343,19 @@ ClientCache::ClientCache(
                                    TransportDoneFunc on_done) {
     // Don't support tracing on this transport
     auto& null_span = Envoy::Tracing::NullSpan::instance();
+    // Kept to be handed off if the call is cancelled on destruction.
+    std::shared_ptr<AllocateQuotaRequest> pending_request;
+    if (pending_state_handoff_) {
+      pending_request = std::make_shared<AllocateQuotaRequest>(request);
+    }
     auto* call = quota_call_factory_->createHttpCall(
         request, null_span,
-        [this, response, on_done](const Status& status,
-                                  const std::string& body) {
+        [this, response, on_done, pending_request](const Status& status,
+                                                   const std::string& body) {
+          if (pending_request && status.code() == StatusCode::kCancelled) {
+            pending_state_handoff_->addQuota(*pending_request);
+            filter_stats_.filter_.pending_state_handed_off_.inc();
+          }
           Status final_status =
               processScCallTransportStatus<AllocateQuotaResponse>(
                   status, response, body);
@@ -282,21 +366,9 @@ ClientCache::ClientCache(
   };
 
   options.report_transport = [this](const ReportRequest& request,
-                                    ReportResponse* response,
+                                    ReportResponse*,
                                     TransportDoneFunc on_done) {
-    // Don't support tracing on this transport
-    auto& null_span = Envoy::Tracing::NullSpan::instance();
-    auto* call = report_call_factory_->createHttpCall(
-        request, null_span,
-        [this, response, on_done](const Status& status,
-                                  const std::string& body) {
-          Status final_status = processScCallTransportStatus<ReportResponse>(
-              status, response, body);
-          collectCallStatus(filter_stats_.report_, final_status.code());
-
-          on_done(final_status);
-        });
-    call->call();
+    report_retry_queue_->send(request, on_done);
   };
 
   options.periodic_timer = [&dispatcher](int interval_ms,
@@ -310,6 +382,55 @@ ClientCache::ClientCache(
       config_.service_name(), config_.service_config_id(), options);
 }
 
+void ClientCache::logSuppressedErrors() {
+  log_limiter_.flushSuppressed([](absl::string_view key, uint64_t suppressed) {
+    ENVOY_LOG(error, "{}: {} similar errors suppressed", key, suppressed);
+  });
+  log_summary_timer_->enableTimer(utils::kLogRateLimitSummaryInterval);
+}
+
+void ClientCache::sendReport(const ReportRequest& request,
+                             ReportRetryQueue::DoneFunc on_done) {
+  // Don't support tracing on this transport
+  auto& null_span = Envoy::Tracing::NullSpan::instance();
+  // Kept to be handed off if the call is cancelled on destruction.
+  std::shared_ptr<ReportRequest> pending_request;
+  if (pending_state_handoff_) {
+    pending_request = std::make_shared<ReportRequest>(request);
+  }
+  auto* call = report_call_factory_->createHttpCall(
+      request, null_span,
+      [this, on_done, pending_request](const Status& status,
+                                       const std::string& body) {
+        if (pending_request && status.code() == StatusCode::kCancelled) {
+          pending_state_handoff_->addReport(*pending_request);
+          filter_stats_.filter_.pending_state_handed_off_.inc();
+        }
+        ReportResponse response;
+        Status final_status = processScCallTransportStatus<ReportResponse>(
+            status, &response, body);
+        collectCallStatus(filter_stats_.report_, final_status.code());
+
+        on_done(final_status);
+      });
+  call->call();
+}
+
+void ClientCache::mergePendingState(
+    const std::vector<ReportRequest>& reports,
+    const std::vector<AllocateQuotaRequest>& quota_requests) {
+  for (const auto& request : reports) {
+    callReport(request);
+  }
+  for (const auto& request : quota_requests) {
+    auto* response = new AllocateQuotaResponse;
+    client_->Quota(request, response,
+                   [response](const Status&) { delete response; });
+  }
+  filter_stats_.filter_.pending_state_taken_over_.add(reports.size() +
+                                                      quota_requests.size());
+}
+
 void ClientCache::collectScResponseErrorStats(ScResponseErrorType error_type) {
   switch (error_type) {
     case ScResponseErrorType::CONSUMER_BLOCKED:
@@ -335,22 +456,22 @@ CancelFunc ClientCache::callCheck(const CheckRequest& request,
                              const CheckRequest& request,
                              CheckResponse* response,
                              TransportDoneFunc on_done) {
-    auto* call = check_call_factory_->createHttpCall(
-        request, parent_span,
-        [this, response, on_done](const Status& status,
-                                  const std::string& body) {
-          Status final_status = processScCallTransportStatus<CheckResponse>(
-              status, response, body);
-          collectCallStatus(filter_stats_.check_, final_status.code());
-          on_done(final_status);
-        });
-    call->call();
-    cancel_fn = [call]() { call->cancel(); };
+    cancel_fn = coalesceCheck(request, response, on_done, parent_span);
   };
 
   parent_span.log(time_source_.systemTime(),
                   "Service Control cache query: Check");
 
+  // The signature is only computed for the consumers with a pinned response.
+  if (pinned_check_cache_ &&
+      pinned_check_cache_->hasConsumer(request.operation().consumer_id())) {
+    auto pinned = std::make_unique<CheckResponse>();
+    if (pinned_check_cache_->lookup(checkSignature(request), pinned.get())) {
+      handleCheckResponse(OkStatus(), pinned.release(), on_done);
+      return nullptr;
+    }
+  }
+
   auto* response = new CheckResponse;
   client_->Check(
       request, response,
@@ -361,6 +482,187 @@ CancelFunc ClientCache::callCheck(const CheckRequest& request,
   return cancel_fn;
 }
 
+CancelFunc ClientCache::coalesceCheck(const CheckRequest& request,
+                                      CheckResponse* response,
+                                      TransportDoneFunc on_done,
+                                      Envoy::Tracing::Span& parent_span) {
+  const uint64_t waiter_id = next_check_waiter_id_++;
+  std::string signature = checkSignature(request);
+
+  auto it = pending_checks_.find(signature);
+  std::shared_ptr<PendingCheck> pending;
+  if (it != pending_checks_.end()) {
+    // The streams of a connection burst share the check of the first one.
+    filter_stats_.filter_.check_coalesced_.inc();
+    pending = it->second;
+  } else {
+    pending = std::make_shared<PendingCheck>();
+    pending_checks_.emplace(signature, pending);
+    filter_stats_.filter_.check_pending_.inc();
+  }
+  // Added before the call is made, as it may complete inline.
+  pending->waiters.emplace(
+      waiter_id, PendingCheck::Waiter{response, on_done, &parent_span});
+
+  if (pending->call == nullptr) {
+    if (peer_check_cache_) {
+      lookupPeerCheck(request, signature, pending, parent_span);
+    } else {
+      sendCheck(request, signature, pending, parent_span);
+    }
+  }
+
+  std::weak_ptr<PendingCheck> weak_pending = pending;
+  return [this, weak_pending, waiter_id]() {
+    auto pending = weak_pending.lock();
+    if (!pending) {
+      return;
+    }
+    auto waiter = pending->waiters.find(waiter_id);
+    if (waiter == pending->waiters.end()) {
+      return;
+    }
+    if (pending->waiters.size() == 1) {
+      // The last waiter cancels the call, which calls it back.
+      pending->call->cancel();
+      return;
+    }
+    // The call is still awaited by the other streams, so it is not cancelled
+    // and its status is collected when it completes.
+    TransportDoneFunc on_done = std::move(waiter->second.on_done);
+    Envoy::Tracing::Span* span = waiter->second.span;
+    pending->waiters.erase(waiter);
+    if (pending->call_span == span) {
+      // Its retries would spawn their spans in the span of this stream.
+      pending->call_span = pending->waiters.begin()->second.span;
+      pending->call->setParentSpan(*pending->call_span);
+    }
+    on_done(Status(StatusCode::kCancelled, "Request cancelled"));
+  };
+}
+
+void ClientCache::lookupPeerCheck(const CheckRequest& request,
+                                  const std::string& signature,
+                                  std::shared_ptr<PendingCheck> pending,
+                                  Envoy::Tracing::Span& parent_span) {
+  // Kept to call Service Control if the lookup does not find it.
+  auto pending_request = std::make_shared<CheckRequest>(request);
+  pending->call_span = &parent_span;
+  pending->call = peer_check_cache_->lookup(
+      signature, parent_span,
+      [this, signature, pending, pending_request](const Status& status,
+                                                  const std::string& body) {
+        if (status.code() == StatusCode::kCancelled ||
+            pending->waiters.empty()) {
+          finishPendingCheck(signature, pending, status, body,
+                             /*from_service_control=*/false);
+          return;
+        }
+        if (status.ok()) {
+          CheckResponse parsed;
+          if (parsed.ParseFromString(body)) {
+            finishPendingCheck(signature, pending, status, body,
+                               /*from_service_control=*/false);
+            return;
+          }
+          ENVOY_LOG(debug, "Invalid check response from the peer check cache");
+        }
+        // The lookup missed or failed: the check is traced in the span of the
+        // lookup, which is handed to a remaining stream when its own stream
+        // is cancelled.
+        sendCheck(*pending_request, signature, pending, *pending->call_span);
+      });
+  pending->call->call();
+}
+
+void ClientCache::sendCheck(const CheckRequest& request,
+                            const std::string& signature,
+                            std::shared_ptr<PendingCheck> pending,
+                            Envoy::Tracing::Span& parent_span) {
+  // Kept to pin the response of a priority consumer.
+  std::shared_ptr<CheckRequest> pinned_request;
+  if (pinned_check_cache_) {
+    pinned_request = std::make_shared<CheckRequest>(request);
+  }
+  pending->call_span = &parent_span;
+  pending->call = check_call_factory_->createHttpCall(
+      request, parent_span,
+      [this, signature, pending, pinned_request](const Status& status,
+                                                 const std::string& body) {
+        if (peer_check_cache_ && status.ok()) {
+          peer_check_cache_->publish(signature, body);
+        }
+        if (pinned_request && status.ok()) {
+          CheckResponse response;
+          if (response.ParseFromString(body)) {
+            pinned_check_cache_->update(*pinned_request, signature, response);
+          }
+        }
+        finishPendingCheck(signature, pending, status, body,
+                           /*from_service_control=*/true);
+      });
+  pending->call->call();
+}
+
+void ClientCache::sendPinnedCheck(const CheckRequest& request,
+                                  PinnedCheckCache::DoneFunc on_done) {
+  // Don't support tracing on this transport
+  auto& null_span = Envoy::Tracing::NullSpan::instance();
+  auto* call = check_call_factory_->createHttpCall(
+      request, null_span,
+      [this, on_done](const Status& status, const std::string& body) {
+        CheckResponse response;
+        Status final_status = processScCallTransportStatus<CheckResponse>(
+            status, &response, body);
+        collectCallStatus(filter_stats_.check_, final_status.code());
+        on_done(final_status, response);
+      });
+  call->call();
+}
+
+void ClientCache::finishPendingCheck(const std::string& signature,
+                                     std::shared_ptr<PendingCheck> pending,
+                                     const Status& status,
+                                     const std::string& body,
+                                     bool from_service_control) {
+  auto it = pending_checks_.find(signature);
+  if (it != pending_checks_.end() && it->second == pending) {
+    pending_checks_.erase(it);
+    filter_stats_.filter_.check_pending_.dec();
+  }
+
+  CheckResponse parsed;
+  Status final_status =
+      processScCallTransportStatus<CheckResponse>(status, &parsed, body);
+  if (from_service_control) {
+    collectCallStatus(filter_stats_.check_, final_status.code());
+  }
+
+  // The callbacks may make new checks, so they are moved out first.
+  auto waiters = std::move(pending->waiters);
+  pending->waiters.clear();
+  for (auto& waiter : waiters) {
+    waiter.second.response->CopyFrom(parsed);
+    waiter.second.on_done(final_status);
+  }
+}
+
+std::string ClientCache::checkSignature(const CheckRequest& request) {
+  CheckRequest key = request;
+  key.mutable_operation()->clear_operation_id();
+  key.mutable_operation()->clear_start_time();
+  key.mutable_operation()->clear_end_time();
+
+  std::string signature;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&signature);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    key.SerializeToCodedStream(&coded_stream);
+  }
+  return signature;
+}
+
 void ClientCache::handleCheckResponse(const Status& http_status,
                                       CheckResponse* response,
                                       CheckDoneFunc on_done) {
@@ -390,19 +692,28 @@ void ClientCache::handleCheckResponse(const Status& http_status,
 
     if (network_fail_open_) {
       filter_stats_.filter_.allowed_control_plane_fault_.inc();
-      ENVOY_LOG(warn,
-                "Google Service Control Check is unavailable, but the "
-                "request is allowed due to network fail open. Original "
-                "error: {}",
-                final_status.message());
+      std::string summary;
+      if (log_limiter_.allow("Check unavailable, allowed by fail open",
+                             summary)) {
+        ENVOY_LOG(warn,
+                  "Google Service Control Check is unavailable, but the "
+                  "request is allowed due to network fail open. Original "
+                  "error: {}{}",
+                  final_status.message(), summary);
+      }
       on_done(OkStatus(), response_info);
     } else {
       // Preserve the original 5xx error code in the response back.
       filter_stats_.filter_.denied_control_plane_fault_.inc();
-      ENVOY_LOG(warn,
-                "Google Service Control Check is unavailable, and the "
-                "request is denied due to network fail closed, with error: {}",
-                final_status.message());
+      std::string summary;
+      if (log_limiter_.allow("Check unavailable, denied by fail closed",
+                             summary)) {
+        ENVOY_LOG(warn,
+                  "Google Service Control Check is unavailable, and the "
+                  "request is denied due to network fail closed, with "
+                  "error: {}{}",
+                  final_status.message(), summary);
+      }
 
       // If http_status is not ok, the StatusCode::kUnavailable is from
       // http_status.
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include "absl/container/flat_hash_map.h"
 #include "api/envoy/v11/http/service_control/config.pb.h"
 #include "envoy/event/dispatcher.h"
 #include "envoy/tracing/http_tracer.h"
@@ -23,7 +24,12 @@
 #include "src/api_proxy/service_control/request_info.h"
 #include "src/envoy/http/service_control/filter_stats.h"
 #include "src/envoy/http/service_control/http_call.h"
+#include "src/envoy/http/service_control/peer_check_cache.h"
+#include "src/envoy/http/service_control/pending_state_handoff.h"
+#include "src/envoy/http/service_control/pinned_check_cache.h"
+#include "src/envoy/http/service_control/report_retry_queue.h"
 #include "src/envoy/http/service_control/service_control_callback_func.h"
+#include "src/envoy/utils/log_rate_limiter.h"
 
 namespace espv2 {
 namespace envoy {
@@ -50,7 +56,9 @@ class ClientCache : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
       Envoy::Upstream::ClusterManager& cm, Envoy::TimeSource& time_source,
       Envoy::Event::Dispatcher& dispatcher,
       std::function<const std::string&()> sc_token_fn,
-      std::function<const std::string&()> quota_token_fn);
+      std::function<const std::string&()> quota_token_fn,
+      const std::string& peer_check_cache_secret,
+      PendingStateHandoffSharedPtr pending_state_handoff);
 
   CancelFunc callCheck(
       const ::google::api::servicecontrol::v1::CheckRequest& request,
@@ -63,6 +71,15 @@ class ClientCache : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
   void callReport(
       const ::google::api::servicecontrol::v1::ReportRequest& request);
 
+  // Merges the requests handed off by the previous hot restart epoch into
+  // the aggregators.
+  void mergePendingState(
+      const std::vector<::google::api::servicecontrol::v1::ReportRequest>&
+          reports,
+      const std::vector<
+          ::google::api::servicecontrol::v1::AllocateQuotaRequest>&
+          quota_requests);
+
  private:
   friend class test::ClientCacheCheckResponseTest;
   friend class test::ClientCacheCheckResponseErrorTypeTest;
@@ -95,8 +112,71 @@ class ClientCache : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
   void collectCallStatus(CallStatusStats& filter_stats,
                          const ::google::protobuf::util::StatusCode& code);
 
+  // Makes one report call. Retries are made by the report retry queue.
+  void sendReport(
+      const ::google::api::servicecontrol::v1::ReportRequest& request,
+      ReportRetryQueue::DoneFunc on_done);
+
+  // A check call in flight, shared by the cache misses of identical check
+  // requests.
+  struct PendingCheck {
+    struct Waiter {
+      ::google::api::servicecontrol::v1::CheckResponse* response;
+      ::google::service_control_client::TransportDoneFunc on_done;
+      // Traces the Service Control call made after a failed peer lookup.
+      Envoy::Tracing::Span* span;
+    };
+
+    HttpCall* call = nullptr;
+    // The span of the waiter the call is traced in. It is handed to another
+    // waiter when that one is cancelled, as its span goes away with it.
+    Envoy::Tracing::Span* call_span = nullptr;
+    absl::flat_hash_map<uint64_t, Waiter> waiters;
+  };
+
+  // Makes the check call for a cache miss, or attaches it to the pending
+  // call of an identical request. Returns the function to detach it.
+  CancelFunc coalesceCheck(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      ::google::api::servicecontrol::v1::CheckResponse* response,
+      ::google::service_control_client::TransportDoneFunc on_done,
+      Envoy::Tracing::Span& parent_span);
+
+  // Looks the check up in the peer check cache, and calls Service Control if
+  // the lookup does not find it.
+  void lookupPeerCheck(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      const std::string& signature, std::shared_ptr<PendingCheck> pending,
+      Envoy::Tracing::Span& parent_span);
+
+  // Makes the check call refreshing a pinned check response.
+  void sendPinnedCheck(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      PinnedCheckCache::DoneFunc on_done);
+
+  // Makes the check call to Service Control.
+  void sendCheck(const ::google::api::servicecontrol::v1::CheckRequest& request,
+                 const std::string& signature,
+                 std::shared_ptr<PendingCheck> pending,
+                 Envoy::Tracing::Span& parent_span);
+
+  // Completes the waiters of the pending check. The Service Control call
+  // stats are collected if the response is from Service Control.
+  void finishPendingCheck(const std::string& signature,
+                          std::shared_ptr<PendingCheck> pending,
+                          const ::google::protobuf::util::Status& status,
+                          const std::string& body, bool from_service_control);
+
+  // Returns the key of the check requests that have the same response. The
+  // fields unique to each request are ignored.
+  static std::string checkSignature(
+      const ::google::api::servicecontrol::v1::CheckRequest& request);
+
+  // Logs the suppressed errors, and schedules the next summary.
+  void logSuppressedErrors();
+
   template <class Response>
-  static ::google::protobuf::util::Status processScCallTransportStatus(
+  ::google::protobuf::util::Status processScCallTransportStatus(
       const ::google::protobuf::util::Status& status, Response* resp,
       const std::string& body);
 
@@ -121,6 +201,38 @@ class ClientCache : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
   // Used to retrieve the current time for tracing.
   Envoy::TimeSource& time_source_;
 
+  // Rate limits the error logs of the failed calls, as they are repeated for
+  // each request during an outage. The calls cancelled on destruction log, so
+  // it must be declared before the call factories.
+  utils::LogRateLimiter log_limiter_;
+  Envoy::Event::TimerPtr log_summary_timer_;
+
+  // Set if the hot restart handoff is enabled. The report and quota calls
+  // cancelled by the destruction of the call factories are added to it, so it
+  // must be declared before them.
+  PendingStateHandoffSharedPtr pending_state_handoff_;
+
+  // The failed reports waiting for a retry. The report calls retried by it
+  // call back into it, and the reports still queued on destruction are handed
+  // off, so it must be declared between the handoff and the call factories.
+  ReportRetryQueuePtr report_retry_queue_;
+
+  // The pending check calls by request signature. Their callbacks run when
+  // the call factories are destructed, so this must be declared before them.
+  absl::flat_hash_map<std::string, std::shared_ptr<PendingCheck>>
+      pending_checks_;
+  uint64_t next_check_waiter_id_ = 0;
+
+  // Set if the check responses of priority consumers are pinned. Its refresh
+  // calls call back into it when they are cancelled on destruction, so it
+  // must be declared before the call factories.
+  PinnedCheckCachePtr pinned_check_cache_;
+
+  // Set if the peer check cache is enabled. Its lookups are cancelled on
+  // destruction without falling back to Service Control, so it may be
+  // destroyed after the check call factory.
+  std::unique_ptr<PeerCheckCache> peer_check_cache_;
+
   // The http call factories. On destruction, they automatically cancel all
   // pending RPCs. These should always be close to the last member variables in
   // the class to mitigate use-after-free of other class members (destructor
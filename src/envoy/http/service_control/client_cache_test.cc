@@ -34,6 +34,8 @@ namespace service_control {
 namespace test {
 
 using ::espv2::api::envoy::v11::http::service_control::FilterConfig;
+using ::espv2::api::envoy::v11::http::service_control::PeerCheckCacheEntry;
+using ::espv2::api::envoy::v11::http::service_control::PeerCheckCacheLookup;
 using ::espv2::api::envoy::v11::http::service_control::Service;
 using ::espv2::api_proxy::service_control::CheckResponseInfo;
 using ::espv2::api_proxy::service_control::api_key::ApiKeyState;
@@ -55,11 +57,13 @@ using ::google::protobuf::util::StatusCode;
 using ::testing::_;
 using ::testing::InSequence;
 using ::testing::NiceMock;
+using ::testing::Ref;
 using ::testing::Return;
 
 constexpr char kServiceName[] = "bookstore.endpoints.test";
 constexpr char kServiceConfigId[] = "2020-06-24r1";
 constexpr char kCheckFilterStateOperationId[] = "test.check.operation";
+constexpr int64_t kPinnedConsumerNumber = 123;
 
 class ClientCacheTestBase : public ::testing::Test {
  protected:
@@ -71,7 +75,7 @@ class ClientCacheTestBase : public ::testing::Test {
   void SetUp() override {
     cache_ = std::make_unique<ClientCache>(
         service_config_, filter_config_, "test", context_.scope_, cm_,
-        time_source_, dispatcher_, token_fn_, token_fn_);
+        time_source_, dispatcher_, token_fn_, token_fn_, "secret", nullptr);
   }
 
   void checkAndReset(Envoy::Stats::Counter& counter, const int expected_value) {
@@ -90,6 +94,7 @@ class ClientCacheTestBase : public ::testing::Test {
     checkAndReset(stats_.filter_.denied_producer_error_, 0);
 
     // Check request tests.
+    checkAndReset(stats_.filter_.check_coalesced_, 0);
     checkAndReset(stats_.check_.OK_, 0);
     checkAndReset(stats_.check_.CANCELLED_, 0);
     checkAndReset(stats_.check_.INVALID_ARGUMENT_, 0);
@@ -177,7 +182,7 @@ class ClientCacheCheckResponseNetworkFailClosedTest
         ->set_value(false);
     cache_ = std::make_unique<ClientCache>(
         service_config_, filter_config_, "test", context_.scope_, cm_,
-        time_source_, dispatcher_, token_fn_, token_fn_);
+        time_source_, dispatcher_, token_fn_, token_fn_, "secret", nullptr);
   }
 };
 
@@ -326,7 +331,7 @@ class ClientCacheHttpRequestTest : public ClientCacheTestBase {
 
     cache_ = std::make_unique<ClientCache>(
         service_config_, filter_config_, "test", context_.scope_, cm_,
-        time_source_, dispatcher_, token_fn_, token_fn_);
+        time_source_, dispatcher_, token_fn_, token_fn_, "secret", nullptr);
 
     // Setup mock http call.
     http_call_ = std::make_unique<MockHttpCall>();
@@ -343,6 +348,15 @@ class ClientCacheHttpRequestTest : public ClientCacheTestBase {
     cache_->report_call_factory_ = std::move(report_call_factory_);
   }
 
+  // Replaces the call factories of the only peer of the peer check cache.
+  void injectPeerFactoryMocks(
+      std::unique_ptr<MockHttpCallFactory> lookup_call_factory,
+      std::unique_ptr<MockHttpCallFactory> publish_call_factory) {
+    auto& peer = cache_->peer_check_cache_->peers_.at(0);
+    peer.lookup_call_factory = std::move(lookup_call_factory);
+    peer.publish_call_factory = std::move(publish_call_factory);
+  }
+
   int got_num_callbacks_ = 0;
   NiceMock<Envoy::Tracing::MockSpan> mock_parent_span_;
   std::unique_ptr<MockHttpCall> http_call_;
@@ -509,6 +523,96 @@ TEST_F(ClientCacheCheckHttpRequestTest, OnePendingHttpCallCancelled) {
   checkAndReset(stats_.filter_.denied_producer_error_, 1);
 }
 
+// Check call 1: Cache miss occurs, so cache makes HttpCall to SC Check.
+// Check call 2: Cache miss occurs while the identical call is pending, so it
+// waits on the same HttpCall. Both CheckDoneFuncs are called on its response.
+TEST_F(ClientCacheCheckHttpRequestTest, ConcurrentMissesShareHttpCall) {
+  // The cache is filled by the shared call, so it is flushed on destruction.
+  setupHttpMocks(1, 1);
+
+  CheckDoneFunc on_check_done = [this](const Status& got_status,
+                                       const CheckResponseInfo&) {
+    got_num_callbacks_++;
+    EXPECT_EQ(got_status.code(), StatusCode::kOk);
+  };
+
+  // The operation ids of the streams differ.
+  CheckRequest request = getValidCheckRequest();
+  cache_->callCheck(request, mock_parent_span_, on_check_done);
+  request.mutable_operation()->set_operation_id("second-operation-id");
+  cache_->callCheck(request, mock_parent_span_, on_check_done);
+
+  // Both RPCs are pending on the one http call.
+  EXPECT_EQ(got_num_callbacks_, 0);
+
+  std::string response_body;
+  const CheckResponse response = getValidCheckResponse();
+  response.SerializeToString(&response_body);
+  http_done_(OkStatus(), response_body);
+
+  EXPECT_EQ(got_num_callbacks_, 2);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  checkAndReset(stats_.filter_.check_coalesced_, 1);
+  checkAndReset(stats_.check_.OK_, 1);
+  checkAndReset(stats_.check_.CANCELLED_, 1);
+}
+
+// Check call 1 & 2: Cache misses share one HttpCall to SC Check.
+// Check call 1 is cancelled, but the HttpCall is kept for check call 2, and
+// its retries are traced in the span of check call 2.
+TEST_F(ClientCacheCheckHttpRequestTest, CancelledWaiterKeepsSharedHttpCall) {
+  setupHttpMocks(1, 1);
+  NiceMock<Envoy::Tracing::MockSpan> second_parent_span;
+
+  const CheckRequest request = getValidCheckRequest();
+  int got_cancelled_callbacks = 0;
+  CancelFunc cancel_func = cache_->callCheck(
+      request, mock_parent_span_,
+      [&got_cancelled_callbacks](const Status& got_status,
+                                 const CheckResponseInfo&) {
+        got_cancelled_callbacks++;
+        EXPECT_EQ(got_status.code(), StatusCode::kInternal);
+      });
+  cache_->callCheck(request, second_parent_span,
+                    [this](const Status& got_status, const CheckResponseInfo&) {
+                      got_num_callbacks_++;
+                      EXPECT_EQ(got_status.code(), StatusCode::kOk);
+                    });
+
+  // Only the waiter is detached, and the call moves to the remaining span.
+  EXPECT_CALL(*http_call_, cancel()).Times(0);
+  EXPECT_CALL(*http_call_, setParentSpan(Ref(second_parent_span)));
+  cancel_func();
+  EXPECT_EQ(got_cancelled_callbacks, 1);
+  EXPECT_EQ(got_num_callbacks_, 0);
+
+  std::string response_body;
+  const CheckResponse response = getValidCheckResponse();
+  response.SerializeToString(&response_body);
+  http_done_(OkStatus(), response_body);
+
+  EXPECT_EQ(got_cancelled_callbacks, 1);
+  EXPECT_EQ(got_num_callbacks_, 1);
+
+  // Cancelling after the response is a no-op.
+  cancel_func();
+  EXPECT_EQ(got_cancelled_callbacks, 1);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  // The detached waiter is not counted as a cancelled call.
+  checkAndReset(stats_.filter_.check_coalesced_, 1);
+  checkAndReset(stats_.filter_.denied_producer_error_, 1);
+  checkAndReset(stats_.check_.OK_, 1);
+  checkAndReset(stats_.check_.CANCELLED_, 1);
+}
+
 // Check call 1: Cache miss occurs, so cache makes HttpCall to SC Check.
 // HttpCall is successful, and the onCheckDone callback is called.
 // Check call 2 & 3: Cache hit, the CheckDoneFunc is called again.
@@ -552,6 +656,226 @@ TEST_F(ClientCacheCheckHttpRequestTest, SuccessfulHttpCallWithCache) {
   checkAndReset(stats_.check_.CANCELLED_, 1);
 }
 
+class ClientCachePeerCheckCacheTest : public ClientCacheCheckHttpRequestTest {
+ public:
+  void SetUp() override {
+    auto* peer = filter_config_.mutable_peer_check_cache()->add_peers();
+    peer->set_uri("http://127.0.0.1:8792");
+    peer->set_cluster("check-cache-peer-cluster-127.0.0.1:8792");
+    peer->mutable_timeout()->set_seconds(1);
+    ClientCacheCheckHttpRequestTest::SetUp();
+
+    auto lookup_call_factory = std::make_unique<MockHttpCallFactory>();
+    EXPECT_CALL(*lookup_call_factory, createHttpCall(_, _, _))
+        .WillOnce(Invoke([this](const Envoy::Protobuf::Message& request,
+                                Envoy::Tracing::Span&,
+                                HttpCall::DoneFunc on_done) {
+          peer_key_ =
+              dynamic_cast<const PeerCheckCacheLookup&>(request).key();
+          peer_done_ = on_done;
+          return &peer_call_;
+        }));
+    publish_call_factory_ = new MockHttpCallFactory();
+    injectPeerFactoryMocks(
+        std::move(lookup_call_factory),
+        std::unique_ptr<MockHttpCallFactory>(publish_call_factory_));
+  }
+
+  void TearDown() override {
+    checkAndReset(stats_.filter_.peer_check_cache_hit_, 0);
+    checkAndReset(stats_.filter_.peer_check_cache_miss_, 0);
+    checkAndReset(stats_.filter_.peer_check_cache_error_, 0);
+    ClientCacheCheckHttpRequestTest::TearDown();
+  }
+
+  std::string validCheckResponseBody() {
+    std::string response_body;
+    getValidCheckResponse().SerializeToString(&response_body);
+    return response_body;
+  }
+
+  // The entry the owner publishes for the looked up key, signed with
+  // `secret`.
+  std::string peerEntryBody(const std::string& secret) {
+    PeerCheckCacheEntry entry;
+    entry.set_key(peer_key_);
+    entry.set_check_response(validCheckResponseBody());
+    entry.mutable_expire_time()->set_seconds(60);
+    entry.set_hmac(PeerCheckCache::entryHmac(
+        std::vector<uint8_t>(secret.begin(), secret.end()), entry));
+    std::string body;
+    entry.SerializeToString(&body);
+    return body;
+  }
+
+  MockHttpCall peer_call_;
+  std::string peer_key_;
+  HttpCall::DoneFunc peer_done_;
+  // Owned by the peer check cache.
+  MockHttpCallFactory* publish_call_factory_;
+};
+
+// Cache miss occurs, and the peer check cache has the response, so no
+// HttpCall is made to SC Check.
+TEST_F(ClientCachePeerCheckCacheTest, PeerHitSkipsServiceControl) {
+  // The only call is the cache flush on destruction.
+  setupHttpMocks(0, 1);
+  EXPECT_CALL(peer_call_, call());
+  EXPECT_CALL(*publish_call_factory_, createHttpCall(_, _, _)).Times(0);
+
+  cache_->callCheck(getValidCheckRequest(), mock_parent_span_,
+                    [this](const Status& got_status, const CheckResponseInfo&) {
+                      got_num_callbacks_++;
+                      EXPECT_EQ(got_status.code(), StatusCode::kOk);
+                    });
+  EXPECT_EQ(got_num_callbacks_, 0);
+
+  peer_done_(OkStatus(), peerEntryBody("secret"));
+  EXPECT_EQ(got_num_callbacks_, 1);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  checkAndReset(stats_.filter_.peer_check_cache_hit_, 1);
+  checkAndReset(stats_.check_.CANCELLED_, 1);
+}
+
+// Cache miss occurs, and the peer check cache does not have the response, so
+// the HttpCall is made to SC Check, and its response is published.
+TEST_F(ClientCachePeerCheckCacheTest, PeerMissCallsServiceControlAndPublishes) {
+  setupHttpMocks(1, 1);
+  EXPECT_CALL(peer_call_, call());
+  MockHttpCall publish_call;
+  EXPECT_CALL(publish_call, call());
+  EXPECT_CALL(*publish_call_factory_, createHttpCall(_, _, _))
+      .WillOnce(Return(&publish_call));
+
+  cache_->callCheck(getValidCheckRequest(), mock_parent_span_,
+                    [this](const Status& got_status, const CheckResponseInfo&) {
+                      got_num_callbacks_++;
+                      EXPECT_EQ(got_status.code(), StatusCode::kOk);
+                    });
+
+  // The owner answers a miss with 404.
+  peer_done_(Status(StatusCode::kUnimplemented, "Not Found"),
+             Envoy::EMPTY_STRING);
+  EXPECT_EQ(got_num_callbacks_, 0);
+
+  http_done_(OkStatus(), validCheckResponseBody());
+  EXPECT_EQ(got_num_callbacks_, 1);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  checkAndReset(stats_.filter_.peer_check_cache_miss_, 1);
+  checkAndReset(stats_.check_.OK_, 1);
+  checkAndReset(stats_.check_.CANCELLED_, 1);
+}
+
+// The peer check cache fails, so the HttpCall is made to SC Check.
+TEST_F(ClientCachePeerCheckCacheTest, PeerErrorFallsBackToServiceControl) {
+  setupHttpMocks(1, 0);
+  EXPECT_CALL(peer_call_, call());
+  EXPECT_CALL(*publish_call_factory_, createHttpCall(_, _, _)).Times(0);
+
+  cache_->callCheck(getValidCheckRequest(), mock_parent_span_,
+                    [this](const Status& got_status, const CheckResponseInfo&) {
+                      got_num_callbacks_++;
+                      EXPECT_EQ(got_status.code(), StatusCode::kOk);
+                    });
+
+  peer_done_(Status(StatusCode::kUnavailable, "unavailable"),
+             Envoy::EMPTY_STRING);
+  EXPECT_EQ(got_num_callbacks_, 0);
+
+  // Service Control is unavailable too, and the network fails open.
+  http_done_(Status(StatusCode::kUnavailable, "unavailable"),
+             Envoy::EMPTY_STRING);
+  EXPECT_EQ(got_num_callbacks_, 1);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  checkAndReset(stats_.filter_.peer_check_cache_error_, 1);
+  checkAndReset(stats_.filter_.allowed_control_plane_fault_, 1);
+  checkAndReset(stats_.check_.UNAVAILABLE_, 1);
+}
+
+// The peer serves an entry not signed with the shared secret, so it is ignored
+// and the HttpCall is made to SC Check.
+TEST_F(ClientCachePeerCheckCacheTest, ForgedPeerEntryCallsServiceControl) {
+  setupHttpMocks(1, 1);
+  EXPECT_CALL(peer_call_, call());
+  MockHttpCall publish_call;
+  EXPECT_CALL(publish_call, call());
+  EXPECT_CALL(*publish_call_factory_, createHttpCall(_, _, _))
+      .WillOnce(Return(&publish_call));
+
+  cache_->callCheck(getValidCheckRequest(), mock_parent_span_,
+                    [this](const Status& got_status, const CheckResponseInfo&) {
+                      got_num_callbacks_++;
+                      EXPECT_EQ(got_status.code(), StatusCode::kOk);
+                    });
+
+  peer_done_(OkStatus(), peerEntryBody("other secret"));
+  EXPECT_EQ(got_num_callbacks_, 0);
+
+  http_done_(OkStatus(), validCheckResponseBody());
+  EXPECT_EQ(got_num_callbacks_, 1);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  checkAndReset(stats_.filter_.peer_check_cache_error_, 1);
+  checkAndReset(stats_.check_.OK_, 1);
+  checkAndReset(stats_.check_.CANCELLED_, 1);
+}
+
+class ClientCachePinnedCheckCacheTest : public ClientCacheCheckHttpRequestTest {
+ public:
+  void SetUp() override {
+    filter_config_.mutable_pinned_check_cache()->add_consumer_numbers(
+        kPinnedConsumerNumber);
+    ClientCacheCheckHttpRequestTest::SetUp();
+  }
+};
+
+// The response of a priority consumer is pinned, and serves its next checks
+// without querying the check cache.
+TEST_F(ClientCachePinnedCheckCacheTest, PinnedResponseServesNextChecks) {
+  setupHttpMocks(1, 1);
+
+  CheckResponse response = getValidCheckResponse();
+  response.mutable_check_info()->mutable_consumer_info()->set_project_number(
+      kPinnedConsumerNumber);
+  std::string response_body;
+  response.SerializeToString(&response_body);
+
+  auto on_done = [this](const Status& got_status, const CheckResponseInfo&) {
+    got_num_callbacks_++;
+    EXPECT_EQ(got_status.code(), StatusCode::kOk);
+  };
+  cache_->callCheck(getValidCheckRequest(), mock_parent_span_, on_done);
+  http_done_(OkStatus(), response_body);
+  EXPECT_EQ(got_num_callbacks_, 1);
+
+  // Served inline by the pinned response.
+  cache_->callCheck(getValidCheckRequest(), mock_parent_span_, on_done);
+  EXPECT_EQ(got_num_callbacks_, 2);
+
+  // Force destructor on cache.
+  cache_.reset(nullptr);
+
+  // Stats.
+  checkAndReset(stats_.filter_.pinned_check_cache_hit_, 1);
+  checkAndReset(stats_.check_.OK_, 1);
+  checkAndReset(stats_.check_.CANCELLED_, 1);
+}
+
 }  // namespace test
 }  // namespace service_control
 }  // namespace http_filters
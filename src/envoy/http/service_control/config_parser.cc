@@ -16,6 +16,8 @@
 
 #include "source/common/protobuf/utility.h"
 
+using ::espv2::api::envoy::v11::http::service_control::ApiKeyLocation;
+using ::espv2::api::envoy::v11::http::service_control::ApiKeyRequirement;
 using ::espv2::api::envoy::v11::http::service_control::FilterConfig;
 
 namespace espv2 {
@@ -28,6 +30,16 @@ namespace {
 const char kUnrecognizedOperation[] = "<Unknown Operation Name>";
 }  // namespace
 
+std::vector<std::string> apiKeyCookieNames(const ApiKeyRequirement& api_key) {
+  std::vector<std::string> names;
+  for (const auto& location : api_key.locations()) {
+    if (location.key_case() == ApiKeyLocation::kCookie) {
+      names.push_back(location.cookie());
+    }
+  }
+  return names;
+}
+
 FilterConfigParser::FilterConfigParser(const FilterConfig& config,
                                        ServiceControlCallFactory& factory)
     : config_(config) {
@@ -74,6 +86,8 @@ FilterConfigParser::FilterConfigParser(const FilterConfig& config,
   default_api_keys_.add_locations()->set_query("key");
   default_api_keys_.add_locations()->set_query("api_key");
   default_api_keys_.add_locations()->set_header("x-api-key");
+  default_api_key_cookies_ =
+      utils::CookieScanner(apiKeyCookieNames(default_api_keys_));
 }
 
 }  // namespace service_control
@@ -15,12 +15,15 @@
 #pragma once
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "api/envoy/v11/http/service_control/config.pb.h"
 #include "api/envoy/v11/http/service_control/requirement.pb.h"
 #include "envoy/router/router.h"
 #include "source/common/protobuf/utility.h"
+#include "src/envoy/http/service_control/local_reply.h"
 #include "src/envoy/http/service_control/service_control_call.h"
+#include "src/envoy/utils/cookie_scanner.h"
 
 namespace espv2 {
 namespace envoy {
@@ -36,6 +39,11 @@ constexpr int64_t kDefaultMinStreamReportIntervalMs = 10000;
 constexpr int64_t kLowerBoundMinStreamReportIntervalMs = 100;
 }  // namespace
 
+// Returns the cookie names of the api-key locations, in order.
+std::vector<std::string> apiKeyCookieNames(
+    const ::espv2::api::envoy::v11::http::service_control::ApiKeyRequirement&
+        api_key);
+
 // The filter name.
 constexpr const char kFilterName[] =
     "com.google.espv2.filters.http.service_control";
@@ -45,7 +53,9 @@ class ServiceContext {
   ServiceContext(
       const ::espv2::api::envoy::v11::http::service_control::Service& config,
       ServiceControlCallFactory& factory)
-      : config_(config), service_control_call_(factory.create(config_)) {
+      : config_(config),
+        service_control_call_(factory.create(config_)),
+        local_replies_(config_.service_name()) {
     min_stream_report_interval_ms_ = config_.min_stream_report_interval_ms();
     if (!min_stream_report_interval_ms_) {
       min_stream_report_interval_ms_ = kDefaultMinStreamReportIntervalMs;
@@ -69,9 +79,13 @@ class ServiceContext {
 
   ServiceControlCall& call() const { return *service_control_call_; }
 
+  const LocalReplyCache& local_replies() const { return local_replies_; }
+
  private:
   const ::espv2::api::envoy::v11::http::service_control::Service& config_;
   ServiceControlCallPtr service_control_call_;
+  // The pre-rendered local replies for denied requests.
+  LocalReplyCache local_replies_;
   int64_t min_stream_report_interval_ms_;
 };
 using ServiceContextPtr = std::unique_ptr<ServiceContext>;
@@ -82,12 +96,18 @@ class RequirementContext {
       const ::espv2::api::envoy::v11::http::service_control::Requirement&
           config,
       const ServiceContext& service_ctx)
-      : config_(config), service_ctx_(service_ctx) {
+      : config_(config),
+        service_ctx_(service_ctx),
+        api_key_cookies_(apiKeyCookieNames(config.api_key())) {
     metric_costs_.reserve(config.metric_costs().size());
     for (const auto& metric_cost : config.metric_costs()) {
       metric_costs_.push_back(
           std::make_pair(metric_cost.name(), metric_cost.cost()));
     }
+    for (const auto& caller : config.trusted_jwt_callers()) {
+      trusted_jwt_audiences_[caller.issuer()].insert(
+          caller.audiences().begin(), caller.audiences().end());
+    }
   }
 
   const ::espv2::api::envoy::v11::http::service_control::Requirement& config()
@@ -101,10 +121,38 @@ class RequirementContext {
     return metric_costs_;
   }
 
+  // Looks up the cookies of the api-key locations.
+  const utils::CookieScanner& api_key_cookies() const {
+    return api_key_cookies_;
+  }
+
+  bool has_trusted_jwt_callers() const {
+    return !trusted_jwt_audiences_.empty();
+  }
+
+  // Whether a JWT with the issuer and audiences is from a trusted caller.
+  bool isTrustedJwtCaller(absl::string_view issuer,
+                          const std::vector<std::string>& audiences) const {
+    const auto it = trusted_jwt_audiences_.find(issuer);
+    if (it == trusted_jwt_audiences_.end()) {
+      return false;
+    }
+    for (const auto& audience : audiences) {
+      if (it->second.contains(audience)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
  private:
   const ::espv2::api::envoy::v11::http::service_control::Requirement& config_;
   const ServiceContext& service_ctx_;
   std::vector<std::pair<std::string, int>> metric_costs_;
+  const utils::CookieScanner api_key_cookies_;
+  // The audiences of the trusted JWT callers, by issuer.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>
+      trusted_jwt_audiences_;
 };
 using RequirementContextPtr = std::unique_ptr<RequirementContext>;
 
@@ -133,6 +181,10 @@ class FilterConfigParser {
     return default_api_keys_;
   }
 
+  const utils::CookieScanner& default_api_key_cookies() const {
+    return default_api_key_cookies_;
+  }
+
   const RequirementContext* non_match_rqm_ctx() const {
     return non_match_rqm_ctx_.get();
   }
@@ -151,6 +203,7 @@ class FilterConfigParser {
   // The default locations to extract api-key.
   ::espv2::api::envoy::v11::http::service_control::ApiKeyRequirement
       default_api_keys_;
+  utils::CookieScanner default_api_key_cookies_;
 };
 
 class PerRouteFilterConfig : public Envoy::Router::RouteSpecificFilterConfig {
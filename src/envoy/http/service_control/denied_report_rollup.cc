@@ -0,0 +1,124 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/denied_report_rollup.h"
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/util/time_util.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::espv2::api::envoy::v11::http::service_control::
+    DeniedReportRollupConfig;
+using ::espv2::api_proxy::service_control::ReportRequestInfo;
+using ::google::protobuf::util::TimeUtil;
+
+namespace {
+
+// Clears the fields identifying the request the rolled-up report was filled
+// from, as the report stands for the denied requests of any caller.
+void clearRequestIdentity(ReportRequestInfo& info) {
+  info.api_key.clear();
+  info.referer.clear();
+  info.client_ip.clear();
+  info.trace_id.clear();
+  info.auth_issuer.clear();
+  info.auth_audience.clear();
+  info.request_headers.clear();
+  info.response_headers.clear();
+  info.jwt_payloads.clear();
+  info.check_response_info =
+      ::espv2::api_proxy::service_control::CheckResponseInfo();
+  // The query may carry an API key.
+  info.url = info.url.substr(0, info.url.find('?'));
+}
+
+}  // namespace
+
+DeniedReportRollup::DeniedReportRollup(const DeniedReportRollupConfig& config,
+                                       Envoy::Event::Dispatcher& dispatcher,
+                                       const std::string& stats_prefix,
+                                       Envoy::Stats::Scope& scope,
+                                       FlushFunc flush_fn)
+    : threshold_(kDeniedReportRollupDefaultThreshold),
+      interval_(kDeniedReportRollupDefaultInterval),
+      filter_stats_(ServiceControlFilterStats::create(stats_prefix, scope)),
+      flush_fn_(std::move(flush_fn)),
+      timer_(dispatcher.createTimer([this]() {
+        flush();
+        timer_->enableTimer(interval_);
+      })) {
+  if (config.threshold() > 0) {
+    threshold_ = config.threshold();
+  }
+  if (config.has_interval()) {
+    interval_ = std::chrono::milliseconds(
+        TimeUtil::DurationToMilliseconds(config.interval()));
+  }
+  timer_->enableTimer(interval_);
+}
+
+DeniedReportRollup::~DeniedReportRollup() { flush(); }
+
+bool DeniedReportRollup::record(absl::string_view operation_name,
+                                const LocalReply& reply,
+                                const DeniedReportFillFunc& fill_fn) {
+  if (++denied_in_interval_ <= threshold_) {
+    return false;
+  }
+
+  auto op_it = entries_.find(operation_name);
+  if (op_it == entries_.end()) {
+    op_it = entries_.emplace(std::string(operation_name),
+                             absl::flat_hash_map<std::string, Entry>())
+                .first;
+  }
+
+  auto entry_it = op_it->second.find(reply.rc_detail);
+  if (entry_it == op_it->second.end()) {
+    entry_it = op_it->second.emplace(reply.rc_detail, Entry()).first;
+    fill_fn(entry_it->second.info);
+    clearRequestIdentity(entry_it->second.info);
+  }
+  ++entry_it->second.count;
+  filter_stats_.filter_.denied_report_rolled_up_.inc();
+  return true;
+}
+
+void DeniedReportRollup::flush() {
+  if (denied_in_interval_ > threshold_) {
+    ENVOY_LOG(debug, "{} denied reports in the last interval, {} rolled up",
+              denied_in_interval_, denied_in_interval_ - threshold_);
+  }
+  denied_in_interval_ = 0;
+
+  for (auto& op : entries_) {
+    for (auto& reason : op.second) {
+      ReportRequestInfo& info = reason.second.info;
+      info.request_count = reason.second.count;
+      info.log_message = absl::StrCat(info.api_method, " is denied ",
+                                      reason.second.count, " times");
+      flush_fn_(info);
+    }
+  }
+  entries_.clear();
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
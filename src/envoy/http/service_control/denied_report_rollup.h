@@ -0,0 +1,107 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "api/envoy/v11/http/service_control/config.pb.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "source/common/common/logger.h"
+#include "src/api_proxy/service_control/request_info.h"
+#include "src/envoy/http/service_control/filter_stats.h"
+#include "src/envoy/http/service_control/local_reply.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+// The number of denied reports per worker per interval sent as is, and the
+// interval, if they are not configured.
+constexpr uint64_t kDeniedReportRollupDefaultThreshold = 100;
+constexpr std::chrono::milliseconds kDeniedReportRollupDefaultInterval(1000);
+
+// The function to fill the report of a denied request.
+using DeniedReportFillFunc = std::function<void(
+    ::espv2::api_proxy::service_control::ReportRequestInfo& info)>;
+
+// Rolls up the reports of requests denied with a pre-rendered local reply
+// during a denial flood (credential stuffing, missing API keys), see
+// DeniedReportRollupConfig.
+//
+// Below the threshold of denied reports per interval, every report is sent as
+// is. Above it, reports are only counted per operation and denial reason, and
+// one report per counter is sent at the end of the interval with
+// `request_count` set to the number of denied requests it stands for. As it
+// stands for requests of many callers, the identity of the first one is
+// cleared from it.
+//
+// It is not thread-safe and is expected to be owned by a worker thread.
+class DeniedReportRollup
+    : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+ public:
+  // The function to send a rolled-up report.
+  using FlushFunc = std::function<void(
+      const ::espv2::api_proxy::service_control::ReportRequestInfo& info)>;
+
+  DeniedReportRollup(
+      const ::espv2::api::envoy::v11::http::service_control::
+          DeniedReportRollupConfig& config,
+      Envoy::Event::Dispatcher& dispatcher, const std::string& stats_prefix,
+      Envoy::Stats::Scope& scope, FlushFunc flush_fn);
+
+  // Sends the pending rolled-up reports.
+  ~DeniedReportRollup();
+
+  // Returns false if the report should be sent individually by the caller.
+  // Otherwise the report is counted, and `fill_fn` is only called for the
+  // first report of each operation and denial reason in the interval.
+  bool record(absl::string_view operation_name, const LocalReply& reply,
+              const DeniedReportFillFunc& fill_fn);
+
+ private:
+  struct Entry {
+    ::espv2::api_proxy::service_control::ReportRequestInfo info;
+    uint64_t count = 0;
+  };
+
+  void flush();
+
+  uint64_t threshold_;
+  std::chrono::milliseconds interval_;
+  ServiceControlFilterStats filter_stats_;
+  FlushFunc flush_fn_;
+
+  // The number of denied reports seen in the current interval.
+  uint64_t denied_in_interval_ = 0;
+
+  // Operation name to rc_detail to the rolled-up report.
+  absl::flat_hash_map<std::string, absl::flat_hash_map<std::string, Entry>>
+      entries_;
+
+  Envoy::Event::TimerPtr timer_;
+};
+
+using DeniedReportRollupPtr = std::unique_ptr<DeniedReportRollup>;
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,189 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/denied_report_rollup.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/stats/mocks.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::espv2::api::envoy::v11::http::service_control::
+    DeniedReportRollupConfig;
+using ::espv2::api_proxy::service_control::ReportRequestInfo;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+using ::testing::_;
+using ::testing::NiceMock;
+
+constexpr uint64_t kThreshold = 2;
+
+class DeniedReportRollupTest : public ::testing::Test {
+ protected:
+  DeniedReportRollupTest()
+      : timer_(new NiceMock<Envoy::Event::MockTimer>(&dispatcher_)),
+        stats_(ServiceControlFilterStats::create("", scope_)),
+        reply_a_(Status(StatusCode::kInvalidArgument, "a"), "reason_a"),
+        reply_b_(Status(StatusCode::kPermissionDenied, "b"), "reason_b") {
+    DeniedReportRollupConfig config;
+    config.set_threshold(kThreshold);
+    createRollup(config);
+  }
+
+  void createRollup(const DeniedReportRollupConfig& config) {
+    rollup_ = std::make_unique<DeniedReportRollup>(
+        config, dispatcher_, "", scope_,
+        [this](const ReportRequestInfo& info) { flushed_.push_back(info); });
+  }
+
+  bool record(absl::string_view operation, const LocalReply& reply,
+              const std::string& api_key = "key") {
+    return rollup_->record(operation, reply, [&](ReportRequestInfo& info) {
+      ++fill_count_;
+      info.operation_id = "operation-id";
+      info.operation_name = std::string(operation);
+      info.api_method = std::string(operation);
+      info.response_code_detail = reply.rc_detail;
+      info.api_key = api_key;
+      info.client_ip = "10.0.0.1";
+      info.trace_id = "trace-id";
+      info.url = "/echo?key=" + api_key;
+      info.check_response_info.consumer_project_number = "123";
+    });
+  }
+
+  NiceMock<Envoy::Event::MockDispatcher> dispatcher_;
+  Envoy::Event::MockTimer* timer_;
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope_;
+  ServiceControlFilterStats stats_;
+  const LocalReply reply_a_;
+  const LocalReply reply_b_;
+
+  std::vector<ReportRequestInfo> flushed_;
+  int fill_count_ = 0;
+
+  std::unique_ptr<DeniedReportRollup> rollup_;
+};
+
+TEST_F(DeniedReportRollupTest, UnderThresholdNotRolledUp) {
+  EXPECT_FALSE(record("op", reply_a_));
+  EXPECT_FALSE(record("op", reply_a_));
+  EXPECT_EQ(fill_count_, 0);
+
+  timer_->invokeCallback();
+  EXPECT_TRUE(flushed_.empty());
+  EXPECT_EQ(stats_.filter_.denied_report_rolled_up_.value(), 0);
+}
+
+TEST_F(DeniedReportRollupTest, RolledUpPerOperationAndReason) {
+  EXPECT_FALSE(record("op1", reply_a_));
+  EXPECT_FALSE(record("op1", reply_a_));
+
+  // Over the threshold, reports are counted instead of sent.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(record("op1", reply_a_));
+  }
+  EXPECT_TRUE(record("op1", reply_b_));
+  EXPECT_TRUE(record("op2", reply_a_));
+  EXPECT_TRUE(record("op2", reply_a_));
+
+  // Only the first report of each key is filled.
+  EXPECT_EQ(fill_count_, 3);
+  EXPECT_EQ(stats_.filter_.denied_report_rolled_up_.value(), 6);
+  EXPECT_TRUE(flushed_.empty());
+
+  timer_->invokeCallback();
+  ASSERT_EQ(flushed_.size(), 3);
+
+  absl::flat_hash_map<std::string, int64_t> counts;
+  for (const auto& info : flushed_) {
+    counts[absl::StrCat(info.operation_name, "/", info.response_code_detail)] =
+        info.request_count;
+  }
+  EXPECT_EQ(counts["op1/reason_a"], 3);
+  EXPECT_EQ(counts["op1/reason_b"], 1);
+  EXPECT_EQ(counts["op2/reason_a"], 2);
+}
+
+TEST_F(DeniedReportRollupTest, RolledUpReportHasNoCallerIdentity) {
+  EXPECT_FALSE(record("op", reply_a_, "key1"));
+  EXPECT_FALSE(record("op", reply_a_, "key1"));
+  EXPECT_TRUE(record("op", reply_a_, "key2"));
+  EXPECT_TRUE(record("op", reply_a_, "key3"));
+
+  timer_->invokeCallback();
+  ASSERT_EQ(flushed_.size(), 1);
+  const ReportRequestInfo& info = flushed_[0];
+  EXPECT_EQ(info.request_count, 2);
+  EXPECT_EQ(info.operation_id, "operation-id");
+  EXPECT_EQ(info.operation_name, "op");
+  EXPECT_EQ(info.api_key, "");
+  EXPECT_EQ(info.client_ip, "");
+  EXPECT_EQ(info.trace_id, "");
+  EXPECT_EQ(info.url, "/echo");
+  EXPECT_EQ(info.check_response_info.consumer_project_number, "");
+}
+
+TEST_F(DeniedReportRollupTest, DefaultConfig) {
+  timer_ = new NiceMock<Envoy::Event::MockTimer>(&dispatcher_);
+  EXPECT_CALL(*timer_, enableTimer(kDeniedReportRollupDefaultInterval, _));
+  createRollup(DeniedReportRollupConfig());
+
+  for (uint64_t i = 0; i < kDeniedReportRollupDefaultThreshold; ++i) {
+    EXPECT_FALSE(record("op", reply_a_));
+  }
+  EXPECT_TRUE(record("op", reply_a_));
+}
+
+TEST_F(DeniedReportRollupTest, ConfiguredInterval) {
+  timer_ = new NiceMock<Envoy::Event::MockTimer>(&dispatcher_);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(5000), _));
+  DeniedReportRollupConfig config;
+  config.mutable_interval()->set_seconds(5);
+  createRollup(config);
+}
+
+TEST_F(DeniedReportRollupTest, FlushResetsInterval) {
+  EXPECT_FALSE(record("op", reply_a_));
+  EXPECT_FALSE(record("op", reply_a_));
+  EXPECT_TRUE(record("op", reply_a_));
+
+  timer_->invokeCallback();
+  ASSERT_EQ(flushed_.size(), 1);
+
+  // The new interval starts under the threshold again.
+  EXPECT_FALSE(record("op", reply_a_));
+}
+
+TEST_F(DeniedReportRollupTest, FlushOnDestruction) {
+  EXPECT_FALSE(record("op", reply_a_));
+  EXPECT_FALSE(record("op", reply_a_));
+  EXPECT_TRUE(record("op", reply_a_));
+
+  rollup_.reset();
+  ASSERT_EQ(flushed_.size(), 1);
+  EXPECT_EQ(flushed_[0].request_count, 1);
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
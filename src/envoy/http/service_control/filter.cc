@@ -17,6 +17,7 @@
 #include <chrono>
 
 #include "envoy/http/header_map.h"
+#include "source/common/common/macros.h"
 #include "source/common/grpc/status.h"
 #include "src/envoy/http/service_control/handler.h"
 #include "src/envoy/utils/http_header_utils.h"
@@ -26,6 +27,25 @@ namespace espv2 {
 namespace envoy {
 namespace http_filters {
 namespace service_control {
+namespace {
+
+const std::string& missingMethodRcDetail() {
+  CONSTRUCT_ON_FIRST_USE(
+      std::string,
+      utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
+                               utils::kRcDetailErrorTypeBadRequest,
+                               utils::kRcDetailErrorMissingMethod));
+}
+
+const std::string& missingPathRcDetail() {
+  CONSTRUCT_ON_FIRST_USE(
+      std::string,
+      utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
+                               utils::kRcDetailErrorTypeBadRequest,
+                               utils::kRcDetailErrorMissingPath));
+}
+
+}  // namespace
 
 void ServiceControlFilter::onDestroy() {
   ENVOY_LOG(debug, "Called ServiceControl Filter : {}", __func__);
@@ -40,16 +60,11 @@ Envoy::Http::FilterHeadersStatus ServiceControlFilter::decodeHeaders(
 
   if (!headers.Method()) {
     rejectRequest(Envoy::Http::Code::BadRequest,
-                  "No method in request headers.",
-                  utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
-                                           utils::kRcDetailErrorTypeBadRequest,
-                                           utils::kRcDetailErrorMissingMethod));
+                  "No method in request headers.", missingMethodRcDetail());
     return Envoy::Http::FilterHeadersStatus::StopIteration;
   } else if (!headers.Path()) {
     rejectRequest(Envoy::Http::Code::BadRequest, "No path in request headers.",
-                  utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
-                                           utils::kRcDetailErrorTypeBadRequest,
-                                           utils::kRcDetailErrorMissingPath));
+                  missingPathRcDetail());
     return Envoy::Http::FilterHeadersStatus::StopIteration;
   }
 
@@ -109,6 +124,10 @@ void ServiceControlFilter::onCheckDone(
   }
 }
 
+void ServiceControlFilter::onCheckDenied(const LocalReply& reply) {
+  rejectRequest(reply.http_code, reply.body, reply.rc_detail);
+}
+
 void ServiceControlFilter::rejectRequest(Envoy::Http::Code code,
                                          absl::string_view error_msg,
                                          absl::string_view rc_detail) {
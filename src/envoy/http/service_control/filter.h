@@ -59,6 +59,7 @@ class ServiceControlFilter
   // For Handler::CheckDoneCallback, called when callCheck() is done
   void onCheckDone(const ::google::protobuf::util::Status& status,
                    absl::string_view rc_detail) override;
+  void onCheckDenied(const LocalReply& reply) override;
 
  private:
   void rejectRequest(Envoy::Http::Code code, absl::string_view error_msg,
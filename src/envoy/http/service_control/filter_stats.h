@@ -28,17 +28,40 @@ namespace service_control {
  * For description of each stat, @see the README.md for this filter.
  * @see stats_macros.h
  */
-#define FILTER_STATS(COUNTER, HISTOGRAM) \
-  COUNTER(allowed)                       \
-  COUNTER(allowed_control_plane_fault)   \
-  COUNTER(denied)                        \
-  COUNTER(denied_control_plane_fault)    \
-  COUNTER(denied_consumer_blocked)       \
-  COUNTER(denied_consumer_error)         \
-  COUNTER(denied_consumer_quota)         \
-  COUNTER(denied_producer_error)         \
-  HISTOGRAM(request_time, Milliseconds)  \
-  HISTOGRAM(backend_time, Milliseconds)  \
+#define FILTER_STATS(COUNTER, GAUGE, HISTOGRAM) \
+  COUNTER(allowed)                              \
+  COUNTER(allowed_control_plane_fault)          \
+  COUNTER(api_key_request_normalized)           \
+  COUNTER(api_key_restricted)                   \
+  COUNTER(api_key_restriction_probed)           \
+  COUNTER(api_key_unrestricted)                 \
+  COUNTER(check_coalesced)                      \
+  GAUGE(check_pending, NeverImport)             \
+  COUNTER(check_skipped_trusted_jwt)            \
+  COUNTER(denied)                               \
+  COUNTER(denied_control_plane_fault)           \
+  COUNTER(denied_consumer_blocked)              \
+  COUNTER(denied_consumer_error)                \
+  COUNTER(denied_consumer_quota)                \
+  COUNTER(denied_producer_error)                \
+  COUNTER(denied_report_rolled_up)              \
+  GAUGE(http_call_active, NeverImport)          \
+  COUNTER(peer_check_cache_error)               \
+  COUNTER(peer_check_cache_hit)                 \
+  COUNTER(peer_check_cache_miss)                \
+  COUNTER(peer_check_cache_published)           \
+  COUNTER(pending_state_handed_off)             \
+  COUNTER(pending_state_taken_over)             \
+  COUNTER(pinned_check_cache_hit)               \
+  COUNTER(pinned_check_cache_refresh_failed)    \
+  COUNTER(pinned_check_cache_refreshed)         \
+  COUNTER(report_retry_dropped)                 \
+  COUNTER(report_retry_merged)                  \
+  COUNTER(report_retry_queued)                  \
+  GAUGE(report_retry_queued_bytes, NeverImport) \
+  COUNTER(report_retry_sent)                    \
+  HISTOGRAM(request_time, Milliseconds)         \
+  HISTOGRAM(backend_time, Milliseconds)         \
   HISTOGRAM(overhead_time, Milliseconds)
 
 /**
@@ -70,7 +93,8 @@ namespace service_control {
  * Wrapper struct for general service control filter stats. @see stats_macros.h
  */
 struct FilterStats {
-  FILTER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_HISTOGRAM_STRUCT);
+  FILTER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT,
+               GENERATE_HISTOGRAM_STRUCT);
 };
 
 /**
@@ -104,6 +128,7 @@ struct ServiceControlFilterStats {
     const std::string final_prefix = prefix + "service_control.";
 
     return {{FILTER_STATS(POOL_COUNTER_PREFIX(scope, final_prefix),
+                          POOL_GAUGE_PREFIX(scope, final_prefix),
                           POOL_HISTOGRAM_PREFIX(scope, final_prefix))},
             {CALL_STATUS_STATS(
                 POOL_COUNTER_PREFIX(scope, final_prefix + "check."))},
@@ -215,6 +215,32 @@ TEST_F(ServiceControlFilterTest, DecodeHeadersAsyncBadStatus) {
       kBadStatus, "service_control_check_error{API_KEY_INVALID}");
 }
 
+TEST_F(ServiceControlFilterTest, DecodeHeadersSyncDeniedWithLocalReply) {
+  // Test: A pre-rendered local reply is sent as is.
+  const LocalReply reply(kBadStatus,
+                         "service_control_bad_request{MISSING_API_KEY}");
+  EXPECT_CALL(*mock_handler_, callCheck(_, _, _))
+      .WillOnce(Invoke(
+          [&reply](Envoy::Http::RequestHeaderMap&, Envoy::Tracing::Span&,
+                   ServiceControlHandler::CheckDoneCallback& callback) {
+            callback.onCheckDenied(reply);
+          }));
+
+  EXPECT_CALL(
+      mock_decoder_callbacks_.stream_info_,
+      setResponseFlag(
+          Envoy::StreamInfo::ResponseFlag::UnauthorizedExternalService));
+  EXPECT_CALL(
+      mock_decoder_callbacks_,
+      sendLocalReply(Envoy::Http::Code::Unauthorized, "UNAUTHENTICATED:test", _,
+                     _, "service_control_bad_request{MISSING_API_KEY}"));
+  EXPECT_CALL(mock_decoder_callbacks_, continueDecoding()).Times(0);
+
+  EXPECT_EQ(Envoy::Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(req_headers_, true));
+  EXPECT_EQ(stats_.filter_.denied_.value(), 1);
+}
+
 TEST_F(ServiceControlFilterTest, LogWithoutHandlerOrHeaders) {
   // Test: If no handler and no headers, a handler is not created
   EXPECT_CALL(mock_handler_factory_, createHandler(_, _, _)).Times(0);
@@ -20,6 +20,7 @@
 #include "envoy/stream_info/stream_info.h"
 #include "src/api_proxy/service_control/request_info.h"
 #include "src/envoy/http/service_control/filter_stats.h"
+#include "src/envoy/http/service_control/local_reply.h"
 #include "src/envoy/utils/filter_state_utils.h"
 
 namespace espv2 {
@@ -36,6 +37,13 @@ class ServiceControlHandler {
     virtual ~CheckDoneCallback() = default;
     virtual void onCheckDone(const ::google::protobuf::util::Status&,
                              absl::string_view) PURE;
+
+    // Called instead of onCheckDone() when the request is denied with a
+    // pre-rendered local reply, so the reply body and rc_detail don't need
+    // to be rendered again.
+    virtual void onCheckDenied(const LocalReply& reply) {
+      onCheckDone(reply.status, reply.rc_detail);
+    }
   };
 
   // Make an async check call.
@@ -99,10 +99,10 @@ ServiceControlHandlerImpl::ServiceControlHandlerImpl(
 
   if (require_ctx_->config().api_key().locations_size() > 0) {
     extractAPIKey(headers, require_ctx_->config().api_key().locations(),
-                  api_key_);
+                  require_ctx_->api_key_cookies(), api_key_);
   } else {
     extractAPIKey(headers, cfg_parser_.default_api_keys().locations(),
-                  api_key_);
+                  cfg_parser_.default_api_key_cookies(), api_key_);
   }
 
   if (require_ctx_->service_ctx().config().client_ip_from_forwarded_header()) {
@@ -206,18 +206,19 @@ void ServiceControlHandlerImpl::callCheck(
     return;
   }
 
+  // Without an api key, there is no consumer to charge the quota to.
+  if (isTrustedJwtCaller()) {
+    filter_stats_.filter_.check_skipped_trusted_jwt_.inc();
+    callback.onCheckDone(check_status_, rc_detail_);
+    return;
+  }
+
   if (!hasApiKey()) {
     filter_stats_.filter_.denied_consumer_error_.inc();
-    check_status_ =
-        Status(StatusCode::kUnauthenticated,
-               "Method doesn't allow unregistered callers (callers without "
-               "established identity). Please use API Key or other form of "
-               "API consumer identity to call this API.");
-    callback.onCheckDone(
-        check_status_,
-        utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
-                                 utils::kRcDetailErrorTypeBadRequest,
-                                 utils::kRcDetailErrorMissingApiKey));
+    denied_reply_ =
+        &require_ctx_->service_ctx().local_replies().missingApiKey();
+    check_status_ = denied_reply_->status;
+    callback.onCheckDenied(*denied_reply_);
     return;
   }
 
@@ -248,6 +249,21 @@ void ServiceControlHandlerImpl::callCheck(
   }
 }
 
+bool ServiceControlHandlerImpl::isTrustedJwtCaller() const {
+  if (!require_ctx_->has_trusted_jwt_callers()) {
+    return false;
+  }
+  std::string issuer;
+  std::vector<std::string> audiences;
+  if (!extractJwtIssuerAndAudiences(
+          stream_info_.dynamicMetadata(),
+          require_ctx_->service_ctx().config().jwt_payload_metadata_name(),
+          issuer, audiences)) {
+    return false;
+  }
+  return require_ctx_->isTrustedJwtCaller(issuer, audiences);
+}
+
 // TODO(taoxuy): add unit test
 void ServiceControlHandlerImpl::callQuota() {
   if (!isQuotaRequired()) {
@@ -284,16 +300,27 @@ void ServiceControlHandlerImpl::onCheckResponse(
     Envoy::Http::RequestHeaderMap& headers, const Status& status,
     const CheckResponseInfo& response_info) {
   check_response_info_ = response_info;
+  check_status_ = status;
 
   if (!response_info.error.name.empty()) {
-    rc_detail_ =
-        utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
-                                 response_info.error.is_network_error
-                                     ? utils::kRcDetailErrorTypeScCheckNetwork
-                                     : utils::kRcDetailErrorTypeScCheck,
-                                 response_info.error.name);
+    if (!response_info.error.is_network_error && !status.ok()) {
+      // Use the pre-rendered reply if the denial matches it.
+      const LocalReply* reply =
+          require_ctx_->service_ctx().local_replies().findCheckError(
+              response_info.error.name);
+      if (reply != nullptr && reply->status == status) {
+        denied_reply_ = reply;
+      }
+    }
+    if (denied_reply_ == nullptr) {
+      rc_detail_ = utils::generateRcDetails(
+          utils::kRcDetailFilterServiceControl,
+          response_info.error.is_network_error
+              ? utils::kRcDetailErrorTypeScCheckNetwork
+              : utils::kRcDetailErrorTypeScCheck,
+          response_info.error.name);
+    }
   }
-  check_status_ = status;
 
   // Set consumer info to backend. Since consumer_project_id is deprecated and
   // replaced by consumer_number so don't set it here.
@@ -307,7 +334,11 @@ void ServiceControlHandlerImpl::onCheckResponse(
   }
 
   if (!check_status_.ok()) {
-    check_callback_->onCheckDone(check_status_, rc_detail_);
+    if (denied_reply_ != nullptr) {
+      check_callback_->onCheckDenied(*denied_reply_);
+    } else {
+      check_callback_->onCheckDone(check_status_, rc_detail_);
+    }
     return;
   }
 
@@ -323,7 +354,30 @@ void ServiceControlHandlerImpl::callReport(
     return;
   }
 
+  // During a denial flood, the reports of requests denied with a pre-rendered
+  // reply are rolled up instead of being built and sent one by one.
+  if (denied_reply_ != nullptr &&
+      require_ctx_->service_ctx().call().rollupDeniedReport(
+          require_ctx_->config().operation_name(), *denied_reply_,
+          [&](::espv2::api_proxy::service_control::ReportRequestInfo& info) {
+            fillReportRequestInfo(request_headers, response_headers,
+                                  response_trailers, parent_span, info);
+          })) {
+    return;
+  }
+
   ::espv2::api_proxy::service_control::ReportRequestInfo info;
+  fillReportRequestInfo(request_headers, response_headers, response_trailers,
+                        parent_span, info);
+  require_ctx_->service_ctx().call().callReport(info);
+}
+
+void ServiceControlHandlerImpl::fillReportRequestInfo(
+    const Envoy::Http::RequestHeaderMap* request_headers,
+    const Envoy::Http::ResponseHeaderMap* response_headers,
+    const Envoy::Http::ResponseTrailerMap* response_trailers,
+    const Envoy::Tracing::Span& parent_span,
+    ::espv2::api_proxy::service_control::ReportRequestInfo& info) {
   prepareReportRequest(info);
   fillLoggedHeader(request_headers,
                    require_ctx_->service_ctx().config().log_request_headers(),
@@ -375,8 +429,6 @@ void ServiceControlHandlerImpl::callReport(
   if (!require_ctx_->service_ctx().config().tracing_disabled()) {
     info.trace_id = parent_span.getTraceIdAsHex();
   }
-
-  require_ctx_->service_ctx().call().callReport(info);
 }
 
 }  // namespace service_control
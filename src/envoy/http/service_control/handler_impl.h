@@ -87,12 +87,23 @@ class ServiceControlHandlerImpl
            !require_ctx_->config().skip_service_control();
   }
 
+  // Whether the request has a JWT from a trusted caller, which skips the
+  // check and quota calls.
+  bool isTrustedJwtCaller() const;
+
   bool isReportRequired() const {
     return !require_ctx_->config().skip_service_control();
   }
 
   bool hasApiKey() const { return !api_key_.empty(); }
 
+  void fillReportRequestInfo(
+      const Envoy::Http::RequestHeaderMap* request_headers,
+      const Envoy::Http::ResponseHeaderMap* response_headers,
+      const Envoy::Http::ResponseTrailerMap* response_trailers,
+      const Envoy::Tracing::Span& parent_span,
+      ::espv2::api_proxy::service_control::ReportRequestInfo& info);
+
   void onCheckResponse(
       Envoy::Http::RequestHeaderMap& headers,
       const ::google::protobuf::util::Status& status,
@@ -135,6 +146,9 @@ class ServiceControlHandlerImpl
   // The response code detail.
   std::string rc_detail_;
 
+  // The pre-rendered local reply if the request is denied with one.
+  const LocalReply* denied_reply_{};
+
   CancelFunc cancel_fn_;
   bool on_check_done_called_;
 
@@ -64,6 +64,7 @@ services {
   service_name: "echo"
   backend_protocol: "grpc"
   producer_project_id: "project-id"
+  jwt_payload_metadata_name: "jwt_payloads"
   log_request_headers: "x-test-log-request-header"
   log_response_headers: "x-test-log-response-header"
   min_stream_report_interval_ms: 100
@@ -146,6 +147,23 @@ requirements {
     cost: 1
   }
 }
+requirements {
+  service_name: "echo"
+  api_name: "test_api"
+  api_version: "test_version"
+  operation_name: "get_trusted_jwt"
+  api_key: {
+    allow_without_api_key: false
+  }
+  metric_costs: {
+    name: "metric_name"
+    cost: 1
+  }
+  trusted_jwt_callers: {
+    issuer: "https://internal.example.com"
+    audiences: "internal-audience"
+  }
+}
 requirements {
   service_name: "echo"
   api_name: "test_api"
@@ -209,6 +227,22 @@ class HandlerTest : public ::testing::Test {
             }));
   }
 
+  // Sets the JWT payload verified by the jwt_authn filter.
+  void setJwtPayload(const std::string& issuer, const std::string& audience) {
+    Envoy::ProtobufWkt::Struct payload;
+    (*payload.mutable_fields())["iss"].set_string_value(issuer);
+    (*payload.mutable_fields())["aud"]
+        .mutable_list_value()
+        ->add_values()
+        ->set_string_value(audience);
+    Envoy::ProtobufWkt::Struct jwt_authn;
+    *(*jwt_authn.mutable_fields())["jwt_payloads"].mutable_struct_value() =
+        payload;
+    (*mock_decoder_callbacks_.stream_info_.metadata_
+          .mutable_filter_metadata())["envoy.filters.http.jwt_authn"] =
+        jwt_authn;
+  }
+
   testing::NiceMock<Envoy::Stats::MockIsolatedStatsStore> mock_stats_scope_;
   ServiceControlFilterStats stats_;
 
@@ -452,6 +486,56 @@ TEST_F(HandlerTest, HandlerCheckNotNeeded) {
   handler.callReport(&headers, &response_headers, &resp_trailer_, mock_span_);
 }
 
+TEST_F(HandlerTest, HandlerCheckSkippedForTrustedJwtCaller) {
+  // Test: A request with a JWT from a trusted caller skips the check and the
+  // quota, even without an api key, and is still reported.
+  setPerRouteOperation("get_trusted_jwt");
+  setJwtPayload("https://internal.example.com", "internal-audience");
+  TestRequestHeaderMapImpl headers{{":method", "GET"}, {":path", "/echo"}};
+  TestResponseHeaderMapImpl response_headers{
+      {"content-type", "application/grpc"}};
+  ServiceControlHandlerImpl handler(headers, &mock_decoder_callbacks_,
+                                    "test-uuid", *cfg_parser_, test_time_,
+                                    stats_);
+
+  EXPECT_CALL(*mock_call_, callCheck(_, _, _)).Times(0);
+  EXPECT_CALL(*mock_call_, callQuota(_, _)).Times(0);
+  EXPECT_CALL(mock_check_done_callback_, onCheckDone(OkStatus(), ""));
+  handler.callCheck(headers, mock_span_, mock_check_done_callback_);
+
+  EXPECT_CALL(*mock_call_, callReport(_));
+  handler.callReport(&headers, &response_headers, &resp_trailer_, mock_span_);
+
+  // Stats.
+  checkAndReset(stats_.filter_.check_skipped_trusted_jwt_, 1);
+}
+
+TEST_F(HandlerTest, HandlerCheckNotSkippedForUntrustedJwtCaller) {
+  // Test: A JWT from a trusted issuer but for another audience, or from
+  // another issuer, does not skip the check.
+  for (const auto& [issuer, audience] :
+       std::vector<std::pair<std::string, std::string>>{
+           {"https://internal.example.com", "other-audience"},
+           {"https://other.example.com", "internal-audience"}}) {
+    setPerRouteOperation("get_trusted_jwt");
+    setJwtPayload(issuer, audience);
+    TestRequestHeaderMapImpl headers{{":method", "GET"}, {":path", "/echo"}};
+    ServiceControlHandlerImpl handler(headers, &mock_decoder_callbacks_,
+                                      "test-uuid", *cfg_parser_, test_time_,
+                                      stats_);
+
+    // The check fails without an api key.
+    EXPECT_CALL(
+        mock_check_done_callback_,
+        onCheckDone(_, "service_control_bad_request{MISSING_API_KEY}"));
+    handler.callCheck(headers, mock_span_, mock_check_done_callback_);
+
+    // Stats.
+    checkAndReset(stats_.filter_.check_skipped_trusted_jwt_, 0);
+    checkAndReset(stats_.filter_.denied_consumer_error_, 1);
+  }
+}
+
 TEST_F(HandlerTest, RequestHeaderSizeWithModificationInUpstream) {
   setPerRouteOperation("get_no_key");
   TestRequestHeaderMapImpl request_headers{{":method", "GET"},
@@ -516,6 +600,41 @@ TEST_F(HandlerTest, HandlerCheckMissingApiKey) {
   checkAndReset(stats_.filter_.denied_consumer_error_, 1);
 }
 
+TEST_F(HandlerTest, HandlerCheckMissingApiKeyReportRolledUp) {
+  // Test: During a denial flood, the report of a request denied with a
+  // pre-rendered reply is rolled up instead of sent.
+  setPerRouteOperation("get_header_key");
+  TestRequestHeaderMapImpl headers{{":method", "GET"}, {":path", "/echo"}};
+  TestResponseHeaderMapImpl response_headers{
+      {"content-type", "application/grpc"}};
+
+  ServiceControlHandlerImpl handler(headers, &mock_decoder_callbacks_,
+                                    "test-uuid", *cfg_parser_, test_time_,
+                                    stats_);
+  EXPECT_CALL(mock_check_done_callback_,
+              onCheckDone(_, "service_control_bad_request{MISSING_API_KEY}"));
+  handler.callCheck(headers, mock_span_, mock_check_done_callback_);
+
+  ReportRequestInfo filled_info;
+  EXPECT_CALL(*mock_call_, rollupDeniedReport("get_header_key", _, _))
+      .WillOnce(Invoke([&filled_info](absl::string_view,
+                                      const LocalReply& reply,
+                                      const DeniedReportFillFunc& fill_fn) {
+        EXPECT_EQ(reply.rc_detail,
+                  "service_control_bad_request{MISSING_API_KEY}");
+        fill_fn(filled_info);
+        return true;
+      }));
+  EXPECT_CALL(*mock_call_, callReport(_)).Times(0);
+  handler.callReport(&headers, &response_headers, &resp_trailer_, mock_span_);
+
+  EXPECT_EQ(filled_info.operation_name, "get_header_key");
+  EXPECT_EQ(filled_info.status.code(), StatusCode::kUnauthenticated);
+
+  // Stats.
+  checkAndReset(stats_.filter_.denied_consumer_error_, 1);
+}
+
 TEST_F(HandlerTest, HandlerSuccessfulCheckSyncWithApiKeyRestrictionFields) {
   // Test: Check is required and succeeds, and api key restriction fields are
   // present on the check request
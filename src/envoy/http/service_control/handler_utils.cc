@@ -17,6 +17,7 @@
 #include <sstream>
 #include <vector>
 
+#include "absl/container/inlined_vector.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
@@ -34,6 +35,7 @@
 #include "source/common/stream_info/utility.h"
 #include "source/extensions/filters/http/well_known_names.h"
 #include "src/api_proxy/service_control/request_builder.h"
+#include "src/envoy/utils/header_scan_utils.h"
 
 using ::espv2::api::envoy::v11::http::service_control::ApiKeyLocation;
 using ::espv2::api::envoy::v11::http::service_control::Service;
@@ -50,6 +52,8 @@ namespace {
 
 // Delimeter used in jwt payload key path
 constexpr char kJwtPayLoadsDelimeter = '.';
+constexpr char kJwtIssuerClaim[] = "iss";
+constexpr char kJwtAudienceClaim[] = "aud";
 
 constexpr char kContentTypeApplicationGrpcPrefix[] = "application/grpc";
 const Envoy::Http::LowerCaseString kContentTypeHeader{"content-type"};
@@ -63,21 +67,16 @@ inline int64_t convertNsToMs(std::chrono::nanoseconds ns) {
 }
 
 bool extractAPIKeyFromQuery(const Envoy::Http::RequestHeaderMap& headers,
-                            const std::string& query, bool& were_params_parsed,
-                            Envoy::Http::Utility::QueryParams& parsed_params,
-                            std::string& api_key) {
-  if (!were_params_parsed) {
-    if (headers.Path() == nullptr) {
-      return false;
-    }
-    parsed_params = Envoy::Http::Utility::parseQueryString(
-        headers.Path()->value().getStringView());
-    were_params_parsed = true;
+                            const std::string& query, std::string& api_key) {
+  if (headers.Path() == nullptr) {
+    return false;
   }
 
-  const auto& it = parsed_params.find(query);
-  if (it != parsed_params.end()) {
-    api_key = it->second;
+  // Only the parameter is looked for, instead of parsing all of them.
+  const absl::optional<absl::string_view> value = utils::findQueryParameter(
+      headers.Path()->value().getStringView(), query);
+  if (value.has_value()) {
+    api_key = std::string(value.value());
     return true;
   }
   return false;
@@ -94,17 +93,6 @@ bool extractAPIKeyFromHeader(const Envoy::Http::RequestHeaderMap& headers,
   return false;
 }
 
-bool extractAPIKeyFromCookie(const Envoy::Http::RequestHeaderMap& headers,
-                             const std::string& cookie, std::string& api_key) {
-  std::string parsed_api_key =
-      Envoy::Http::Utility::parseCookieValue(headers, cookie);
-  if (!parsed_api_key.empty()) {
-    api_key = parsed_api_key;
-    return true;
-  }
-  return false;
-}
-
 void extractJwtPayload(const Envoy::ProtobufWkt::Value& value,
                        const std::string& jwt_payload_path,
                        std::string& info_jwt_payloads) {
@@ -300,22 +288,56 @@ void fillJwtPayload(const ::envoy::config::core::v3::Metadata& metadata,
   }
 }
 
+bool extractJwtIssuerAndAudiences(
+    const ::envoy::config::core::v3::Metadata& metadata,
+    const std::string& jwt_payload_metadata_name, std::string& issuer,
+    std::vector<std::string>& audiences) {
+  const Envoy::ProtobufWkt::Value& payload =
+      Envoy::Config::Metadata::metadataValue(
+          &metadata,
+          Envoy::Extensions::HttpFilters::HttpFilterNames::get().JwtAuthn,
+          jwt_payload_metadata_name);
+  if (payload.kind_case() != Envoy::ProtobufWkt::Value::kStructValue) {
+    return false;
+  }
+  const auto& claims = payload.struct_value().fields();
+  const auto iss_it = claims.find(kJwtIssuerClaim);
+  if (iss_it == claims.end() || iss_it->second.string_value().empty()) {
+    return false;
+  }
+  issuer = iss_it->second.string_value();
+
+  audiences.clear();
+  const auto aud_it = claims.find(kJwtAudienceClaim);
+  if (aud_it == claims.end()) {
+    return true;
+  }
+  if (aud_it->second.kind_case() == Envoy::ProtobufWkt::Value::kStringValue) {
+    audiences.push_back(aud_it->second.string_value());
+  } else if (aud_it->second.kind_case() ==
+             Envoy::ProtobufWkt::Value::kListValue) {
+    for (const auto& audience : aud_it->second.list_value().values()) {
+      if (audience.kind_case() == Envoy::ProtobufWkt::Value::kStringValue) {
+        audiences.push_back(audience.string_value());
+      }
+    }
+  }
+  return true;
+}
+
 bool extractAPIKey(
     const Envoy::Http::RequestHeaderMap& headers,
     const ::google::protobuf::RepeatedPtrField<
         ::espv2::api::envoy::v11::http::service_control::ApiKeyLocation>&
         locations,
-    std::string& api_key) {
-  // If checking multiple headers, cache the parameters so they are only parsed
-  // once
-  bool were_params_parsed{false};
-  Envoy::Http::Utility::QueryParams parsed_params;
-
+    const utils::CookieScanner& cookies, std::string& api_key) {
+  // The cookies are only scanned if a cookie location is reached.
+  absl::InlinedVector<absl::string_view, 4> cookie_values;
+  size_t cookie_index = 0;
   for (const auto& location : locations) {
     switch (location.key_case()) {
       case ApiKeyLocation::kQuery:
-        if (extractAPIKeyFromQuery(headers, location.query(),
-                                   were_params_parsed, parsed_params, api_key))
+        if (extractAPIKeyFromQuery(headers, location.query(), api_key))
           return true;
         break;
       case ApiKeyLocation::kHeader:
@@ -323,8 +345,16 @@ bool extractAPIKey(
           return true;
         break;
       case ApiKeyLocation::kCookie:
-        if (extractAPIKeyFromCookie(headers, location.cookie(), api_key))
+        if (cookie_values.empty()) {
+          cookie_values.resize(cookies.size());
+          cookies.scan(headers, absl::MakeSpan(cookie_values));
+        }
+        if (cookie_index < cookie_values.size() &&
+            !cookie_values[cookie_index].empty()) {
+          api_key = std::string(cookie_values[cookie_index]);
           return true;
+        }
+        ++cookie_index;
         break;
       case ApiKeyLocation::KEY_NOT_SET:
         break;
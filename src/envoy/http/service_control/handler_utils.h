@@ -20,6 +20,7 @@
 #include "source/common/http/utility.h"
 #include "src/api_proxy/service_control/request_builder.h"
 #include "src/envoy/http/service_control/filter_stats.h"
+#include "src/envoy/utils/cookie_scanner.h"
 #include "src/envoy/utils/filter_state_utils.h"
 #include "src/envoy/utils/http_header_utils.h"
 
@@ -29,7 +30,8 @@ namespace http_filters {
 namespace service_control {
 
 // Searches the headers at the given locations and sets the `api_key` if one is
-// found.
+// found. The `cookies` are built from the cookie names of the `locations`, in
+// order; the cookie headers are scanned once for all of them.
 //
 // Returns whether an `api_key` was found.
 bool extractAPIKey(
@@ -37,7 +39,7 @@ bool extractAPIKey(
     const ::google::protobuf::RepeatedPtrField<
         ::espv2::api::envoy::v11::http::service_control::ApiKeyLocation>&
         locations,
-    std::string& api_key);
+    const utils::CookieScanner& cookies, std::string& api_key);
 
 // Adds information from the `FilterConfig`'s gcp_attributes to the given info.
 void fillGCPInfo(
@@ -70,6 +72,14 @@ void fillJwtPayload(const ::envoy::config::core::v3::Metadata& metadata,
                     const std::string& jwt_payload_path,
                     std::string& info_iss_or_aud);
 
+// Extracts the `iss` and `aud` claims of the JWT payload verified by the
+// jwt_authn filter. The `aud` claim is either a string or a list of strings.
+// Returns false if there is no verified JWT with an issuer.
+bool extractJwtIssuerAndAudiences(
+    const ::envoy::config::core::v3::Metadata& metadata,
+    const std::string& jwt_payload_metadata_name, std::string& issuer,
+    std::vector<std::string>& audiences);
+
 // Returns the protocol of the frontend request or UNKNOWN if not found
 ::espv2::api_proxy::service_control::protocol::Protocol getFrontendProtocol(
     const Envoy::Http::ResponseHeaderMap* response_headers,
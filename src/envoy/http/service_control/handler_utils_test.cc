@@ -22,6 +22,7 @@
 #include "gtest/gtest.h"
 #include "source/common/common/empty_string.h"
 #include "src/api_proxy/service_control/request_builder.h"
+#include "src/envoy/http/service_control/config_parser.h"
 #include "test/mocks/server/mocks.h"
 #include "test/test_common/utility.h"
 
@@ -197,6 +198,24 @@ TEST(ServiceControlUtils, ExtractApiKey) {
           "foobar",
       },
 
+      // Test: cookie locations are searched in order, not the cookies
+      {
+          R"(
+            locations: { cookie: "apikey" }
+            locations: { cookie: "apikey2" } )",
+          {{"cookie", "apikey2=bar"}, {"cookie", "apikey=foo"}},
+          "foo",
+      },
+
+      // Test: an empty cookie moves on to the next location
+      {
+          R"(
+            locations: { cookie: "apikey" }
+            locations: { header: "apikey" } )",
+          {{"cookie", "apikey=; other=1"}, {"apikey", "foobar"}},
+          "foobar",
+      },
+
       // Test: header location expected but not provided
       {
           R"(locations: { header: "apikey" } )",
@@ -273,10 +292,12 @@ TEST(ServiceControlUtils, ExtractApiKey) {
     ASSERT_TRUE(
         TextFormat::ParseFromString(test.requirement_proto, &requirement));
 
+    const utils::CookieScanner cookies(apiKeyCookieNames(requirement));
     std::string api_key;
 
     EXPECT_EQ(!test.expected_api_key.empty(),
-              extractAPIKey(test.headers, requirement.locations(), api_key));
+              extractAPIKey(test.headers, requirement.locations(), cookies,
+                            api_key));
 
     EXPECT_EQ(test.expected_api_key, api_key);
   }
@@ -463,6 +484,53 @@ TEST(ServiceControlUtils, GetFrontendProtocol) {
   EXPECT_EQ(Protocol::HTTP, getFrontendProtocol(nullptr, mock_stream_info));
 }
 
+TEST(ServiceControlUtils, ExtractJwtIssuerAndAudiences) {
+  ::envoy::config::core::v3::Metadata metadata;
+  std::string issuer;
+  std::vector<std::string> audiences;
+
+  // Test: no jwt_authn metadata
+  EXPECT_FALSE(extractJwtIssuerAndAudiences(metadata, "jwt_payloads", issuer,
+                                            audiences));
+
+  Envoy::ProtobufWkt::Struct& payload =
+      *(*(*metadata.mutable_filter_metadata())["envoy.filters.http.jwt_authn"]
+             .mutable_fields())["jwt_payloads"]
+           .mutable_struct_value();
+
+  // Test: a payload without issuer
+  (*payload.mutable_fields())["aud"].set_string_value("audience");
+  EXPECT_FALSE(extractJwtIssuerAndAudiences(metadata, "jwt_payloads", issuer,
+                                            audiences));
+
+  // Test: a string audience
+  (*payload.mutable_fields())["iss"].set_string_value("issuer");
+  EXPECT_TRUE(extractJwtIssuerAndAudiences(metadata, "jwt_payloads", issuer,
+                                           audiences));
+  EXPECT_EQ(issuer, "issuer");
+  EXPECT_EQ(audiences, std::vector<std::string>{"audience"});
+
+  // Test: a list of audiences, skipping the values which are not strings
+  auto* aud_list = (*payload.mutable_fields())["aud"].mutable_list_value();
+  aud_list->add_values()->set_string_value("audience-1");
+  aud_list->add_values()->set_number_value(2);
+  aud_list->add_values()->set_string_value("audience-3");
+  EXPECT_TRUE(extractJwtIssuerAndAudiences(metadata, "jwt_payloads", issuer,
+                                           audiences));
+  EXPECT_EQ(audiences,
+            (std::vector<std::string>{"audience-1", "audience-3"}));
+
+  // Test: no audience
+  payload.mutable_fields()->erase("aud");
+  EXPECT_TRUE(extractJwtIssuerAndAudiences(metadata, "jwt_payloads", issuer,
+                                           audiences));
+  EXPECT_TRUE(audiences.empty());
+
+  // Test: another metadata name
+  EXPECT_FALSE(extractJwtIssuerAndAudiences(metadata, "other_payloads",
+                                            issuer, audiences));
+}
+
 TEST(TestExtractIPFromForwardedHeader, HeaderNotExist) {
   Envoy::Http::TestRequestHeaderMapImpl headers;
   EXPECT_EQ(extractIPFromForwardedHeader(headers).value(), "");
@@ -56,7 +56,8 @@ class HttpCallImpl : public HttpCall,
                const Envoy::Protobuf::Message& body, uint32_t timeout_ms,
                uint32_t retries, Envoy::Tracing::Span& parent_span,
                Envoy::TimeSource& time_source,
-               const std::string& trace_operation_name)
+               const std::string& trace_operation_name,
+               Envoy::Stats::Gauge* active_calls)
       : cm_(cm),
         dispatcher_(dispatcher),
         http_uri_(uri),
@@ -65,10 +66,14 @@ class HttpCallImpl : public HttpCall,
         timeout_ms_(timeout_ms),
         cancelled(false),
         token_fn_(token_fn),
-        parent_span_(parent_span),
+        parent_span_(&parent_span),
         time_source_(time_source),
-        trace_operation_name_(trace_operation_name) {
+        trace_operation_name_(trace_operation_name),
+        active_calls_(active_calls) {
     uri_ = http_uri_.uri() + suffix_url;
+    if (active_calls_) {
+      active_calls_->inc();
+    }
 
     Envoy::Http::Utility::extractHostPathFromUri(uri_, host_, path_);
     body.SerializeToString(&str_body_);
@@ -77,10 +82,20 @@ class HttpCallImpl : public HttpCall,
     ENVOY_LOG(trace, "{}", __func__);
   }
 
+  ~HttpCallImpl() override {
+    if (active_calls_) {
+      active_calls_->dec();
+    }
+  }
+
   void setDoneFunc(HttpCall::DoneFunc on_done) { on_done_ = on_done; }
 
   void call() override { makeOneCall(); }
 
+  void setParentSpan(Envoy::Tracing::Span& parent_span) override {
+    parent_span_ = &parent_span;
+  }
+
   // HTTP async receive methods
   void onSuccess(const Envoy::Http::AsyncClient::Request&,
                  Envoy::Http::ResponseMessagePtr&& response) override {
@@ -182,8 +197,9 @@ class HttpCallImpl : public HttpCall,
 
   void makeOneCall() {
     request_count_++;
-    std::string token = token_fn_();
-    if (token.empty()) {
+    // The calls without a token function are not authenticated.
+    std::string token = token_fn_ ? token_fn_() : std::string();
+    if (token_fn_ && token.empty()) {
       on_done_(Status(StatusCode::kInternal,
                       "Missing access token for service control call"),
                Envoy::EMPTY_STRING);
@@ -196,9 +212,9 @@ class HttpCallImpl : public HttpCall,
                          ? trace_operation_name_
                          : absl::StrCat(trace_operation_name_, " - Retry ",
                                         request_count_ - 1);
-    request_span_ =
-        parent_span_.spawnChild(Envoy::Tracing::EgressConfig::get(), span_name,
-                                time_source_.systemTime());
+    request_span_ = parent_span_->spawnChild(
+        Envoy::Tracing::EgressConfig::get(), span_name,
+        time_source_.systemTime());
     request_span_->setTag(Envoy::Tracing::Tags::get().Component,
                           Envoy::Tracing::Tags::get().Proxy);
     request_span_->setTag(Envoy::Tracing::Tags::get().UpstreamCluster,
@@ -256,9 +272,10 @@ class HttpCallImpl : public HttpCall,
     message->body().add(str_body_.data(), str_body_.size());
     message->headers().setContentLength(message->body().length());
 
-    // assume token is not empty
-    message->headers().setInline(authorization_handle.handle(),
-                                 "Bearer " + token);
+    if (!token.empty()) {
+      message->headers().setInline(authorization_handle.handle(),
+                                   "Bearer " + token);
+    }
     message->headers().setContentType(KApplicationProto);
     return message;
   }
@@ -304,10 +321,14 @@ class HttpCallImpl : public HttpCall,
   std::function<const std::string&()> token_fn_;
 
   // Tracing data
-  Envoy::Tracing::Span& parent_span_;
+  // The span of the stream the call is made for, see setParentSpan().
+  Envoy::Tracing::Span* parent_span_;
   Envoy::TimeSource& time_source_;
   Envoy::Tracing::SpanPtr request_span_;
   const std::string trace_operation_name_;
+
+  // Counts the calls alive, may be null.
+  Envoy::Stats::Gauge* active_calls_;
 };
 
 }  // namespace
@@ -317,7 +338,8 @@ HttpCallFactoryImpl::HttpCallFactoryImpl(
     const ::espv2::api::envoy::v11::http::common::HttpUri& uri,
     const std::string& suffix_url, std::function<const std::string&()> token_fn,
     uint32_t timeout_ms, uint32_t retries, Envoy::TimeSource& time_source,
-    const std::string& trace_operation_name)
+    const std::string& trace_operation_name,
+    Envoy::Stats::Gauge* active_calls)
     : cm_(cm),
       dispatcher_(dispatcher),
       uri_(uri),
@@ -327,7 +349,8 @@ HttpCallFactoryImpl::HttpCallFactoryImpl(
       retries_(retries),
       destruct_mode_(false),
       time_source_(time_source),
-      trace_operation_name_(trace_operation_name){};
+      trace_operation_name_(trace_operation_name),
+      active_calls_gauge_(active_calls){};
 
 HttpCall* HttpCallFactoryImpl::createHttpCall(
     const Envoy::Protobuf::Message& body, Envoy::Tracing::Span& parent_span,
@@ -335,7 +358,8 @@ HttpCall* HttpCallFactoryImpl::createHttpCall(
   ENVOY_LOG(debug, "{} is created", trace_operation_name_);
   HttpCallImpl* http_call = new HttpCallImpl(
       cm_, dispatcher_, uri_, suffix_url_, token_fn_, body, timeout_ms_,
-      retries_, parent_span, time_source_, trace_operation_name_);
+      retries_, parent_span, time_source_, trace_operation_name_,
+      active_calls_gauge_);
   http_call->setDoneFunc([this, on_done, http_call](const Status& status,
                                                     const std::string& body) {
     // When the call is finished, it should be removed from active_calls_ .
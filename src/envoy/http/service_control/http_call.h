@@ -16,6 +16,7 @@
 
 #include "api/envoy/v11/http/common/base.pb.h"
 #include "envoy/common/pure.h"
+#include "envoy/stats/stats.h"
 #include "envoy/tracing/http_tracer.h"
 #include "envoy/upstream/cluster_manager.h"
 #include "google/protobuf/stubs/status.h"
@@ -38,6 +39,12 @@ class HttpCall {
   virtual void cancel() PURE;
 
   virtual void call() PURE;
+
+  /*
+   * Traces the next attempts in `parent_span`, as the span the call was
+   * created with is going away.
+   */
+  virtual void setParentSpan(Envoy::Tracing::Span& parent_span) PURE;
 };
 
 class HttpCallFactory
@@ -52,13 +59,16 @@ class HttpCallFactory
 
 class HttpCallFactoryImpl : public HttpCallFactory {
  public:
+  // If set, `active_calls` counts the calls alive, from their creation to
+  // their deferred deletion.
   HttpCallFactoryImpl(
       Envoy::Upstream::ClusterManager& cm, Envoy::Event::Dispatcher& dispatcher,
       const ::espv2::api::envoy::v11::http::common::HttpUri& uri,
       const std::string& suffix_url,
       std::function<const std::string&()> token_fn, uint32_t timeout_ms,
       uint32_t retries, Envoy::TimeSource& time_source,
-      const std::string& trace_operation_name);
+      const std::string& trace_operation_name,
+      Envoy::Stats::Gauge* active_calls = nullptr);
 
   HttpCall* createHttpCall(const Envoy::Protobuf::Message& body,
                            Envoy::Tracing::Span& parent_span,
@@ -78,7 +88,7 @@ class HttpCallFactoryImpl : public HttpCallFactory {
   const ::espv2::api::envoy::v11::http::common::HttpUri uri_;
   const std::string suffix_url_;
 
-  // token getter
+  // token getter, the calls are not authenticated if it is empty
   std::function<const std::string&()> token_fn_;
 
   // call setting
@@ -91,6 +101,9 @@ class HttpCallFactoryImpl : public HttpCallFactory {
   // tracing related
   Envoy::TimeSource& time_source_;
   const std::string trace_operation_name_;
+
+  // the gauge of the calls alive, may be null
+  Envoy::Stats::Gauge* active_calls_gauge_;
 };
 
 }  // namespace service_control
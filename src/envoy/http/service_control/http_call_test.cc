@@ -29,6 +29,7 @@
 #include "test/mocks/event/mocks.h"
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/server/mocks.h"
+#include "test/mocks/stats/mocks.h"
 #include "test/mocks/tracing/mocks.h"
 #include "test/test_common/utility.h"
 
@@ -254,6 +255,34 @@ TEST_F(HttpCallTest, TestEmptyTokenCallFailure) {
   EXPECT_EQ(0, http_requests_.size());
 }
 
+TEST_F(HttpCallTest, TestCallWithoutTokenFunction) {
+  // Without a token function, the call is made without authorization.
+  http_call_factory_ = std::make_unique<HttpCallFactoryImpl>(
+      cm_, dispatcher_, http_uri_, fake_suffix_url_, nullptr, timeout_ms_,
+      retries_, mock_time_source_, fake_trace_operation_name_);
+  NiceMock<Envoy::Http::MockAsyncClientRequest> request(&http_client_);
+  EXPECT_CALL(http_client_, send_(_, _, _))
+      .WillOnce(Invoke([&request](Envoy::Http::RequestMessagePtr& message_ptr,
+                                  Envoy::Http::AsyncClient::Callbacks&,
+                                  const Envoy::Http::AsyncClient::RequestOptions)
+                           -> Envoy::Http::AsyncClient::Request* {
+        EXPECT_TRUE(message_ptr->headers()
+                        .get(Envoy::Http::CustomHeaders::get().Authorization)
+                        .empty());
+        return &request;
+      }));
+
+  HttpCall* call = http_call_factory_->createHttpCall(
+      fake_request_, mock_parent_span_, mock_done_fn_.AsStdFunction());
+  call->call();
+
+  // The factory cancels the call on destruction.
+  EXPECT_CALL(mock_done_fn_,
+              Call(Status(StatusCode::kCancelled, "Request cancelled"), _))
+      .Times(1);
+  http_call_factory_.reset();
+}
+
 TEST_F(HttpCallTest, TestRetryCallSuccess) {
   // Set request to retry 2 more times
   retries_ = 2;
@@ -293,6 +322,40 @@ TEST_F(HttpCallTest, TestRetryCallSuccess) {
                                  makeResponseWithStatus(200));
 }
 
+TEST_F(HttpCallTest, TestRetryAfterSetParentSpan) {
+  retries_ = 1;
+  http_call_factory_ = std::make_unique<HttpCallFactoryImpl>(
+      cm_, dispatcher_, http_uri_, fake_suffix_url_, fake_token_fn_,
+      timeout_ms_, retries_, mock_time_source_, fake_trace_operation_name_);
+  auto mock_child_span_1 = makeMockChildSpan();
+
+  HttpCall* call = http_call_factory_->createHttpCall(
+      fake_request_, mock_parent_span_, mock_done_fn_.AsStdFunction());
+  call->call();
+
+  // The stream of the first span goes away, so the retry is traced in the
+  // new span.
+  NiceMock<Envoy::Tracing::MockSpan> new_parent_span;
+  call->setParentSpan(new_parent_span);
+
+  EXPECT_CALL(*mock_child_span_1, finishSpan()).Times(1);
+  auto mock_child_span_2 = new NiceMock<Envoy::Tracing::MockSpan>();
+  EXPECT_CALL(mock_parent_span_, spawnChild_(_, _, _)).Times(0);
+  EXPECT_CALL(new_parent_span,
+              spawnChild_(_, absl::StrCat(fake_trace_operation_name_,
+                                          " - Retry 1"),
+                          _))
+      .WillOnce(Return(mock_child_span_2));
+  async_callbacks_[0]->onSuccess(lastHttpRequest(),
+                                 makeResponseWithStatus(503));
+  EXPECT_EQ(2, async_callbacks_.size());
+
+  EXPECT_CALL(*mock_child_span_2, finishSpan()).Times(1);
+  EXPECT_CALL(mock_done_fn_, Call(OkStatus(), _)).Times(1);
+  async_callbacks_[1]->onSuccess(lastHttpRequest(),
+                                 makeResponseWithStatus(200));
+}
+
 TEST_F(HttpCallTest, TestThreeRetriesWithLastSuccess) {
   // Set request to retry 2 more times
   retries_ = 2;
@@ -422,6 +485,54 @@ TEST_F(HttpCallTest, TestSingleCallCancel) {
   http_call_factory_.reset();
 }
 
+TEST_F(HttpCallTest, TestActiveCallsGauge) {
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope;
+  Envoy::Stats::Gauge& active_calls = scope.gaugeFromString(
+      "http_call_active", Envoy::Stats::Gauge::ImportMode::NeverImport);
+  http_call_factory_ = std::make_unique<HttpCallFactoryImpl>(
+      cm_, dispatcher_, http_uri_, fake_suffix_url_, fake_token_fn_,
+      timeout_ms_, retries_, mock_time_source_, fake_trace_operation_name_,
+      &active_calls);
+
+  auto mock_child_span = makeMockChildSpan();
+  HttpCall* call = http_call_factory_->createHttpCall(
+      fake_request_, mock_parent_span_, mock_done_fn_.AsStdFunction());
+  call->call();
+  EXPECT_EQ(active_calls.value(), 1);
+
+  // The call is counted until its deferred deletion.
+  EXPECT_CALL(*mock_child_span, finishSpan()).Times(1);
+  EXPECT_CALL(mock_done_fn_, Call(OkStatus(), _)).Times(1);
+  async_callbacks_[0]->onSuccess(lastHttpRequest(),
+                                 makeResponseWithStatus(200));
+  EXPECT_EQ(active_calls.value(), 1);
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(active_calls.value(), 0);
+}
+
+TEST_F(HttpCallTest, TestActiveCallsGaugeCancel) {
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope;
+  Envoy::Stats::Gauge& active_calls = scope.gaugeFromString(
+      "http_call_active", Envoy::Stats::Gauge::ImportMode::NeverImport);
+  http_call_factory_ = std::make_unique<HttpCallFactoryImpl>(
+      cm_, dispatcher_, http_uri_, fake_suffix_url_, fake_token_fn_,
+      timeout_ms_, retries_, mock_time_source_, fake_trace_operation_name_,
+      &active_calls);
+
+  auto mock_child_span = makeMockChildSpan();
+  HttpCall* call = http_call_factory_->createHttpCall(
+      fake_request_, mock_parent_span_, mock_done_fn_.AsStdFunction());
+  call->call();
+
+  EXPECT_CALL(*mock_child_span, finishSpan()).Times(1);
+  EXPECT_CALL(*http_requests_[0], cancel()).Times(1);
+  EXPECT_CALL(mock_done_fn_, Call(_, _)).Times(1);
+  call->cancel();
+  EXPECT_EQ(active_calls.value(), 1);
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(active_calls.value(), 0);
+}
+
 }  // namespace
 }  // namespace service_control
 }  // namespace http_filters
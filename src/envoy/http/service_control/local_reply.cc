@@ -0,0 +1,96 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/local_reply.h"
+
+#include "source/common/grpc/status.h"
+#include "src/api_proxy/service_control/check_response_convert_utils.h"
+#include "src/envoy/utils/rc_detail_utils.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::espv2::api_proxy::service_control::CheckResponseInfo;
+using ::google::api::servicecontrol::v1::CheckError_Code;
+using ::google::api::servicecontrol::v1::CheckError_Code_descriptor;
+using ::google::api::servicecontrol::v1::CheckResponse;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+
+namespace {
+
+Envoy::Http::Code toHttpCode(const Status& status) {
+  // protobuf::util::Status.error_code is the same as Envoy GrpcStatus
+  // This cast is safe.
+  return static_cast<Envoy::Http::Code>(Envoy::Grpc::Utility::grpcToHttpStatus(
+      static_cast<Envoy::Grpc::Status::GrpcStatus>(status.code())));
+}
+
+}  // namespace
+
+LocalReply::LocalReply(const Status& status, std::string rc_detail)
+    : status(status),
+      http_code(toHttpCode(status)),
+      body(status.ToString()),
+      rc_detail(std::move(rc_detail)) {}
+
+LocalReplyCache::LocalReplyCache(const std::string& service_name)
+    : missing_api_key_(
+          Status(StatusCode::kUnauthenticated,
+                 "Method doesn't allow unregistered callers (callers without "
+                 "established identity). Please use API Key or other form of "
+                 "API consumer identity to call this API."),
+          utils::generateRcDetails(utils::kRcDetailFilterServiceControl,
+                                   utils::kRcDetailErrorTypeBadRequest,
+                                   utils::kRcDetailErrorMissingApiKey)) {
+  // Render every CheckError code through the same conversion used for live
+  // Check responses, so the cached replies can never drift from it.
+  const auto* descriptor = CheckError_Code_descriptor();
+  for (int i = 0; i < descriptor->value_count(); ++i) {
+    CheckResponse response;
+    response.add_check_errors()->set_code(
+        static_cast<CheckError_Code>(descriptor->value(i)->number()));
+
+    CheckResponseInfo response_info;
+    const Status status = api_proxy::service_control::ConvertCheckResponse(
+        response, service_name, &response_info);
+    if (status.ok() || response_info.error.name.empty()) {
+      continue;
+    }
+
+    check_errors_.emplace(
+        response_info.error.name,
+        std::make_unique<const LocalReply>(
+            status, utils::generateRcDetails(
+                        utils::kRcDetailFilterServiceControl,
+                        utils::kRcDetailErrorTypeScCheck,
+                        response_info.error.name)));
+  }
+}
+
+const LocalReply* LocalReplyCache::findCheckError(
+    absl::string_view error_name) const {
+  const auto it = check_errors_.find(error_name);
+  if (it == check_errors_.end()) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,69 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "envoy/http/codes.h"
+#include "google/protobuf/stubs/status.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+// A local reply rendered once and shared by every request denied for the
+// same reason.
+struct LocalReply {
+  LocalReply(const ::google::protobuf::util::Status& status,
+             std::string rc_detail);
+
+  // The status the request is denied with.
+  const ::google::protobuf::util::Status status;
+  // The HTTP code translated from the status code.
+  const Envoy::Http::Code http_code;
+  // The local reply body, same as `status.ToString()`.
+  const std::string body;
+  // The response code detail.
+  const std::string rc_detail;
+};
+
+// The pre-rendered local replies for the common denial reasons of one
+// service. Built at config load and only read afterwards, so it is safe to
+// share across worker threads.
+class LocalReplyCache {
+ public:
+  explicit LocalReplyCache(const std::string& service_name);
+
+  // The reply for a request without an API key on a method requiring one.
+  const LocalReply& missingApiKey() const { return missing_api_key_; }
+
+  // The reply for a Check error returned by Service Control, keyed by the
+  // CheckError code name. Returns nullptr if it is not pre-rendered.
+  const LocalReply* findCheckError(absl::string_view error_name) const;
+
+ private:
+  const LocalReply missing_api_key_;
+  absl::flat_hash_map<std::string, std::unique_ptr<const LocalReply>>
+      check_errors_;
+};
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,83 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/local_reply.h"
+
+#include "gtest/gtest.h"
+#include "src/api_proxy/service_control/check_response_convert_utils.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::espv2::api_proxy::service_control::CheckResponseInfo;
+using ::google::api::servicecontrol::v1::CheckError;
+using ::google::api::servicecontrol::v1::CheckResponse;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+
+constexpr char kServiceName[] = "bookstore.endpoints.test";
+
+TEST(LocalReplyTest, RendersStatus) {
+  const LocalReply reply(Status(StatusCode::kPermissionDenied, "test"),
+                         "rc_detail");
+  EXPECT_EQ(reply.http_code, Envoy::Http::Code::Forbidden);
+  EXPECT_EQ(reply.body, "PERMISSION_DENIED:test");
+  EXPECT_EQ(reply.rc_detail, "rc_detail");
+}
+
+TEST(LocalReplyCacheTest, MissingApiKey) {
+  const LocalReplyCache cache(kServiceName);
+  const LocalReply& reply = cache.missingApiKey();
+  EXPECT_EQ(reply.status.code(), StatusCode::kUnauthenticated);
+  EXPECT_EQ(reply.http_code, Envoy::Http::Code::Unauthorized);
+  EXPECT_EQ(reply.body, reply.status.ToString());
+  EXPECT_EQ(reply.rc_detail, "service_control_bad_request{MISSING_API_KEY}");
+}
+
+TEST(LocalReplyCacheTest, CheckErrorMatchesConversion) {
+  const LocalReplyCache cache(kServiceName);
+
+  for (const auto code :
+       {CheckError::API_KEY_INVALID, CheckError::API_KEY_NOT_FOUND,
+        CheckError::SERVICE_NOT_ACTIVATED, CheckError::IP_ADDRESS_BLOCKED}) {
+    CheckResponse response;
+    response.add_check_errors()->set_code(code);
+    CheckResponseInfo info;
+    const Status status = api_proxy::service_control::ConvertCheckResponse(
+        response, kServiceName, &info);
+
+    const LocalReply* reply = cache.findCheckError(info.error.name);
+    ASSERT_NE(reply, nullptr) << info.error.name;
+    EXPECT_EQ(reply->status, status);
+    EXPECT_EQ(reply->body, status.ToString());
+    EXPECT_EQ(reply->rc_detail,
+              absl::StrCat("service_control_check_error{", info.error.name,
+                           "}"));
+  }
+}
+
+TEST(LocalReplyCacheTest, UnknownCheckError) {
+  const LocalReplyCache cache(kServiceName);
+  EXPECT_EQ(cache.findCheckError("NOT_A_CHECK_ERROR"), nullptr);
+  EXPECT_EQ(cache.findCheckError(""), nullptr);
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
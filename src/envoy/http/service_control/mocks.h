@@ -73,6 +73,11 @@ class MockServiceControlCall : public ServiceControlCall {
       void, callReport,
       (const ::espv2::api_proxy::service_control::ReportRequestInfo& request),
       (override));
+
+  MOCK_METHOD(bool, rollupDeniedReport,
+              (absl::string_view operation_name, const LocalReply& reply,
+               const DeniedReportFillFunc& fill_fn),
+              (override));
 };
 
 class MockServiceControlCallFactory : public ServiceControlCallFactory {
@@ -100,6 +105,7 @@ class MockHttpCall : public HttpCall {
 
   MOCK_METHOD(void, cancel, (), (override));
   MOCK_METHOD(void, call, (), (override));
+  MOCK_METHOD(void, setParentSpan, (Envoy::Tracing::Span&), (override));
 };
 
 class MockHttpCallFactory : public HttpCallFactory {
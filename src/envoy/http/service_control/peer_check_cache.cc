@@ -0,0 +1,224 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/peer_check_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/util/time_util.h"
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/empty_string.h"
+#include "source/common/common/hash.h"
+#include "source/common/crypto/utility.h"
+#include "source/common/tracing/http_tracer_impl.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::espv2::api::envoy::v11::http::service_control::PeerCheckCacheConfig;
+using ::espv2::api::envoy::v11::http::service_control::PeerCheckCacheEntry;
+using ::espv2::api::envoy::v11::http::service_control::PeerCheckCacheLookup;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+using ::google::protobuf::util::TimeUtil;
+
+namespace {
+
+std::string hmac(const std::vector<uint8_t>& secret,
+                 absl::string_view message) {
+  const std::vector<uint8_t> digest =
+      Envoy::Common::Crypto::UtilitySingleton::get().getSha256Hmac(secret,
+                                                                    message);
+  return std::string(digest.begin(), digest.end());
+}
+
+// Compares in a time independent of the position of the first difference.
+bool constantTimeEquals(absl::string_view a, absl::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  uint8_t diff = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    diff |= static_cast<uint8_t>(a[i]) ^ static_cast<uint8_t>(b[i]);
+  }
+  return diff == 0;
+}
+
+}  // namespace
+
+PeerCheckCache::PeerCheckCache(const PeerCheckCacheConfig& config,
+                               Envoy::Upstream::ClusterManager& cm,
+                               Envoy::Event::Dispatcher& dispatcher,
+                               Envoy::TimeSource& time_source,
+                               const std::string& stats_prefix,
+                               Envoy::Stats::Scope& scope,
+                               const std::string& secret)
+    : time_source_(time_source),
+      filter_stats_(ServiceControlFilterStats::create(stats_prefix, scope)),
+      secret_(secret.begin(), secret.end()) {
+  if (config.has_ttl()) {
+    ttl_ = config.ttl();
+  } else {
+    ttl_.set_seconds(kPeerCheckCacheDefaultTtlSeconds);
+  }
+
+  for (const auto& uri : config.peers()) {
+    const uint32_t timeout_ms =
+        static_cast<uint32_t>(TimeUtil::DurationToMilliseconds(uri.timeout()));
+    peer_seeds_.push_back(Envoy::HashUtil::xxHash64(uri.uri()));
+    // The calls carry an HMAC instead of a token, and are not retried: a
+    // failure falls back to calling Service Control.
+    peers_.push_back(Peer{
+        std::make_unique<HttpCallFactoryImpl>(
+            cm, dispatcher, uri, "/v1/checkCache:lookup",
+            /*token_fn=*/nullptr, timeout_ms, /*retries=*/0, time_source,
+            "Peer check cache: Lookup",
+            &filter_stats_.filter_.http_call_active_),
+        std::make_unique<HttpCallFactoryImpl>(
+            cm, dispatcher, uri, "/v1/checkCache:publish",
+            /*token_fn=*/nullptr, timeout_ms, /*retries=*/0, time_source,
+            "Peer check cache: Publish",
+            &filter_stats_.filter_.http_call_active_),
+    });
+  }
+}
+
+std::string PeerCheckCache::key(absl::string_view signature) {
+  Envoy::Buffer::OwnedImpl buffer(signature);
+  const std::vector<uint8_t> digest =
+      Envoy::Common::Crypto::UtilitySingleton::get().getSha256Digest(buffer);
+  return std::string(digest.begin(), digest.end());
+}
+
+std::string PeerCheckCache::lookupHmac(const std::vector<uint8_t>& secret,
+                                       absl::string_view key) {
+  return hmac(secret, absl::StrCat("lookup\n", key));
+}
+
+std::string PeerCheckCache::entryHmac(const std::vector<uint8_t>& secret,
+                                      const PeerCheckCacheEntry& entry) {
+  return hmac(secret,
+              absl::StrCat("entry\n", entry.key(), "\n",
+                           entry.expire_time().seconds(), "\n",
+                           entry.check_response()));
+}
+
+bool PeerCheckCache::isValidEntry(const std::vector<uint8_t>& secret,
+                                  absl::string_view key,
+                                  const PeerCheckCacheEntry& entry,
+                                  Envoy::SystemTime now) {
+  if (entry.key() != key ||
+      !constantTimeEquals(entry.hmac(), entryHmac(secret, entry))) {
+    return false;
+  }
+  const int64_t now_seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch())
+          .count();
+  return entry.expire_time().seconds() > now_seconds;
+}
+
+size_t PeerCheckCache::selectOwner(absl::string_view key,
+                                   const std::vector<uint64_t>& peer_seeds) {
+  size_t owner = 0;
+  uint64_t owner_score = 0;
+  for (size_t i = 0; i < peer_seeds.size(); ++i) {
+    const uint64_t score = Envoy::HashUtil::xxHash64(key, peer_seeds[i]);
+    if (i == 0 || score > owner_score) {
+      owner = i;
+      owner_score = score;
+    }
+  }
+  return owner;
+}
+
+PeerCheckCache::Peer& PeerCheckCache::owner(absl::string_view key) {
+  return peers_[selectOwner(key, peer_seeds_)];
+}
+
+HttpCall* PeerCheckCache::lookup(absl::string_view signature,
+                                 Envoy::Tracing::Span& parent_span,
+                                 HttpCall::DoneFunc on_done) {
+  PeerCheckCacheLookup request;
+  request.set_key(key(signature));
+  request.set_hmac(lookupHmac(secret_, request.key()));
+  return owner(request.key())
+      .lookup_call_factory->createHttpCall(
+          request, parent_span,
+          [this, on_done, key = request.key()](const Status& status,
+                                               const std::string& body) {
+            switch (status.code()) {
+              case StatusCode::kOk: {
+                PeerCheckCacheEntry entry;
+                if (!entry.ParseFromString(body) ||
+                    !isValidEntry(secret_, key, entry,
+                                  time_source_.systemTime())) {
+                  // Falls back to Service Control.
+                  ENVOY_LOG(debug, "Invalid peer check cache entry");
+                  filter_stats_.filter_.peer_check_cache_error_.inc();
+                  on_done(Status(StatusCode::kDataLoss,
+                                 "Invalid peer check cache entry"),
+                          Envoy::EMPTY_STRING);
+                  return;
+                }
+                filter_stats_.filter_.peer_check_cache_hit_.inc();
+                on_done(status, entry.check_response());
+                return;
+              }
+              case StatusCode::kUnimplemented:
+                // The owner answers a miss with 404.
+                filter_stats_.filter_.peer_check_cache_miss_.inc();
+                break;
+              case StatusCode::kCancelled:
+                break;
+              default:
+                ENVOY_LOG(debug, "Peer check cache lookup failed: {}",
+                          status.ToString());
+                filter_stats_.filter_.peer_check_cache_error_.inc();
+                break;
+            }
+            on_done(status, body);
+          });
+}
+
+void PeerCheckCache::publish(absl::string_view signature,
+                             const std::string& check_response) {
+  PeerCheckCacheEntry entry;
+  entry.set_key(key(signature));
+  entry.set_check_response(check_response);
+  const int64_t now_seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(
+          time_source_.systemTime().time_since_epoch())
+          .count();
+  entry.mutable_expire_time()->set_seconds(now_seconds + ttl_.seconds());
+  entry.set_hmac(entryHmac(secret_, entry));
+
+  auto* call = owner(entry.key()).publish_call_factory->createHttpCall(
+      entry, Envoy::Tracing::NullSpan::instance(),
+      [this](const Status& status, const std::string&) {
+        if (status.ok()) {
+          filter_stats_.filter_.peer_check_cache_published_.inc();
+        } else if (status.code() != StatusCode::kCancelled) {
+          ENVOY_LOG(debug, "Peer check cache publish failed: {}",
+                    status.ToString());
+          filter_stats_.filter_.peer_check_cache_error_.inc();
+        }
+      });
+  call->call();
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,131 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "api/envoy/v11/http/service_control/config.pb.h"
+#include "api/envoy/v11/http/service_control/peer_check_cache.pb.h"
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/tracing/http_tracer.h"
+#include "envoy/upstream/cluster_manager.h"
+#include "google/protobuf/duration.pb.h"
+#include "source/common/common/logger.h"
+#include "src/envoy/http/service_control/filter_stats.h"
+#include "src/envoy/http/service_control/http_call.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+// Forward declare friend class to test private functions.
+namespace test {
+class ClientCacheHttpRequestTest;
+}  // namespace test
+
+// How long the owner serves a published check response if the ttl is not
+// configured.
+constexpr int64_t kPeerCheckCacheDefaultTtlSeconds = 60;
+
+// Shares the check responses with the peer replicas of the service, see
+// PeerCheckCacheConfig.
+//
+// The owner of a check request is selected by rendezvous hashing: the peer
+// with the highest hash of the request key and the peer uri. Adding or
+// removing a peer only moves the requests it owns.
+//
+// The lookups and the published entries carry an HMAC with the secret shared
+// by the replicas. The entries found are only used if their HMAC is valid and
+// they are not expired, so a peer can not serve a forged check response.
+//
+// It is not thread-safe and is expected to be owned by a worker thread.
+class PeerCheckCache
+    : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+ public:
+  PeerCheckCache(
+      const ::espv2::api::envoy::v11::http::service_control::
+          PeerCheckCacheConfig& config,
+      Envoy::Upstream::ClusterManager& cm,
+      Envoy::Event::Dispatcher& dispatcher, Envoy::TimeSource& time_source,
+      const std::string& stats_prefix, Envoy::Stats::Scope& scope,
+      const std::string& secret);
+
+  // Looks up the response of the check request with the given signature in
+  // its owner. On a hit with a valid entry, `on_done` is called with OK and
+  // the serialized CheckResponse. The returned call must be started by the
+  // caller.
+  HttpCall* lookup(absl::string_view signature,
+                   Envoy::Tracing::Span& parent_span,
+                   HttpCall::DoneFunc on_done);
+
+  // Publishes the serialized CheckResponse of the check request with the
+  // given signature to its owner. Failures are only counted.
+  void publish(absl::string_view signature, const std::string& check_response);
+
+  // Returns the key of a check request signature, shared with the peers.
+  static std::string key(absl::string_view signature);
+
+  // Returns the HMACs of the lookup and the entry, see
+  // peer_check_cache.proto.
+  static std::string lookupHmac(const std::vector<uint8_t>& secret,
+                                absl::string_view key);
+  static std::string entryHmac(
+      const std::vector<uint8_t>& secret,
+      const ::espv2::api::envoy::v11::http::service_control::
+          PeerCheckCacheEntry& entry);
+
+  // Returns true if the entry found for the key has a valid HMAC, and is not
+  // expired at `now`.
+  static bool isValidEntry(
+      const std::vector<uint8_t>& secret, absl::string_view key,
+      const ::espv2::api::envoy::v11::http::service_control::
+          PeerCheckCacheEntry& entry,
+      Envoy::SystemTime now);
+
+  // Returns the index of the owner of the key, given the hash seeds of the
+  // peers.
+  static size_t selectOwner(absl::string_view key,
+                            const std::vector<uint64_t>& peer_seeds);
+
+ private:
+  friend class test::ClientCacheHttpRequestTest;
+
+  struct Peer {
+    std::unique_ptr<HttpCallFactory> lookup_call_factory;
+    std::unique_ptr<HttpCallFactory> publish_call_factory;
+  };
+
+  Peer& owner(absl::string_view key);
+
+  Envoy::TimeSource& time_source_;
+  ServiceControlFilterStats filter_stats_;
+  const std::vector<uint8_t> secret_;
+  ::google::protobuf::Duration ttl_;
+  std::vector<uint64_t> peer_seeds_;
+
+  // The http call factories cancel their pending calls on destruction, so
+  // this must be the last member.
+  std::vector<Peer> peers_;
+};
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,152 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/peer_check_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "source/common/common/hash.h"
+#include "source/common/common/hex.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::espv2::api::envoy::v11::http::service_control::PeerCheckCacheEntry;
+
+constexpr int kNumKeys = 10000;
+constexpr char kSecret[] = "secret";
+
+std::vector<uint8_t> secret() {
+  return std::vector<uint8_t>(kSecret, kSecret + sizeof(kSecret) - 1);
+}
+
+PeerCheckCacheEntry entry(const std::string& key) {
+  PeerCheckCacheEntry entry;
+  entry.set_key(key);
+  entry.set_check_response("response");
+  entry.mutable_expire_time()->set_seconds(1000);
+  entry.set_hmac(PeerCheckCache::entryHmac(secret(), entry));
+  return entry;
+}
+
+std::string hex(const std::string& hmac) {
+  return Envoy::Hex::encode(reinterpret_cast<const uint8_t*>(hmac.data()),
+                            hmac.size());
+}
+
+Envoy::SystemTime at(int64_t seconds) {
+  return Envoy::SystemTime(std::chrono::seconds(seconds));
+}
+
+std::vector<uint64_t> peerSeeds(int num_peers) {
+  std::vector<uint64_t> seeds;
+  for (int i = 0; i < num_peers; ++i) {
+    seeds.push_back(
+        Envoy::HashUtil::xxHash64(absl::StrCat("http://10.0.0.", i, ":8792")));
+  }
+  return seeds;
+}
+
+TEST(PeerCheckCacheTest, KeyIsSha256OfSignature) {
+  const std::string key = PeerCheckCache::key("signature");
+  EXPECT_EQ(key.size(), 32);
+  EXPECT_EQ(key, PeerCheckCache::key("signature"));
+  EXPECT_NE(key, PeerCheckCache::key("other signature"));
+}
+
+// The HMACs are shared with the peers, see peer_check_cache.go.
+TEST(PeerCheckCacheTest, Hmac) {
+  const std::string key(32, 'k');
+  EXPECT_EQ(hex(PeerCheckCache::lookupHmac(secret(), key)),
+            "178b4bc166cc0c48f0d38ba950906c51495d3aef363db499b124ed1fc4564bef");
+  EXPECT_EQ(hex(entry(key).hmac()),
+            "53b1594495a4ac7d39d130537399712789e2969e73cbb1874262c3a329a2c878");
+}
+
+TEST(PeerCheckCacheTest, ValidEntry) {
+  const std::string key(32, 'k');
+  EXPECT_TRUE(PeerCheckCache::isValidEntry(secret(), key, entry(key), at(999)));
+}
+
+TEST(PeerCheckCacheTest, EntryOfOtherKeyInvalid) {
+  const std::string key(32, 'k');
+  EXPECT_FALSE(PeerCheckCache::isValidEntry(
+      secret(), key, entry(std::string(32, 'o')), at(999)));
+}
+
+TEST(PeerCheckCacheTest, ForgedEntryInvalid) {
+  const std::string key(32, 'k');
+  PeerCheckCacheEntry forged = entry(key);
+  forged.set_check_response("forged");
+  EXPECT_FALSE(PeerCheckCache::isValidEntry(secret(), key, forged, at(999)));
+
+  // Extending the life of an entry invalidates its HMAC too.
+  forged = entry(key);
+  forged.mutable_expire_time()->set_seconds(2000);
+  EXPECT_FALSE(PeerCheckCache::isValidEntry(secret(), key, forged, at(999)));
+
+  // Signed with another secret.
+  forged = entry(key);
+  const std::vector<uint8_t> other_secret = {'o', 't', 'h', 'e', 'r'};
+  forged.set_hmac(PeerCheckCache::entryHmac(other_secret, forged));
+  EXPECT_FALSE(PeerCheckCache::isValidEntry(secret(), key, forged, at(999)));
+}
+
+TEST(PeerCheckCacheTest, ExpiredEntryInvalid) {
+  const std::string key(32, 'k');
+  EXPECT_FALSE(
+      PeerCheckCache::isValidEntry(secret(), key, entry(key), at(1000)));
+}
+
+TEST(PeerCheckCacheTest, SinglePeerOwnsAllKeys) {
+  const std::vector<uint64_t> seeds = peerSeeds(1);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(PeerCheckCache::selectOwner(absl::StrCat("key", i), seeds), 0);
+  }
+}
+
+TEST(PeerCheckCacheTest, KeysSpreadOverPeers) {
+  const std::vector<uint64_t> seeds = peerSeeds(4);
+  std::vector<int> owned(seeds.size());
+  for (int i = 0; i < kNumKeys; ++i) {
+    ++owned[PeerCheckCache::selectOwner(absl::StrCat("key", i), seeds)];
+  }
+  for (int count : owned) {
+    EXPECT_GT(count, kNumKeys / 4 * 0.8);
+    EXPECT_LT(count, kNumKeys / 4 * 1.2);
+  }
+}
+
+TEST(PeerCheckCacheTest, RemovedPeerOnlyMovesItsKeys) {
+  const std::vector<uint64_t> seeds = peerSeeds(4);
+  // The last peer is removed.
+  const std::vector<uint64_t> remaining(seeds.begin(), seeds.end() - 1);
+  for (int i = 0; i < kNumKeys; ++i) {
+    const std::string key = absl::StrCat("key", i);
+    const size_t owner = PeerCheckCache::selectOwner(key, seeds);
+    if (owner != seeds.size() - 1) {
+      EXPECT_EQ(PeerCheckCache::selectOwner(key, remaining), owner);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,277 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/pending_state_handoff.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::google::api::servicecontrol::v1::AllocateQuotaRequest;
+using ::google::api::servicecontrol::v1::ReportRequest;
+
+namespace {
+
+// A handoff file is the magic and the little-endian time it was written in
+// milliseconds since the epoch, followed by records of
+// <type:1><little-endian size:4><serialized request:size>.
+constexpr char kMagic[] = "ESPV2PN2";
+constexpr size_t kMagicSize = sizeof(kMagic) - 1;
+constexpr size_t kHeaderSize = kMagicSize + 8;
+constexpr size_t kRecordHeaderSize = 5;
+
+constexpr char kReportRecord = 'R';
+constexpr char kQuotaRecord = 'Q';
+
+constexpr char kPendingSuffix[] = ".pending";
+
+// Makes the file names of the instances unique across the processes and
+// threads of the node.
+std::string uniqueSuffix() {
+  static std::atomic<uint64_t> next_id{0};
+  return absl::StrCat(getpid(), ".", next_id++);
+}
+
+bool readFile(const std::string& path, std::string* data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *data = buffer.str();
+  return true;
+}
+
+}  // namespace
+
+PendingStateHandoff::PendingStateHandoff(const std::string& dir,
+                                         const std::string& service_name,
+                                         Envoy::TimeSource& time_source)
+    : dir_(dir),
+      file_prefix_(absl::StrCat(absl::StrReplaceAll(service_name, {{"/", "_"}}),
+                                ".")),
+      time_source_(time_source) {}
+
+PendingStateHandoff::~PendingStateHandoff() {
+  absl::MutexLock lock(&mutex_);
+  if (records_.empty()) {
+    return;
+  }
+
+  const uint64_t written =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          time_source_.systemTime().time_since_epoch())
+          .count();
+  char header[kHeaderSize];
+  memcpy(header, kMagic, kMagicSize);
+  for (size_t i = 0; i < 8; ++i) {
+    header[kMagicSize + i] = static_cast<char>((written >> (8 * i)) & 0xff);
+  }
+
+  // Written under a temporary name, so a partial file is never claimed.
+  const std::string path =
+      absl::StrCat(dir_, "/", file_prefix_, uniqueSuffix(), kPendingSuffix);
+  const std::string temp_path = absl::StrCat(path, ".tmp");
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(header, kHeaderSize);
+    file.write(records_.data(), records_.size());
+    if (!file) {
+      ENVOY_LOG(error, "Failed to write the pending state to {}", temp_path);
+      std::remove(temp_path.c_str());
+      return;
+    }
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    ENVOY_LOG(error, "Failed to rename {} to {}", temp_path, path);
+    std::remove(temp_path.c_str());
+    return;
+  }
+  ENVOY_LOG(info, "Handed off {} bytes of pending state in {}",
+            records_.size(), path);
+}
+
+void PendingStateHandoff::addReport(const ReportRequest& request) {
+  addRecord(kReportRecord, request.SerializeAsString());
+}
+
+void PendingStateHandoff::addQuota(const AllocateQuotaRequest& request) {
+  addRecord(kQuotaRecord, request.SerializeAsString());
+}
+
+void PendingStateHandoff::addRecord(char type, const std::string& data) {
+  const uint32_t size = data.size();
+  const char header[kRecordHeaderSize] = {
+      type,
+      static_cast<char>(size & 0xff),
+      static_cast<char>((size >> 8) & 0xff),
+      static_cast<char>((size >> 16) & 0xff),
+      static_cast<char>((size >> 24) & 0xff),
+  };
+  absl::MutexLock lock(&mutex_);
+  records_.append(header, kRecordHeaderSize);
+  records_.append(data);
+}
+
+void PendingStateHandoff::takeOver(
+    std::vector<ReportRequest>* reports,
+    std::vector<AllocateQuotaRequest>* quota_requests) {
+  DIR* dir = opendir(dir_.c_str());
+  if (dir == nullptr) {
+    ENVOY_LOG(warn, "Failed to open the pending state directory {}", dir_);
+    return;
+  }
+  std::vector<std::string> names;
+  while (const struct dirent* entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (absl::StartsWith(name, file_prefix_) &&
+        absl::EndsWith(name, kPendingSuffix)) {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+
+  for (const std::string& name : names) {
+    // Only one of the instances racing for a file succeeds the rename.
+    const std::string path = absl::StrCat(dir_, "/", name);
+    const std::string claimed_path =
+        absl::StrCat(path, ".claimed.", uniqueSuffix());
+    if (std::rename(path.c_str(), claimed_path.c_str()) != 0) {
+      continue;
+    }
+
+    std::string data;
+    Envoy::SystemTime written;
+    // Parsed aside so an invalid file is dropped as a whole.
+    std::vector<ReportRequest> file_reports;
+    std::vector<AllocateQuotaRequest> file_quota_requests;
+    const bool valid =
+        readFile(claimed_path, &data) &&
+        parse(data, &written, &file_reports, &file_quota_requests);
+    std::remove(claimed_path.c_str());
+    if (!valid) {
+      ENVOY_LOG(error, "Dropping invalid pending state file {}", path);
+      continue;
+    }
+
+    ENVOY_LOG(info, "Took over {} bytes of pending state from {}", data.size(),
+              path);
+    reports->insert(reports->end(), file_reports.begin(), file_reports.end());
+    if (!file_quota_requests.empty() &&
+        time_source_.systemTime() - written > kPendingQuotaMaxAge) {
+      ENVOY_LOG(info, "Dropping {} stale quota requests from {}",
+                file_quota_requests.size(), path);
+      continue;
+    }
+    quota_requests->insert(quota_requests->end(), file_quota_requests.begin(),
+                           file_quota_requests.end());
+  }
+}
+
+PendingStateTakeOver::PendingStateTakeOver(PendingStateHandoff& handoff,
+                                           Envoy::Event::Dispatcher& dispatcher,
+                                           std::chrono::milliseconds window,
+                                           MergeFunc merge_fn)
+    : handoff_(handoff),
+      merge_fn_(std::move(merge_fn)),
+      // Rounded up, so the window is covered.
+      take_overs_left_(1 + (window + kPendingStateTakeOverInterval -
+                            std::chrono::milliseconds(1)) /
+                               kPendingStateTakeOverInterval),
+      timer_(dispatcher.createTimer([this]() { takeOver(); })) {
+  takeOver();
+}
+
+void PendingStateTakeOver::takeOver() {
+  std::vector<ReportRequest> reports;
+  std::vector<AllocateQuotaRequest> quota_requests;
+  handoff_.takeOver(&reports, &quota_requests);
+  if (!reports.empty() || !quota_requests.empty()) {
+    merge_fn_(std::move(reports), std::move(quota_requests));
+  }
+
+  if (--take_overs_left_ > 0) {
+    timer_->enableTimer(kPendingStateTakeOverInterval);
+  }
+}
+
+bool PendingStateHandoff::parse(
+    const std::string& data, Envoy::SystemTime* written,
+    std::vector<ReportRequest>* reports,
+    std::vector<AllocateQuotaRequest>* quota_requests) {
+  if (data.size() < kHeaderSize || data.compare(0, kMagicSize, kMagic) != 0) {
+    return false;
+  }
+  uint64_t written_ms = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    written_ms |= static_cast<uint64_t>(
+                      static_cast<uint8_t>(data[kMagicSize + i]))
+                  << (8 * i);
+  }
+  *written = Envoy::SystemTime(std::chrono::milliseconds(written_ms));
+
+  size_t pos = kHeaderSize;
+  while (pos < data.size()) {
+    if (data.size() - pos < kRecordHeaderSize) {
+      return false;
+    }
+    const auto* header = reinterpret_cast<const uint8_t*>(data.data() + pos);
+    const uint32_t size = header[1] | (header[2] << 8) | (header[3] << 16) |
+                          (static_cast<uint32_t>(header[4]) << 24);
+    pos += kRecordHeaderSize;
+    if (data.size() - pos < size) {
+      return false;
+    }
+
+    const char* record = data.data() + pos;
+    switch (header[0]) {
+      case kReportRecord:
+        reports->emplace_back();
+        if (!reports->back().ParseFromArray(record, size)) {
+          return false;
+        }
+        break;
+      case kQuotaRecord:
+        quota_requests->emplace_back();
+        if (!quota_requests->back().ParseFromArray(record, size)) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+    pos += size;
+  }
+  return true;
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
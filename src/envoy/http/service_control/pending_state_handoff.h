@@ -0,0 +1,139 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "google/api/servicecontrol/v1/quota_controller.pb.h"
+#include "google/api/servicecontrol/v1/service_controller.pb.h"
+#include "source/common/common/logger.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+// How old a handed off quota request may be when it is taken over. The older
+// ones are dropped, as their allocation is no longer meaningful.
+constexpr std::chrono::seconds kPendingQuotaMaxAge(10);
+
+// The interval to take over the pending state handed off by the previous hot
+// restart epoch.
+constexpr std::chrono::seconds kPendingStateTakeOverInterval(5);
+// How long the pending state is taken over if the window is not configured.
+// The previous epoch exits, and hands its pending state off, the default
+// --parent-shutdown-time-s of Envoy of 15 minutes after this one started.
+constexpr std::chrono::minutes kPendingStateDefaultTakeOverWindow(16);
+
+// Hands the report and quota requests the ClientCaches could not send before
+// their destruction to the ClientCaches of the next hot restart epoch.
+//
+// When the parent epoch drains, its ClientCaches flush their aggregated
+// reports and quota requests, but the calls are cancelled when the parent
+// exits. The cancelled requests are added here and written to one file in
+// `dir` on destruction. The same service in the child epoch on the same node
+// claims the files with an atomic rename, and merges the requests into the
+// aggregators of a ClientCache.
+//
+// The requests may be added from any thread. It is shared by the
+// ClientCaches of the workers and is expected to be destroyed, and to take
+// over the files, on the main thread, so the workers do not block on the
+// file system.
+class PendingStateHandoff
+    : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+ public:
+  PendingStateHandoff(const std::string& dir, const std::string& service_name,
+                      Envoy::TimeSource& time_source);
+
+  // Writes the added requests, if any.
+  ~PendingStateHandoff();
+
+  void addReport(
+      const ::google::api::servicecontrol::v1::ReportRequest& request);
+
+  void addQuota(
+      const ::google::api::servicecontrol::v1::AllocateQuotaRequest& request);
+
+  // Claims the files written for the service by other instances and appends
+  // their requests. The quota requests of the files written more than
+  // kPendingQuotaMaxAge ago are dropped. Invalid files are logged and deleted.
+  void takeOver(
+      std::vector<::google::api::servicecontrol::v1::ReportRequest>* reports,
+      std::vector<::google::api::servicecontrol::v1::AllocateQuotaRequest>*
+          quota_requests);
+
+ private:
+  void addRecord(char type, const std::string& data);
+
+  // Returns false if the file is not a valid handoff file.
+  bool parse(
+      const std::string& data, Envoy::SystemTime* written,
+      std::vector<::google::api::servicecontrol::v1::ReportRequest>* reports,
+      std::vector<::google::api::servicecontrol::v1::AllocateQuotaRequest>*
+          quota_requests);
+
+  const std::string dir_;
+  // The file name prefix of the service.
+  const std::string file_prefix_;
+  Envoy::TimeSource& time_source_;
+
+  absl::Mutex mutex_;
+  // The encoded records of the added requests.
+  std::string records_ ABSL_GUARDED_BY(mutex_);
+};
+
+using PendingStateHandoffSharedPtr = std::shared_ptr<PendingStateHandoff>;
+
+// Takes over the pending state handed off to a PendingStateHandoff on
+// creation, then every kPendingStateTakeOverInterval until the take over
+// window ends. The last take over is at the end of the window.
+//
+// It is expected to be owned by the main thread, as the files are read on
+// its dispatcher.
+class PendingStateTakeOver {
+ public:
+  // Called with the requests taken over, if any.
+  using MergeFunc = std::function<void(
+      std::vector<::google::api::servicecontrol::v1::ReportRequest> reports,
+      std::vector<::google::api::servicecontrol::v1::AllocateQuotaRequest>
+          quota_requests)>;
+
+  PendingStateTakeOver(PendingStateHandoff& handoff,
+                       Envoy::Event::Dispatcher& dispatcher,
+                       std::chrono::milliseconds window, MergeFunc merge_fn);
+
+ private:
+  void takeOver();
+
+  PendingStateHandoff& handoff_;
+  MergeFunc merge_fn_;
+  // The number of take overs left, including the one in progress.
+  uint64_t take_overs_left_;
+  Envoy::Event::TimerPtr timer_;
+};
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,237 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/pending_state_handoff.h"
+
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "test/mocks/event/mocks.h"
+#include "test/test_common/environment.h"
+#include "test/test_common/simulated_time_system.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::google::api::servicecontrol::v1::AllocateQuotaRequest;
+using ::google::api::servicecontrol::v1::ReportRequest;
+using ::testing::NiceMock;
+
+ReportRequest report(const std::string& operation_id) {
+  ReportRequest request;
+  request.set_service_config_id("config-id");
+  request.add_operations()->set_operation_id(operation_id);
+  return request;
+}
+
+AllocateQuotaRequest quota(const std::string& operation_id) {
+  AllocateQuotaRequest request;
+  request.set_service_config_id("config-id");
+  request.mutable_allocate_operation()->set_operation_id(operation_id);
+  return request;
+}
+
+class PendingStateHandoffTest : public ::testing::Test {
+ protected:
+  PendingStateHandoffTest()
+      : dir_(Envoy::TestEnvironment::temporaryPath(
+            ::testing::UnitTest::GetInstance()->current_test_info()->name())) {
+    Envoy::TestEnvironment::createPath(dir_);
+  }
+
+  void takeOver(const std::string& service_name) {
+    reports_.clear();
+    quota_requests_.clear();
+    PendingStateHandoff(dir_, service_name, time_system_)
+        .takeOver(&reports_, &quota_requests_);
+  }
+
+  const std::string dir_;
+  Envoy::Event::SimulatedTimeSystem time_system_;
+  std::vector<ReportRequest> reports_;
+  std::vector<AllocateQuotaRequest> quota_requests_;
+};
+
+TEST_F(PendingStateHandoffTest, HandsOffRequests) {
+  {
+    PendingStateHandoff parent(dir_, "echo.endpoints.cloudesf.cloud.goog",
+                               time_system_);
+    parent.addReport(report("report-1"));
+    parent.addQuota(quota("quota-1"));
+    parent.addReport(report("report-2"));
+  }
+
+  takeOver("echo.endpoints.cloudesf.cloud.goog");
+  ASSERT_EQ(reports_.size(), 2);
+  EXPECT_EQ(reports_[0].operations(0).operation_id(), "report-1");
+  EXPECT_EQ(reports_[1].operations(0).operation_id(), "report-2");
+  ASSERT_EQ(quota_requests_.size(), 1);
+  EXPECT_EQ(quota_requests_[0].allocate_operation().operation_id(), "quota-1");
+
+  // The files are only taken over once.
+  takeOver("echo.endpoints.cloudesf.cloud.goog");
+  EXPECT_TRUE(reports_.empty());
+  EXPECT_TRUE(quota_requests_.empty());
+}
+
+TEST_F(PendingStateHandoffTest, MergesAllInstances) {
+  for (int i = 0; i < 3; ++i) {
+    PendingStateHandoff(dir_, "echo", time_system_).addReport(report("report"));
+  }
+  // Nothing is written without pending requests.
+  { PendingStateHandoff empty(dir_, "echo", time_system_); }
+
+  takeOver("echo");
+  EXPECT_EQ(reports_.size(), 3);
+  EXPECT_TRUE(quota_requests_.empty());
+}
+
+TEST_F(PendingStateHandoffTest, OnlyTakesOverSameService) {
+  PendingStateHandoff(dir_, "bookstore", time_system_)
+      .addReport(report("bookstore"));
+
+  takeOver("echo");
+  EXPECT_TRUE(reports_.empty());
+
+  takeOver("bookstore");
+  ASSERT_EQ(reports_.size(), 1);
+  EXPECT_EQ(reports_[0].operations(0).operation_id(), "bookstore");
+}
+
+TEST_F(PendingStateHandoffTest, DropsInvalidFiles) {
+  PendingStateHandoff(dir_, "echo", time_system_).addReport(report("valid"));
+  std::ofstream(dir_ + "/echo.1.1.pending", std::ios::binary) << "garbage";
+  std::ofstream(dir_ + "/echo.1.2.pending", std::ios::binary)
+      << std::string("ESPV2PN2\0\0\0\0\0\0\0\0R\x10\x00\x00\x00", 21)
+      << "short";
+  // Written by an older version.
+  std::ofstream(dir_ + "/echo.1.3.pending", std::ios::binary) << "ESPV2PND";
+
+  takeOver("echo");
+  ASSERT_EQ(reports_.size(), 1);
+  EXPECT_EQ(reports_[0].operations(0).operation_id(), "valid");
+
+  takeOver("echo");
+  EXPECT_TRUE(reports_.empty());
+}
+
+TEST_F(PendingStateHandoffTest, DropsStaleQuotaRequests) {
+  {
+    PendingStateHandoff parent(dir_, "echo", time_system_);
+    parent.addReport(report("report"));
+    parent.addQuota(quota("quota"));
+  }
+  time_system_.advanceTimeWait(kPendingQuotaMaxAge + std::chrono::seconds(1));
+
+  // The reports are still sent.
+  takeOver("echo");
+  EXPECT_EQ(reports_.size(), 1);
+  EXPECT_TRUE(quota_requests_.empty());
+}
+
+TEST_F(PendingStateHandoffTest, MissingDirectory) {
+  PendingStateHandoff(dir_ + "/missing", "echo", time_system_)
+      .takeOver(&reports_, &quota_requests_);
+  EXPECT_TRUE(reports_.empty());
+  EXPECT_TRUE(quota_requests_.empty());
+}
+
+class PendingStateTakeOverTest : public PendingStateHandoffTest {
+ protected:
+  PendingStateTakeOverTest()
+      : handoff_(dir_, "echo", time_system_),
+        timer_(new NiceMock<Envoy::Event::MockTimer>(&dispatcher_)) {}
+
+  void createTakeOver(std::chrono::milliseconds window) {
+    take_over_ = std::make_unique<PendingStateTakeOver>(
+        handoff_, dispatcher_, window,
+        [this](std::vector<ReportRequest> reports,
+               std::vector<AllocateQuotaRequest> quota_requests) {
+          ++merges_;
+          reports_ = std::move(reports);
+          quota_requests_ = std::move(quota_requests);
+        });
+  }
+
+  PendingStateHandoff handoff_;
+  NiceMock<Envoy::Event::MockDispatcher> dispatcher_;
+  NiceMock<Envoy::Event::MockTimer>* timer_;
+  std::unique_ptr<PendingStateTakeOver> take_over_;
+  int merges_ = 0;
+};
+
+TEST_F(PendingStateTakeOverTest, ParentWritesAfterChildStartedPolling) {
+  createTakeOver(kPendingStateDefaultTakeOverWindow);
+  EXPECT_EQ(merges_, 0);
+  EXPECT_TRUE(timer_->enabled_);
+
+  timer_->invokeCallback();
+  EXPECT_EQ(merges_, 0);
+  EXPECT_TRUE(timer_->enabled_);
+
+  // The parent exits, and hands its pending state off, long after the child
+  // started.
+  PendingStateHandoff(dir_, "echo", time_system_).addReport(report("report"));
+
+  timer_->invokeCallback();
+  EXPECT_EQ(merges_, 1);
+  ASSERT_EQ(reports_.size(), 1);
+  EXPECT_EQ(reports_[0].operations(0).operation_id(), "report");
+  EXPECT_TRUE(timer_->enabled_);
+
+  // Nothing is merged without new files.
+  timer_->invokeCallback();
+  EXPECT_EQ(merges_, 1);
+}
+
+TEST_F(PendingStateTakeOverTest, TakesOverOnCreation) {
+  PendingStateHandoff(dir_, "echo", time_system_).addQuota(quota("quota"));
+
+  createTakeOver(kPendingStateDefaultTakeOverWindow);
+  EXPECT_EQ(merges_, 1);
+  EXPECT_TRUE(reports_.empty());
+  EXPECT_EQ(quota_requests_.size(), 1);
+}
+
+TEST_F(PendingStateTakeOverTest, StopsAtEndOfWindow) {
+  // Taken over on creation, then 5s and 10s later.
+  createTakeOver(std::chrono::seconds(10));
+  EXPECT_TRUE(timer_->enabled_);
+
+  timer_->invokeCallback();
+  EXPECT_TRUE(timer_->enabled_);
+
+  timer_->invokeCallback();
+  EXPECT_FALSE(timer_->enabled_);
+}
+
+TEST_F(PendingStateTakeOverTest, RoundsWindowUp) {
+  // Taken over on creation, then 5s and 10s later to cover 6s.
+  createTakeOver(std::chrono::seconds(6));
+
+  timer_->invokeCallback();
+  EXPECT_TRUE(timer_->enabled_);
+
+  timer_->invokeCallback();
+  EXPECT_FALSE(timer_->enabled_);
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,204 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/pinned_check_cache.h"
+
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "google/protobuf/util/time_util.h"
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/hex.h"
+#include "source/common/crypto/utility.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::espv2::api::envoy::v11::http::service_control::PinnedCheckCacheConfig;
+using ::google::api::servicecontrol::v1::CheckRequest;
+using ::google::api::servicecontrol::v1::CheckResponse;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+using ::google::protobuf::util::TimeUtil;
+
+namespace {
+
+// The prefix of the consumer id of the requests with an API key, see
+// kConsumerIdApiKey in request_builder.cc.
+constexpr absl::string_view kApiKeyConsumerPrefix = "api_key:";
+
+}  // namespace
+
+PinnedCheckCache::PinnedCheckCache(const PinnedCheckCacheConfig& config,
+                                   Envoy::Event::Dispatcher& dispatcher,
+                                   Envoy::TimeSource& time_source,
+                                   const std::string& stats_prefix,
+                                   Envoy::Stats::Scope& scope,
+                                   SendFunc send_fn)
+    : time_source_(time_source),
+      filter_stats_(ServiceControlFilterStats::create(stats_prefix, scope)),
+      send_fn_(std::move(send_fn)),
+      api_key_sha256_(config.api_key_sha256().begin(),
+                      config.api_key_sha256().end()),
+      consumer_numbers_(config.consumer_numbers().begin(),
+                        config.consumer_numbers().end()),
+      ttl_(kPinnedCheckCacheDefaultTtl),
+      max_entries_(kPinnedCheckCacheDefaultMaxEntries),
+      timer_(dispatcher.createTimer([this]() { onTimer(); })) {
+  if (config.has_ttl()) {
+    ttl_ = std::chrono::milliseconds(
+        TimeUtil::DurationToMilliseconds(config.ttl()));
+  }
+  if (config.max_entries() > 0) {
+    max_entries_ = config.max_entries();
+  }
+}
+
+std::string PinnedCheckCache::apiKeySha256(absl::string_view consumer_id) {
+  if (!absl::ConsumePrefix(&consumer_id, kApiKeyConsumerPrefix)) {
+    return "";
+  }
+  Envoy::Buffer::OwnedImpl buffer(consumer_id);
+  return Envoy::Hex::encode(
+      Envoy::Common::Crypto::UtilitySingleton::get().getSha256Digest(buffer));
+}
+
+bool PinnedCheckCache::lookup(const std::string& signature,
+                              CheckResponse* response) {
+  auto it = entries_.find(signature);
+  if (it == entries_.end()) {
+    return false;
+  }
+  if (it->second.expires <= time_source_.monotonicTime()) {
+    erase(it);
+    return false;
+  }
+  it->second.hit = true;
+  response->CopyFrom(it->second.response);
+  filter_stats_.filter_.pinned_check_cache_hit_.inc();
+  return true;
+}
+
+void PinnedCheckCache::update(const CheckRequest& request,
+                              const std::string& signature,
+                              const CheckResponse& response) {
+  auto it = entries_.find(signature);
+  if (!isPinned(request, response)) {
+    // Not a priority consumer, or no longer one.
+    if (it != entries_.end()) {
+      erase(it);
+    }
+    return;
+  }
+
+  if (it == entries_.end()) {
+    if (entries_.size() >= max_entries_) {
+      ENVOY_LOG(debug, "Pinned check cache full, the response is not pinned");
+      return;
+    }
+    it = entries_.emplace(signature, Entry{request}).first;
+    ++consumer_entries_[request.operation().consumer_id()];
+    if (!timer_->enabled()) {
+      timer_->enableTimer(kPinnedCheckCacheScanInterval);
+    }
+  }
+  Entry& entry = it->second;
+  entry.response = response;
+  entry.expires = time_source_.monotonicTime() + ttl_;
+  entry.hit = false;
+}
+
+bool PinnedCheckCache::isPinned(const CheckRequest& request,
+                                const CheckResponse& response) const {
+  if (consumer_numbers_.contains(
+          response.check_info().consumer_info().project_number())) {
+    return true;
+  }
+  return !api_key_sha256_.empty() &&
+         api_key_sha256_.contains(
+             apiKeySha256(request.operation().consumer_id()));
+}
+
+void PinnedCheckCache::erase(
+    absl::flat_hash_map<std::string, Entry>::iterator it) {
+  auto consumer =
+      consumer_entries_.find(it->second.request.operation().consumer_id());
+  if (consumer != consumer_entries_.end() && --consumer->second == 0) {
+    consumer_entries_.erase(consumer);
+  }
+  entries_.erase(it);
+}
+
+void PinnedCheckCache::refresh(const std::string& signature, Entry& entry) {
+  entry.refreshing = true;
+  send_fn_(entry.request, [this, signature](const Status& status,
+                                            const CheckResponse& response) {
+    auto it = entries_.find(signature);
+    if (it == entries_.end()) {
+      // Expired while it was refreshed.
+      return;
+    }
+    it->second.refreshing = false;
+    if (status.code() == StatusCode::kCancelled) {
+      return;
+    }
+    if (!status.ok()) {
+      // Retried on the next scan, and still served until it expires.
+      filter_stats_.filter_.pinned_check_cache_refresh_failed_.inc();
+      return;
+    }
+    filter_stats_.filter_.pinned_check_cache_refreshed_.inc();
+    // Copied, as the entry is removed if it is no longer pinned.
+    const CheckRequest request = it->second.request;
+    update(request, signature, response);
+  });
+}
+
+void PinnedCheckCache::onTimer() {
+  const Envoy::MonotonicTime now = time_source_.monotonicTime();
+  // Refreshed in the last quarter of the ttl.
+  const Envoy::MonotonicTime refresh_before = now + ttl_ / 4;
+
+  // The refresh calls may complete inline and update the entries, so they
+  // are made after the scan.
+  std::vector<std::string> due;
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    Entry& entry = it->second;
+    if (entry.expires <= now) {
+      erase(it++);
+      continue;
+    }
+    if (entry.hit && !entry.refreshing && entry.expires <= refresh_before) {
+      due.push_back(it->first);
+    }
+    ++it;
+  }
+  for (const std::string& signature : due) {
+    auto it = entries_.find(signature);
+    if (it != entries_.end()) {
+      refresh(signature, it->second);
+    }
+  }
+
+  if (!entries_.empty()) {
+    timer_->enableTimer(kPinnedCheckCacheScanInterval);
+  }
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
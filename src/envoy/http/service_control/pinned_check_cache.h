@@ -0,0 +1,142 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "api/envoy/v11/http/service_control/config.pb.h"
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "google/api/servicecontrol/v1/service_controller.pb.h"
+#include "google/protobuf/stubs/status.h"
+#include "source/common/common/logger.h"
+#include "src/envoy/http/service_control/filter_stats.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+// How long a pinned check response is served if the ttl is not configured.
+// It matches the flush interval of the check cache.
+constexpr std::chrono::minutes kPinnedCheckCacheDefaultTtl(5);
+// The maximum number of pinned check responses if it is not configured.
+constexpr uint32_t kPinnedCheckCacheDefaultMaxEntries = 1000;
+// How often the pinned check responses are scanned for refresh and expiry.
+constexpr std::chrono::seconds kPinnedCheckCacheScanInterval(5);
+
+// Holds the check responses of the priority consumers outside of the check
+// cache, see PinnedCheckCacheConfig.
+//
+// A response served since its last refresh is refreshed once it enters the
+// last quarter of its ttl. A failed refresh is retried on the next scan, and
+// the response is still served until it expires. The responses not served
+// since their last refresh expire, so the consumers gone idle are not
+// refreshed forever.
+//
+// It is not thread-safe and is expected to be owned by a worker thread.
+class PinnedCheckCache
+    : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+ public:
+  using DoneFunc = std::function<void(
+      const ::google::protobuf::util::Status& status,
+      const ::google::api::servicecontrol::v1::CheckResponse& response)>;
+
+  // The function to make a check call to Service Control.
+  using SendFunc = std::function<void(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      DoneFunc on_done)>;
+
+  PinnedCheckCache(
+      const ::espv2::api::envoy::v11::http::service_control::
+          PinnedCheckCacheConfig& config,
+      Envoy::Event::Dispatcher& dispatcher, Envoy::TimeSource& time_source,
+      const std::string& stats_prefix, Envoy::Stats::Scope& scope,
+      SendFunc send_fn);
+
+  // Returns true if a response is pinned for the consumer. It is checked
+  // before computing the signature of a check request for the lookup.
+  bool hasConsumer(const std::string& consumer_id) const {
+    return consumer_entries_.contains(consumer_id);
+  }
+
+  // Copies the pinned response of the check request with the given signature
+  // to `response`. Returns false if it is not pinned or is expired.
+  bool lookup(
+      const std::string& signature,
+      ::google::api::servicecontrol::v1::CheckResponse* response);
+
+  // Pins the response of a check call to Service Control if its consumer is
+  // a priority consumer, or updates the pinned one.
+  void update(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      const std::string& signature,
+      const ::google::api::servicecontrol::v1::CheckResponse& response);
+
+  // Returns the hex encoded SHA-256 digest of the API key of the consumer
+  // id, or an empty string if the consumer is not identified by an API key.
+  static std::string apiKeySha256(absl::string_view consumer_id);
+
+ private:
+  struct Entry {
+    ::google::api::servicecontrol::v1::CheckRequest request;
+    ::google::api::servicecontrol::v1::CheckResponse response;
+    Envoy::MonotonicTime expires;
+    // Whether the response was served since it was last refreshed.
+    bool hit = false;
+    bool refreshing = false;
+  };
+
+  bool isPinned(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      const ::google::api::servicecontrol::v1::CheckResponse& response) const;
+
+  void erase(absl::flat_hash_map<std::string, Entry>::iterator it);
+
+  // Makes the check call refreshing the entry.
+  void refresh(const std::string& signature, Entry& entry);
+
+  // Refreshes the entries due, and removes the expired ones.
+  void onTimer();
+
+  Envoy::TimeSource& time_source_;
+  ServiceControlFilterStats filter_stats_;
+  SendFunc send_fn_;
+
+  absl::flat_hash_set<std::string> api_key_sha256_;
+  absl::flat_hash_set<int64_t> consumer_numbers_;
+  std::chrono::milliseconds ttl_;
+  uint32_t max_entries_;
+
+  // The pinned responses by request signature.
+  absl::flat_hash_map<std::string, Entry> entries_;
+  // The number of pinned responses by consumer id.
+  absl::flat_hash_map<std::string, uint32_t> consumer_entries_;
+
+  Envoy::Event::TimerPtr timer_;
+};
+
+using PinnedCheckCachePtr = std::unique_ptr<PinnedCheckCache>;
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
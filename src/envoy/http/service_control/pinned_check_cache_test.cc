@@ -0,0 +1,229 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/pinned_check_cache.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/stats/mocks.h"
+#include "test/test_common/simulated_time_system.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::espv2::api::envoy::v11::http::service_control::PinnedCheckCacheConfig;
+using ::google::api::servicecontrol::v1::CheckRequest;
+using ::google::api::servicecontrol::v1::CheckResponse;
+using ::google::protobuf::util::OkStatus;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+using ::testing::NiceMock;
+
+// The SHA-256 digest of "key".
+constexpr char kKeySha256[] =
+    "2c70e12b7a0646f92279f427c7b38e7334d8e5389cff167a1dc30e73f826b683";
+constexpr int64_t kPinnedNumber = 123;
+
+CheckRequest request(const std::string& consumer_id) {
+  CheckRequest request;
+  request.mutable_operation()->set_consumer_id(consumer_id);
+  return request;
+}
+
+CheckResponse response(int64_t project_number) {
+  CheckResponse response;
+  response.mutable_check_info()->mutable_consumer_info()->set_project_number(
+      project_number);
+  return response;
+}
+
+class PinnedCheckCacheTest : public ::testing::Test {
+ protected:
+  PinnedCheckCacheTest()
+      : timer_(new NiceMock<Envoy::Event::MockTimer>(&dispatcher_)),
+        stats_(ServiceControlFilterStats::create("", scope_)) {}
+
+  void createCache(uint32_t max_entries = 0) {
+    PinnedCheckCacheConfig config;
+    config.add_api_key_sha256(kKeySha256);
+    config.add_consumer_numbers(kPinnedNumber);
+    config.mutable_ttl()->set_seconds(60);
+    config.set_max_entries(max_entries);
+    cache_ = std::make_unique<PinnedCheckCache>(
+        config, dispatcher_, time_system_, "", scope_,
+        [this](const CheckRequest& request,
+               PinnedCheckCache::DoneFunc on_done) {
+          sent_.push_back(request);
+          pending_.push_back(on_done);
+        });
+  }
+
+  bool lookup(const std::string& signature) {
+    CheckResponse response;
+    return cache_->lookup(signature, &response);
+  }
+
+  // Completes the oldest pending refresh.
+  void complete(const Status& status, int64_t project_number) {
+    ASSERT_FALSE(pending_.empty());
+    auto on_done = pending_.front();
+    pending_.erase(pending_.begin());
+    on_done(status, response(project_number));
+  }
+
+  void advanceTime(std::chrono::seconds duration) {
+    time_system_.advanceTimeWait(duration);
+  }
+
+  NiceMock<Envoy::Event::MockDispatcher> dispatcher_;
+  Envoy::Event::MockTimer* timer_;
+  Envoy::Event::SimulatedTimeSystem time_system_;
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope_;
+  ServiceControlFilterStats stats_;
+
+  std::vector<CheckRequest> sent_;
+  std::vector<PinnedCheckCache::DoneFunc> pending_;
+
+  std::unique_ptr<PinnedCheckCache> cache_;
+};
+
+TEST(PinnedCheckCacheApiKeyTest, ApiKeySha256) {
+  EXPECT_EQ(PinnedCheckCache::apiKeySha256("api_key:key"), kKeySha256);
+  EXPECT_EQ(PinnedCheckCache::apiKeySha256("project:123"), "");
+}
+
+TEST_F(PinnedCheckCacheTest, PinsListedApiKey) {
+  createCache();
+  cache_->update(request("api_key:key"), "a", response(0));
+  cache_->update(request("api_key:other"), "b", response(0));
+
+  EXPECT_TRUE(cache_->hasConsumer("api_key:key"));
+  EXPECT_FALSE(cache_->hasConsumer("api_key:other"));
+  EXPECT_TRUE(lookup("a"));
+  EXPECT_FALSE(lookup("b"));
+  EXPECT_EQ(stats_.filter_.pinned_check_cache_hit_.value(), 1);
+  EXPECT_TRUE(timer_->enabled_);
+}
+
+TEST_F(PinnedCheckCacheTest, PinsListedConsumerNumber) {
+  createCache();
+  cache_->update(request("api_key:other"), "a", response(kPinnedNumber));
+
+  EXPECT_TRUE(cache_->hasConsumer("api_key:other"));
+  EXPECT_TRUE(lookup("a"));
+}
+
+TEST_F(PinnedCheckCacheTest, ExpiresAfterTtl) {
+  createCache();
+  cache_->update(request("api_key:key"), "a", response(0));
+
+  advanceTime(std::chrono::seconds(60));
+  EXPECT_FALSE(lookup("a"));
+  EXPECT_FALSE(cache_->hasConsumer("api_key:key"));
+}
+
+TEST_F(PinnedCheckCacheTest, ServedEntryRefreshedAheadOfExpiry) {
+  createCache();
+  cache_->update(request("api_key:key"), "a", response(0));
+  EXPECT_TRUE(lookup("a"));
+
+  // Not due yet.
+  advanceTime(std::chrono::seconds(30));
+  timer_->invokeCallback();
+  EXPECT_TRUE(sent_.empty());
+
+  // In the last quarter of the ttl.
+  advanceTime(std::chrono::seconds(20));
+  timer_->invokeCallback();
+  ASSERT_EQ(sent_.size(), 1);
+  EXPECT_EQ(sent_[0].operation().consumer_id(), "api_key:key");
+
+  // Not refreshed again while the refresh is in flight.
+  timer_->invokeCallback();
+  EXPECT_EQ(sent_.size(), 1);
+
+  complete(OkStatus(), 0);
+  EXPECT_EQ(stats_.filter_.pinned_check_cache_refreshed_.value(), 1);
+
+  // Served past the first expiry.
+  advanceTime(std::chrono::seconds(30));
+  EXPECT_TRUE(lookup("a"));
+}
+
+TEST_F(PinnedCheckCacheTest, IdleEntryNotRefreshed) {
+  createCache();
+  cache_->update(request("api_key:key"), "a", response(0));
+
+  advanceTime(std::chrono::seconds(50));
+  timer_->invokeCallback();
+  EXPECT_TRUE(sent_.empty());
+
+  advanceTime(std::chrono::seconds(10));
+  timer_->invokeCallback();
+  EXPECT_TRUE(sent_.empty());
+  EXPECT_FALSE(cache_->hasConsumer("api_key:key"));
+}
+
+TEST_F(PinnedCheckCacheTest, FailedRefreshRetried) {
+  createCache();
+  cache_->update(request("api_key:key"), "a", response(0));
+  EXPECT_TRUE(lookup("a"));
+
+  advanceTime(std::chrono::seconds(50));
+  timer_->invokeCallback();
+  complete(Status(StatusCode::kUnavailable, "unavailable"), 0);
+  EXPECT_EQ(stats_.filter_.pinned_check_cache_refresh_failed_.value(), 1);
+
+  // Still served until it expires, and retried on the next scan.
+  EXPECT_TRUE(lookup("a"));
+  advanceTime(std::chrono::seconds(5));
+  timer_->invokeCallback();
+  EXPECT_EQ(sent_.size(), 2);
+}
+
+TEST_F(PinnedCheckCacheTest, RefreshedConsumerNoLongerPinned) {
+  createCache();
+  cache_->update(request("api_key:other"), "a", response(kPinnedNumber));
+  EXPECT_TRUE(lookup("a"));
+
+  advanceTime(std::chrono::seconds(50));
+  timer_->invokeCallback();
+  complete(OkStatus(), 456);
+
+  EXPECT_FALSE(lookup("a"));
+  EXPECT_FALSE(cache_->hasConsumer("api_key:other"));
+}
+
+TEST_F(PinnedCheckCacheTest, MaxEntries) {
+  createCache(/*max_entries=*/1);
+  cache_->update(request("api_key:key"), "a", response(0));
+  cache_->update(request("api_key:key"), "b", response(0));
+
+  EXPECT_TRUE(lookup("a"));
+  EXPECT_FALSE(lookup("b"));
+
+  // The pinned entries are still updated.
+  cache_->update(request("api_key:key"), "a", response(0));
+  EXPECT_TRUE(lookup("a"));
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,197 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/report_retry_queue.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+using ::google::api::servicecontrol::v1::ReportRequest;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+
+namespace {
+
+// Keeps the shift of the backoff in range.
+constexpr uint32_t kMaxBackoffShift = 20;
+
+}  // namespace
+
+ReportRetryQueue::ReportRetryQueue(Envoy::Event::Dispatcher& dispatcher,
+                                   Envoy::TimeSource& time_source,
+                                   const ReportRetryOptions& options,
+                                   const std::string& stats_prefix,
+                                   Envoy::Stats::Scope& scope,
+                                   SendFunc send_fn, DropFunc drop_fn)
+    : time_source_(time_source),
+      options_(options),
+      filter_stats_(ServiceControlFilterStats::create(stats_prefix, scope)),
+      send_fn_(std::move(send_fn)),
+      drop_fn_(std::move(drop_fn)),
+      timer_(dispatcher.createTimer([this]() { onTimer(); })) {}
+
+ReportRetryQueue::~ReportRetryQueue() {
+  if (!queue_.empty()) {
+    ENVOY_LOG(debug, "{} reports still queued for retry on destruction",
+              queue_.size());
+  }
+  for (const auto& it : queue_) {
+    if (drop_fn_) {
+      drop_fn_(it.second.request);
+    }
+  }
+  filter_stats_.filter_.report_retry_queued_bytes_.sub(queued_bytes_);
+}
+
+bool ReportRetryQueue::isRetryable(StatusCode code) {
+  switch (code) {
+    // 429 and 5xx responses, and timeouts.
+    case StatusCode::kUnavailable:
+    case StatusCode::kUnknown:
+    case StatusCode::kDeadlineExceeded:
+    // Network errors and missing access tokens.
+    case StatusCode::kInternal:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void ReportRetryQueue::send(const ReportRequest& request, DoneFunc on_done) {
+  std::vector<Entry> batch;
+  uint64_t batch_bytes = request.ByteSizeLong();
+  batch.push_back({request, 0, batch_bytes});
+
+  takeDue(request.service_config_id(), &batch_bytes, &batch);
+  if (batch.size() > 1) {
+    filter_stats_.filter_.report_retry_merged_.add(batch.size() - 1);
+    enableTimer();
+  }
+  sendBatch(std::move(batch), std::move(on_done));
+}
+
+void ReportRetryQueue::takeDue(const std::string& service_config_id,
+                               uint64_t* batch_bytes,
+                               std::vector<Entry>* batch) {
+  const Envoy::MonotonicTime now = time_source_.monotonicTime();
+  for (auto it = queue_.begin(); it != queue_.end() && it->first <= now;) {
+    Entry& entry = it->second;
+    if (entry.request.service_config_id() != service_config_id ||
+        *batch_bytes + entry.bytes > options_.max_batch_bytes) {
+      ++it;
+      continue;
+    }
+    *batch_bytes += entry.bytes;
+    queued_bytes_ -= entry.bytes;
+    filter_stats_.filter_.report_retry_queued_bytes_.sub(entry.bytes);
+    batch->push_back(std::move(entry));
+    it = queue_.erase(it);
+  }
+}
+
+void ReportRetryQueue::sendBatch(std::vector<Entry> batch, DoneFunc on_done) {
+  auto pending = std::make_shared<std::vector<Entry>>(std::move(batch));
+
+  ReportRequest merged;
+  const ReportRequest* request = &pending->front().request;
+  if (pending->size() > 1) {
+    merged = *request;
+    for (size_t i = 1; i < pending->size(); ++i) {
+      const ReportRequest& retried = (*pending)[i].request;
+      merged.mutable_operations()->MergeFrom(retried.operations());
+    }
+    request = &merged;
+  }
+
+  send_fn_(*request, [this, pending, on_done](const Status& status) {
+    if (!status.ok() && isRetryable(status.code())) {
+      for (Entry& entry : *pending) {
+        retryLater(std::move(entry));
+      }
+      enableTimer();
+    }
+    if (on_done) {
+      on_done(status);
+    }
+  });
+}
+
+void ReportRetryQueue::retryLater(Entry entry) {
+  if (entry.retries >= options_.max_retries) {
+    ENVOY_LOG(debug, "Dropping report with {} operations after {} retries",
+              entry.request.operations_size(), entry.retries);
+    filter_stats_.filter_.report_retry_dropped_.inc();
+    return;
+  }
+
+  const uint32_t shift = std::min(entry.retries, kMaxBackoffShift);
+  const std::chrono::milliseconds backoff =
+      std::min(options_.initial_backoff * (1 << shift), options_.max_backoff);
+  ++entry.retries;
+
+  queued_bytes_ += entry.bytes;
+  filter_stats_.filter_.report_retry_queued_bytes_.add(entry.bytes);
+  queue_.emplace(time_source_.monotonicTime() + backoff, std::move(entry));
+  filter_stats_.filter_.report_retry_queued_.inc();
+
+  // Over the memory bound, the reports retried last are dropped first.
+  while (queued_bytes_ > options_.max_queued_bytes) {
+    auto last = std::prev(queue_.end());
+    ENVOY_LOG(debug,
+              "Report retry queue is full, dropping report with {} operations",
+              last->second.request.operations_size());
+    queued_bytes_ -= last->second.bytes;
+    filter_stats_.filter_.report_retry_queued_bytes_.sub(last->second.bytes);
+    queue_.erase(last);
+    filter_stats_.filter_.report_retry_dropped_.inc();
+  }
+}
+
+void ReportRetryQueue::onTimer() {
+  const Envoy::MonotonicTime now = time_source_.monotonicTime();
+  while (!queue_.empty() && queue_.begin()->first <= now) {
+    std::vector<Entry> batch;
+    batch.push_back(std::move(queue_.begin()->second));
+    queue_.erase(queue_.begin());
+    queued_bytes_ -= batch.front().bytes;
+    filter_stats_.filter_.report_retry_queued_bytes_.sub(batch.front().bytes);
+
+    uint64_t batch_bytes = batch.front().bytes;
+    takeDue(batch.front().request.service_config_id(), &batch_bytes, &batch);
+    filter_stats_.filter_.report_retry_sent_.inc();
+    sendBatch(std::move(batch), nullptr);
+  }
+  enableTimer();
+}
+
+void ReportRetryQueue::enableTimer() {
+  if (queue_.empty()) {
+    timer_->disableTimer();
+    return;
+  }
+  const auto delay = std::max(
+      queue_.begin()->first - time_source_.monotonicTime(),
+      Envoy::MonotonicTime::duration::zero());
+  timer_->enableTimer(std::chrono::ceil<std::chrono::milliseconds>(delay));
+}
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,132 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "google/api/servicecontrol/v1/service_controller.pb.h"
+#include "google/protobuf/stubs/status.h"
+#include "source/common/common/logger.h"
+#include "src/envoy/http/service_control/filter_stats.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+
+struct ReportRetryOptions {
+  // The number of times a report is retried before it is dropped.
+  uint32_t max_retries;
+  // The delay of the first retry, doubled on each retry up to `max_backoff`.
+  std::chrono::milliseconds initial_backoff;
+  std::chrono::milliseconds max_backoff;
+  // The bound of the serialized size of the queued reports.
+  uint64_t max_queued_bytes;
+  // The bound of the serialized size of the reports merged into one call.
+  uint64_t max_batch_bytes;
+};
+
+// Retries the report calls failed with a transient error with an exponential
+// backoff, instead of reissuing them right away.
+//
+// The failed reports are kept in a queue ordered by the time of their next
+// retry. The due reports are merged into the next report flushed by the
+// aggregator, or sent together when the earliest of them is due. A merged
+// call that fails again is split back into its reports, so each report keeps
+// its own retry count.
+//
+// It is not thread-safe and is expected to be owned by a worker thread.
+class ReportRetryQueue
+    : public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+ public:
+  using DoneFunc =
+      std::function<void(const ::google::protobuf::util::Status& status)>;
+
+  // The function to make a report call, without retries.
+  using SendFunc = std::function<void(
+      const ::google::api::servicecontrol::v1::ReportRequest& request,
+      DoneFunc on_done)>;
+
+  // The function called with the reports still queued on destruction.
+  using DropFunc = std::function<void(
+      const ::google::api::servicecontrol::v1::ReportRequest& request)>;
+
+  ReportRetryQueue(Envoy::Event::Dispatcher& dispatcher,
+                   Envoy::TimeSource& time_source,
+                   const ReportRetryOptions& options,
+                   const std::string& stats_prefix, Envoy::Stats::Scope& scope,
+                   SendFunc send_fn, DropFunc drop_fn);
+
+  // Passes the queued reports to the DropFunc.
+  ~ReportRetryQueue();
+
+  // Sends the report with the due reports merged into it. `on_done` is
+  // called with the status of the call once, even if it is retried later.
+  void send(const ::google::api::servicecontrol::v1::ReportRequest& request,
+            DoneFunc on_done);
+
+  // Returns true if a report call failed with `code` may succeed later.
+  static bool isRetryable(::google::protobuf::util::StatusCode code);
+
+ private:
+  struct Entry {
+    ::google::api::servicecontrol::v1::ReportRequest request;
+    // The number of times the report has been retried.
+    uint32_t retries;
+    uint64_t bytes;
+  };
+
+  // Appends the due reports of the service config to `batch`, up to the
+  // batch size.
+  void takeDue(const std::string& service_config_id, uint64_t* batch_bytes,
+               std::vector<Entry>* batch);
+
+  // Makes one call for the reports in `batch`.
+  void sendBatch(std::vector<Entry> batch, DoneFunc on_done);
+
+  // Queues the report for its next retry, or drops it.
+  void retryLater(Entry entry);
+
+  // Sends the due reports.
+  void onTimer();
+
+  void enableTimer();
+
+  Envoy::TimeSource& time_source_;
+  const ReportRetryOptions options_;
+  ServiceControlFilterStats filter_stats_;
+  SendFunc send_fn_;
+  DropFunc drop_fn_;
+
+  // The reports by the time of their next retry.
+  std::multimap<Envoy::MonotonicTime, Entry> queue_;
+  uint64_t queued_bytes_ = 0;
+
+  Envoy::Event::TimerPtr timer_;
+};
+
+using ReportRetryQueuePtr = std::unique_ptr<ReportRetryQueue>;
+
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,253 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/http/service_control/report_retry_queue.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/stats/mocks.h"
+#include "test/test_common/simulated_time_system.h"
+
+namespace espv2 {
+namespace envoy {
+namespace http_filters {
+namespace service_control {
+namespace {
+
+using ::google::api::servicecontrol::v1::ReportRequest;
+using ::google::protobuf::util::OkStatus;
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusCode;
+using ::testing::_;
+using ::testing::NiceMock;
+
+constexpr uint32_t kMaxRetries = 2;
+
+ReportRequest report(const std::string& operation_id,
+                     const std::string& config_id = "config-id") {
+  ReportRequest request;
+  request.set_service_config_id(config_id);
+  request.add_operations()->set_operation_id(operation_id);
+  return request;
+}
+
+class ReportRetryQueueTest : public ::testing::Test {
+ protected:
+  ReportRetryQueueTest()
+      : timer_(new NiceMock<Envoy::Event::MockTimer>(&dispatcher_)),
+        stats_(ServiceControlFilterStats::create("", scope_)) {}
+
+  void createQueue(uint64_t max_queued_bytes = 1024 * 1024,
+                   uint64_t max_batch_bytes = 1024 * 1024) {
+    queue_ = std::make_unique<ReportRetryQueue>(
+        dispatcher_, time_system_,
+        ReportRetryOptions{kMaxRetries, std::chrono::milliseconds(100),
+                           std::chrono::milliseconds(150), max_queued_bytes,
+                           max_batch_bytes},
+        "", scope_,
+        [this](const ReportRequest& request,
+               ReportRetryQueue::DoneFunc on_done) {
+          sent_.push_back(request);
+          pending_.push_back(on_done);
+        },
+        [this](const ReportRequest& request) { dropped_.push_back(request); });
+  }
+
+  void send(const ReportRequest& request) {
+    queue_->send(request, [this](const Status&) { ++done_count_; });
+  }
+
+  // Completes the oldest pending call.
+  void complete(const Status& status) {
+    ASSERT_FALSE(pending_.empty());
+    auto on_done = pending_.front();
+    pending_.erase(pending_.begin());
+    on_done(status);
+  }
+
+  void advanceTime(std::chrono::milliseconds duration) {
+    time_system_.advanceTimeWait(duration);
+  }
+
+  std::vector<std::string> sentOperations(size_t index) {
+    std::vector<std::string> ids;
+    for (const auto& operation : sent_[index].operations()) {
+      ids.push_back(operation.operation_id());
+    }
+    return ids;
+  }
+
+  NiceMock<Envoy::Event::MockDispatcher> dispatcher_;
+  Envoy::Event::MockTimer* timer_;
+  Envoy::Event::SimulatedTimeSystem time_system_;
+  NiceMock<Envoy::Stats::MockIsolatedStatsStore> scope_;
+  ServiceControlFilterStats stats_;
+
+  std::vector<ReportRequest> sent_;
+  std::vector<ReportRetryQueue::DoneFunc> pending_;
+  std::vector<ReportRequest> dropped_;
+  int done_count_ = 0;
+
+  std::unique_ptr<ReportRetryQueue> queue_;
+};
+
+TEST_F(ReportRetryQueueTest, SuccessNotRetried) {
+  createQueue();
+  send(report("a"));
+  complete(OkStatus());
+
+  EXPECT_EQ(sent_.size(), 1);
+  EXPECT_EQ(done_count_, 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_.value(), 0);
+}
+
+TEST_F(ReportRetryQueueTest, ClientErrorNotRetried) {
+  createQueue();
+  send(report("a"));
+  complete(Status(StatusCode::kPermissionDenied, "denied"));
+
+  EXPECT_EQ(done_count_, 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_.value(), 0);
+  EXPECT_EQ(stats_.filter_.report_retry_dropped_.value(), 0);
+}
+
+TEST_F(ReportRetryQueueTest, RetriedWithBackoff) {
+  createQueue();
+  send(report("a"));
+
+  // The first retry is after the initial backoff.
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(100), _));
+  complete(Status(StatusCode::kUnavailable, "503"));
+  EXPECT_EQ(done_count_, 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_.value(), 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_bytes_.value(),
+            report("a").ByteSizeLong());
+
+  // Not sent before it is due.
+  advanceTime(std::chrono::milliseconds(50));
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(50), _));
+  timer_->invokeCallback();
+  EXPECT_EQ(sent_.size(), 1);
+
+  advanceTime(std::chrono::milliseconds(50));
+  timer_->invokeCallback();
+  EXPECT_FALSE(timer_->enabled_);
+  ASSERT_EQ(sent_.size(), 2);
+  EXPECT_EQ(sentOperations(1), std::vector<std::string>{"a"});
+  EXPECT_EQ(stats_.filter_.report_retry_sent_.value(), 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_bytes_.value(), 0);
+
+  // The second backoff is capped.
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(150), _));
+  complete(Status(StatusCode::kDeadlineExceeded, "timeout"));
+  advanceTime(std::chrono::milliseconds(150));
+  timer_->invokeCallback();
+  ASSERT_EQ(sent_.size(), 3);
+
+  // Dropped after the last retry. The caller is only called back once.
+  complete(Status(StatusCode::kUnavailable, "503"));
+  EXPECT_EQ(done_count_, 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_.value(), 2);
+  EXPECT_EQ(stats_.filter_.report_retry_dropped_.value(), 1);
+}
+
+TEST_F(ReportRetryQueueTest, DueReportsMergedIntoNextReport) {
+  createQueue();
+  send(report("a"));
+  send(report("b", "other-config-id"));
+  complete(Status(StatusCode::kUnavailable, "503"));
+  complete(Status(StatusCode::kUnavailable, "503"));
+
+  // Not merged before they are due.
+  send(report("c"));
+  EXPECT_EQ(sentOperations(2), std::vector<std::string>{"c"});
+  complete(OkStatus());
+
+  // Only merged into the reports of the same service config.
+  advanceTime(std::chrono::milliseconds(100));
+  send(report("d"));
+  EXPECT_EQ(sentOperations(3), (std::vector<std::string>{"d", "a"}));
+  EXPECT_EQ(stats_.filter_.report_retry_merged_.value(), 1);
+
+  // A merged report that fails is split back, and "a" is on its last retry.
+  complete(Status(StatusCode::kUnavailable, "503"));
+  EXPECT_EQ(stats_.filter_.report_retry_queued_.value(), 4);
+
+  advanceTime(std::chrono::milliseconds(150));
+  timer_->invokeCallback();
+  ASSERT_EQ(sent_.size(), 6);
+  EXPECT_EQ(sentOperations(4), std::vector<std::string>{"b"});
+  EXPECT_EQ(sentOperations(5), (std::vector<std::string>{"d", "a"}));
+  EXPECT_EQ(stats_.filter_.report_retry_sent_.value(), 2);
+
+  complete(OkStatus());
+  complete(Status(StatusCode::kUnavailable, "503"));
+  EXPECT_EQ(stats_.filter_.report_retry_dropped_.value(), 1);
+  EXPECT_EQ(stats_.filter_.report_retry_queued_.value(), 5);
+}
+
+TEST_F(ReportRetryQueueTest, BatchSizeBounded) {
+  const uint64_t report_bytes = report("a").ByteSizeLong();
+  createQueue(/*max_queued_bytes=*/1024, /*max_batch_bytes=*/2 * report_bytes);
+  for (const char* id : {"a", "b", "c"}) {
+    send(report(id));
+    complete(Status(StatusCode::kUnavailable, "503"));
+  }
+
+  advanceTime(std::chrono::milliseconds(100));
+  timer_->invokeCallback();
+  ASSERT_EQ(sent_.size(), 5);
+  EXPECT_EQ(sentOperations(3), (std::vector<std::string>{"a", "b"}));
+  EXPECT_EQ(sentOperations(4), std::vector<std::string>{"c"});
+}
+
+TEST_F(ReportRetryQueueTest, QueuedBytesBounded) {
+  const uint64_t report_bytes = report("a").ByteSizeLong();
+  createQueue(/*max_queued_bytes=*/2 * report_bytes);
+
+  send(report("a"));
+  complete(Status(StatusCode::kUnavailable, "503"));
+  advanceTime(std::chrono::milliseconds(10));
+  send(report("b"));
+  complete(Status(StatusCode::kUnavailable, "503"));
+  advanceTime(std::chrono::milliseconds(10));
+  send(report("c"));
+  complete(Status(StatusCode::kUnavailable, "503"));
+
+  // The report retried last is dropped.
+  EXPECT_EQ(stats_.filter_.report_retry_dropped_.value(), 1);
+  advanceTime(std::chrono::milliseconds(200));
+  timer_->invokeCallback();
+  ASSERT_EQ(sent_.size(), 4);
+  EXPECT_EQ(sentOperations(3), (std::vector<std::string>{"a", "b"}));
+}
+
+TEST_F(ReportRetryQueueTest, QueuedReportsDroppedOnDestruction) {
+  createQueue();
+  send(report("a"));
+  complete(Status(StatusCode::kInternal, "network error"));
+  send(report("b"));
+  complete(OkStatus());
+
+  queue_.reset();
+  ASSERT_EQ(dropped_.size(), 1);
+  EXPECT_EQ(dropped_[0].operations(0).operation_id(), "a");
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace http_filters
+}  // namespace envoy
+}  // namespace espv2
@@ -17,6 +17,8 @@
 #include "api/envoy/v11/http/service_control/config.pb.h"
 #include "envoy/common/pure.h"
 #include "envoy/tracing/http_tracer.h"
+#include "src/envoy/http/service_control/denied_report_rollup.h"
+#include "src/envoy/http/service_control/local_reply.h"
 #include "src/envoy/http/service_control/service_control_callback_func.h"
 
 namespace espv2 {
@@ -39,6 +41,13 @@ class ServiceControlCall {
   virtual void callReport(
       const ::espv2::api_proxy::service_control::ReportRequestInfo&
           request_info) PURE;
+
+  // Rolls the report of a request denied with `reply` into a per-operation,
+  // per-reason counter during a denial flood. Returns false if the report
+  // should be sent with callReport() instead.
+  virtual bool rollupDeniedReport(absl::string_view operation_name,
+                                  const LocalReply& reply,
+                                  const DeniedReportFillFunc& fill_fn) PURE;
 };
 
 using ServiceControlCallPtr = std::unique_ptr<ServiceControlCall>;
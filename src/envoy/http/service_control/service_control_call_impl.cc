@@ -14,8 +14,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
 #include "google/protobuf/util/time_util.h"
 #include "source/common/common/assert.h"
+#include "source/common/tracing/http_tracer_impl.h"
 #include "src/api_proxy/service_control/logs_metrics_loader.h"
 #include "src/envoy/http/service_control/service_control_call_impl.h"
 
@@ -28,12 +33,29 @@ using ::espv2::api::envoy::v11::http::common::AccessToken;
 using ::espv2::api::envoy::v11::http::common::DependencyErrorBehavior;
 using ::espv2::api::envoy::v11::http::service_control::FilterConfig;
 using ::espv2::api::envoy::v11::http::service_control::Service;
+using ::espv2::api_proxy::service_control::CheckRequestInfo;
+using ::espv2::api_proxy::service_control::CheckResponseInfo;
 using ::espv2::api_proxy::service_control::LogsMetricsLoader;
+using ::espv2::api_proxy::service_control::QuotaRequestInfo;
 using ::espv2::api_proxy::service_control::RequestBuilder;
+using ::google::protobuf::util::Status;
 using ::google::protobuf::util::TimeUtil;
 using token::TokenSubscriber;
 using token::TokenType;
 
+namespace {
+
+// The pending state taken over on the main thread, merged by the first worker
+// to run the callback.
+struct TakenOverPendingState {
+  std::vector<::google::api::servicecontrol::v1::ReportRequest> reports;
+  std::vector<::google::api::servicecontrol::v1::AllocateQuotaRequest>
+      quota_requests;
+  std::atomic<bool> merged{false};
+};
+
+}  // namespace
+
 void ServiceControlCallImpl::createImdsTokenSub() {
   const std::string& token_cluster = filter_config_.imds_token().cluster();
   const std::string& token_uri = filter_config_.imds_token().uri();
@@ -108,17 +130,80 @@ ServiceControlCallImpl::ServiceControlCallImpl(
     : filter_config_(*proto_config),
       token_subscriber_factory_(context),
       tls_(context.threadLocal()) {
+  // The request builder is shared with the thread local caches, so it must be
+  // created first.
+  if (config.has_service_config()) {
+    std::set<std::string> logs, metrics, labels;
+    (void)LogsMetricsLoader::Load(config.service_config(), &logs, &metrics,
+                                  &labels);
+    request_builder_ = std::make_shared<const RequestBuilder>(
+        logs, metrics, labels, config.service_name(),
+        config.service_config_id());
+  } else {
+    request_builder_ = std::make_shared<const RequestBuilder>(
+        std::set<std::string>{"endpoints_log"}, config.service_name(),
+        config.service_config_id());
+  }
+
+  // The secret is read here on the main thread, so the workers do not block
+  // on the file.
+  std::string peer_check_cache_secret;
+  if (proto_config->has_peer_check_cache()) {
+    peer_check_cache_secret =
+        std::string(absl::StripAsciiWhitespace(
+            context.api().fileSystem().fileReadToEnd(
+                proto_config->peer_check_cache().secret_path())));
+    if (peer_check_cache_secret.empty()) {
+      throw Envoy::EnvoyException(
+          absl::StrCat("Empty peer check cache secret in ",
+                       proto_config->peer_check_cache().secret_path()));
+    }
+  }
+
+  if (!proto_config->hot_restart_handoff_dir().empty()) {
+    pending_state_handoff_ = std::make_shared<PendingStateHandoff>(
+        proto_config->hot_restart_handoff_dir(), config.service_name(),
+        context.timeSource());
+  }
+
   // Pass shared_ptr of proto_config to the function capture so that
   // it will not be released when the function is called.
   tls_.set([proto_config, &config, stats_prefix, &scope = context.scope(),
             &cm = context.clusterManager(),
-            &time_source =
-                context.timeSource()](Envoy::Event::Dispatcher& dispatcher) {
-    return std::make_shared<ThreadLocalCache>(config, *proto_config,
-                                              stats_prefix, scope, cm,
-                                              time_source, dispatcher);
+            &time_source = context.timeSource(),
+            &main_dispatcher = context.mainThreadDispatcher(),
+            request_builder = request_builder_, peer_check_cache_secret,
+            pending_state_handoff = pending_state_handoff_](
+               Envoy::Event::Dispatcher& dispatcher) {
+    // The last reference writes the handoff file, so the references of the
+    // workers are released on the main thread.
+    PendingStateHandoffSharedPtr worker_handoff;
+    if (pending_state_handoff) {
+      worker_handoff = PendingStateHandoffSharedPtr(
+          pending_state_handoff.get(),
+          [pending_state_handoff, &main_dispatcher](PendingStateHandoff*) {
+            main_dispatcher.post([pending_state_handoff]() {});
+          });
+    }
+    return std::make_shared<ThreadLocalCache>(
+        config, *proto_config, stats_prefix, scope, cm, time_source,
+        dispatcher, request_builder, peer_check_cache_secret,
+        std::move(worker_handoff));
   });
 
+  if (pending_state_handoff_) {
+    std::chrono::milliseconds window = kPendingStateDefaultTakeOverWindow;
+    if (proto_config->has_hot_restart_take_over_window()) {
+      window = std::chrono::milliseconds(TimeUtil::DurationToMilliseconds(
+          proto_config->hot_restart_take_over_window()));
+    }
+    pending_state_take_over_ = std::make_unique<PendingStateTakeOver>(
+        *pending_state_handoff_, context.mainThreadDispatcher(), window,
+        [this](auto reports, auto quota_requests) {
+          mergePendingState(std::move(reports), std::move(quota_requests));
+        });
+  }
+
   switch (filter_config_.access_token_case()) {
     case FilterConfig::kImdsToken:
       createImdsTokenSub();
@@ -130,34 +215,122 @@ ServiceControlCallImpl::ServiceControlCallImpl(
       PANIC(absl::StrCat("invalid access_token_case: ",
                          filter_config_.access_token_case()));
   }
-
-  if (config.has_service_config()) {
-    std::set<std::string> logs, metrics, labels;
-    (void)LogsMetricsLoader::Load(config.service_config(), &logs, &metrics,
-                                  &labels);
-    request_builder_.reset(new RequestBuilder(logs, metrics, labels,
-                                              config.service_name(),
-                                              config.service_config_id()));
-  } else {
-    request_builder_.reset(new RequestBuilder(
-        {"endpoints_log"}, config.service_name(), config.service_config_id()));
-  }
 }  // namespace ServiceControl
 
-CancelFunc ServiceControlCallImpl::callCheck(
-    const ::espv2::api_proxy::service_control::CheckRequestInfo& request_info,
-    Envoy::Tracing::Span& parent_span, CheckDoneFunc on_done) {
+void ServiceControlCallImpl::mergePendingState(
+    std::vector<::google::api::servicecontrol::v1::ReportRequest> reports,
+    std::vector<::google::api::servicecontrol::v1::AllocateQuotaRequest>
+        quota_requests) {
+  auto state = std::make_shared<TakenOverPendingState>();
+  state->reports = std::move(reports);
+  state->quota_requests = std::move(quota_requests);
+  tls_.runOnAllThreads([state](Envoy::OptRef<ThreadLocalCache> object) {
+    if (!state->merged.exchange(true)) {
+      object->client_cache().mergePendingState(state->reports,
+                                               state->quota_requests);
+    }
+  });
+}
+
+CancelFunc ServiceControlCallImpl::sendCheck(
+    ThreadLocalCache& tl_cache, const RequestBuilder& request_builder,
+    const CheckRequestInfo& request_info, Envoy::Tracing::Span& parent_span,
+    CheckDoneFunc on_done) {
   ::google::api::servicecontrol::v1::CheckRequest request;
-  (void)request_builder_->FillCheckRequest(request_info, &request);
+  (void)request_builder.FillCheckRequest(request_info, &request);
   ENVOY_LOG(debug, "Sending check : {}", request.DebugString());
-  return getTLCache().client_cache().callCheck(request, parent_span, on_done);
+  return tl_cache.client_cache().callCheck(request, parent_span, on_done);
+}
+
+void ServiceControlCallImpl::sendProbe(ThreadLocalCache& tl_cache,
+                                       const RequestBuilder& request_builder,
+                                       const CheckRequestInfo& probe_info) {
+  // The probe is not cancelled with the request that triggered it.
+  (void)sendCheck(
+      tl_cache, request_builder, probe_info,
+      Envoy::Tracing::NullSpan::instance(),
+      [&tl_cache, api_key = probe_info.api_key](
+          const Status& status, const CheckResponseInfo& response_info) {
+        (void)tl_cache.api_key_restriction_tracker().onNormalizedCheckDone(
+            api_key, status, response_info);
+      });
 }
 
-void ServiceControlCallImpl::callQuota(
-    const ::espv2::api_proxy::service_control::QuotaRequestInfo& request_info,
-    QuotaDoneFunc on_done) {
+CancelFunc ServiceControlCallImpl::callCheck(
+    const CheckRequestInfo& request_info, Envoy::Tracing::Span& parent_span,
+    CheckDoneFunc on_done) {
+  ThreadLocalCache& tl_cache = getTLCache();
+  if (!filter_config_.learn_api_key_restrictions() ||
+      request_info.api_key.empty()) {
+    return sendCheck(tl_cache, *request_builder_, request_info, parent_span,
+                     on_done);
+  }
+
+  CheckRequestInfo normalized_info = request_info;
+  if (!tl_cache.api_key_restriction_tracker().normalizeIfUnrestricted(
+          &normalized_info)) {
+    // The restrictions of the key are unknown: the check keeps the client IP
+    // and referer, and the key is probed once the check succeeds.
+    ApiKeyRestrictionTracker::normalize(&normalized_info);
+    return sendCheck(
+        tl_cache, *request_builder_, request_info, parent_span,
+        [&tl_cache, request_builder = request_builder_,
+         probe_info = std::move(normalized_info),
+         on_done](const Status& status,
+                  const CheckResponseInfo& response_info) {
+          if (tl_cache.api_key_restriction_tracker().onCheckDone(
+                  probe_info.api_key, status, response_info)) {
+            sendProbe(tl_cache, *request_builder, probe_info);
+          }
+          on_done(status, response_info);
+        });
+  }
+
+  // A restriction may have been added to the key since it was probed: the
+  // check is then sent again with the client IP and referer. The check may
+  // complete inline, so the cancel function of the retry is kept if it was
+  // already made.
+  struct CheckRetry {
+    CancelFunc cancel;
+    bool sent = false;
+  };
+  auto retry = std::make_shared<CheckRetry>();
+  CancelFunc cancel = sendCheck(
+      tl_cache, *request_builder_, normalized_info, parent_span,
+      [&tl_cache, &parent_span, request_builder = request_builder_,
+       request_info, on_done,
+       retry](const Status& status, const CheckResponseInfo& response_info) {
+        if (!tl_cache.api_key_restriction_tracker().onNormalizedCheckDone(
+                request_info.api_key, status, response_info)) {
+          on_done(status, response_info);
+          return;
+        }
+        retry->sent = true;
+        retry->cancel = sendCheck(tl_cache, *request_builder, request_info,
+                                  parent_span, on_done);
+      });
+  if (!retry->sent) {
+    retry->cancel = std::move(cancel);
+  }
+  return [retry]() {
+    if (retry->cancel) {
+      retry->cancel();
+    }
+  };
+}
+
+void ServiceControlCallImpl::callQuota(const QuotaRequestInfo& request_info,
+                                       QuotaDoneFunc on_done) {
   ::google::api::servicecontrol::v1::AllocateQuotaRequest request;
-  (void)request_builder_->FillAllocateQuotaRequest(request_info, &request);
+  QuotaRequestInfo normalized_info = request_info;
+  if (filter_config_.learn_api_key_restrictions() &&
+      getTLCache().api_key_restriction_tracker().normalizeIfUnrestricted(
+          &normalized_info)) {
+    (void)request_builder_->FillAllocateQuotaRequest(normalized_info,
+                                                     &request);
+  } else {
+    (void)request_builder_->FillAllocateQuotaRequest(request_info, &request);
+  }
   ENVOY_LOG(debug, "Sending allocateQuota : {}", request.DebugString());
   getTLCache().client_cache().callQuota(request, on_done);
 }
@@ -171,6 +344,13 @@ void ServiceControlCallImpl::callReport(
   getTLCache().client_cache().callReport(request);
 }
 
+bool ServiceControlCallImpl::rollupDeniedReport(
+    absl::string_view operation_name, const LocalReply& reply,
+    const DeniedReportFillFunc& fill_fn) {
+  return getTLCache().denied_report_rollup().record(operation_name, reply,
+                                                    fill_fn);
+}
+
 }  // namespace service_control
 }  // namespace http_filters
 }  // namespace envoy
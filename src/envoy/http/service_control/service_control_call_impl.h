@@ -22,6 +22,7 @@
 #include "source/common/common/empty_string.h"
 #include "source/common/common/logger.h"
 #include "src/api_proxy/service_control/request_builder.h"
+#include "src/envoy/http/service_control/api_key_restriction_tracker.h"
 #include "src/envoy/http/service_control/client_cache.h"
 #include "src/envoy/http/service_control/service_control_call.h"
 #include "src/envoy/token/token_subscriber_factory_impl.h"
@@ -38,6 +39,9 @@ using TokenSharedPtr = std::shared_ptr<std::string>;
 constexpr char kServiceControlScope[] =
     "https://www.googleapis.com/auth/servicecontrol";
 
+using RequestBuilderSharedPtr =
+    std::shared_ptr<const ::espv2::api_proxy::service_control::RequestBuilder>;
+
 class ThreadLocalCache : public Envoy::ThreadLocal::ThreadLocalObject {
  public:
   ThreadLocalCache(
@@ -46,11 +50,27 @@ class ThreadLocalCache : public Envoy::ThreadLocal::ThreadLocalObject {
           filter_config,
       const std::string& stats_prefix, Envoy::Stats::Scope& scope,
       Envoy::Upstream::ClusterManager& cm, Envoy::TimeSource& time_source,
-      Envoy::Event::Dispatcher& dispatcher)
-      : client_cache_(
+      Envoy::Event::Dispatcher& dispatcher,
+      RequestBuilderSharedPtr request_builder,
+      const std::string& peer_check_cache_secret,
+      PendingStateHandoffSharedPtr pending_state_handoff)
+      : api_key_restriction_tracker_(kApiKeyRestrictionMaxKeys, stats_prefix,
+                                     scope),
+        client_cache_(
             config, filter_config, stats_prefix, scope, cm, time_source,
             dispatcher, [this]() -> const std::string& { return sc_token(); },
-            [this]() -> const std::string& { return quota_token(); }) {}
+            [this]() -> const std::string& { return quota_token(); },
+            peer_check_cache_secret, std::move(pending_state_handoff)),
+        denied_report_rollup_(
+            filter_config.denied_report_rollup(), dispatcher, stats_prefix,
+            scope,
+            [this, request_builder](
+                const ::espv2::api_proxy::service_control::ReportRequestInfo&
+                    info) {
+              ::google::api::servicecontrol::v1::ReportRequest request;
+              (void)request_builder->FillReportRequest(info, &request);
+              client_cache_.callReport(request);
+            }) {}
 
   void set_sc_token(TokenSharedPtr sc_token) { sc_token_ = sc_token; }
   const std::string& sc_token() const {
@@ -66,10 +86,22 @@ class ThreadLocalCache : public Envoy::ThreadLocal::ThreadLocalObject {
 
   ClientCache& client_cache() { return client_cache_; }
 
+  ApiKeyRestrictionTracker& api_key_restriction_tracker() {
+    return api_key_restriction_tracker_;
+  }
+
+  DeniedReportRollup& denied_report_rollup() { return denied_report_rollup_; }
+
  private:
   TokenSharedPtr sc_token_;
   TokenSharedPtr quota_token_;
+  // Used by the callbacks of the client cache, so it must be declared before
+  // it.
+  ApiKeyRestrictionTracker api_key_restriction_tracker_;
   ClientCache client_cache_;
+  // Flushes into the client cache on destruction, so it must be declared
+  // after it.
+  DeniedReportRollup denied_report_rollup_;
 };
 
 using FilterConfigProtoSharedPtr = std::shared_ptr<
@@ -96,17 +128,46 @@ class ServiceControlCallImpl
   void callReport(const ::espv2::api_proxy::service_control::ReportRequestInfo&
                       request_info) override;
 
+  bool rollupDeniedReport(absl::string_view operation_name,
+                          const LocalReply& reply,
+                          const DeniedReportFillFunc& fill_fn) override;
+
  private:
   // Get thread local cache object.
   ThreadLocalCache& getTLCache() { return *tls_; }
 
+  // The callbacks of the checks only capture the thread local cache, as they
+  // may be called after this object is destroyed.
+  static CancelFunc sendCheck(
+      ThreadLocalCache& tl_cache,
+      const ::espv2::api_proxy::service_control::RequestBuilder&
+          request_builder,
+      const ::espv2::api_proxy::service_control::CheckRequestInfo&
+          request_info,
+      Envoy::Tracing::Span& parent_span, CheckDoneFunc on_done);
+
+  // Checks the API key with a fixed client IP and referer, to learn whether
+  // it has an IP or referer restriction.
+  static void sendProbe(
+      ThreadLocalCache& tl_cache,
+      const ::espv2::api_proxy::service_control::RequestBuilder&
+          request_builder,
+      const ::espv2::api_proxy::service_control::CheckRequestInfo&
+          probe_info);
+
   void createImdsTokenSub();
   void createIamTokenSub();
 
+  // Merges the pending state taken over on the main thread into the client
+  // cache of one worker.
+  void mergePendingState(
+      std::vector<::google::api::servicecontrol::v1::ReportRequest> reports,
+      std::vector<::google::api::servicecontrol::v1::AllocateQuotaRequest>
+          quota_requests);
+
   const ::espv2::api::envoy::v11::http::service_control::FilterConfig&
       filter_config_;
-  std::unique_ptr<::espv2::api_proxy::service_control::RequestBuilder>
-      request_builder_;
+  RequestBuilderSharedPtr request_builder_;
 
   const token::TokenSubscriberFactoryImpl token_subscriber_factory_;
 
@@ -121,6 +182,11 @@ class ServiceControlCallImpl
   token::TokenSubscriberPtr iam_token_sub_;
 
   Envoy::ThreadLocal::TypedSlot<ThreadLocalCache> tls_;
+
+  // Set if the hot restart handoff is enabled. The files are taken over on
+  // the main thread, so the workers do not block on the file system.
+  PendingStateHandoffSharedPtr pending_state_handoff_;
+  std::unique_ptr<PendingStateTakeOver> pending_state_take_over_;
 };  // namespace ServiceControl
 
 class ServiceControlCallFactoryImpl : public ServiceControlCallFactory {
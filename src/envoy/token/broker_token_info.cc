@@ -0,0 +1,67 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/token/broker_token_info.h"
+
+#include "src/envoy/utils/json_struct.h"
+
+namespace espv2 {
+namespace envoy {
+namespace token {
+
+using utils::JsonStruct;
+
+BrokerTokenInfo::BrokerTokenInfo() {}
+
+// Identity token response is a JSON payload in the format:
+// {
+//   "id_token": "string",
+//   "expires_in": uint
+// }
+bool BrokerTokenInfo::parseIdentityToken(absl::string_view response,
+                                         TokenResult* ret) const {
+  ::google::protobuf::Struct response_pb;
+  ::google::protobuf::util::Status parse_status =
+      ::google::protobuf::util::JsonStringToMessage(std::string(response),
+                                                    &response_pb);
+  if (!parse_status.ok()) {
+    ENVOY_LOG(error, "Parsing response failed: {}", parse_status.ToString());
+    return false;
+  }
+  JsonStruct json_struct(response_pb);
+
+  std::string token;
+  parse_status = json_struct.getString("id_token", &token);
+  if (!parse_status.ok()) {
+    ENVOY_LOG(error, "Parsing response failed for field `id_token`: {}",
+              parse_status.ToString());
+    return false;
+  }
+
+  int expires_seconds;
+  parse_status = json_struct.getInteger("expires_in", &expires_seconds);
+  if (!parse_status.ok()) {
+    ENVOY_LOG(error, "Parsing response failed for field `expires_in`: {}",
+              parse_status.ToString());
+    return false;
+  }
+
+  ret->token = token;
+  ret->expiry_duration = std::chrono::seconds(expires_seconds);
+  return true;
+}
+
+}  // namespace token
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,38 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "src/envoy/token/imds_token_info.h"
+
+namespace espv2 {
+namespace envoy {
+namespace token {
+
+// `BrokerTokenInfo` is a bridge `TokenInfo` for the node-local token broker,
+// which fetches tokens from the Instance Metadata Server once for all the
+// proxies of a node. Access tokens are returned in the IMDS format. Identity
+// tokens are returned with their remaining lifetime, since the broker may
+// hand out a token fetched a while ago.
+class BrokerTokenInfo : public ImdsTokenInfo {
+ public:
+  BrokerTokenInfo();
+
+  bool parseIdentityToken(absl::string_view response,
+                          TokenResult* ret) const override;
+};
+
+}  // namespace token
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,75 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/token/broker_token_info.h"
+
+#include "gtest/gtest.h"
+
+namespace espv2 {
+namespace envoy {
+namespace token {
+namespace test {
+
+class BrokerTokenInfoTest : public testing::Test {
+ protected:
+  void SetUp() override { info_ = std::make_unique<BrokerTokenInfo>(); }
+
+  TokenInfoPtr info_;
+};
+
+TEST_F(BrokerTokenInfoTest, AccessTokenSuccess) {
+  std::string response =
+      R"({ "access_token": "fake-access-token", "expires_in": 3000 })";
+  TokenResult result{};
+
+  bool success = info_->parseAccessToken(response, &result);
+  EXPECT_TRUE(success);
+  EXPECT_EQ(result.token, "fake-access-token");
+  EXPECT_EQ(result.expiry_duration, std::chrono::seconds(3000));
+}
+
+TEST_F(BrokerTokenInfoTest, IdentityTokenSuccess) {
+  std::string response =
+      R"({ "id_token": "fake-id-token", "expires_in": 1200 })";
+  TokenResult result{};
+
+  // The remaining lifetime from the broker is used, not the IMDS default.
+  bool success = info_->parseIdentityToken(response, &result);
+  EXPECT_TRUE(success);
+  EXPECT_EQ(result.token, "fake-id-token");
+  EXPECT_EQ(result.expiry_duration, std::chrono::seconds(1200));
+}
+
+TEST_F(BrokerTokenInfoTest, IdentityTokenNonJsonResponse) {
+  std::string response = R"(non-json-response)";
+  TokenResult result{};
+
+  bool success = info_->parseIdentityToken(response, &result);
+  EXPECT_FALSE(success);
+}
+
+TEST_F(BrokerTokenInfoTest, IdentityTokenMissingFields) {
+  TokenResult result{};
+
+  EXPECT_FALSE(info_->parseIdentityToken(R"({ "expires_in": 1200 })", &result));
+  EXPECT_FALSE(
+      info_->parseIdentityToken(R"({ "id_token": "fake-id-token" })", &result));
+  EXPECT_FALSE(info_->parseIdentityToken(
+      R"({ "id_token": "fake-id-token", "expires_in": "invalid" })", &result));
+}
+
+}  // namespace test
+}  // namespace token
+}  // namespace envoy
+}  // namespace espv2
@@ -35,6 +35,14 @@ class MockTokenSubscriberFactory : public TokenSubscriberFactory {
                UpdateTokenCallback callback),
               (const));
 
+  MOCK_METHOD(TokenSubscriberPtr, createBrokerTokenSubscriber,
+              (const TokenType& token_type, const std::string& token_cluster,
+               const std::string& token_url, std::chrono::seconds fetch_timeout,
+               ::espv2::api::envoy::v11::http::common::DependencyErrorBehavior
+                   error_behavior,
+               UpdateTokenCallback callback),
+              (const));
+
   MOCK_METHOD(
       TokenSubscriberPtr, createIamTokenSubscriber,
       (const TokenType& token_type, const std::string& token_cluster,
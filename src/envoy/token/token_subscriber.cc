@@ -22,6 +22,7 @@
 #include "source/common/common/enum_to_int.h"
 #include "source/common/http/message_impl.h"
 #include "source/common/http/utility.h"
+#include "src/envoy/utils/header_scan_utils.h"
 
 namespace espv2 {
 namespace envoy {
@@ -50,7 +51,8 @@ TokenSubscriber::TokenSubscriber(
       callback_(callback),
       token_info_(std::move(token_info)),
       active_request_(nullptr),
-      init_target_(nullptr) {
+      init_target_(nullptr),
+      log_limiter_(context.mainThreadDispatcher().timeSource()) {
   debug_name_ = absl::StrCat("TokenSubscriber(", token_url_, ")");
 }
 
@@ -89,6 +91,12 @@ void TokenSubscriber::handleSuccessResponse(absl::string_view token,
                                             std::chrono::seconds expires_in) {
   active_request_ = nullptr;
 
+  log_limiter_.flushSuppressed(
+      [this](absl::string_view key, uint64_t suppressed) {
+        ENVOY_LOG(info, "{}: recovered, {} similar errors suppressed: {}",
+                  debug_name_, suppressed, key);
+      });
+
   // Signal that we are ready for initialization.
   ENVOY_LOG(debug, "{}: Got token and expiry duration: {} , {} seconds",
             debug_name_, token, expires_in.count());
@@ -114,7 +122,11 @@ void TokenSubscriber::refresh() {
       token_info_->prepareRequest(token_url_);
   if (message == nullptr) {
     // Preconditions in TokenInfo are not met, not an error.
-    ENVOY_LOG(warn, "{}: preconditions not met, retrying later", debug_name_);
+    std::string summary;
+    if (log_limiter_.allow("preconditions not met", summary)) {
+      ENVOY_LOG(warn, "{}: preconditions not met, retrying later{}",
+                debug_name_, summary);
+    }
     handleFailResponse();
     return;
   }
@@ -135,12 +147,23 @@ void TokenSubscriber::refresh() {
   } else {
     // This code doesn't handle the wrong cluster name case.
     // Assume it is due to the cluster is not ready.
-    ENVOY_LOG(warn, "{}: the cluster {} is not ready.", debug_name_,
-              token_cluster_);
+    std::string summary;
+    if (log_limiter_.allow("cluster not ready", summary)) {
+      ENVOY_LOG(warn, "{}: the cluster {} is not ready.{}", debug_name_,
+                token_cluster_, summary);
+    }
     handleFailResponse();
   }
 }
 
+void TokenSubscriber::logFailure(absl::string_view key,
+                                 absl::string_view details) {
+  std::string summary;
+  if (log_limiter_.allow(key, summary)) {
+    ENVOY_LOG(error, "{}: {}{}{}", debug_name_, key, details, summary);
+  }
+}
+
 void TokenSubscriber::processResponse(
     Envoy::Http::ResponseMessagePtr&& response) {
   auto status =
@@ -148,14 +171,14 @@ void TokenSubscriber::processResponse(
   if (!status.has_value()) {
     // This occurs if the status header is missing.
     // Catch the exception to prevent unwinding and skipping cleanup.
-    ENVOY_LOG(error, "{}: failed: No status in headers", debug_name_);
+    logFailure("failed: No status in headers");
     handleFailResponse();
     return;
   }
 
   const uint64_t status_code = status.value();
   if (status_code != Envoy::enumToInt(Envoy::Http::Code::OK)) {
-    ENVOY_LOG(error, "{}: failed: {}", debug_name_, status_code);
+    logFailure(absl::StrCat("failed: ", status_code));
     handleFailResponse();
     return;
   }
@@ -185,20 +208,18 @@ void TokenSubscriber::processResponse(
   // Token will be used as a HTTP_HEADER_VALUE in the future. Ensure it is
   // sanitized. Otherwise, special characters will cause a runtime failure
   // in other components.
-  if (!Envoy::Http::validHeaderString(result.token)) {
-    ENVOY_LOG(error,
-              "{}: failed because invalid characters were detected in token {}",
-              debug_name_, result.token);
+  if (!utils::isValidHeaderValue(result.token)) {
+    logFailure("failed because invalid characters were detected in token ",
+               result.token);
     handleFailResponse();
     return;
   }
 
   // Tokens that have already expired are treated as failures.
   if (result.expiry_duration.count() <= 0) {
-    ENVOY_LOG(error,
-              "{}: failed because token has already expired, it expired {} "
-              "seconds ago",
-              debug_name_, result.expiry_duration.count());
+    logFailure("failed because token has already expired",
+               absl::StrCat(", it expired ", result.expiry_duration.count(),
+                            " seconds ago"));
     handleFailResponse();
     return;
   }
@@ -218,13 +239,11 @@ void TokenSubscriber::onFailure(
     Envoy::Http::AsyncClient::FailureReason reason) {
   switch (reason) {
     case Envoy::Http::AsyncClient::FailureReason::Reset:
-      ENVOY_LOG(error, "{}: failed with error: the stream has been reset",
-                debug_name_);
+      logFailure("failed with error: the stream has been reset");
 
       break;
     default:
-      ENVOY_LOG(error, "{}: failed with an unknown network failure",
-                debug_name_);
+      logFailure("failed with an unknown network failure");
       break;
   }
 
@@ -23,6 +23,7 @@
 #include "source/common/common/logger.h"
 #include "source/common/init/target_impl.h"
 #include "src/envoy/token/token_info.h"
+#include "src/envoy/utils/log_rate_limiter.h"
 
 namespace espv2 {
 namespace envoy {
@@ -62,6 +63,10 @@ class TokenSubscriber
   void processResponse(Envoy::Http::ResponseMessagePtr&& response);
   void refresh();
 
+  // Logs a fetch failure, rate limited by its key, as a failed fetch is
+  // retried every few seconds while the token server is down.
+  void logFailure(absl::string_view key, absl::string_view details = "");
+
   // Envoy::Http::AsyncClient::Callbacks implemented by this class.
   void onSuccess(const Envoy::Http::AsyncClient::Request& request,
                  Envoy::Http::ResponseMessagePtr&& response) override;
@@ -94,6 +99,7 @@ class TokenSubscriber
 
   // Used in logs.
   std::string debug_name_;
+  utils::LogRateLimiter log_limiter_;
 };
 
 using TokenSubscriberPtr = std::unique_ptr<TokenSubscriber>;
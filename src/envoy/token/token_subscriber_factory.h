@@ -15,6 +15,7 @@
 #pragma once
 
 #include "api/envoy/v11/http/common/base.pb.h"
+#include "src/envoy/token/broker_token_info.h"
 #include "src/envoy/token/iam_token_info.h"
 #include "src/envoy/token/imds_token_info.h"
 #include "src/envoy/token/token_subscriber.h"
@@ -34,6 +35,14 @@ class TokenSubscriberFactory {
           error_behavior,
       UpdateTokenCallback callback) const PURE;
 
+  // Fetches the tokens from the node-local token broker.
+  virtual TokenSubscriberPtr createBrokerTokenSubscriber(
+      const TokenType& token_type, const std::string& token_cluster,
+      const std::string& token_url, std::chrono::seconds fetch_timeout,
+      ::espv2::api::envoy::v11::http::common::DependencyErrorBehavior
+          error_behavior,
+      UpdateTokenCallback callback) const PURE;
+
   virtual TokenSubscriberPtr createIamTokenSubscriber(
       const TokenType& token_type, const std::string& token_cluster,
       const std::string& token_url, std::chrono::seconds fetch_timeout,
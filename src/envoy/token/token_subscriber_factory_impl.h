@@ -15,6 +15,7 @@
 #pragma once
 
 #include "api/envoy/v11/http/common/base.pb.h"
+#include "src/envoy/token/broker_token_info.h"
 #include "src/envoy/token/iam_token_info.h"
 #include "src/envoy/token/imds_token_info.h"
 #include "src/envoy/token/token_subscriber.h"
@@ -44,6 +45,20 @@ class TokenSubscriberFactoryImpl : public TokenSubscriberFactory {
     return subscriber;
   }
 
+  TokenSubscriberPtr createBrokerTokenSubscriber(
+      const TokenType& token_type, const std::string& token_cluster,
+      const std::string& token_url, std::chrono::seconds fetch_timeout,
+      ::espv2::api::envoy::v11::http::common::DependencyErrorBehavior
+          error_behavior,
+      UpdateTokenCallback callback) const override {
+    TokenInfoPtr info = std::make_unique<BrokerTokenInfo>();
+    TokenSubscriberPtr subscriber = std::make_unique<TokenSubscriber>(
+        context_, token_type, token_cluster, token_url, fetch_timeout,
+        error_behavior, callback, std::move(info));
+    subscriber->init();
+    return subscriber;
+  }
+
   TokenSubscriberPtr createIamTokenSubscriber(
       const TokenType& token_type, const std::string& token_cluster,
       const std::string& token_url, std::chrono::seconds fetch_timeout,
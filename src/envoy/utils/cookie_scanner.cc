@@ -0,0 +1,105 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/utils/cookie_scanner.h"
+
+#include "source/common/http/headers.h"
+#include "src/envoy/utils/header_scan_utils.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+
+CookieScanner::CookieScanner(std::vector<std::string> names)
+    : names_(std::move(names)) {
+  for (const std::string& name : names_) {
+    if (name.size() < 64) {
+      name_sizes_ |= uint64_t{1} << name.size();
+    } else {
+      has_long_names_ = true;
+    }
+  }
+}
+
+void CookieScanner::scan(const Envoy::Http::RequestHeaderMap& headers,
+                         absl::Span<absl::string_view> values) const {
+  for (absl::string_view& value : values) {
+    value = absl::string_view();
+  }
+  if (names_.empty()) {
+    return;
+  }
+
+  size_t remaining = names_.size();
+  const auto cookies = headers.get(Envoy::Http::Headers::get().Cookie);
+  for (size_t i = 0; i < cookies.size() && remaining > 0; ++i) {
+    remaining -= scanHeaderValue(cookies[i]->value().getStringView(), values);
+  }
+}
+
+size_t CookieScanner::scanHeaderValue(
+    absl::string_view header_value,
+    absl::Span<absl::string_view> values) const {
+  size_t found = 0;
+  size_t start = 0;
+  while (start < header_value.size()) {
+    // The `=` and `;` of each cookie are found in one scan.
+    const size_t equals = findFirstOf(header_value, ";=", start);
+    if (equals == absl::string_view::npos) {
+      break;
+    }
+    if (header_value[equals] == ';') {
+      // A cookie without `=` is skipped.
+      start = equals + 1;
+      continue;
+    }
+    size_t end = header_value.find(';', equals + 1);
+    if (end == absl::string_view::npos) {
+      end = header_value.size();
+    }
+
+    // Only the leading spaces of the name are removed.
+    size_t name_start = start;
+    while (header_value[name_start] == ' ') {
+      ++name_start;
+    }
+    const absl::string_view name =
+        header_value.substr(name_start, equals - name_start);
+    start = end + 1;
+    if (!mayMatch(name.size())) {
+      continue;
+    }
+
+    for (size_t i = 0; i < names_.size(); ++i) {
+      // A found value points into the header even when it is empty.
+      if (values[i].data() != nullptr || names_[i] != name) {
+        continue;
+      }
+      absl::string_view value =
+          header_value.substr(equals + 1, end - equals - 1);
+      // Cookie values may be wrapped in double quotes.
+      // https://tools.ietf.org/html/rfc6265#section-4.1.1
+      if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+      }
+      values[i] = value;
+      ++found;
+    }
+  }
+  return found;
+}
+
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
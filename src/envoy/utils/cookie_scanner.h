@@ -0,0 +1,66 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "envoy/http/header_map.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+
+// Looks up a fixed set of cookie names in the cookie headers of a request, in
+// one pass over the headers instead of one pass per name.
+//
+// The cookies are matched the way `Envoy::Http::Utility::parseCookieValue`
+// does: the first cookie of a name in the headers wins, and its value is
+// unquoted. The values are views into the headers, so nothing is allocated.
+class CookieScanner {
+ public:
+  CookieScanner() = default;
+  explicit CookieScanner(std::vector<std::string> names);
+
+  size_t size() const { return names_.size(); }
+
+  // Sets `values[i]` to the value of the cookie `names[i]`, or to a default
+  // constructed view if there is none. `values` has `size()` elements.
+  void scan(const Envoy::Http::RequestHeaderMap& headers,
+            absl::Span<absl::string_view> values) const;
+
+  // Same as `scan`, on the value of one cookie header. Only the values that
+  // are still default constructed are set. Returns the number of values set.
+  size_t scanHeaderValue(absl::string_view header_value,
+                         absl::Span<absl::string_view> values) const;
+
+ private:
+  // Returns false if no name has the size of `key`, without comparing it.
+  bool mayMatch(size_t key_size) const {
+    return key_size < 64 ? (name_sizes_ >> key_size) & 1 : has_long_names_;
+  }
+
+  std::vector<std::string> names_;
+  // The bit `n` is set if a name has `n` bytes, for names shorter than 64.
+  uint64_t name_sizes_ = 0;
+  bool has_long_names_ = false;
+};
+
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
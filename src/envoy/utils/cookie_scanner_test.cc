@@ -0,0 +1,94 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/utils/cookie_scanner.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "source/common/http/utility.h"
+#include "test/test_common/utility.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+namespace {
+
+std::vector<absl::string_view> scan(
+    const CookieScanner& scanner,
+    const Envoy::Http::RequestHeaderMap& headers) {
+  std::vector<absl::string_view> values(scanner.size());
+  scanner.scan(headers, absl::MakeSpan(values));
+  return values;
+}
+
+TEST(CookieScannerTest, NoNames) {
+  const CookieScanner scanner;
+  Envoy::Http::TestRequestHeaderMapImpl headers{{"cookie", "a=1"}};
+  EXPECT_TRUE(scan(scanner, headers).empty());
+}
+
+TEST(CookieScannerTest, FindsAllNames) {
+  const CookieScanner scanner({"api_key", "key", "missing"});
+  Envoy::Http::TestRequestHeaderMapImpl headers{
+      {"cookie", "_ga=GA1.1; key=abc"},
+      {"cookie", "  api_key=\"def\"; other=1"}};
+  EXPECT_THAT(scan(scanner, headers),
+              testing::ElementsAre("def", "abc", absl::string_view()));
+}
+
+TEST(CookieScannerTest, FirstCookieWins) {
+  const CookieScanner scanner({"key"});
+  Envoy::Http::TestRequestHeaderMapImpl headers{{"cookie", "key=; key=abc"},
+                                                {"cookie", "key=def"}};
+  const auto values = scan(scanner, headers);
+  EXPECT_EQ(values[0], "");
+  // The empty cookie was found, so the later ones are not used.
+  EXPECT_NE(values[0].data(), nullptr);
+}
+
+TEST(CookieScannerTest, ScanHeaderValue) {
+  const CookieScanner scanner({"a", "bb"});
+  std::vector<absl::string_view> values(scanner.size());
+  EXPECT_EQ(scanner.scanHeaderValue("x; bb=1;a", absl::MakeSpan(values)), 1);
+  EXPECT_EQ(scanner.scanHeaderValue("a=2; bb=3", absl::MakeSpan(values)), 1);
+  EXPECT_THAT(values, testing::ElementsAre("2", "1"));
+}
+
+TEST(CookieScannerTest, MatchesEnvoyParseCookieValue) {
+  const std::vector<std::string> names = {"key", "k", "", "api_key",
+                                          std::string(70, 'n')};
+  const CookieScanner scanner(names);
+  for (const std::string& cookie : std::vector<std::string>{
+           "", ";", "key", "key=", "key=\"\"", "key=\"", "key=\"a\"", " key=a",
+           "key =a", "key=a=b", "=a; k=1", ";;key=1;;", "  =1; key=2",
+           "api_key=1;key=2;k=3", "keys=1; a_key=2; key=3",
+           std::string(70, 'n') + "=1"}) {
+    Envoy::Http::TestRequestHeaderMapImpl headers{
+        {"cookie", cookie}, {"cookie", "key=late; k=2"}};
+    const auto values = scan(scanner, headers);
+    for (size_t i = 0; i < names.size(); ++i) {
+      EXPECT_EQ(values[i],
+                Envoy::Http::Utility::parseCookieValue(headers, names[i]))
+          << "cookie: " << cookie << ", name: " << names[i];
+    }
+  }
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
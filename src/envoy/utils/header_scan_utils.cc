@@ -0,0 +1,156 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/utils/header_scan_utils.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "absl/base/config.h"
+#include "absl/strings/match.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+namespace {
+
+constexpr absl::string_view kInvalidHeaderValueBytes("\0\r\n", 3);
+
+#if defined(__SSE2__)
+
+// Compares 16 bytes at a time with each of the bytes.
+size_t findFirstOfBlocks(const char* data, size_t size, size_t pos,
+                         absl::string_view bytes) {
+  __m128i needles[kMaxScanBytes];
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    needles[i] = _mm_set1_epi8(bytes[i]);
+  }
+
+  for (; pos + sizeof(__m128i) <= size; pos += sizeof(__m128i)) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    __m128i matches = _mm_cmpeq_epi8(block, needles[0]);
+    for (size_t i = 1; i < bytes.size(); ++i) {
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, needles[i]));
+    }
+    const int mask = _mm_movemask_epi8(matches);
+    if (mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+  return pos;
+}
+
+#elif defined(ABSL_IS_LITTLE_ENDIAN)
+
+// Compares 8 bytes at a time with each of the bytes, within a word.
+size_t findFirstOfBlocks(const char* data, size_t size, size_t pos,
+                         absl::string_view bytes) {
+  constexpr uint64_t kOnes = 0x0101010101010101ULL;
+  constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+
+  uint64_t needles[kMaxScanBytes];
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    needles[i] = kOnes * static_cast<uint8_t>(bytes[i]);
+  }
+
+  for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+    uint64_t block;
+    std::memcpy(&block, data + pos, sizeof(block));
+    // The high bit of the lowest matching byte is set. Higher bytes may be
+    // false positives, but only the lowest one is used.
+    uint64_t matches = 0;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      const uint64_t diff = block ^ needles[i];
+      matches |= (diff - kOnes) & ~diff & kHighBits;
+    }
+    if (matches != 0) {
+      return pos + __builtin_ctzll(matches) / 8;
+    }
+  }
+  return pos;
+}
+
+#else
+
+size_t findFirstOfBlocks(const char*, size_t, size_t pos, absl::string_view) {
+  return pos;
+}
+
+#endif
+
+}  // namespace
+
+size_t findFirstOf(absl::string_view value, absl::string_view bytes,
+                   size_t pos) {
+  if (pos >= value.size() || bytes.empty()) {
+    return absl::string_view::npos;
+  }
+  if (bytes.size() == 1) {
+    // memchr is already vectorized.
+    return value.find(bytes[0], pos);
+  }
+  if (bytes.size() > kMaxScanBytes) {
+    return value.find_first_of(bytes, pos);
+  }
+
+  pos = findFirstOfBlocks(value.data(), value.size(), pos, bytes);
+  for (; pos < value.size(); ++pos) {
+    if (bytes.find(value[pos]) != absl::string_view::npos) {
+      return pos;
+    }
+  }
+  return absl::string_view::npos;
+}
+
+bool isValidHeaderValue(absl::string_view value) {
+  return findFirstOf(value, kInvalidHeaderValueBytes) ==
+         absl::string_view::npos;
+}
+
+absl::optional<absl::string_view> findQueryParameter(absl::string_view path,
+                                                     absl::string_view name) {
+  size_t start = path.find('?');
+  // The name of a parameter ends at its first `=`.
+  if (start == absl::string_view::npos ||
+      name.find('=') != absl::string_view::npos) {
+    return absl::nullopt;
+  }
+
+  for (++start; start < path.size();) {
+    size_t end = path.find('&', start);
+    if (end == absl::string_view::npos) {
+      end = path.size();
+    }
+    const absl::string_view param = path.substr(start, end - start);
+    if (absl::StartsWith(param, name)) {
+      if (param.size() == name.size()) {
+        return absl::string_view();
+      }
+      if (param[name.size()] == '=') {
+        return param.substr(name.size() + 1);
+      }
+    }
+    start = end + 1;
+  }
+  return absl::nullopt;
+}
+
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
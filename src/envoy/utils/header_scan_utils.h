@@ -0,0 +1,48 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+
+// The maximum number of bytes `findFirstOf` scans for 16 bytes at a time.
+constexpr size_t kMaxScanBytes = 4;
+
+// Returns the position of the first byte of `value` at or after `pos` that is
+// one of `bytes`, or npos. Same result as `value.find_first_of(bytes, pos)`,
+// but up to kMaxScanBytes bytes are compared a block of bytes at a time.
+size_t findFirstOf(absl::string_view value, absl::string_view bytes,
+                   size_t pos = 0);
+
+// Returns true if `value` can be used as an HTTP header value, i.e. has no
+// NUL, CR or LF. Same result as `Envoy::Http::validHeaderString`.
+bool isValidHeaderValue(absl::string_view value);
+
+// Returns the value of the first query parameter `name` in the query of
+// `path`, without decoding it. A parameter without `=` has an empty value.
+// Same result as a lookup in `Envoy::Http::Utility::parseQueryString`, without
+// parsing the other parameters.
+absl::optional<absl::string_view> findQueryParameter(absl::string_view path,
+                                                     absl::string_view name);
+
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,150 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the header scanning utilities and the cookie scanner with the Envoy
+// and standard library functions they replace, on long cookies and query
+// strings.
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "envoy/http/header_map.h"
+#include "source/common/http/header_map_impl.h"
+#include "source/common/http/utility.h"
+#include "src/envoy/utils/cookie_scanner.h"
+#include "src/envoy/utils/header_scan_utils.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+namespace {
+
+// A cookie header with `count` analytics cookies before the API key.
+std::string longCookie(int count) {
+  std::string cookie;
+  for (int i = 0; i < count; ++i) {
+    absl::StrAppend(&cookie, "_ga_", i, "=GS1.1.1650000000.1.1.1650000000.0; ");
+  }
+  absl::StrAppend(&cookie, "api_key=AIzaSyD-abcdefghijklmnopqrstuvwxyz012345");
+  return cookie;
+}
+
+// A path with `count` query parameters before the API key.
+std::string longQuery(int count) {
+  std::string path = "/v1/shelves/1/books?";
+  for (int i = 0; i < count; ++i) {
+    absl::StrAppend(&path, "filter_", i, "=value_", i, "&");
+  }
+  absl::StrAppend(&path, "key=AIzaSyD-abcdefghijklmnopqrstuvwxyz012345");
+  return path;
+}
+
+void BM_EnvoyValidHeaderString(benchmark::State& state) {
+  const std::string cookie = longCookie(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Envoy::Http::validHeaderString(cookie));
+  }
+  state.SetBytesProcessed(state.iterations() * cookie.size());
+}
+BENCHMARK(BM_EnvoyValidHeaderString)->Arg(4)->Arg(64);
+
+void BM_IsValidHeaderValue(benchmark::State& state) {
+  const std::string cookie = longCookie(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(isValidHeaderValue(cookie));
+  }
+  state.SetBytesProcessed(state.iterations() * cookie.size());
+}
+BENCHMARK(BM_IsValidHeaderValue)->Arg(4)->Arg(64);
+
+// Splits the cookie at each separator, as a cookie parser does.
+void BM_StdFindFirstOf(benchmark::State& state) {
+  const std::string cookie = longCookie(state.range(0));
+  const absl::string_view value = cookie;
+  for (auto _ : state) {
+    for (size_t pos = value.find_first_of(";=");
+         pos != absl::string_view::npos;
+         pos = value.find_first_of(";=", pos + 1)) {
+      benchmark::DoNotOptimize(pos);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * cookie.size());
+}
+BENCHMARK(BM_StdFindFirstOf)->Arg(4)->Arg(64);
+
+void BM_FindFirstOf(benchmark::State& state) {
+  const std::string cookie = longCookie(state.range(0));
+  for (auto _ : state) {
+    for (size_t pos = findFirstOf(cookie, ";=");
+         pos != absl::string_view::npos;
+         pos = findFirstOf(cookie, ";=", pos + 1)) {
+      benchmark::DoNotOptimize(pos);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * cookie.size());
+}
+BENCHMARK(BM_FindFirstOf)->Arg(4)->Arg(64);
+
+// Looks up two cookie names, as for two api-key cookie locations.
+void BM_EnvoyParseCookieValue(benchmark::State& state) {
+  auto headers = Envoy::Http::RequestHeaderMapImpl::create();
+  headers->addCopy(Envoy::Http::LowerCaseString("cookie"),
+                   longCookie(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        Envoy::Http::Utility::parseCookieValue(*headers, "apikey"));
+    benchmark::DoNotOptimize(
+        Envoy::Http::Utility::parseCookieValue(*headers, "api_key"));
+  }
+}
+BENCHMARK(BM_EnvoyParseCookieValue)->Arg(4)->Arg(64);
+
+void BM_CookieScanner(benchmark::State& state) {
+  auto headers = Envoy::Http::RequestHeaderMapImpl::create();
+  headers->addCopy(Envoy::Http::LowerCaseString("cookie"),
+                   longCookie(state.range(0)));
+  const CookieScanner scanner({"apikey", "api_key"});
+  std::vector<absl::string_view> values(scanner.size());
+  for (auto _ : state) {
+    scanner.scan(*headers, absl::MakeSpan(values));
+    benchmark::DoNotOptimize(values.data());
+  }
+}
+BENCHMARK(BM_CookieScanner)->Arg(4)->Arg(64);
+
+void BM_EnvoyParseQueryString(benchmark::State& state) {
+  const std::string path = longQuery(state.range(0));
+  for (auto _ : state) {
+    const auto params = Envoy::Http::Utility::parseQueryString(path);
+    benchmark::DoNotOptimize(params.find("key"));
+  }
+  state.SetBytesProcessed(state.iterations() * path.size());
+}
+BENCHMARK(BM_EnvoyParseQueryString)->Arg(4)->Arg(64);
+
+void BM_FindQueryParameter(benchmark::State& state) {
+  const std::string path = longQuery(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(findQueryParameter(path, "key"));
+  }
+  state.SetBytesProcessed(state.iterations() * path.size());
+}
+BENCHMARK(BM_FindQueryParameter)->Arg(4)->Arg(64);
+
+}  // namespace
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,130 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/utils/header_scan_utils.h"
+
+#include <random>
+#include <string>
+
+#include "envoy/http/header_map.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "source/common/http/utility.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+namespace {
+
+// Bytes of the sets below, and bytes with the high bit set.
+constexpr absl::string_view kAlphabet("ab;=,&\0\r\n\x80\xff", 11);
+
+std::string randomString(std::mt19937& rng, size_t size) {
+  std::uniform_int_distribution<size_t> index(0, kAlphabet.size() - 1);
+  std::string value(size, 'x');
+  for (char& c : value) {
+    // Mostly bytes not in the sets, so the blocks are skipped.
+    if (rng() % 8 == 0) {
+      c = kAlphabet[index(rng)];
+    }
+  }
+  return value;
+}
+
+TEST(HeaderScanUtilsTest, FindFirstOfMatchesStdFindFirstOf) {
+  std::mt19937 rng(1);
+  for (absl::string_view bytes :
+       {absl::string_view(";"), absl::string_view(";="),
+        absl::string_view("\0\r\n", 3), absl::string_view(",;&="),
+        absl::string_view("\x80\xff"), absl::string_view("ab;=,")}) {
+    for (size_t size = 0; size < 80; ++size) {
+      const std::string value = randomString(rng, size);
+      for (size_t pos = 0; pos <= size + 1; ++pos) {
+        EXPECT_EQ(findFirstOf(value, bytes, pos),
+                  absl::string_view(value).find_first_of(bytes, pos))
+            << "value: " << value << ", pos: " << pos;
+      }
+    }
+  }
+}
+
+TEST(HeaderScanUtilsTest, FindFirstOfNoBytes) {
+  EXPECT_EQ(findFirstOf("abc", ""), absl::string_view::npos);
+  EXPECT_EQ(findFirstOf("", ";="), absl::string_view::npos);
+}
+
+TEST(HeaderScanUtilsTest, IsValidHeaderValue) {
+  EXPECT_TRUE(isValidHeaderValue(""));
+  EXPECT_TRUE(isValidHeaderValue("Bearer eyJhbGciOiJSUzI1NiJ9.e30.sig"));
+  EXPECT_TRUE(isValidHeaderValue("\t\x7f\x80\xff"));
+
+  const std::string long_value(100, 'a');
+  for (size_t i = 0; i < long_value.size(); ++i) {
+    for (char c : {'\0', '\r', '\n'}) {
+      std::string value = long_value;
+      value[i] = c;
+      EXPECT_FALSE(isValidHeaderValue(value)) << "position: " << i;
+    }
+  }
+}
+
+TEST(HeaderScanUtilsTest, IsValidHeaderValueMatchesEnvoy) {
+  std::mt19937 rng(2);
+  for (size_t size = 0; size < 200; ++size) {
+    const std::string value = randomString(rng, size);
+    EXPECT_EQ(isValidHeaderValue(value),
+              Envoy::Http::validHeaderString(value))
+        << "value: " << value;
+  }
+}
+
+TEST(HeaderScanUtilsTest, FindQueryParameter) {
+  EXPECT_EQ(findQueryParameter("/path?key=abc", "key"), "abc");
+  EXPECT_EQ(findQueryParameter("/path?a=1&key=abc&b=2", "key"), "abc");
+  EXPECT_EQ(findQueryParameter("/path?key=abc&key=def", "key"), "abc");
+  EXPECT_EQ(findQueryParameter("/path?key=a=b", "key"), "a=b");
+  EXPECT_EQ(findQueryParameter("/path?key", "key"), "");
+  EXPECT_EQ(findQueryParameter("/path?key=&a=1", "key"), "");
+  EXPECT_EQ(findQueryParameter("/path?api_key=abc", "api_key"), "abc");
+
+  EXPECT_EQ(findQueryParameter("/path", "key"), absl::nullopt);
+  EXPECT_EQ(findQueryParameter("/path?", "key"), absl::nullopt);
+  EXPECT_EQ(findQueryParameter("/path?keys=abc", "key"), absl::nullopt);
+  EXPECT_EQ(findQueryParameter("/path?a_key=abc", "key"), absl::nullopt);
+  EXPECT_EQ(findQueryParameter("/path?key=abc", "KEY"), absl::nullopt);
+  EXPECT_EQ(findQueryParameter("/key=abc", "key"), absl::nullopt);
+}
+
+TEST(HeaderScanUtilsTest, FindQueryParameterMatchesEnvoy) {
+  for (absl::string_view path :
+       {"/path", "/path?", "/path?&", "/path?key", "/path?key=",
+        "/path?=abc&key=1", "/path?k=1&key=2&key=3", "/path?key=a=b&k",
+        "/path?a&b&key&c", "/path?key=1?key=2", "/path?&&key=abc&&"}) {
+    const auto params = Envoy::Http::Utility::parseQueryString(path);
+    for (absl::string_view name : {"key", "k", "", "a", "key=a"}) {
+      const auto it = params.find(std::string(name));
+      const auto found = findQueryParameter(path, name);
+      if (it == params.end()) {
+        EXPECT_EQ(found, absl::nullopt) << path << " " << name;
+      } else {
+        EXPECT_EQ(found, it->second) << path << " " << name;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,78 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/utils/log_rate_limiter.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+
+LogRateLimiter::LogRateLimiter(Envoy::TimeSource& time_source, uint32_t burst,
+                               std::chrono::milliseconds refill_interval)
+    : time_source_(time_source),
+      burst_(burst),
+      refill_interval_(refill_interval) {}
+
+bool LogRateLimiter::allow(absl::string_view key, std::string& summary) {
+  summary.clear();
+  const Envoy::MonotonicTime now = time_source_.monotonicTime();
+  auto it = buckets_.find(key);
+  if (it == buckets_.end()) {
+    it = buckets_
+             .emplace(std::string(key),
+                      Bucket{static_cast<double>(burst_), now, 0})
+             .first;
+  }
+  Bucket& bucket = it->second;
+
+  const double elapsed =
+      std::chrono::duration<double>(now - bucket.last_refill).count();
+  bucket.tokens =
+      std::min(static_cast<double>(burst_),
+               bucket.tokens +
+                   elapsed / std::chrono::duration<double>(refill_interval_)
+                                 .count());
+  bucket.last_refill = now;
+
+  if (bucket.tokens < 1) {
+    ++bucket.suppressed;
+    return false;
+  }
+  bucket.tokens -= 1;
+  if (bucket.suppressed > 0) {
+    summary = absl::StrCat(" (", bucket.suppressed,
+                           " similar errors suppressed)");
+    bucket.suppressed = 0;
+  }
+  return true;
+}
+
+void LogRateLimiter::flushSuppressed(
+    const std::function<void(absl::string_view key, uint64_t suppressed)>&
+        report) {
+  for (auto& it : buckets_) {
+    if (it.second.suppressed > 0) {
+      report(it.first, it.second.suppressed);
+      it.second.suppressed = 0;
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
@@ -0,0 +1,78 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "envoy/common/time.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+
+// The default number of logs of a key allowed in a burst.
+constexpr uint32_t kLogRateLimitBurst = 5;
+// The default interval at which one more log of a key is allowed.
+constexpr std::chrono::seconds kLogRateLimitRefillInterval{10};
+// The interval at which the owners report the suppressed logs.
+constexpr std::chrono::seconds kLogRateLimitSummaryInterval{60};
+
+// Rate limits the logs of repeated errors, so an outage does not flood the
+// logs while the proxy is already degraded.
+//
+// Each key, such as a call type and an error class, has a token bucket of
+// `burst` logs, refilled with one log per `refill_interval`. The logs
+// suppressed for a key are counted, and summarized by the next log allowed
+// for it, or by the owner with `flushSuppressed()`.
+//
+// It is not thread-safe and is expected to be owned by a thread.
+class LogRateLimiter {
+ public:
+  explicit LogRateLimiter(
+      Envoy::TimeSource& time_source, uint32_t burst = kLogRateLimitBurst,
+      std::chrono::milliseconds refill_interval = kLogRateLimitRefillInterval);
+
+  // Returns true if a log of the key is allowed. `summary` is set to the
+  // suffix to append to the log, such as " (3 similar errors suppressed)", or
+  // cleared if no log of the key was suppressed since the last one.
+  bool allow(absl::string_view key, std::string& summary);
+
+  // Calls `report` with the number of logs suppressed for each key since its
+  // last allowed log or report, and resets them.
+  void flushSuppressed(
+      const std::function<void(absl::string_view key, uint64_t suppressed)>&
+          report);
+
+ private:
+  struct Bucket {
+    double tokens;
+    Envoy::MonotonicTime last_refill;
+    uint64_t suppressed;
+  };
+
+  Envoy::TimeSource& time_source_;
+  const uint32_t burst_;
+  const std::chrono::milliseconds refill_interval_;
+  // The keys are expected to be a small set, so they are never evicted.
+  absl::flat_hash_map<std::string, Bucket> buckets_;
+};
+
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
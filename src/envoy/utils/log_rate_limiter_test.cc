@@ -0,0 +1,96 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/envoy/utils/log_rate_limiter.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "test/test_common/simulated_time_system.h"
+
+namespace espv2 {
+namespace envoy {
+namespace utils {
+namespace {
+
+class LogRateLimiterTest : public ::testing::Test {
+ protected:
+  LogRateLimiterTest()
+      : limiter_(time_system_, /*burst=*/2, std::chrono::seconds(10)) {}
+
+  Envoy::Event::SimulatedTimeSystem time_system_;
+  LogRateLimiter limiter_;
+  std::string summary_;
+};
+
+TEST_F(LogRateLimiterTest, BurstThenSuppressed) {
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  EXPECT_EQ(summary_, "");
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  EXPECT_FALSE(limiter_.allow("check:14", summary_));
+  EXPECT_FALSE(limiter_.allow("check:14", summary_));
+
+  // The keys are limited separately.
+  EXPECT_TRUE(limiter_.allow("report:14", summary_));
+}
+
+TEST_F(LogRateLimiterTest, RefilledLogSummarizesSuppressed) {
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(limiter_.allow("check:14", summary_));
+  }
+
+  time_system_.advanceTimeWait(std::chrono::seconds(5));
+  EXPECT_FALSE(limiter_.allow("check:14", summary_));
+
+  time_system_.advanceTimeWait(std::chrono::seconds(5));
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  EXPECT_EQ(summary_, " (4 similar errors suppressed)");
+  EXPECT_FALSE(limiter_.allow("check:14", summary_));
+
+  // The bucket is not refilled over the burst.
+  time_system_.advanceTimeWait(std::chrono::seconds(100));
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  EXPECT_EQ(summary_, " (1 similar errors suppressed)");
+  EXPECT_TRUE(limiter_.allow("check:14", summary_));
+  EXPECT_EQ(summary_, "");
+  EXPECT_FALSE(limiter_.allow("check:14", summary_));
+}
+
+TEST_F(LogRateLimiterTest, FlushSuppressed) {
+  for (int i = 0; i < 5; ++i) {
+    limiter_.allow("check:14", summary_);
+  }
+  limiter_.allow("report:14", summary_);
+
+  std::vector<std::pair<std::string, uint64_t>> reported;
+  auto report = [&reported](absl::string_view key, uint64_t suppressed) {
+    reported.emplace_back(std::string(key), suppressed);
+  };
+  limiter_.flushSuppressed(report);
+  ASSERT_EQ(reported.size(), 1);
+  EXPECT_EQ(reported[0].first, "check:14");
+  EXPECT_EQ(reported[0].second, 3);
+
+  // The suppressed logs are reported once.
+  reported.clear();
+  limiter_.flushSuppressed(report);
+  EXPECT_TRUE(reported.empty());
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace envoy
+}  // namespace espv2
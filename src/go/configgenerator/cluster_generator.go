@@ -16,6 +16,8 @@ package configgenerator
 
 import (
 	"fmt"
+	"net"
+	"strconv"
 	"time"
 
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/options"
@@ -51,6 +53,11 @@ func MakeClusters(serviceInfo *sc.ServiceInfo) ([]*clusterpb.Cluster, error) {
 			clusters = append(clusters, tokenAgentCluster)
 		}
 
+		if serviceInfo.Options.TokenBrokerSocket != "" {
+			tokenBrokerCluster := makeTokenBrokerCluster(serviceInfo)
+			clusters = append(clusters, tokenBrokerCluster)
+		}
+
 		// IMDS may be used, even when SA is provided.
 		metadataCluster, err := makeMetadataCluster(serviceInfo)
 		if err != nil {
@@ -69,6 +76,14 @@ func MakeClusters(serviceInfo *sc.ServiceInfo) ([]*clusterpb.Cluster, error) {
 		clusters = append(clusters, iamCluster)
 	}
 
+	peerClusters, err := makeCheckCachePeerClusters(serviceInfo)
+	if err != nil {
+		return nil, err
+	}
+	if peerClusters != nil {
+		clusters = append(clusters, peerClusters...)
+	}
+
 	// Note: makeServiceControlCluster should be called before makeListener
 	// as makeServiceControlFilter is using m.serviceControlURI assigned by
 	// makeServiceControlCluster
@@ -161,6 +176,51 @@ func makeTokenAgentCluster(serviceInfo *sc.ServiceInfo) *clusterpb.Cluster {
 	}
 }
 
+func makeTokenBrokerCluster(serviceInfo *sc.ServiceInfo) *clusterpb.Cluster {
+	return &clusterpb.Cluster{
+		Name:           util.TokenBrokerClusterName,
+		LbPolicy:       clusterpb.Cluster_ROUND_ROBIN,
+		ConnectTimeout: ptypes.DurationProto(serviceInfo.Options.ClusterConnectTimeout),
+		ClusterDiscoveryType: &clusterpb.Cluster_Type{
+			Type: clusterpb.Cluster_STATIC,
+		},
+		LoadAssignment: util.CreateUdsLoadAssignment(serviceInfo.Options.TokenBrokerSocket),
+	}
+}
+
+func makeCheckCachePeerClusters(serviceInfo *sc.ServiceInfo) ([]*clusterpb.Cluster, error) {
+	if serviceInfo.Options.CheckCachePeers == "" {
+		return nil, nil
+	}
+	addresses, err := util.ParseCheckCachePeers(serviceInfo.Options.CheckCachePeers)
+	if err != nil {
+		return nil, err
+	}
+
+	var peerClusters []*clusterpb.Cluster
+	generatedClusters := map[string]bool{}
+	for _, address := range addresses {
+		clusterName := util.CheckCachePeerClusterName(address)
+		if generatedClusters[clusterName] {
+			continue
+		}
+		generatedClusters[clusterName] = true
+
+		hostname, portStr, _ := net.SplitHostPort(address)
+		port, _ := strconv.ParseUint(portStr, 10, 32)
+		peerClusters = append(peerClusters, &clusterpb.Cluster{
+			Name:           clusterName,
+			LbPolicy:       clusterpb.Cluster_ROUND_ROBIN,
+			ConnectTimeout: ptypes.DurationProto(serviceInfo.Options.ClusterConnectTimeout),
+			ClusterDiscoveryType: &clusterpb.Cluster_Type{
+				Type: clusterpb.Cluster_STRICT_DNS,
+			},
+			LoadAssignment: util.CreateLoadAssignment(hostname, uint32(port)),
+		})
+	}
+	return peerClusters, nil
+}
+
 func makeIamCluster(serviceInfo *sc.ServiceInfo) (*clusterpb.Cluster, error) {
 	if serviceInfo.Options.ServiceControlCredentials == nil && serviceInfo.Options.BackendAuthCredentials == nil {
 		return nil, nil
@@ -977,3 +977,79 @@ func TestMakeTokenAgentCluster(t *testing.T) {
 		t.Errorf("Test makeTokenAgentClusters, \ngot: %v,\nwant: %v", cluster, wantCluster)
 	}
 }
+
+func TestMakeTokenBrokerCluster(t *testing.T) {
+	opts := options.DefaultConfigGeneratorOptions()
+	opts.TokenBrokerSocket = "/var/run/espv2/token-broker.sock"
+	fakeServiceInfo, _ := configinfo.NewServiceInfoFromServiceConfig(&confpb.Service{
+		Apis: []*apipb.Api{
+			{
+				Name: testApiName,
+			},
+		},
+	}, testConfigID, opts)
+
+	cluster := makeTokenBrokerCluster(fakeServiceInfo)
+	wantCluster := &clusterpb.Cluster{
+		Name:           util.TokenBrokerClusterName,
+		LbPolicy:       clusterpb.Cluster_ROUND_ROBIN,
+		ConnectTimeout: ptypes.DurationProto(fakeServiceInfo.Options.ClusterConnectTimeout),
+		ClusterDiscoveryType: &clusterpb.Cluster_Type{
+			Type: clusterpb.Cluster_STATIC,
+		},
+		LoadAssignment: util.CreateUdsLoadAssignment("/var/run/espv2/token-broker.sock"),
+	}
+
+	if !proto.Equal(cluster, wantCluster) {
+		t.Errorf("Test makeTokenBrokerCluster, \ngot: %v,\nwant: %v", cluster, wantCluster)
+	}
+
+	wantAccessToken := "http://token-broker/v1/access_token"
+	if got := fakeServiceInfo.AccessToken.GetRemoteToken().GetUri(); got != wantAccessToken {
+		t.Errorf("Test makeTokenBrokerCluster, access token uri\ngot: %v,\nwant: %v", got, wantAccessToken)
+	}
+}
+
+func TestMakeCheckCachePeerClusters(t *testing.T) {
+	opts := options.DefaultConfigGeneratorOptions()
+	opts.CheckCachePeers = "10.0.0.1:8792,esp-1.esp:8792,10.0.0.1:8792"
+	fakeServiceInfo, _ := configinfo.NewServiceInfoFromServiceConfig(&confpb.Service{
+		Apis: []*apipb.Api{
+			{
+				Name: testApiName,
+			},
+		},
+	}, testConfigID, opts)
+
+	clusters, err := makeCheckCachePeerClusters(fakeServiceInfo)
+	if err != nil {
+		t.Fatalf("Test makeCheckCachePeerClusters, got error: %v", err)
+	}
+	makeWantCluster := func(hostname string) *clusterpb.Cluster {
+		return &clusterpb.Cluster{
+			Name:           util.CheckCachePeerClusterName(hostname + ":8792"),
+			LbPolicy:       clusterpb.Cluster_ROUND_ROBIN,
+			ConnectTimeout: ptypes.DurationProto(fakeServiceInfo.Options.ClusterConnectTimeout),
+			ClusterDiscoveryType: &clusterpb.Cluster_Type{
+				Type: clusterpb.Cluster_STRICT_DNS,
+			},
+			LoadAssignment: util.CreateLoadAssignment(hostname, 8792),
+		}
+	}
+	// The duplicated peer has one cluster.
+	wantClusters := []*clusterpb.Cluster{makeWantCluster("10.0.0.1"), makeWantCluster("esp-1.esp")}
+	if len(clusters) != len(wantClusters) {
+		t.Fatalf("Test makeCheckCachePeerClusters, got %d clusters, want %d", len(clusters), len(wantClusters))
+	}
+	for i := range clusters {
+		if !proto.Equal(clusters[i], wantClusters[i]) {
+			t.Errorf("Test makeCheckCachePeerClusters, \ngot: %v,\nwant: %v", clusters[i], wantClusters[i])
+		}
+	}
+
+	opts.CheckCachePeers = "10.0.0.1"
+	fakeServiceInfo.Options = opts
+	if _, err := makeCheckCachePeerClusters(fakeServiceInfo); err == nil {
+		t.Errorf("Test makeCheckCachePeerClusters with an invalid peer, got no error")
+	}
+}
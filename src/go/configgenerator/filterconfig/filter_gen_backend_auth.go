@@ -85,6 +85,14 @@ var baFilterGenFunc = func(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, []*c
 				ServiceAccountEmail: serviceInfo.Options.BackendAuthCredentials.ServiceAccountEmail,
 				Delegates:           serviceInfo.Options.BackendAuthCredentials.Delegates,
 			}}
+	} else if serviceInfo.Options.TokenBrokerSocket != "" {
+		backendAuthConfig.IdTokenInfo = &bapb.FilterConfig_TokenBroker{
+			TokenBroker: &commonpb.HttpUri{
+				Uri:     fmt.Sprintf("%s%s", util.TokenBrokerURL, util.TokenBrokerIdentityTokenPath),
+				Cluster: util.TokenBrokerClusterName,
+				Timeout: ptypes.DurationProto(serviceInfo.Options.HttpRequestTimeout),
+			},
+		}
 	} else {
 		backendAuthConfig.IdTokenInfo = &bapb.FilterConfig_ImdsToken{
 			ImdsToken: &commonpb.HttpUri{
@@ -33,6 +33,7 @@ func TestBackendAuthFilter(t *testing.T) {
 	testdata := []struct {
 		desc                  string
 		iamServiceAccount     string
+		tokenBrokerSocket     string
 		fakeServiceConfig     *confpb.Service
 		delegates             []string
 		depErrorBehavior      string
@@ -224,6 +225,51 @@ func TestBackendAuthFilter(t *testing.T) {
       "jwtAudienceList":["bar.com"]
    }
 }
+`,
+		},
+		{
+			desc:              "Success, set tokenBroker when token broker socket is set",
+			tokenBrokerSocket: "/var/run/espv2/token-broker.sock",
+			depErrorBehavior:  commonpb.DependencyErrorBehavior_ALWAYS_INIT.String(),
+			fakeServiceConfig: &confpb.Service{
+				Name: testProjectName,
+				Apis: []*apipb.Api{
+					{
+						Name: "testapipb",
+						Methods: []*apipb.Method{
+							{
+								Name: "bar",
+							},
+						},
+					},
+				},
+				Backend: &confpb.Backend{
+					Rules: []*confpb.BackendRule{
+						{
+							Selector:        "testapipb.bar",
+							Address:         "https://testapipb.com/foo",
+							PathTranslation: confpb.BackendRule_CONSTANT_ADDRESS,
+							Authentication: &confpb.BackendRule_JwtAudience{
+								JwtAudience: "bar.com",
+							},
+						},
+					},
+				},
+			},
+			wantBackendAuthFilter: `
+{
+   "name":"com.google.espv2.filters.http.backend_auth",
+   "typedConfig":{
+      "@type":"type.googleapis.com/espv2.api.envoy.v11.http.backend_auth.FilterConfig",
+      "depErrorBehavior":"ALWAYS_INIT",
+      "tokenBroker":{
+          "cluster":"token-broker-cluster",
+          "timeout":"30s",
+          "uri":"http://token-broker/v1/identity_token"
+      },
+      "jwtAudienceList":["bar.com"]
+   }
+}
 `,
 		},
 		{
@@ -263,6 +309,7 @@ func TestBackendAuthFilter(t *testing.T) {
 			opts := options.DefaultConfigGeneratorOptions()
 			opts.BackendAddress = "grpc://127.0.0.1:80"
 			opts.DependencyErrorBehavior = tc.depErrorBehavior
+			opts.TokenBrokerSocket = tc.tokenBrokerSocket
 			if tc.iamServiceAccount != "" {
 				opts.BackendAuthCredentials = &options.IAMCredentialsOptions{
 					ServiceAccountEmail: tc.iamServiceAccount,
@@ -16,9 +16,13 @@ package filterconfig
 
 import (
 	"fmt"
+	"math"
+	"strings"
 
 	ci "github.com/GoogleCloudPlatform/esp-v2/src/go/configinfo"
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/options"
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util/httppattern"
 	corepb "github.com/envoyproxy/go-control-plane/envoy/config/core/v3"
 	brpb "github.com/envoyproxy/go-control-plane/envoy/extensions/compression/brotli/compressor/v3"
 	gzippb "github.com/envoyproxy/go-control-plane/envoy/extensions/compression/gzip/compressor/v3"
@@ -26,6 +30,8 @@ import (
 	hcmpb "github.com/envoyproxy/go-control-plane/envoy/extensions/filters/network/http_connection_manager/v3"
 	"github.com/golang/protobuf/proto"
 	"github.com/golang/protobuf/ptypes"
+	anypb "github.com/golang/protobuf/ptypes/any"
+	wrapperspb "github.com/golang/protobuf/ptypes/wrappers"
 )
 
 type compressorType int
@@ -45,7 +51,97 @@ func getCompressorConfig(c compressorType) (proto.Message, string, error) {
 	return nil, "", fmt.Errorf("unknown compressor type: %v", c)
 }
 
-func createComprssorFilter(c compressorType) (*hcmpb.HttpFilter, []*ci.MethodInfo, error) {
+// compressionPolicy is the response compression policy of an operation.
+type compressionPolicy int
+
+const (
+	// Compress with any of the enabled compressors.
+	compressionDefault compressionPolicy = iota
+	// Do not compress.
+	compressionOff
+	// Only compress with gzip.
+	compressionGzipOnly
+	// Only compress with brotli.
+	compressionBrotliOnly
+)
+
+var compressionPolicyNames = map[string]compressionPolicy{
+	"off":  compressionOff,
+	"gzip": compressionGzipOnly,
+	"br":   compressionBrotliOnly,
+}
+
+// parseCompressionOperations parses the per-operation policies of
+// --response_compression_operations, e.g. "pkg.Svc.Get=off;pkg.Svc.List=br".
+func parseCompressionOperations(sc *ci.ServiceInfo) (map[string]compressionPolicy, error) {
+	policies := make(map[string]compressionPolicy)
+	for _, entry := range strings.Split(sc.Options.ResponseCompressionOperations, ";") {
+		entry = strings.TrimSpace(entry)
+		if entry == "" {
+			continue
+		}
+		kv := strings.SplitN(entry, "=", 2)
+		if len(kv) != 2 {
+			return nil, fmt.Errorf("invalid response compression operation policy %q, expected selector=policy", entry)
+		}
+		selector, name := strings.TrimSpace(kv[0]), strings.TrimSpace(kv[1])
+		policy, ok := compressionPolicyNames[name]
+		if !ok {
+			return nil, fmt.Errorf("unknown response compression policy %q for operation %q, accepted values are: off, gzip, br", name, selector)
+		}
+		if _, ok := sc.Methods[selector]; !ok {
+			return nil, fmt.Errorf("response compression policy for operation %q which is not in the service config", selector)
+		}
+		if _, ok := policies[selector]; ok {
+			return nil, fmt.Errorf("duplicated response compression policy for operation %q", selector)
+		}
+		policies[selector] = policy
+	}
+	return policies, nil
+}
+
+// compressorDisabled returns whether the compressor should be disabled for
+// the responses of the method.
+func compressorDisabled(method *ci.MethodInfo, policy compressionPolicy, c compressorType) bool {
+	// Compressing a stream makes the compressor buffer the messages, which
+	// delays them, and most gRPC clients do not accept a compressed stream.
+	if method.IsStreaming {
+		return true
+	}
+	switch policy {
+	case compressionOff:
+		return true
+	case compressionGzipOnly:
+		return c != gzipCompressor
+	case compressionBrotliOnly:
+		return c != brotliCompressor
+	}
+	return false
+}
+
+func makeCompressorCommonConfig(opts *options.ConfigGeneratorOptions) (*comppb.Compressor_CommonDirectionConfig, error) {
+	if opts.ResponseCompressionMinSize == 0 && opts.ResponseCompressionContentTypes == "" {
+		return nil, nil
+	}
+	if opts.ResponseCompressionMinSize > math.MaxUint32 {
+		return nil, fmt.Errorf("response compression min size %d is too large", opts.ResponseCompressionMinSize)
+	}
+
+	cfg := &comppb.Compressor_CommonDirectionConfig{}
+	if opts.ResponseCompressionMinSize != 0 {
+		cfg.MinContentLength = &wrapperspb.UInt32Value{
+			Value: uint32(opts.ResponseCompressionMinSize),
+		}
+	}
+	for _, contentType := range strings.Split(opts.ResponseCompressionContentTypes, ",") {
+		if contentType = strings.TrimSpace(contentType); contentType != "" {
+			cfg.ContentType = append(cfg.ContentType, contentType)
+		}
+	}
+	return cfg, nil
+}
+
+func createCompressorFilter(sc *ci.ServiceInfo, c compressorType) (*hcmpb.HttpFilter, []*ci.MethodInfo, error) {
 	cfg, name, err := getCompressorConfig(c)
 	if err != nil {
 		return nil, nil, err
@@ -60,21 +156,61 @@ func createComprssorFilter(c compressorType) (*hcmpb.HttpFilter, []*ci.MethodInf
 			TypedConfig: ca,
 		},
 	}
+
+	commonConfig, err := makeCompressorCommonConfig(&sc.Options)
+	if err != nil {
+		return nil, nil, err
+	}
+	if commonConfig != nil {
+		cmp.ResponseDirectionConfig = &comppb.Compressor_ResponseDirectionConfig{
+			CommonConfig: commonConfig,
+		}
+	}
+
+	policies, err := parseCompressionOperations(sc)
+	if err != nil {
+		return nil, nil, err
+	}
+	var perRouteConfigRequiredMethods []*ci.MethodInfo
+	for _, operation := range sc.Operations {
+		method := sc.Methods[operation]
+		if compressorDisabled(method, policies[operation], c) {
+			perRouteConfigRequiredMethods = append(perRouteConfigRequiredMethods, method)
+		}
+	}
+
 	a, err := ptypes.MarshalAny(cmp)
 	if err != nil {
 		return nil, nil, fmt.Errorf("error marshaling Compressor filter config to Any: %v", err)
 	}
+	filterName := util.EnvoyGzipCompressorFilter
+	if c == brotliCompressor {
+		filterName = util.EnvoyBrotliCompressorFilter
+	}
 	return &hcmpb.HttpFilter{
-		Name:       util.EnvoyCompressorFilter,
+		Name:       filterName,
 		ConfigType: &hcmpb.HttpFilter_TypedConfig{a},
-	}, nil, nil
+	}, perRouteConfigRequiredMethods, nil
+}
 
+// compressorPerRouteFilterConfigGen disables the compressor on the routes of
+// the methods returned by createCompressorFilter.
+var compressorPerRouteFilterConfigGen = func(method *ci.MethodInfo, httpRule *httppattern.Pattern) (*anypb.Any, error) {
+	a, err := ptypes.MarshalAny(&comppb.CompressorPerRoute{
+		Override: &comppb.CompressorPerRoute_Disabled{
+			Disabled: true,
+		},
+	})
+	if err != nil {
+		return nil, fmt.Errorf("error marshaling Compressor per-route config to Any: %v", err)
+	}
+	return a, nil
 }
 
 var gzipCompressorGenFunc = func(sc *ci.ServiceInfo) (*hcmpb.HttpFilter, []*ci.MethodInfo, error) {
-	return createComprssorFilter(gzipCompressor)
+	return createCompressorFilter(sc, gzipCompressor)
 }
 
 var brotliCompressorGenFunc = func(sc *ci.ServiceInfo) (*hcmpb.HttpFilter, []*ci.MethodInfo, error) {
-	return createComprssorFilter(brotliCompressor)
+	return createCompressorFilter(sc, brotliCompressor)
 }
@@ -0,0 +1,266 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package filterconfig
+
+import (
+	"reflect"
+	"sort"
+	"strings"
+	"testing"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/configinfo"
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/options"
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"github.com/golang/protobuf/jsonpb"
+
+	confpb "google.golang.org/genproto/googleapis/api/serviceconfig"
+	apipb "google.golang.org/genproto/protobuf/api"
+)
+
+func TestCompressorFilter(t *testing.T) {
+	fakeServiceConfig := &confpb.Service{
+		Name: testProjectName,
+		Apis: []*apipb.Api{
+			{
+				Name: "testapi",
+				Methods: []*apipb.Method{
+					{
+						Name: "Get",
+					},
+					{
+						Name: "List",
+					},
+					{
+						Name:              "Watch",
+						ResponseStreaming: true,
+					},
+				},
+			},
+		},
+	}
+
+	testdata := []struct {
+		desc             string
+		minSize          uint
+		contentTypes     string
+		operations       string
+		wantGzipFilter   string
+		wantBrotliFilter string
+		wantGzipOff      []string
+		wantBrotliOff    []string
+		wantError        string
+	}{
+		{
+			desc: "Default config, streaming methods are not compressed",
+			wantGzipFilter: `
+{
+  "name": "envoy.filters.http.compressor.gzip",
+  "typedConfig": {
+    "@type": "type.googleapis.com/envoy.extensions.filters.http.compressor.v3.Compressor",
+    "compressorLibrary": {
+      "name": "envoy.compression.gzip.compressor",
+      "typedConfig": {
+        "@type": "type.googleapis.com/envoy.extensions.compression.gzip.compressor.v3.Gzip"
+      }
+    }
+  }
+}`,
+			wantBrotliFilter: `
+{
+  "name": "envoy.filters.http.compressor.brotli",
+  "typedConfig": {
+    "@type": "type.googleapis.com/envoy.extensions.filters.http.compressor.v3.Compressor",
+    "compressorLibrary": {
+      "name": "envoy.compression.brotli.compressor",
+      "typedConfig": {
+        "@type": "type.googleapis.com/envoy.extensions.compression.brotli.compressor.v3.Brotli"
+      }
+    }
+  }
+}`,
+			wantGzipOff:   []string{"testapi.Watch"},
+			wantBrotliOff: []string{"testapi.Watch"},
+		},
+		{
+			desc:         "Min size and content types",
+			minSize:      1024,
+			contentTypes: "application/json, text/html",
+			wantGzipFilter: `
+{
+  "name": "envoy.filters.http.compressor.gzip",
+  "typedConfig": {
+    "@type": "type.googleapis.com/envoy.extensions.filters.http.compressor.v3.Compressor",
+    "compressorLibrary": {
+      "name": "envoy.compression.gzip.compressor",
+      "typedConfig": {
+        "@type": "type.googleapis.com/envoy.extensions.compression.gzip.compressor.v3.Gzip"
+      }
+    },
+    "responseDirectionConfig": {
+      "commonConfig": {
+        "contentType": ["application/json", "text/html"],
+        "minContentLength": 1024
+      }
+    }
+  }
+}`,
+			wantBrotliFilter: `
+{
+  "name": "envoy.filters.http.compressor.brotli",
+  "typedConfig": {
+    "@type": "type.googleapis.com/envoy.extensions.filters.http.compressor.v3.Compressor",
+    "compressorLibrary": {
+      "name": "envoy.compression.brotli.compressor",
+      "typedConfig": {
+        "@type": "type.googleapis.com/envoy.extensions.compression.brotli.compressor.v3.Brotli"
+      }
+    },
+    "responseDirectionConfig": {
+      "commonConfig": {
+        "contentType": ["application/json", "text/html"],
+        "minContentLength": 1024
+      }
+    }
+  }
+}`,
+			wantGzipOff:   []string{"testapi.Watch"},
+			wantBrotliOff: []string{"testapi.Watch"},
+		},
+		{
+			desc:          "Per-operation policies",
+			operations:    "testapi.Get=off; testapi.List=br;",
+			wantGzipOff:   []string{"testapi.Get", "testapi.List", "testapi.Watch"},
+			wantBrotliOff: []string{"testapi.Get", "testapi.Watch"},
+		},
+		{
+			desc:          "Gzip only policy",
+			operations:    "testapi.List=gzip",
+			wantGzipOff:   []string{"testapi.Watch"},
+			wantBrotliOff: []string{"testapi.List", "testapi.Watch"},
+		},
+		{
+			desc:       "Fail with an unknown policy",
+			operations: "testapi.Get=zstd",
+			wantError:  `unknown response compression policy "zstd" for operation "testapi.Get"`,
+		},
+		{
+			desc:       "Fail with an unknown operation",
+			operations: "testapi.Delete=off",
+			wantError:  `response compression policy for operation "testapi.Delete" which is not in the service config`,
+		},
+		{
+			desc:       "Fail with a policy without selector",
+			operations: "off",
+			wantError:  `invalid response compression operation policy "off"`,
+		},
+		{
+			desc:       "Fail with a duplicated operation",
+			operations: "testapi.Get=off;testapi.Get=br",
+			wantError:  `duplicated response compression policy for operation "testapi.Get"`,
+		},
+	}
+
+	for _, tc := range testdata {
+		t.Run(tc.desc, func(t *testing.T) {
+			opts := options.DefaultConfigGeneratorOptions()
+			opts.BackendAddress = "grpc://127.0.0.1:80"
+			opts.EnableResponseCompression = true
+			opts.ResponseCompressionMinSize = tc.minSize
+			opts.ResponseCompressionContentTypes = tc.contentTypes
+			opts.ResponseCompressionOperations = tc.operations
+
+			fakeServiceInfo, err := configinfo.NewServiceInfoFromServiceConfig(fakeServiceConfig, testConfigID, opts)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			for _, c := range []struct {
+				genFunc    FilterGenFunc
+				wantFilter string
+				wantOff    []string
+			}{
+				{
+					genFunc:    gzipCompressorGenFunc,
+					wantFilter: tc.wantGzipFilter,
+					wantOff:    tc.wantGzipOff,
+				},
+				{
+					genFunc:    brotliCompressorGenFunc,
+					wantFilter: tc.wantBrotliFilter,
+					wantOff:    tc.wantBrotliOff,
+				},
+			} {
+				filterConfig, methods, err := c.genFunc(fakeServiceInfo)
+				if err != nil {
+					if tc.wantError == "" || !strings.Contains(err.Error(), tc.wantError) {
+						t.Fatalf("exepected err (%v), got err (%v)", tc.wantError, err)
+					}
+					continue
+				}
+				if tc.wantError != "" {
+					t.Fatalf("exepected err (%v), got no err", tc.wantError)
+				}
+
+				if c.wantFilter != "" {
+					marshaler := &jsonpb.Marshaler{}
+					gotFilter, err := marshaler.MarshalToString(filterConfig)
+					if err != nil {
+						t.Fatal(err)
+					}
+					if err := util.JsonEqual(c.wantFilter, gotFilter); err != nil {
+						t.Errorf("createCompressorFilter failed,\n %v", err)
+					}
+				}
+
+				if got := selectors(fakeServiceInfo, methods); !reflect.DeepEqual(got, c.wantOff) {
+					t.Errorf("createCompressorFilter per-route methods, want: %v, got: %v", c.wantOff, got)
+				}
+			}
+		})
+	}
+}
+
+func TestCompressorPerRouteFilterConfig(t *testing.T) {
+	a, err := compressorPerRouteFilterConfigGen(&configinfo.MethodInfo{}, nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	gotConfig, err := (&jsonpb.Marshaler{}).MarshalToString(a)
+	if err != nil {
+		t.Fatal(err)
+	}
+	wantConfig := `
+{
+  "@type": "type.googleapis.com/envoy.extensions.filters.http.compressor.v3.CompressorPerRoute",
+  "disabled": true
+}`
+	if err := util.JsonEqual(wantConfig, gotConfig); err != nil {
+		t.Errorf("compressorPerRouteFilterConfigGen failed,\n %v", err)
+	}
+}
+
+// selectors returns the sorted selectors of the methods.
+func selectors(sc *configinfo.ServiceInfo, methods []*configinfo.MethodInfo) []string {
+	var got []string
+	for selector, method := range sc.Methods {
+		for _, m := range methods {
+			if m == method {
+				got = append(got, selector)
+			}
+		}
+	}
+	sort.Strings(got)
+	return got
+}
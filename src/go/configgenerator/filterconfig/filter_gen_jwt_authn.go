@@ -107,6 +107,17 @@ var jaFilterGenFunc = func(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, []*c
 			Forward:                 true,
 			PadForwardPayloadHeader: serviceInfo.Options.JwtPadForwardPayloadHeader,
 		}
+		// The JWKS fetched by the config manager is served from the config, and
+		// replaced with a new snapshot when it is refreshed.
+		if localJwks, ok := serviceInfo.LocalJwks[provider.GetJwksUri()]; ok {
+			jp.JwksSourceSpecifier = &jwtpb.JwtProvider_LocalJwks{
+				LocalJwks: &corepb.DataSource{
+					Specifier: &corepb.DataSource_InlineString{
+						InlineString: localJwks,
+					},
+				},
+			}
+		}
 
 		if len(provider.GetAudiences()) != 0 {
 			for _, a := range strings.Split(provider.GetAudiences(), ",") {
@@ -34,6 +34,7 @@ func TestJwtAuthnFilter(t *testing.T) {
 		disableJwksAsyncFetch      bool
 		jwksAsyncFetchFastListener bool
 		jwtCacheSize               uint
+		localJwks                  map[string]string
 		wantJwtAuthnFilter         string
 	}{
 		{
@@ -388,6 +389,101 @@ func TestJwtAuthnFilter(t *testing.T) {
             }
         }
     }
+}`,
+		},
+		{
+			desc: "Success. Generate jwt authn filter with the local jwks fetched by the config manager",
+			fakeServiceConfig: &confpb.Service{
+				Name: testProjectName,
+				Apis: []*apipb.Api{
+					{
+						Name: "testapi",
+						Methods: []*apipb.Method{
+							{
+								Name: "foo",
+							},
+						},
+					},
+				},
+				Authentication: &confpb.Authentication{
+					Providers: []*confpb.AuthProvider{
+						{
+							Id:      "auth_provider",
+							Issuer:  "issuer-0",
+							JwksUri: "https://fake-jwks.com",
+						},
+						{
+							Id:      "other_provider",
+							Issuer:  "issuer-1",
+							JwksUri: "https://other-jwks.com",
+						},
+					},
+				},
+			},
+			localJwks: map[string]string{
+				"https://fake-jwks.com": `{"keys":[]}`,
+			},
+			wantJwtAuthnFilter: `{
+    "name": "envoy.filters.http.jwt_authn",
+    "typedConfig": {
+        "@type": "type.googleapis.com/envoy.extensions.filters.http.jwt_authn.v3.JwtAuthentication",
+        "providers": {
+            "auth_provider": {
+                "audiences": [
+                    "https://bookstore.endpoints.project123.cloud.goog"
+                ],
+                "forward": true,
+                "forwardPayloadHeader": "X-Endpoint-API-UserInfo",
+                "fromHeaders": [
+                    {
+                        "name": "Authorization",
+                        "valuePrefix": "Bearer "
+                    },
+                    {
+                        "name": "X-Goog-Iap-Jwt-Assertion"
+                    }
+                ],
+                "fromParams": [
+                    "access_token"
+                ],
+                "issuer": "issuer-0",
+                "payloadInMetadata": "jwt_payloads",
+                "localJwks": {
+                    "inlineString": "{\"keys\":[]}"
+                }
+            },
+            "other_provider": {
+                "audiences": [
+                    "https://bookstore.endpoints.project123.cloud.goog"
+                ],
+                "forward": true,
+                "forwardPayloadHeader": "X-Endpoint-API-UserInfo",
+                "fromHeaders": [
+                    {
+                        "name": "Authorization",
+                        "valuePrefix": "Bearer "
+                    },
+                    {
+                        "name": "X-Goog-Iap-Jwt-Assertion"
+                    }
+                ],
+                "fromParams": [
+                    "access_token"
+                ],
+                "issuer": "issuer-1",
+                "payloadInMetadata": "jwt_payloads",
+                "remoteJwks": {
+                    "cacheDuration": "300s",
+                    "httpUri": {
+                        "cluster": "jwt-provider-cluster-other-jwks.com:443",
+                        "timeout": "30s",
+                        "uri": "https://other-jwks.com"
+                    },
+                    "asyncFetch": {}
+                }
+            }
+        }
+    }
 }`,
 		},
 	}
@@ -402,6 +498,7 @@ func TestJwtAuthnFilter(t *testing.T) {
 		if err != nil {
 			t.Fatal(err)
 		}
+		fakeServiceInfo.LocalJwks = tc.localJwks
 
 		marshaler := &jsonpb.Marshaler{}
 		gotProto, _, _ := jaFilterGenFunc(fakeServiceInfo)
@@ -15,8 +15,13 @@
 package filterconfig
 
 import (
+	"crypto/sha256"
+	"encoding/hex"
 	"fmt"
+	"math"
+	"strconv"
 	"strings"
+	"time"
 
 	ci "github.com/GoogleCloudPlatform/esp-v2/src/go/configinfo"
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/options"
@@ -31,6 +36,9 @@ import (
 	confpb "google.golang.org/genproto/googleapis/api/serviceconfig"
 )
 
+// The minimum ttl of the pinned check responses.
+const pinnedCheckMinTtl = 20 * time.Second
+
 var scPerRouteFilterConfigGen = func(method *ci.MethodInfo, httpRule *httppattern.Pattern) (*anypb.Any, error) {
 	scPerRoute := &scpb.PerRouteFilterConfig{
 		OperationName: method.Operation(),
@@ -133,6 +141,11 @@ var scFilterGenFunc = func(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, []*c
 		filterConfig.GcpAttributes.Platform = serviceInfo.Options.ComputePlatformOverride
 	}
 
+	trustedJwtCallers, err := parseTrustedJwtCallers(serviceInfo)
+	if err != nil {
+		return nil, nil, err
+	}
+
 	var perRouteConfigRequiredMethods []*ci.MethodInfo
 	for _, operation := range serviceInfo.Operations {
 		method := serviceInfo.Methods[operation]
@@ -143,6 +156,7 @@ var scFilterGenFunc = func(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, []*c
 			ApiVersion:         method.ApiVersion,
 			SkipServiceControl: method.SkipServiceControl,
 			MetricCosts:        method.MetricCosts,
+			TrustedJwtCallers:  trustedJwtCallers[operation],
 		}
 
 		// For these OPTIONS methods, auth should be disabled and AllowWithoutApiKey
@@ -164,6 +178,36 @@ var scFilterGenFunc = func(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, []*c
 		filterConfig.Requirements = append(filterConfig.Requirements, requirement)
 	}
 
+	filterConfig.HotRestartHandoffDir = serviceInfo.Options.HotRestartHandoffDir
+	if serviceInfo.Options.HotRestartTakeOverWindow > 0 {
+		if serviceInfo.Options.HotRestartTakeOverWindow < time.Second {
+			return nil, nil, fmt.Errorf("invalid hot restart take over window %v, it must be at least 1s", serviceInfo.Options.HotRestartTakeOverWindow)
+		}
+		filterConfig.HotRestartTakeOverWindow = ptypes.DurationProto(serviceInfo.Options.HotRestartTakeOverWindow)
+	}
+	filterConfig.LearnApiKeyRestrictions = serviceInfo.Options.LearnApiKeyRestrictions
+	if serviceInfo.Options.CheckCachePeers != "" {
+		peerCheckCache, err := makePeerCheckCacheConfig(serviceInfo.Options)
+		if err != nil {
+			return nil, nil, err
+		}
+		filterConfig.PeerCheckCache = peerCheckCache
+	}
+	if serviceInfo.Options.PinnedCheckApiKeySha256 != "" || serviceInfo.Options.PinnedCheckConsumerNumbers != "" {
+		pinnedCheckCache, err := makePinnedCheckCacheConfig(serviceInfo.Options)
+		if err != nil {
+			return nil, nil, err
+		}
+		filterConfig.PinnedCheckCache = pinnedCheckCache
+	}
+	if serviceInfo.Options.DeniedReportRollupThreshold > 0 || serviceInfo.Options.DeniedReportRollupInterval > 0 {
+		deniedReportRollup, err := makeDeniedReportRollupConfig(serviceInfo.Options)
+		if err != nil {
+			return nil, nil, err
+		}
+		filterConfig.DeniedReportRollup = deniedReportRollup
+	}
+
 	depErrorBehaviorEnum, err := parseDepErrorBehavior(serviceInfo.Options.DependencyErrorBehavior)
 	if err != nil {
 		return nil, nil, err
@@ -181,6 +225,127 @@ var scFilterGenFunc = func(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, []*c
 	return filter, perRouteConfigRequiredMethods, nil
 }
 
+// parseTrustedJwtCallers parses the trusted JWT callers of the operations,
+// whose requests skip the check call, from the semicolon separated
+// `selector=issuer,audience[,audience...]` entries.
+func parseTrustedJwtCallers(serviceInfo *ci.ServiceInfo) (map[string][]*scpb.TrustedJwtCaller, error) {
+	callers := make(map[string][]*scpb.TrustedJwtCaller)
+	for _, entry := range strings.Split(serviceInfo.Options.TrustedJwtCallers, ";") {
+		entry = strings.TrimSpace(entry)
+		if entry == "" {
+			continue
+		}
+		kv := strings.SplitN(entry, "=", 2)
+		if len(kv) != 2 {
+			return nil, fmt.Errorf("invalid trusted JWT caller %q, expected selector=issuer,audience", entry)
+		}
+		selector := strings.TrimSpace(kv[0])
+		var values []string
+		for _, v := range strings.Split(kv[1], ",") {
+			if v = strings.TrimSpace(v); v != "" {
+				values = append(values, v)
+			}
+		}
+		if len(values) < 2 {
+			return nil, fmt.Errorf("invalid trusted JWT caller %q for operation %q, expected an issuer and at least one audience", kv[1], selector)
+		}
+		method, ok := serviceInfo.Methods[selector]
+		if !ok {
+			return nil, fmt.Errorf("trusted JWT caller for operation %q which is not in the service config", selector)
+		}
+		// Without JWT authentication, the JWT is not verified.
+		if !method.RequireAuth {
+			return nil, fmt.Errorf("trusted JWT caller for operation %q which does not require JWT authentication", selector)
+		}
+		callers[selector] = append(callers[selector], &scpb.TrustedJwtCaller{
+			Issuer:    values[0],
+			Audiences: values[1:],
+		})
+	}
+	return callers, nil
+}
+
+func makePeerCheckCacheConfig(opts options.ConfigGeneratorOptions) (*scpb.PeerCheckCacheConfig, error) {
+	// The peers are only trusted with the shared secret.
+	if opts.CheckCachePeerSecretFile == "" {
+		return nil, fmt.Errorf("flag --check_cache_peer_secret_file is required with --check_cache_peers")
+	}
+	addresses, err := util.ParseCheckCachePeers(opts.CheckCachePeers)
+	if err != nil {
+		return nil, err
+	}
+	config := &scpb.PeerCheckCacheConfig{
+		Ttl:        ptypes.DurationProto(opts.CheckCachePeerTtl),
+		SecretPath: opts.CheckCachePeerSecretFile,
+	}
+	seen := map[string]bool{}
+	for _, address := range addresses {
+		if seen[address] {
+			continue
+		}
+		seen[address] = true
+		config.Peers = append(config.Peers, &commonpb.HttpUri{
+			Uri:     fmt.Sprintf("http://%s", address),
+			Cluster: util.CheckCachePeerClusterName(address),
+			Timeout: ptypes.DurationProto(opts.CheckCachePeerTimeout),
+		})
+	}
+	return config, nil
+}
+
+// makeDeniedReportRollupConfig returns the denied report rollup config, leaving
+// the options not set to the filter defaults.
+func makeDeniedReportRollupConfig(opts options.ConfigGeneratorOptions) (*scpb.DeniedReportRollupConfig, error) {
+	if opts.DeniedReportRollupThreshold > math.MaxUint32 {
+		return nil, fmt.Errorf("invalid denied report rollup threshold %v, it must be at most %v", opts.DeniedReportRollupThreshold, uint32(math.MaxUint32))
+	}
+	config := &scpb.DeniedReportRollupConfig{
+		Threshold: uint32(opts.DeniedReportRollupThreshold),
+	}
+	if opts.DeniedReportRollupInterval > 0 {
+		if opts.DeniedReportRollupInterval < time.Millisecond {
+			return nil, fmt.Errorf("invalid denied report rollup interval %v, it must be at least 1ms", opts.DeniedReportRollupInterval)
+		}
+		config.Interval = ptypes.DurationProto(opts.DeniedReportRollupInterval)
+	}
+	return config, nil
+}
+
+// makePinnedCheckCacheConfig parses the comma separated API key digests and
+// consumer project numbers of the priority consumers.
+func makePinnedCheckCacheConfig(opts options.ConfigGeneratorOptions) (*scpb.PinnedCheckCacheConfig, error) {
+	// The pinned responses are refreshed in the last quarter of their ttl,
+	// which must span a few of the 5s scans of the filter.
+	if opts.PinnedCheckTtl < pinnedCheckMinTtl {
+		return nil, fmt.Errorf("invalid pinned check ttl %v, it must be at least %v", opts.PinnedCheckTtl, pinnedCheckMinTtl)
+	}
+	config := &scpb.PinnedCheckCacheConfig{
+		Ttl: ptypes.DurationProto(opts.PinnedCheckTtl),
+	}
+	for _, digest := range strings.Split(opts.PinnedCheckApiKeySha256, ",") {
+		digest = strings.ToLower(strings.TrimSpace(digest))
+		if digest == "" {
+			continue
+		}
+		if b, err := hex.DecodeString(digest); err != nil || len(b) != sha256.Size {
+			return nil, fmt.Errorf("invalid pinned API key digest %q, expected a hex encoded SHA-256 digest", digest)
+		}
+		config.ApiKeySha256 = append(config.ApiKeySha256, digest)
+	}
+	for _, number := range strings.Split(opts.PinnedCheckConsumerNumbers, ",") {
+		number = strings.TrimSpace(number)
+		if number == "" {
+			continue
+		}
+		n, err := strconv.ParseInt(number, 10, 64)
+		if err != nil || n <= 0 {
+			return nil, fmt.Errorf("invalid pinned consumer number %q, expected a project number", number)
+		}
+		config.ConsumerNumbers = append(config.ConsumerNumbers, n)
+	}
+	return config, nil
+}
+
 func makeServiceControlCallingConfig(opts options.ConfigGeneratorOptions) *scpb.ServiceControlCallingConfig {
 	setting := &scpb.ServiceControlCallingConfig{}
 	setting.NetworkFailOpen = &wrapperspb.BoolValue{Value: opts.ServiceControlNetworkFailOpen}
@@ -15,13 +15,21 @@
 package filterconfig
 
 import (
+	"strings"
 	"testing"
+	"time"
 
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/configinfo"
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/options"
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/utils"
 	"github.com/golang/protobuf/jsonpb"
+	"github.com/golang/protobuf/ptypes"
 
+	scpb "github.com/GoogleCloudPlatform/esp-v2/src/go/proto/api/envoy/v11/http/service_control"
+	durationpb "github.com/golang/protobuf/ptypes/duration"
+
+	annotationspb "google.golang.org/genproto/googleapis/api/annotations"
 	confpb "google.golang.org/genproto/googleapis/api/serviceconfig"
 	apipb "google.golang.org/genproto/protobuf/api"
 )
@@ -125,3 +133,372 @@ func TestServiceControl(t *testing.T) {
 		})
 	}
 }
+
+func TestServiceControlTrustedJwtCallers(t *testing.T) {
+	fakeServiceConfig := &confpb.Service{
+		Name: testProjectName,
+		Apis: []*apipb.Api{
+			{
+				Name: testApiName,
+				Methods: []*apipb.Method{
+					{
+						Name: "ListShelves",
+					},
+					{
+						Name: "CreateShelf",
+					},
+				},
+			},
+		},
+		Authentication: &confpb.Authentication{
+			Providers: []*confpb.AuthProvider{
+				{
+					Id:      "internal_provider",
+					Issuer:  "https://internal.example.com",
+					JwksUri: "https://internal.example.com/jwks",
+				},
+			},
+			Rules: []*confpb.AuthenticationRule{
+				{
+					Selector: testApiName + ".ListShelves",
+					Requirements: []*confpb.AuthRequirement{
+						{
+							ProviderId: "internal_provider",
+						},
+					},
+				},
+			},
+		},
+		Control: &confpb.Control{
+			Environment: util.StatPrefix,
+		},
+	}
+	testData := []struct {
+		desc              string
+		trustedJwtCallers string
+		wantCallers       map[string][]*scpb.TrustedJwtCaller
+		wantError         string
+	}{
+		{
+			desc: "no trusted JWT callers",
+		},
+		{
+			desc:              "trusted JWT callers of an operation",
+			trustedJwtCallers: testApiName + ".ListShelves=https://internal.example.com, aud-1, aud-2; " + testApiName + ".ListShelves=https://other.example.com,aud-3",
+			wantCallers: map[string][]*scpb.TrustedJwtCaller{
+				testApiName + ".ListShelves": {
+					{
+						Issuer:    "https://internal.example.com",
+						Audiences: []string{"aud-1", "aud-2"},
+					},
+					{
+						Issuer:    "https://other.example.com",
+						Audiences: []string{"aud-3"},
+					},
+				},
+			},
+		},
+		{
+			desc:              "no audience",
+			trustedJwtCallers: testApiName + ".ListShelves=https://internal.example.com",
+			wantError:         "expected an issuer and at least one audience",
+		},
+		{
+			desc:              "no selector",
+			trustedJwtCallers: "https://internal.example.com",
+			wantError:         "expected selector=issuer,audience",
+		},
+		{
+			desc:              "unknown operation",
+			trustedJwtCallers: testApiName + ".GetShelf=https://internal.example.com,aud",
+			wantError:         "which is not in the service config",
+		},
+		{
+			desc:              "operation without JWT authentication",
+			trustedJwtCallers: testApiName + ".CreateShelf=https://internal.example.com,aud",
+			wantError:         "which does not require JWT authentication",
+		},
+	}
+	for _, tc := range testData {
+		t.Run(tc.desc, func(t *testing.T) {
+			opts := options.DefaultConfigGeneratorOptions()
+			opts.TrustedJwtCallers = tc.trustedJwtCallers
+			fakeServiceInfo, err := configinfo.NewServiceInfoFromServiceConfig(fakeServiceConfig, testConfigID, opts)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filter, _, err := scFilterGenFunc(fakeServiceInfo)
+			if tc.wantError != "" {
+				if err == nil || !strings.Contains(err.Error(), tc.wantError) {
+					t.Errorf("got error: %v, want: %v", err, tc.wantError)
+				}
+				return
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filterConfig := &scpb.FilterConfig{}
+			if err := ptypes.UnmarshalAny(filter.GetTypedConfig(), filterConfig); err != nil {
+				t.Fatal(err)
+			}
+			for _, requirement := range filterConfig.GetRequirements() {
+				want := &scpb.Requirement{
+					TrustedJwtCallers: tc.wantCallers[requirement.GetOperationName()],
+				}
+				got := &scpb.Requirement{
+					TrustedJwtCallers: requirement.GetTrustedJwtCallers(),
+				}
+				if diff := utils.ProtoDiff(want, got); diff != "" {
+					t.Errorf("trusted JWT callers of %v are not the same: diff (-want +got):\n%v", requirement.GetOperationName(), diff)
+				}
+			}
+		})
+	}
+}
+
+func TestServiceControlPinnedCheckCache(t *testing.T) {
+	fakeServiceConfig := &confpb.Service{
+		Name: testProjectName,
+		Apis: []*apipb.Api{
+			{
+				Name: testApiName,
+				Methods: []*apipb.Method{
+					{
+						Name: "ListShelves",
+					},
+				},
+			},
+		},
+		Control: &confpb.Control{
+			Environment: util.StatPrefix,
+		},
+	}
+	// The SHA-256 digest of "key".
+	keySha256 := "2c70e12b7a0646f92279f427c7b38e7334d8e5389cff167a1dc30e73f826b683"
+	testData := []struct {
+		desc                       string
+		pinnedCheckApiKeySha256    string
+		pinnedCheckConsumerNumbers string
+		pinnedCheckTtl             time.Duration
+		wantPinnedCheckCache       *scpb.PinnedCheckCacheConfig
+		wantError                  string
+	}{
+		{
+			desc: "no pinned consumers",
+		},
+		{
+			desc:                       "pinned API keys and consumer numbers",
+			pinnedCheckApiKeySha256:    strings.ToUpper(keySha256) + ", ",
+			pinnedCheckConsumerNumbers: "123, 456",
+			wantPinnedCheckCache: &scpb.PinnedCheckCacheConfig{
+				ApiKeySha256:    []string{keySha256},
+				ConsumerNumbers: []int64{123, 456},
+				Ttl:             ptypes.DurationProto(5 * time.Minute),
+			},
+		},
+		{
+			desc:                    "invalid API key digest",
+			pinnedCheckApiKeySha256: "api-key",
+			wantError:               "expected a hex encoded SHA-256 digest",
+		},
+		{
+			desc:                       "invalid consumer number",
+			pinnedCheckConsumerNumbers: "project-id",
+			wantError:                  "expected a project number",
+		},
+		{
+			desc:                       "ttl too short",
+			pinnedCheckConsumerNumbers: "123",
+			pinnedCheckTtl:             time.Second,
+			wantError:                  "it must be at least 20s",
+		},
+	}
+	for _, tc := range testData {
+		t.Run(tc.desc, func(t *testing.T) {
+			opts := options.DefaultConfigGeneratorOptions()
+			opts.PinnedCheckApiKeySha256 = tc.pinnedCheckApiKeySha256
+			opts.PinnedCheckConsumerNumbers = tc.pinnedCheckConsumerNumbers
+			if tc.pinnedCheckTtl != 0 {
+				opts.PinnedCheckTtl = tc.pinnedCheckTtl
+			}
+			fakeServiceInfo, err := configinfo.NewServiceInfoFromServiceConfig(fakeServiceConfig, testConfigID, opts)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filter, _, err := scFilterGenFunc(fakeServiceInfo)
+			if tc.wantError != "" {
+				if err == nil || !strings.Contains(err.Error(), tc.wantError) {
+					t.Errorf("got error: %v, want: %v", err, tc.wantError)
+				}
+				return
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filterConfig := &scpb.FilterConfig{}
+			if err := ptypes.UnmarshalAny(filter.GetTypedConfig(), filterConfig); err != nil {
+				t.Fatal(err)
+			}
+			if diff := utils.ProtoDiff(tc.wantPinnedCheckCache, filterConfig.GetPinnedCheckCache()); diff != "" {
+				t.Errorf("pinned check cache config is not the same: diff (-want +got):\n%v", diff)
+			}
+		})
+	}
+}
+
+func TestServiceControlDeniedReportRollup(t *testing.T) {
+	fakeServiceConfig := &confpb.Service{
+		Name: testProjectName,
+		Apis: []*apipb.Api{
+			{
+				Name: testApiName,
+				Methods: []*apipb.Method{
+					{
+						Name: "ListShelves",
+					},
+				},
+			},
+		},
+		Control: &confpb.Control{
+			Environment: util.StatPrefix,
+		},
+	}
+	testData := []struct {
+		desc                   string
+		threshold              uint
+		interval               time.Duration
+		wantDeniedReportRollup *scpb.DeniedReportRollupConfig
+		wantError              string
+	}{
+		{
+			desc: "filter defaults",
+		},
+		{
+			desc:      "threshold only",
+			threshold: 500,
+			wantDeniedReportRollup: &scpb.DeniedReportRollupConfig{
+				Threshold: 500,
+			},
+		},
+		{
+			desc:      "threshold and interval",
+			threshold: 500,
+			interval:  10 * time.Second,
+			wantDeniedReportRollup: &scpb.DeniedReportRollupConfig{
+				Threshold: 500,
+				Interval:  ptypes.DurationProto(10 * time.Second),
+			},
+		},
+		{
+			desc:      "interval too short",
+			interval:  time.Microsecond,
+			wantError: "it must be at least 1ms",
+		},
+	}
+	for _, tc := range testData {
+		t.Run(tc.desc, func(t *testing.T) {
+			opts := options.DefaultConfigGeneratorOptions()
+			opts.DeniedReportRollupThreshold = tc.threshold
+			opts.DeniedReportRollupInterval = tc.interval
+			fakeServiceInfo, err := configinfo.NewServiceInfoFromServiceConfig(fakeServiceConfig, testConfigID, opts)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filter, _, err := scFilterGenFunc(fakeServiceInfo)
+			if tc.wantError != "" {
+				if err == nil || !strings.Contains(err.Error(), tc.wantError) {
+					t.Errorf("got error: %v, want: %v", err, tc.wantError)
+				}
+				return
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filterConfig := &scpb.FilterConfig{}
+			if err := ptypes.UnmarshalAny(filter.GetTypedConfig(), filterConfig); err != nil {
+				t.Fatal(err)
+			}
+			if diff := utils.ProtoDiff(tc.wantDeniedReportRollup, filterConfig.GetDeniedReportRollup()); diff != "" {
+				t.Errorf("denied report rollup config is not the same: diff (-want +got):\n%v", diff)
+			}
+		})
+	}
+}
+
+func TestServiceControlHotRestartTakeOverWindow(t *testing.T) {
+	fakeServiceConfig := &confpb.Service{
+		Name: testProjectName,
+		Apis: []*apipb.Api{
+			{
+				Name: testApiName,
+				Methods: []*apipb.Method{
+					{
+						Name: "ListShelves",
+					},
+				},
+			},
+		},
+		Control: &confpb.Control{
+			Environment: util.StatPrefix,
+		},
+	}
+	testData := []struct {
+		desc       string
+		window     time.Duration
+		wantWindow *durationpb.Duration
+		wantError  string
+	}{
+		{
+			desc: "filter default",
+		},
+		{
+			desc:       "longer than the parent shutdown time",
+			window:     30 * time.Minute,
+			wantWindow: ptypes.DurationProto(30 * time.Minute),
+		},
+		{
+			desc:      "window too short",
+			window:    time.Millisecond,
+			wantError: "it must be at least 1s",
+		},
+	}
+	for _, tc := range testData {
+		t.Run(tc.desc, func(t *testing.T) {
+			opts := options.DefaultConfigGeneratorOptions()
+			opts.HotRestartHandoffDir = "/tmp/handoff"
+			opts.HotRestartTakeOverWindow = tc.window
+			fakeServiceInfo, err := configinfo.NewServiceInfoFromServiceConfig(fakeServiceConfig, testConfigID, opts)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filter, _, err := scFilterGenFunc(fakeServiceInfo)
+			if tc.wantError != "" {
+				if err == nil || !strings.Contains(err.Error(), tc.wantError) {
+					t.Errorf("got error: %v, want: %v", err, tc.wantError)
+				}
+				return
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			filterConfig := &scpb.FilterConfig{}
+			if err := ptypes.UnmarshalAny(filter.GetTypedConfig(), filterConfig); err != nil {
+				t.Fatal(err)
+			}
+			if filterConfig.GetHotRestartHandoffDir() != "/tmp/handoff" {
+				t.Errorf("got hot restart handoff dir: %v, want: /tmp/handoff", filterConfig.GetHotRestartHandoffDir())
+			}
+			if diff := utils.ProtoDiff(tc.wantWindow, filterConfig.GetHotRestartTakeOverWindow()); diff != "" {
+				t.Errorf("hot restart take over window is not the same: diff (-want +got):\n%v", diff)
+			}
+		})
+	}
+}
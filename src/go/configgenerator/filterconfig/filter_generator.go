@@ -100,12 +100,14 @@ func MakeFilterGenerators(serviceInfo *ci.ServiceInfo) ([]*FilterGenerator, erro
 	}
 	if serviceInfo.Options.EnableResponseCompression {
 		filterGenerators = append(filterGenerators, &FilterGenerator{
-			FilterName:    util.EnvoyGzipCompressor,
-			FilterGenFunc: gzipCompressorGenFunc,
+			FilterName:            util.EnvoyGzipCompressorFilter,
+			FilterGenFunc:         gzipCompressorGenFunc,
+			PerRouteConfigGenFunc: compressorPerRouteFilterConfigGen,
 		})
 		filterGenerators = append(filterGenerators, &FilterGenerator{
-			FilterName:    util.EnvoyBrotliCompressor,
-			FilterGenFunc: brotliCompressorGenFunc,
+			FilterName:            util.EnvoyBrotliCompressorFilter,
+			FilterGenFunc:         brotliCompressorGenFunc,
+			PerRouteConfigGenFunc: compressorPerRouteFilterConfigGen,
 		})
 	}
 
@@ -315,6 +317,10 @@ func makeTranscoderFilter(serviceInfo *ci.ServiceInfo) (*hcmpb.HttpFilter, error
 			if err != nil {
 				return nil, err
 			}
+			configContent, err = pruneProtoDescriptor(serviceInfo.ApiNames, configContent)
+			if err != nil {
+				return nil, err
+			}
 
 			transcodeConfig := &transcoderpb.GrpcJsonTranscoder{
 				DescriptorSet: &transcoderpb.GrpcJsonTranscoder_ProtoDescriptorBin{
@@ -0,0 +1,356 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package filterconfig
+
+import (
+	"fmt"
+
+	"github.com/golang/glog"
+
+	descpb "github.com/golang/protobuf/protoc-gen-go/descriptor"
+	"google.golang.org/protobuf/proto"
+)
+
+const anyTypeName = ".google.protobuf.Any"
+
+// pruneProtoDescriptor removes from the proto descriptor set everything the
+// transcoder filter does not need: the services not in apiNames, the message
+// and enum types not reachable from their methods, and the files left empty.
+//
+// The descriptor set usually includes large common protos, such as
+// descriptor.proto for the annotations, which Envoy would otherwise parse and
+// keep in memory for every listener.
+//
+// The descriptor set is returned as is if it cannot be pruned safely: if a
+// type is not defined in it, or if google.protobuf.Any is reachable, as any
+// type may be packed into it.
+func pruneProtoDescriptor(apiNames []string, descriptorBytes []byte) ([]byte, error) {
+	fds := &descpb.FileDescriptorSet{}
+	if err := proto.Unmarshal(descriptorBytes, fds); err != nil {
+		glog.Error("failed to unmarshal protodescriptor, error: ", err)
+		return nil, fmt.Errorf("failed to unmarshal proto descriptor, error: %v", err)
+	}
+
+	p := newDescriptorPruner(fds)
+	if err := p.markReachable(apiNames); err != nil {
+		glog.Infof("not pruning the proto descriptor: %v", err)
+		return descriptorBytes, nil
+	}
+	p.prune()
+
+	newData, err := proto.Marshal(fds)
+	if err != nil {
+		glog.Error("failed to marshal proto descriptor, error: ", err)
+		return nil, fmt.Errorf("failed to marshal proto descriptor, error: %v", err)
+	}
+	glog.Infof("pruned the proto descriptor from %d to %d bytes: kept %d of %d files, %d of %d types",
+		len(descriptorBytes), len(newData), len(fds.GetFile()), p.numFiles, len(p.reachable), len(p.topLevel))
+	return newData, nil
+}
+
+// descriptorPruner tracks the types reachable from the transcoded services.
+// Nested types are kept or removed along with their top level type.
+type descriptorPruner struct {
+	fds      *descpb.FileDescriptorSet
+	numFiles int
+
+	// The top level types by full name, with a leading dot.
+	topLevel map[string]bool
+	// The top level type of each type, nested or not.
+	owner map[string]string
+	// The top level messages by full name, to walk their fields.
+	messages map[string]*descpb.DescriptorProto
+	// The services to keep, by full name without a leading dot.
+	services map[string]bool
+
+	reachable map[string]bool
+	queue     []string
+	// The top level extensions kept, as their extendee is reachable.
+	extensions map[*descpb.FieldDescriptorProto]bool
+}
+
+func newDescriptorPruner(fds *descpb.FileDescriptorSet) *descriptorPruner {
+	p := &descriptorPruner{
+		fds:        fds,
+		numFiles:   len(fds.GetFile()),
+		topLevel:   make(map[string]bool),
+		owner:      make(map[string]string),
+		messages:   make(map[string]*descpb.DescriptorProto),
+		services:   make(map[string]bool),
+		reachable:  make(map[string]bool),
+		extensions: make(map[*descpb.FieldDescriptorProto]bool),
+	}
+	for _, file := range fds.GetFile() {
+		prefix := typePrefix(file)
+		for _, msg := range file.GetMessageType() {
+			name := prefix + "." + msg.GetName()
+			p.topLevel[name] = true
+			p.messages[name] = msg
+			p.addNested(name, name, msg)
+		}
+		for _, enum := range file.GetEnumType() {
+			name := prefix + "." + enum.GetName()
+			p.topLevel[name] = true
+			p.owner[name] = name
+		}
+	}
+	return p
+}
+
+func (p *descriptorPruner) addNested(top, name string, msg *descpb.DescriptorProto) {
+	p.owner[name] = top
+	for _, nested := range msg.GetNestedType() {
+		p.addNested(top, name+"."+nested.GetName(), nested)
+	}
+	for _, enum := range msg.GetEnumType() {
+		p.owner[name+"."+enum.GetName()] = top
+	}
+}
+
+// mark adds the top level type of the type to the reachable ones.
+func (p *descriptorPruner) mark(typeName string) error {
+	top, ok := p.owner[typeName]
+	if !ok {
+		return fmt.Errorf("type %s is not defined in the descriptor set", typeName)
+	}
+	if !p.reachable[top] {
+		p.reachable[top] = true
+		p.queue = append(p.queue, top)
+	}
+	return nil
+}
+
+// markFields marks the types of the fields and extensions of the message and
+// its nested messages.
+func (p *descriptorPruner) markFields(msg *descpb.DescriptorProto) error {
+	for _, field := range msg.GetField() {
+		if field.GetTypeName() != "" {
+			if err := p.mark(field.GetTypeName()); err != nil {
+				return err
+			}
+		}
+	}
+	// The message is kept whole, so its extensions must be resolvable too.
+	for _, ext := range msg.GetExtension() {
+		if err := p.markExtension(ext); err != nil {
+			return err
+		}
+	}
+	for _, nested := range msg.GetNestedType() {
+		if err := p.markFields(nested); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func (p *descriptorPruner) markExtension(ext *descpb.FieldDescriptorProto) error {
+	if err := p.mark(ext.GetExtendee()); err != nil {
+		return err
+	}
+	if ext.GetTypeName() != "" {
+		return p.mark(ext.GetTypeName())
+	}
+	return nil
+}
+
+// markReachable marks the types reachable from the methods of the services
+// in apiNames, and the top level extensions of the reachable messages.
+func (p *descriptorPruner) markReachable(apiNames []string) error {
+	apiMap := make(map[string]bool)
+	for _, apiName := range apiNames {
+		apiMap[apiName] = true
+	}
+	for _, file := range p.fds.GetFile() {
+		for _, service := range file.GetService() {
+			apiName := serviceName(file, service)
+			if !apiMap[apiName] {
+				continue
+			}
+			p.services[apiName] = true
+			for _, method := range service.GetMethod() {
+				if err := p.mark(method.GetInputType()); err != nil {
+					return err
+				}
+				if err := p.mark(method.GetOutputType()); err != nil {
+					return err
+				}
+			}
+		}
+	}
+
+	// Keeping an extension may make more messages reachable, which may in
+	// turn keep more extensions.
+	for len(p.queue) > 0 {
+		for len(p.queue) > 0 {
+			top := p.queue[0]
+			p.queue = p.queue[1:]
+			if msg, ok := p.messages[top]; ok {
+				if err := p.markFields(msg); err != nil {
+					return err
+				}
+			}
+		}
+		for _, file := range p.fds.GetFile() {
+			for _, ext := range file.GetExtension() {
+				if p.extensions[ext] {
+					continue
+				}
+				if top, ok := p.owner[ext.GetExtendee()]; !ok || !p.reachable[top] {
+					continue
+				}
+				p.extensions[ext] = true
+				if err := p.markExtension(ext); err != nil {
+					return err
+				}
+			}
+		}
+	}
+
+	if p.reachable[anyTypeName] {
+		return fmt.Errorf("%s is reachable", anyTypeName)
+	}
+	return nil
+}
+
+// prune removes the unreachable types, services and extensions, and the files
+// left empty. The dependencies on removed files are replaced by the kept files
+// they publicly import.
+func (p *descriptorPruner) prune() {
+	files := make(map[string]*descpb.FileDescriptorProto)
+	kept := make(map[string]bool)
+	var keptFiles []*descpb.FileDescriptorProto
+	for _, file := range p.fds.GetFile() {
+		files[file.GetName()] = file
+
+		prefix := typePrefix(file)
+		var messages []*descpb.DescriptorProto
+		for _, msg := range file.GetMessageType() {
+			if p.reachable[prefix+"."+msg.GetName()] {
+				messages = append(messages, msg)
+			}
+		}
+		var enums []*descpb.EnumDescriptorProto
+		for _, enum := range file.GetEnumType() {
+			if p.reachable[prefix+"."+enum.GetName()] {
+				enums = append(enums, enum)
+			}
+		}
+		var services []*descpb.ServiceDescriptorProto
+		for _, service := range file.GetService() {
+			if p.services[serviceName(file, service)] {
+				services = append(services, service)
+			}
+		}
+		var extensions []*descpb.FieldDescriptorProto
+		for _, ext := range file.GetExtension() {
+			if p.extensions[ext] {
+				extensions = append(extensions, ext)
+			}
+		}
+		if len(messages) == 0 && len(enums) == 0 && len(services) == 0 && len(extensions) == 0 {
+			continue
+		}
+
+		file.MessageType = messages
+		file.EnumType = enums
+		file.Service = services
+		file.Extension = extensions
+		// The source locations are paths of element indexes, which no longer
+		// match, and are not used by the transcoder.
+		file.SourceCodeInfo = nil
+		kept[file.GetName()] = true
+		keptFiles = append(keptFiles, file)
+	}
+
+	for _, file := range keptFiles {
+		pruneDependencies(file, kept, files)
+	}
+	p.fds.File = keptFiles
+}
+
+// pruneDependencies replaces the dependencies of the file on removed files by
+// the kept files they publicly import, so the types they forward still
+// resolve.
+func pruneDependencies(file *descpb.FileDescriptorProto, kept map[string]bool, files map[string]*descpb.FileDescriptorProto) {
+	public := make(map[int32]bool)
+	for _, i := range file.GetPublicDependency() {
+		public[i] = true
+	}
+	weak := make(map[int32]bool)
+	for _, i := range file.GetWeakDependency() {
+		weak[i] = true
+	}
+
+	var deps []string
+	var publicDeps, weakDeps []int32
+	added := make(map[string]bool)
+	for i, dep := range file.GetDependency() {
+		for _, newDep := range keptDependencies(dep, kept, files, make(map[string]bool)) {
+			if added[newDep] {
+				continue
+			}
+			added[newDep] = true
+			if public[int32(i)] {
+				publicDeps = append(publicDeps, int32(len(deps)))
+			}
+			if weak[int32(i)] {
+				weakDeps = append(weakDeps, int32(len(deps)))
+			}
+			deps = append(deps, newDep)
+		}
+	}
+	file.Dependency = deps
+	file.PublicDependency = publicDeps
+	file.WeakDependency = weakDeps
+}
+
+// keptDependencies returns the dependency if it is kept, or else the kept
+// files it publicly imports, transitively.
+func keptDependencies(dep string, kept map[string]bool, files map[string]*descpb.FileDescriptorProto, visited map[string]bool) []string {
+	file, ok := files[dep]
+	if kept[dep] || !ok {
+		// A file missing from the set is left for Envoy to report.
+		return []string{dep}
+	}
+	if visited[dep] {
+		return nil
+	}
+	visited[dep] = true
+
+	var deps []string
+	for _, i := range file.GetPublicDependency() {
+		if int(i) < len(file.GetDependency()) {
+			deps = append(deps, keptDependencies(file.GetDependency()[i], kept, files, visited)...)
+		}
+	}
+	return deps
+}
+
+// typePrefix returns the prefix of the full names of the types in the file.
+func typePrefix(file *descpb.FileDescriptorProto) string {
+	if file.GetPackage() == "" {
+		return ""
+	}
+	return "." + file.GetPackage()
+}
+
+// serviceName returns the full name of the service, as in the api names.
+func serviceName(file *descpb.FileDescriptorProto, service *descpb.ServiceDescriptorProto) string {
+	if file.GetPackage() == "" {
+		return service.GetName()
+	}
+	return file.GetPackage() + "." + service.GetName()
+}
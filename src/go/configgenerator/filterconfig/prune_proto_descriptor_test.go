@@ -0,0 +1,308 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package filterconfig
+
+import (
+	"strings"
+	"testing"
+
+	"github.com/GoogleCloudPlatform/esp-v2/tests/utils"
+	descpb "github.com/golang/protobuf/protoc-gen-go/descriptor"
+
+	"google.golang.org/protobuf/encoding/prototext"
+	"google.golang.org/protobuf/proto"
+)
+
+func TestPruneProtoDescriptor(t *testing.T) {
+	testData := []struct {
+		desc      string
+		apiNames  []string
+		inDesc    string
+		wantDesc  string
+		wantError string
+	}{
+		{
+			desc:      "Failed to unmarshal error",
+			inDesc:    "invalid proto descriptor",
+			wantError: "failed to unmarshal",
+		},
+		{
+			desc:     "Remove the unreachable types, services and files",
+			apiNames: []string{"pkg.Service"},
+			inDesc: `
+file: {
+  name: "common.proto"
+  package: "common"
+  message_type: {
+    name: "Used"
+    field: { name: "color" number: 1 label: LABEL_OPTIONAL type: TYPE_ENUM type_name: ".common.Color" }
+  }
+  message_type: {
+    name: "Unused"
+  }
+  enum_type: {
+    name: "Color"
+    value: { name: "RED" number: 0 }
+  }
+  enum_type: {
+    name: "Shade"
+    value: { name: "DARK" number: 0 }
+  }
+}
+file: {
+  name: "unused.proto"
+  package: "unused"
+  message_type: {
+    name: "Big"
+  }
+}
+file: {
+  name: "service.proto"
+  package: "pkg"
+  dependency: "common.proto"
+  dependency: "unused.proto"
+  message_type: {
+    name: "Request"
+    field: { name: "inner" number: 1 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".pkg.Request.Inner" }
+    nested_type: {
+      name: "Inner"
+      field: { name: "used" number: 1 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".common.Used" }
+    }
+  }
+  message_type: {
+    name: "Unused"
+  }
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".pkg.Request" output_type: ".pkg.Request" }
+  }
+  service: {
+    name: "Other"
+    method: { name: "Method" input_type: ".unused.Big" output_type: ".unused.Big" }
+  }
+}`,
+			wantDesc: `
+file: {
+  name: "common.proto"
+  package: "common"
+  message_type: {
+    name: "Used"
+    field: { name: "color" number: 1 label: LABEL_OPTIONAL type: TYPE_ENUM type_name: ".common.Color" }
+  }
+  enum_type: {
+    name: "Color"
+    value: { name: "RED" number: 0 }
+  }
+}
+file: {
+  name: "service.proto"
+  package: "pkg"
+  dependency: "common.proto"
+  message_type: {
+    name: "Request"
+    field: { name: "inner" number: 1 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".pkg.Request.Inner" }
+    nested_type: {
+      name: "Inner"
+      field: { name: "used" number: 1 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".common.Used" }
+    }
+  }
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".pkg.Request" output_type: ".pkg.Request" }
+  }
+}`,
+		},
+		{
+			desc:     "Replace a removed dependency by the kept files it publicly imports",
+			apiNames: []string{"pkg.Service"},
+			inDesc: `
+file: {
+  name: "base.proto"
+  package: "base"
+  message_type: {
+    name: "Base"
+  }
+}
+file: {
+  name: "forward.proto"
+  package: "forward"
+  dependency: "base.proto"
+  public_dependency: 0
+  message_type: {
+    name: "Unused"
+  }
+}
+file: {
+  name: "service.proto"
+  package: "pkg"
+  dependency: "forward.proto"
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".base.Base" output_type: ".base.Base" }
+  }
+}`,
+			wantDesc: `
+file: {
+  name: "base.proto"
+  package: "base"
+  message_type: {
+    name: "Base"
+  }
+}
+file: {
+  name: "service.proto"
+  package: "pkg"
+  dependency: "base.proto"
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".base.Base" output_type: ".base.Base" }
+  }
+}`,
+		},
+		{
+			desc:     "Keep the extensions of reachable messages only",
+			apiNames: []string{"pkg.Service"},
+			inDesc: `
+file: {
+  name: "google/protobuf/descriptor.proto"
+  package: "google.protobuf"
+  message_type: {
+    name: "MethodOptions"
+  }
+}
+file: {
+  name: "service.proto"
+  package: "pkg"
+  dependency: "google/protobuf/descriptor.proto"
+  message_type: {
+    name: "Request"
+    extension_range: { start: 100 end: 200 }
+  }
+  message_type: {
+    name: "Payload"
+  }
+  extension: { name: "payload" number: 100 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".pkg.Payload" extendee: ".pkg.Request" }
+  extension: { name: "option" number: 50000 label: LABEL_OPTIONAL type: TYPE_STRING extendee: ".google.protobuf.MethodOptions" }
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".pkg.Request" output_type: ".pkg.Request" }
+  }
+}`,
+			wantDesc: `
+file: {
+  name: "service.proto"
+  package: "pkg"
+  message_type: {
+    name: "Request"
+    extension_range: { start: 100 end: 200 }
+  }
+  message_type: {
+    name: "Payload"
+  }
+  extension: { name: "payload" number: 100 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".pkg.Payload" extendee: ".pkg.Request" }
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".pkg.Request" output_type: ".pkg.Request" }
+  }
+}`,
+		},
+		{
+			// The types packed into an Any are only known at runtime.
+			desc:     "Any is reachable, not pruned",
+			apiNames: []string{"pkg.Service"},
+			inDesc: `
+file: {
+  name: "google/protobuf/any.proto"
+  package: "google.protobuf"
+  message_type: {
+    name: "Any"
+  }
+}
+file: {
+  name: "service.proto"
+  package: "pkg"
+  dependency: "google/protobuf/any.proto"
+  message_type: {
+    name: "Request"
+    field: { name: "any" number: 1 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".google.protobuf.Any" }
+  }
+  message_type: {
+    name: "Packed"
+  }
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".pkg.Request" output_type: ".pkg.Request" }
+  }
+}`,
+		},
+		{
+			desc:     "Undefined type, not pruned",
+			apiNames: []string{"pkg.Service"},
+			inDesc: `
+file: {
+  name: "service.proto"
+  package: "pkg"
+  message_type: {
+    name: "Unused"
+  }
+  service: {
+    name: "Service"
+    method: { name: "Method" input_type: ".other.Request" output_type: ".other.Request" }
+  }
+}`,
+		},
+	}
+
+	for _, tc := range testData {
+		t.Run(tc.desc, func(t *testing.T) {
+			var byteDesc []byte
+			fds := &descpb.FileDescriptorSet{}
+			if err := prototext.Unmarshal([]byte(tc.inDesc), fds); err != nil {
+				// Failed case is to use raw test to test failure
+				byteDesc = []byte(tc.inDesc)
+			} else {
+				byteDesc, _ = proto.Marshal(fds)
+			}
+
+			gotByteDesc, err := pruneProtoDescriptor(tc.apiNames, byteDesc)
+			if tc.wantError != "" {
+				if err == nil || !strings.Contains(err.Error(), tc.wantError) {
+					t.Errorf("failed, expected: %s, got: %v", tc.wantError, err)
+				}
+				return
+			}
+			if err != nil {
+				t.Fatalf("got unexpected error: %v", err)
+			}
+
+			got := &descpb.FileDescriptorSet{}
+			if err := proto.Unmarshal(gotByteDesc, got); err != nil {
+				t.Fatal("failed to unmarshal the pruned descriptor: ", err)
+			}
+			// An empty wantDesc means the descriptor is not pruned.
+			want := fds
+			if tc.wantDesc != "" {
+				want = &descpb.FileDescriptorSet{}
+				if err := prototext.Unmarshal([]byte(tc.wantDesc), want); err != nil {
+					t.Fatal("failed to unmarshal wantDesc: ", err)
+				}
+			}
+
+			if diff := utils.ProtoDiff(want, got); diff != "" {
+				t.Errorf("Result is not the same: diff (-want +got):\n%v", diff)
+			}
+		})
+	}
+}
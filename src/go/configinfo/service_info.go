@@ -60,6 +60,9 @@ type ServiceInfo struct {
 	AllowCors         bool
 	ServiceControlURI string
 	GcpAttributes     *scpb.GcpAttributes
+	// The JWKS fetched by the config manager, by jwks uri. The JWT providers
+	// with a JWKS here are given it as local JWKS instead of fetching it.
+	LocalJwks map[string]string
 	// Keep a pointer to original service config. Should always process rules
 	// inside ServiceInfo.
 	serviceConfig *confpb.Service
@@ -312,6 +315,21 @@ func (s *ServiceInfo) processAccessToken() {
 		return
 	}
 
+	if s.Options.TokenBrokerSocket != "" {
+		// The broker serves the access token in the metadata server format.
+		s.AccessToken = &commonpb.AccessToken{
+			TokenType: &commonpb.AccessToken_RemoteToken{
+				RemoteToken: &commonpb.HttpUri{
+					Uri:     fmt.Sprintf("%s%s", util.TokenBrokerURL, util.TokenBrokerAccessTokenPath),
+					Cluster: util.TokenBrokerClusterName,
+					Timeout: ptypes.DurationProto(s.Options.HttpRequestTimeout),
+				},
+			},
+		}
+
+		return
+	}
+
 	s.AccessToken = &commonpb.AccessToken{
 		TokenType: &commonpb.AccessToken_RemoteToken{
 			RemoteToken: &commonpb.HttpUri{
@@ -17,12 +17,17 @@ package configmanager
 import (
 	"bytes"
 	"context"
+	"crypto/sha256"
 	"crypto/tls"
 	"crypto/x509"
+	"encoding/hex"
 	"flag"
 	"fmt"
 	"io/ioutil"
 	"net/http"
+	"os"
+	"sort"
+	"sync"
 	"time"
 
 	"github.com/GoogleCloudPlatform/esp-v2/src/go/configinfo"
@@ -41,6 +46,9 @@ import (
 	confpb "google.golang.org/genproto/googleapis/api/serviceconfig"
 )
 
+// Version prefix of the snapshots restored from disk.
+const persistedVersionPrefix = "persisted-"
+
 var (
 	// These flags are used by config manage only.
 	checkNewRolloutInterval = flag.Duration("check_rollout_interval", 60*time.Second, `the interval periodically to call servicemanagment to check the latest rolloutil.`)
@@ -53,6 +61,16 @@ var (
 					GCP metadata server will not be called to fetch access token, and
 					following flags will be ignored; --service_config_id, --service,
 					--rollout_strategy`)
+	SnapshotDir = flag.String("xds_snapshot_dir", "", `directory where the last applied xDS snapshot is persisted.
+					On restart, the persisted snapshot of the service is served to Envoy
+					right away if it was generated with the same flags (and, with the
+					fixed rollout_strategy, for the same service config id), and the
+					latest service config is fetched and applied in the background.`)
+	JwksDir = flag.String("managed_jwks_dir", "", `directory where the JWKS of the JWT providers are persisted.
+					When set, the config manager fetches the JWKS, refreshes them as
+					their Cache-Control max-age expires, and gives them to Envoy as
+					local JWKS, so JWTs are verified from the first request. On
+					restart, the persisted JWKS are used even if the providers are down.`)
 )
 
 // Config Manager handles service configuration fetching and updating.
@@ -68,6 +86,14 @@ type ConfigManager struct {
 	rolloutIdChangeDetector *sc.RolloutIdChangeDetector
 
 	curServiceConfig *confpb.Service
+
+	// Hash of envoyConfigOptions, recorded in the persisted snapshots.
+	optionsHash string
+
+	// Set with --managed_jwks_dir only.
+	jwksManager *jwksManager
+	// Serializes the snapshot updates of the rollouts and of the JWKS refreshes.
+	mu sync.Mutex
 }
 
 // NewConfigManager creates new instance of Config Manager.
@@ -79,6 +105,23 @@ func NewConfigManager(mf *metadata.MetadataFetcher, opts options.ConfigGenerator
 	}
 	m.cache = cache.NewSnapshotCache(true, m, m)
 
+	var err error
+	if m.optionsHash, err = optionsHash(opts); err != nil {
+		return nil, fmt.Errorf("fail to hash the options: %v", err)
+	}
+
+	if *JwksDir != "" {
+		client, err := httpsClient(opts)
+		if err != nil {
+			return nil, fmt.Errorf("fail to init httpsClient: %v", err)
+		}
+		m.jwksManager, err = newJwksManager(*JwksDir, client,
+			time.Duration(opts.JwksCacheDurationInS)*time.Second, m.onJwksChange)
+		if err != nil {
+			return nil, err
+		}
+	}
+
 	// If service config is provided as a file, just use it and disable managed rollout
 	if *ServicePath != "" {
 		// Following flags will not be used
@@ -102,7 +145,6 @@ func NewConfigManager(mf *metadata.MetadataFetcher, opts options.ConfigGenerator
 
 	m.serviceName = *ServiceName
 	checkMetadata := *CheckMetadata
-	var err error
 
 	if m.serviceName == "" && checkMetadata && mf != nil {
 		m.serviceName, err = mf.FetchServiceName()
@@ -166,35 +208,112 @@ func NewConfigManager(mf *metadata.MetadataFetcher, opts options.ConfigGenerator
 				return nil, fmt.Errorf("failed to read metadata with key endpoints-service-version from metadata server: %v", err)
 			}
 		}
-	} else if rolloutStrategy == util.ManagedRolloutStrategy {
+	}
+
+	// Serve the persisted snapshot right away, so Envoy does not wait for
+	// Service Management, and reconcile with the latest config in the
+	// background.
+	if m.restoreSnapshot(configId) {
+		go m.reconcileStartupConfig(rolloutStrategy, configId, client, accessToken)
+		glog.Infof("create new Config Manager for service (%v) from the persisted snapshot, %v rollout strategy",
+			m.serviceName, rolloutStrategy)
+		return m, nil
+	}
+
+	if err = m.loadAndApplyStartupConfig(rolloutStrategy, configId); err != nil {
+		return nil, err
+	}
+	m.startRolloutDetector(rolloutStrategy, client, accessToken)
+
+	glog.Infof("create new Config Manager for service (%v) with configuration id (%v), %v rollout strategy",
+		m.serviceName, m.curConfigId(), rolloutStrategy)
+	return m, nil
+}
+
+func (m *ConfigManager) loadAndApplyStartupConfig(rolloutStrategy, configId string) error {
+	if rolloutStrategy == util.ManagedRolloutStrategy {
+		var err error
 		configId, err = m.serviceConfigFetcher.LoadConfigIdFromRollouts()
 		if err != nil {
-			return nil, err
+			return err
 		}
 	}
 
-	if err = m.fetchAndApplyServiceConfig(configId); err != nil {
-		return nil, fmt.Errorf("fail to fetch and apply the startup service config, %v", err)
+	if err := m.fetchAndApplyServiceConfig(configId); err != nil {
+		return fmt.Errorf("fail to fetch and apply the startup service config, %v", err)
 	}
+	return nil
+}
 
-	if rolloutStrategy == util.ManagedRolloutStrategy {
-		m.rolloutIdChangeDetector = sc.NewRolloutIdChangeDetector(client, opts.ServiceControlURL, m.serviceName, accessToken)
-		m.rolloutIdChangeDetector.SetDetectRolloutIdChangeTimer(*checkNewRolloutInterval, func() {
-			latestConfigId, err := m.serviceConfigFetcher.LoadConfigIdFromRollouts()
-			if err != nil {
-				glog.Errorf("error occurred when getting configId by fetching rollout, %v", err)
-				return
-			}
+func (m *ConfigManager) startRolloutDetector(rolloutStrategy string, client *http.Client, accessToken util.GetAccessTokenFunc) {
+	if rolloutStrategy != util.ManagedRolloutStrategy {
+		return
+	}
+	m.rolloutIdChangeDetector = sc.NewRolloutIdChangeDetector(client, m.envoyConfigOptions.ServiceControlURL, m.serviceName, accessToken)
+	m.rolloutIdChangeDetector.SetDetectRolloutIdChangeTimer(*checkNewRolloutInterval, func() {
+		latestConfigId, err := m.serviceConfigFetcher.LoadConfigIdFromRollouts()
+		if err != nil {
+			glog.Errorf("error occurred when getting configId by fetching rollout, %v", err)
+			return
+		}
 
-			if err = m.fetchAndApplyServiceConfig(latestConfigId); err != nil {
-				glog.Errorf("error occurred when fetching and applying new service config, %v", err)
-			}
-		})
+		if err = m.fetchAndApplyServiceConfig(latestConfigId); err != nil {
+			glog.Errorf("error occurred when fetching and applying new service config, %v", err)
+		}
+	})
+}
+
+// restoreSnapshot serves the persisted snapshot of the service, if there is
+// one for the current options and, when given, for the config id.
+func (m *ConfigManager) restoreSnapshot(configId string) bool {
+	if *SnapshotDir == "" {
+		return false
+	}
+	persisted, resources, err := readSnapshot(*SnapshotDir, m.serviceName)
+	if err != nil {
+		if !os.IsNotExist(err) {
+			glog.Warningf("fail to read the persisted snapshot of service %v: %v", m.serviceName, err)
+		}
+		return false
+	}
+	if persisted.OptionsHash != m.optionsHash {
+		glog.Infof("persisted snapshot of service %v was generated with other flags, not serving it", m.serviceName)
+		return false
+	}
+	if configId != "" && persisted.ConfigId != configId {
+		glog.Infof("persisted snapshot of service %v is for configuration id %v, not %v, not serving it",
+			m.serviceName, persisted.ConfigId, configId)
+		return false
 	}
 
-	glog.Infof("create new Config Manager for service (%v) with configuration id (%v), %v rollout strategy",
-		m.serviceName, m.curConfigId(), rolloutStrategy)
-	return m, nil
+	// The version differs from the one of the reconciled snapshot, so Envoy
+	// receives it even if the config id did not change.
+	snapshot, err := cache.NewSnapshot(persistedVersionPrefix+persisted.ConfigId, resources)
+	if err != nil {
+		glog.Warningf("fail to make a snapshot from the persisted one of service %v: %v", m.serviceName, err)
+		return false
+	}
+	if err := m.cache.SetSnapshot(context.Background(), m.envoyConfigOptions.Node, snapshot); err != nil {
+		glog.Warningf("fail to serve the persisted snapshot of service %v: %v", m.serviceName, err)
+		return false
+	}
+	glog.Infof("serving the persisted snapshot of service %v with configuration id %v", m.serviceName, persisted.ConfigId)
+	return true
+}
+
+// reconcileStartupConfig replaces the persisted snapshot with the latest
+// service config, retrying until it succeeds.
+func (m *ConfigManager) reconcileStartupConfig(rolloutStrategy, configId string, client *http.Client, accessToken util.GetAccessTokenFunc) {
+	for {
+		err := m.loadAndApplyStartupConfig(rolloutStrategy, configId)
+		if err == nil {
+			break
+		}
+		glog.Errorf("error occurred when reconciling the persisted snapshot, retrying in %v: %v", *checkNewRolloutInterval, err)
+		time.Sleep(*checkNewRolloutInterval)
+	}
+	glog.Infof("reconciled the persisted snapshot of service %v with configuration id %v", m.serviceName, m.curConfigId())
+	m.startRolloutDetector(rolloutStrategy, client, accessToken)
 }
 
 func (m *ConfigManager) fetchAndApplyServiceConfig(latestConfigId string) error {
@@ -231,9 +350,35 @@ func (m *ConfigManager) applyServiceConfig(serviceConfig *confpb.Service) error
 		return fmt.Errorf("applid service config is empty")
 	}
 
-	var err error
+	// Synced before taking mu, as a new JWKS is fetched before Sync returns,
+	// and a slow provider must not block the refreshes of the other JWKS.
+	if m.jwksManager != nil {
+		m.jwksManager.Sync(jwksUris(serviceConfig))
+	}
+
+	m.mu.Lock()
+	defer m.mu.Unlock()
 	m.curServiceConfig = serviceConfig
-	m.serviceInfo, err = configinfo.NewServiceInfoFromServiceConfig(serviceConfig, serviceConfig.Id, m.envoyConfigOptions)
+	return m.updateSnapshot()
+}
+
+// onJwksChange serves a snapshot with the refreshed JWKS.
+func (m *ConfigManager) onJwksChange() {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.curServiceConfig == nil {
+		return
+	}
+	if err := m.updateSnapshot(); err != nil {
+		glog.Errorf("fail to update the snapshot with the refreshed JWKS: %v", err)
+	}
+}
+
+// updateSnapshot generates and serves the snapshot of the current service
+// config. Must be called with mu held.
+func (m *ConfigManager) updateSnapshot() error {
+	var err error
+	m.serviceInfo, err = configinfo.NewServiceInfoFromServiceConfig(m.curServiceConfig, m.curServiceConfig.Id, m.envoyConfigOptions)
 	if err != nil {
 		return fmt.Errorf("fail to initialize ServiceInfo, %s", err)
 	}
@@ -247,20 +392,39 @@ func (m *ConfigManager) applyServiceConfig(serviceConfig *confpb.Service) error
 		}
 	}
 
-	snapshot, err := m.makeSnapshot()
+	if m.jwksManager != nil {
+		m.serviceInfo.LocalJwks = m.localJwks()
+	}
+
+	snapshot, resources, err := m.makeSnapshot()
 	if err != nil {
 		return fmt.Errorf("fail to make a snapshot, %s", err)
 	}
-	return m.cache.SetSnapshot(context.Background(), m.envoyConfigOptions.Node, snapshot)
+	if err := m.cache.SetSnapshot(context.Background(), m.envoyConfigOptions.Node, snapshot); err != nil {
+		return err
+	}
+
+	// Only persisted once served, so a snapshot Envoy never received is not
+	// served on the next start.
+	if *SnapshotDir != "" {
+		if err := writeSnapshot(*SnapshotDir, &persistedSnapshot{
+			ServiceName: m.serviceName,
+			ConfigId:    m.curConfigId(),
+			OptionsHash: m.optionsHash,
+		}, resources); err != nil {
+			glog.Warningf("fail to persist the snapshot of service %v: %v", m.serviceName, err)
+		}
+	}
+	return nil
 }
 
-func (m *ConfigManager) makeSnapshot() (*cache.Snapshot, error) {
+func (m *ConfigManager) makeSnapshot() (*cache.Snapshot, map[rsrc.Type][]types.Resource, error) {
 	m.Infof("making configuration for api: %v", m.serviceInfo.Name)
 
 	var clusterResources, listenerResources []types.Resource
 	clusters, err := gen.MakeClusters(m.serviceInfo)
 	if err != nil {
-		return nil, err
+		return nil, nil, err
 	}
 	for i := range clusters {
 		clusterResources = append(clusterResources, clusters[i])
@@ -269,21 +433,61 @@ func (m *ConfigManager) makeSnapshot() (*cache.Snapshot, error) {
 	m.Infof("adding Listeners configuration for api: %v", m.serviceInfo.Name)
 	listeners, err := gen.MakeListeners(m.serviceInfo)
 	if err != nil {
-		return nil, err
+		return nil, nil, err
 	}
 	for _, lis := range listeners {
 		listenerResources = append(listenerResources, lis)
 	}
 
-	snapshot, err := cache.NewSnapshot(m.curConfigId(), map[rsrc.Type][]types.Resource{
+	resources := map[rsrc.Type][]types.Resource{
 		rsrc.ListenerType: listenerResources,
 		rsrc.ClusterType:  clusterResources,
-	})
+	}
+	snapshot, err := cache.NewSnapshot(m.snapshotVersion(), resources)
 	if err != nil {
-		return nil, err
+		return nil, nil, err
 	}
 	m.Infof("Envoy Dynamic Configuration is cached for service: %v", m.serviceName)
-	return snapshot, nil
+	return snapshot, resources, nil
+}
+
+// jwksUris returns the jwks uris of the JWT providers of the service.
+func jwksUris(serviceConfig *confpb.Service) []string {
+	var uris []string
+	for _, provider := range serviceConfig.GetAuthentication().GetProviders() {
+		uris = append(uris, provider.GetJwksUri())
+	}
+	return uris
+}
+
+// localJwks returns the JWKS of the JWT providers of the service fetched by
+// the jwks manager, by jwks uri.
+func (m *ConfigManager) localJwks() map[string]string {
+	localJwks := make(map[string]string)
+	for _, uri := range jwksUris(m.curServiceConfig) {
+		if jwks := m.jwksManager.Get(uri); jwks != "" {
+			localJwks[uri] = jwks
+		}
+	}
+	return localJwks
+}
+
+// snapshotVersion returns the config id, suffixed with a hash of the local
+// JWKS if any, so a refreshed JWKS is pushed to Envoy.
+func (m *ConfigManager) snapshotVersion() string {
+	if len(m.serviceInfo.LocalJwks) == 0 {
+		return m.curConfigId()
+	}
+	var uris []string
+	for uri := range m.serviceInfo.LocalJwks {
+		uris = append(uris, uri)
+	}
+	sort.Strings(uris)
+	h := sha256.New()
+	for _, uri := range uris {
+		fmt.Fprintf(h, "%s\x00%s\x00", uri, m.serviceInfo.LocalJwks[uri])
+	}
+	return m.curConfigId() + "-jwks-" + hex.EncodeToString(h.Sum(nil))[:12]
 }
 
 func (m *ConfigManager) curConfigId() string {
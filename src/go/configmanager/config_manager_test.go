@@ -17,11 +17,14 @@ import (
 	"context"
 	"flag"
 	"fmt"
+	"io/ioutil"
 	"net/http"
 	"net/http/httptest"
+	"os"
 	"sort"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"testing"
 	"time"
 
@@ -258,6 +261,212 @@ func TestRetryCallServiceManagement(t *testing.T) {
 	}
 }
 
+func TestPersistedSnapshot(t *testing.T) {
+	var fakeConfig, fakeScReport, fakeRollouts safeData
+	if err := genProtoBinary(testdata.FakeServiceConfigForGrpcWithTranscoding, new(confpb.Service), &fakeConfig); err != nil {
+		t.Fatalf("generate fake service config failed: %v", err)
+	}
+	wantedListeners := testdata.WantedListsenerForGrpcWithTranscoding
+
+	snapshotDir, err := ioutil.TempDir("", "xds_snapshot")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(snapshotDir)
+	_ = flag.Set("xds_snapshot_dir", snapshotDir)
+	defer flag.Set("xds_snapshot_dir", "")
+
+	opts := options.DefaultConfigGeneratorOptions()
+	opts.BackendAddress = "grpc://127.0.0.1:80"
+	opts.TracingProjectId = "fake-project-id"
+	opts.DisableTracing = true
+
+	// Service Management can be made unavailable.
+	var available int32 = 1
+	var originalInitMockServer = initMockServer
+	defer func() { initMockServer = originalInitMockServer }()
+	initMockServer = func(t *testing.T, config *safeData) *httptest.Server {
+		return httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+			if atomic.LoadInt32(&available) == 0 {
+				w.WriteHeader(http.StatusInternalServerError)
+				return
+			}
+			w.Header().Set("Content-Type", "application/json")
+			_, _ = w.Write(config.read())
+		}))
+	}
+
+	setFlags(testdata.TestFetchListenersProjectName, testdata.TestFetchListenersConfigID, util.FixedRolloutStrategy, "100ms", "")
+
+	// The first start fetches the service config and persists the snapshot.
+	runTest(t, &fakeScReport, &fakeRollouts, &fakeConfig, opts, func(configManager *ConfigManager, err error) {
+		if err != nil {
+			t.Fatal(err)
+		}
+		path := snapshotPath(snapshotDir, testdata.TestFetchListenersProjectName)
+		if _, err := os.Stat(path); err != nil {
+			t.Fatalf("snapshot was not persisted: %v", err)
+		}
+
+		// A snapshot that could not be served is not persisted.
+		if err := os.Remove(path); err != nil {
+			t.Fatal(err)
+		}
+		servingCache := configManager.cache
+		configManager.cache = &failingSnapshotCache{SnapshotCache: servingCache}
+		configManager.mu.Lock()
+		serviceConfig := configManager.curServiceConfig
+		configManager.mu.Unlock()
+		if err := configManager.applyServiceConfig(serviceConfig); err == nil {
+			t.Errorf("expected the update to fail when the snapshot is not served")
+		}
+		if _, err := os.Stat(path); !os.IsNotExist(err) {
+			t.Errorf("the snapshot that was not served was persisted: %v", err)
+		}
+
+		// Persisted again once it is served.
+		configManager.cache = servingCache
+		if err := configManager.applyServiceConfig(serviceConfig); err != nil {
+			t.Fatal(err)
+		}
+		if _, err := os.Stat(path); err != nil {
+			t.Fatalf("snapshot was not persisted: %v", err)
+		}
+	})
+
+	// Service Management is unavailable on restart: the persisted snapshot is
+	// served, and replaced once Service Management is back.
+	atomic.StoreInt32(&available, 0)
+	runTest(t, &fakeScReport, &fakeRollouts, &fakeConfig, opts, func(configManager *ConfigManager, err error) {
+		if err != nil {
+			t.Fatal(err)
+		}
+
+		_, resp, gotListeners, err := getListeners(configManager, opts)
+		if err != nil {
+			t.Fatal(err)
+		}
+		version, _ := resp.GetVersion()
+		if want := persistedVersionPrefix + testdata.TestFetchListenersConfigID; version != want {
+			t.Errorf("restored snapshot got version: %v, want: %v", version, want)
+		}
+		if err := util.JsonEqual(wantedListeners, gotListeners); err != nil {
+			t.Errorf("restored snapshot got unexpected Listeners, %v", err)
+		}
+
+		atomic.StoreInt32(&available, 1)
+		deadline := time.Now().Add(5 * time.Second)
+		for version != testdata.TestFetchListenersConfigID {
+			if time.Now().After(deadline) {
+				t.Fatalf("persisted snapshot was not reconciled, got version: %v", version)
+			}
+			time.Sleep(50 * time.Millisecond)
+			if _, resp, _, err = getListeners(configManager, opts); err != nil {
+				t.Fatal(err)
+			}
+			version, _ = resp.GetVersion()
+		}
+	})
+
+	// The persisted snapshot is not served for another config id, or when it
+	// was generated with other flags.
+	atomic.StoreInt32(&available, 0)
+	setFlags(testdata.TestFetchListenersProjectName, "2017-05-01r1", util.FixedRolloutStrategy, "100ms", "")
+	runTest(t, &fakeScReport, &fakeRollouts, &fakeConfig, opts, func(configManager *ConfigManager, err error) {
+		if err == nil {
+			t.Errorf("expected the startup to fail for another config id")
+		}
+	})
+	setFlags(testdata.TestFetchListenersProjectName, testdata.TestFetchListenersConfigID, util.FixedRolloutStrategy, "100ms", "")
+	opts.BackendAddress = "grpc://127.0.0.1:81"
+	runTest(t, &fakeScReport, &fakeRollouts, &fakeConfig, opts, func(configManager *ConfigManager, err error) {
+		if err == nil {
+			t.Errorf("expected the startup to fail with other flags")
+		}
+	})
+}
+
+func TestJwksFetchDoesNotBlockRefreshes(t *testing.T) {
+	started := make(chan struct{}, 1)
+	release := make(chan struct{})
+	var releaseOnce sync.Once
+	unblock := func() { releaseOnce.Do(func() { close(release) }) }
+	// The provider hangs until released.
+	provider := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		select {
+		case started <- struct{}{}:
+		default:
+		}
+		<-release
+		_, _ = w.Write([]byte(fakeJwks))
+	}))
+	defer provider.Close()
+	defer unblock()
+
+	dir, err := ioutil.TempDir("", "managed_jwks")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	m := &ConfigManager{envoyConfigOptions: options.DefaultConfigGeneratorOptions()}
+	m.cache = cache.NewSnapshotCache(true, m, m)
+	if m.jwksManager, err = newJwksManager(dir, provider.Client(), 5*time.Minute, m.onJwksChange); err != nil {
+		t.Fatal(err)
+	}
+	defer m.jwksManager.Stop()
+
+	serviceConfig := &confpb.Service{
+		Name: testdata.TestFetchListenersProjectName,
+		Id:   testdata.TestFetchListenersConfigID,
+		Authentication: &confpb.Authentication{
+			Providers: []*confpb.AuthProvider{
+				{
+					Id:      "provider",
+					JwksUri: provider.URL,
+				},
+			},
+		},
+	}
+	applied := make(chan struct{})
+	go func() {
+		_ = m.applyServiceConfig(serviceConfig)
+		close(applied)
+	}()
+	select {
+	case <-started:
+	case <-time.After(5 * time.Second):
+		t.Fatal("the JWKS was not fetched")
+	}
+
+	// The refresh of another JWKS is not blocked by the fetch of the new one.
+	refreshed := make(chan struct{})
+	go func() {
+		m.onJwksChange()
+		close(refreshed)
+	}()
+	select {
+	case <-refreshed:
+	case <-time.After(5 * time.Second):
+		t.Fatal("the JWKS refresh was blocked by the fetch of a new JWKS")
+	}
+
+	unblock()
+	<-applied
+	if got := m.jwksManager.Get(provider.URL); got != fakeJwks {
+		t.Errorf("got jwks: %v, want: %v", got, fakeJwks)
+	}
+}
+
+// failingSnapshotCache fails to serve any snapshot.
+type failingSnapshotCache struct {
+	cache.SnapshotCache
+}
+
+func (c *failingSnapshotCache) SetSnapshot(ctx context.Context, node string, snapshot cache.ResourceSnapshot) error {
+	return fmt.Errorf("fail to set the snapshot")
+}
+
 func getListeners(configManager *ConfigManager, opts options.ConfigGeneratorOptions) (*cache.Request, cache.Response, string, error) {
 	if configManager == nil {
 		return nil, nil, "", fmt.Errorf("configmanager is empty")
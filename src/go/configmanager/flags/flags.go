@@ -90,7 +90,10 @@ var (
 	ServiceAccountKey = flag.String("service_account_key", defaults.ServiceAccountKey, `Use the service account key JSON file to access the service control and the
 	service management.  You can also set {creds_key} environment variable to the location of the service account credentials JSON file. If the option is
   omitted, the proxy contacts the metadata service to fetch an access token`)
-	TokenAgentPort = flag.Uint("token_agent_port", defaults.TokenAgentPort, "Port that configmanager use to setup server to provide envoy with access token using service account credential, for accessing servicecontrol.")
+	TokenAgentPort    = flag.Uint("token_agent_port", defaults.TokenAgentPort, "Port that configmanager use to setup server to provide envoy with access token using service account credential, for accessing servicecontrol.")
+	TokenBrokerSocket = flag.String("token_broker_socket", defaults.TokenBrokerSocket, `Unix domain socket of the node-local token broker. If set, the proxy fetches
+  the access and identity tokens of the metadata server from the broker instead of the metadata server, so all the proxies of a node share them.
+  Not used with --service_account_key or with IAM credentials.`)
 
 	// Flags for external calls.
 	DisableOidcDiscovery = flag.Bool("disable_oidc_discovery", defaults.DisableOidcDiscovery, `Disable OpenID Connect Discovery. 
@@ -154,6 +157,35 @@ Normally JWT based64 encode doesn’t add padding. If this flag is true, the hea
 	ScQuotaRetries  = flag.Int("service_control_quota_retries", defaults.ScQuotaRetries, `Set the retry times for service control Quota request. Must be >= 0 and the default is 1 if not set.`)
 	ScReportRetries = flag.Int("service_control_report_retries", defaults.ScReportRetries, `Set the retry times for service control Report request. Must be >= 0 and the default is 5 if not set.`)
 
+	HotRestartHandoffDir = flag.String("hot_restart_handoff_dir", defaults.HotRestartHandoffDir, `If set, the service control filter writes the report and quota requests it could not send before being destroyed to this directory,
+	and the filter of the next hot restart epoch sends them during --hot_restart_take_over_window. The quota requests older than 10 seconds are dropped. It must be shared by all the Envoy processes on the node.`)
+	HotRestartTakeOverWindow = flag.Duration("hot_restart_take_over_window", defaults.HotRestartTakeOverWindow, `How long the filter of the next hot restart epoch takes the pending state in --hot_restart_handoff_dir over after it is created.
+	The previous epoch hands it off when it exits, so it must be longer than the --parent-shutdown-time-s of Envoy. If 0, the default of 16m is used.`)
+
+	LearnApiKeyRestrictions = flag.Bool("learn_api_key_restrictions", defaults.LearnApiKeyRestrictions, `If true, the service control filter learns which API keys have no IP or referer restriction,
+	and sends their check and quota requests with a fixed client IP and referer, so they are cached once per API key instead of once per client IP and referer.`)
+
+	CheckCachePeers = flag.String("check_cache_peers", defaults.CheckCachePeers, `If set, the check responses are shared with the ESPv2 replicas at these comma-separated host:port addresses,
+	which must include this replica and be the same on all of them. Each replica serves the responses it owns on --check_cache_peer_address and --check_cache_peer_port,
+	which must only be reachable by the replicas. Requires --check_cache_peer_secret_file.`)
+	CheckCachePeerAddress = flag.String("check_cache_peer_address", defaults.CheckCachePeerAddress, `Address that configmanager serves the peer check cache on, if --check_cache_peers is set.
+	Set it to the internal address of this replica, such as the pod IP, that the peers reach it at.`)
+	CheckCachePeerPort       = flag.Uint("check_cache_peer_port", defaults.CheckCachePeerPort, "Port that configmanager serves the peer check cache on, if --check_cache_peers is set.")
+	CheckCachePeerSecretFile = flag.String("check_cache_peer_secret_file", defaults.CheckCachePeerSecretFile, `Path to the file of the secret shared by the replicas, required if --check_cache_peers is set.
+	The peer check cache calls and the check responses they share are authenticated with an HMAC of this secret.`)
+	CheckCachePeerTtl     = flag.Duration("check_cache_peer_ttl", defaults.CheckCachePeerTtl, "How long a check response published to the peer check cache is served.")
+	CheckCachePeerTimeout = flag.Duration("check_cache_peer_timeout", defaults.CheckCachePeerTimeout, "The timeout of the peer check cache calls. On a timeout, Service Control is called.")
+
+	PinnedCheckApiKeySha256 = flag.String("pinned_check_api_key_sha256", defaults.PinnedCheckApiKeySha256, `Comma-separated hex encoded SHA-256 digests of the API keys of priority consumers.
+	Their check responses are held outside of the check cache, and are refreshed ahead of their expiry while they are used.`)
+	PinnedCheckConsumerNumbers = flag.String("pinned_check_consumer_numbers", defaults.PinnedCheckConsumerNumbers, `Comma-separated consumer project numbers of priority consumers.
+	Their check responses are held outside of the check cache, and are refreshed ahead of their expiry while they are used.`)
+	PinnedCheckTtl = flag.Duration("pinned_check_ttl", defaults.PinnedCheckTtl, "How long a pinned check response of a priority consumer is served. It must be at least 20s.")
+
+	DeniedReportRollupThreshold = flag.Uint("denied_report_rollup_threshold", defaults.DeniedReportRollupThreshold, `The number of reports of denied requests each Envoy worker sends as is per --denied_report_rollup_interval.
+	Above it, the reports are rolled up into one report per operation and denial reason. If 0, the default of 100 is used.`)
+	DeniedReportRollupInterval = flag.Duration("denied_report_rollup_interval", defaults.DeniedReportRollupInterval, "The interval the reports of denied requests are rolled up over. If 0, the default of 1s is used.")
+
 	ComputePlatformOverride = flag.String("compute_platform_override", defaults.ComputePlatformOverride, "the overridden platform where the proxy is running at")
 
 	// Flags for testing purpose. They are not exposed to the user via start_proxy.py
@@ -205,7 +237,12 @@ Normally JWT based64 encode doesn’t add padding. If this flag is true, the hea
         policies set in "--backend_retry_ons".
         The format is a comma-delimited String, like "501, 503`)
 
-	EnableResponseCompression = flag.Bool("enable_response_compression", defaults.EnableResponseCompression, `Enable gzip,br compression for response data. The default is disabled.`)
+	EnableResponseCompression       = flag.Bool("enable_response_compression", defaults.EnableResponseCompression, `Enable gzip,br compression for response data. The default is disabled.`)
+	ResponseCompressionMinSize      = flag.Uint("response_compression_min_size", defaults.ResponseCompressionMinSize, `Minimum response size in bytes to be compressed. Only takes effect when --enable_response_compression is set. If 0, the Envoy default of 30 bytes is used.`)
+	ResponseCompressionContentTypes = flag.String("response_compression_content_types", defaults.ResponseCompressionContentTypes, `Comma separated content types of the responses to compress. Only takes effect when --enable_response_compression is set. If empty, the Envoy default list of text, json and xml types is used.`)
+	ResponseCompressionOperations   = flag.String("response_compression_operations", defaults.ResponseCompressionOperations, `Semicolon separated per-operation compression policies, in the form of "selector=policy". The policy is "off" to not compress the responses of the operation, or "gzip" or "br" to only compress them with that algorithm. Streaming gRPC operations are never compressed. Only takes effect when --enable_response_compression is set.`)
+
+	TrustedJwtCallers = flag.String("trusted_jwt_callers", defaults.TrustedJwtCallers, `Semicolon separated trusted JWT callers of the operations, in the form of "selector=issuer,audience[,audience...]". The requests to the operation with a JWT verified from the issuer, for one of the audiences, skip the Service Control check and quota calls, even without an API key. They are still reported. The operation must require JWT authentication.`)
 
 	ClientIPFromForwardedHeader = flag.Bool("client_ip_from_forwarded_header", defaults.ClientIPFromForwardedHeader, `If true, extract client ip from "forwarded" header. The default false.`)
 
@@ -261,6 +298,7 @@ func EnvoyConfigOptionsFromFlags() options.ConfigGeneratorOptions {
 		EnableOperationNameHeader:                     *EnableOperationNameHeader,
 		ServiceAccountKey:                             *ServiceAccountKey,
 		TokenAgentPort:                                *TokenAgentPort,
+		TokenBrokerSocket:                             *TokenBrokerSocket,
 		DisableOidcDiscovery:                          *DisableOidcDiscovery,
 		DependencyErrorBehavior:                       *DependencyErrorBehavior,
 		SkipJwtAuthnFilter:                            *SkipJwtAuthnFilter,
@@ -297,6 +335,20 @@ func EnvoyConfigOptionsFromFlags() options.ConfigGeneratorOptions {
 		ScCheckRetries:                                *ScCheckRetries,
 		ScQuotaRetries:                                *ScQuotaRetries,
 		ScReportRetries:                               *ScReportRetries,
+		HotRestartHandoffDir:                          *HotRestartHandoffDir,
+		HotRestartTakeOverWindow:                      *HotRestartTakeOverWindow,
+		LearnApiKeyRestrictions:                       *LearnApiKeyRestrictions,
+		CheckCachePeers:                               *CheckCachePeers,
+		CheckCachePeerAddress:                         *CheckCachePeerAddress,
+		CheckCachePeerPort:                            *CheckCachePeerPort,
+		CheckCachePeerSecretFile:                      *CheckCachePeerSecretFile,
+		CheckCachePeerTtl:                             *CheckCachePeerTtl,
+		CheckCachePeerTimeout:                         *CheckCachePeerTimeout,
+		PinnedCheckApiKeySha256:                       *PinnedCheckApiKeySha256,
+		PinnedCheckConsumerNumbers:                    *PinnedCheckConsumerNumbers,
+		PinnedCheckTtl:                                *PinnedCheckTtl,
+		DeniedReportRollupThreshold:                   *DeniedReportRollupThreshold,
+		DeniedReportRollupInterval:                    *DeniedReportRollupInterval,
 		BackendClusterMaxRequests:                     *BackendClusterMaxRequests,
 		TranscodingAlwaysPrintPrimitiveFields:         *TranscodingAlwaysPrintPrimitiveFields,
 		TranscodingAlwaysPrintEnumsAsInts:             *TranscodingAlwaysPrintEnumsAsInts,
@@ -308,7 +360,11 @@ func EnvoyConfigOptionsFromFlags() options.ConfigGeneratorOptions {
 		TranscodingMatchUnregisteredCustomVerb:        *TranscodingMatchUnregisteredCustomVerb,
 		TranscodingCaseInsensitiveEnumParsing:         *TranscodingCaseInsensitiveEnumParsing,
 		EnableResponseCompression:                     *EnableResponseCompression,
+		ResponseCompressionMinSize:                    *ResponseCompressionMinSize,
+		ResponseCompressionContentTypes:               *ResponseCompressionContentTypes,
+		ResponseCompressionOperations:                 *ResponseCompressionOperations,
 		ClientIPFromForwardedHeader:                   *ClientIPFromForwardedHeader,
+		TrustedJwtCallers:                             *TrustedJwtCallers,
 
 		// These options are not for ESPv2 users. They are overridden internally.
 		APIAllowList:       []string{},
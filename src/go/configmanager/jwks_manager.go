@@ -0,0 +1,338 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package configmanager
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"encoding/pem"
+	"fmt"
+	"io/ioutil"
+	"net/http"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/golang/glog"
+)
+
+const (
+	// Bounds of the refresh interval of a JWKS, whatever its Cache-Control.
+	jwksMinRefreshInterval = 30 * time.Second
+	jwksMaxRefreshInterval = 24 * time.Hour
+	// Interval between the fetches of a JWKS that could not be fetched.
+	jwksRetryInterval = 10 * time.Second
+)
+
+// jwksEntry is a JWKS, and its on-disk format.
+type jwksEntry struct {
+	Uri  string `json:"uri"`
+	Jwks string `json:"jwks"`
+	// When the JWKS should be fetched again, from its Cache-Control.
+	Expires time.Time `json:"expires"`
+
+	timer *time.Timer
+}
+
+// jwksManager fetches the JWKS of the JWT providers, so they can be given to
+// Envoy as local JWKS and JWTs are verified from the first request, instead
+// of after Envoy fetched them.
+//
+// Each JWKS is fetched again when its Cache-Control max-age expires, and is
+// persisted in a directory, so it is available on restart even if the
+// provider is down.
+type jwksManager struct {
+	dir    string
+	client *http.Client
+	// The refresh interval of the JWKS without a Cache-Control max-age.
+	defaultRefreshInterval time.Duration
+	minRefreshInterval     time.Duration
+	retryInterval          time.Duration
+	// Called, without any lock held, when a JWKS changed after a refresh.
+	onChange func()
+
+	// Serializes the syncs, which fetch the JWKS without holding mu.
+	syncMu sync.Mutex
+
+	mu sync.Mutex
+	// By JWKS uri.
+	entries map[string]*jwksEntry
+}
+
+func newJwksManager(dir string, client *http.Client, defaultRefreshInterval time.Duration, onChange func()) (*jwksManager, error) {
+	if err := os.MkdirAll(dir, 0755); err != nil {
+		return nil, fmt.Errorf("fail to create the JWKS directory: %v", err)
+	}
+	return &jwksManager{
+		dir:                    dir,
+		client:                 client,
+		defaultRefreshInterval: defaultRefreshInterval,
+		minRefreshInterval:     jwksMinRefreshInterval,
+		retryInterval:          jwksRetryInterval,
+		onChange:               onChange,
+		entries:                make(map[string]*jwksEntry),
+	}, nil
+}
+
+// Sync starts managing the JWKS of the uris, and stops managing the others.
+//
+// The JWKS of a new uri is read from disk, and fetched again in the
+// background if it expired. If it is not on disk, it is fetched before Sync
+// returns, and in the background again until it succeeds if the fetch fails.
+func (j *jwksManager) Sync(uris []string) {
+	j.syncMu.Lock()
+	defer j.syncMu.Unlock()
+
+	wanted := make(map[string]bool, len(uris))
+	var added []string
+	j.mu.Lock()
+	for _, uri := range uris {
+		if wanted[uri] {
+			continue
+		}
+		wanted[uri] = true
+		if _, ok := j.entries[uri]; !ok {
+			added = append(added, uri)
+		}
+	}
+	for uri, entry := range j.entries {
+		if !wanted[uri] {
+			entry.timer.Stop()
+			delete(j.entries, uri)
+		}
+	}
+	j.mu.Unlock()
+
+	// The JWKS of the new uris are read and fetched without holding mu, so
+	// Get and the refreshes are not blocked by a provider that is down. The
+	// providers are fetched concurrently, so that one down does not delay the
+	// others.
+	loaded := make([]*jwksEntry, len(added))
+	var wg sync.WaitGroup
+	for i, uri := range added {
+		entry, err := j.read(uri)
+		if err == nil {
+			glog.Infof("using the persisted JWKS of %v, expiring at %v", uri, entry.Expires)
+			loaded[i] = entry
+			continue
+		}
+		if !os.IsNotExist(err) {
+			glog.Warningf("fail to read the persisted JWKS of %v: %v", uri, err)
+		}
+
+		wg.Add(1)
+		go func(i int, uri string) {
+			defer wg.Done()
+			entry, err := j.fetch(uri)
+			if err != nil {
+				glog.Warningf("fail to fetch the JWKS of %v, Envoy will fetch it until it is fetched: %v", uri, err)
+				loaded[i] = &jwksEntry{Uri: uri}
+				return
+			}
+			j.write(entry)
+			loaded[i] = entry
+		}(i, uri)
+	}
+	wg.Wait()
+
+	j.mu.Lock()
+	defer j.mu.Unlock()
+	for _, entry := range loaded {
+		j.entries[entry.Uri] = entry
+		if entry.Jwks == "" {
+			j.schedule(entry, j.retryInterval)
+		} else {
+			j.schedule(entry, time.Until(entry.Expires))
+		}
+	}
+}
+
+// Get returns the JWKS of the uri, or "" if it was never fetched.
+func (j *jwksManager) Get(uri string) string {
+	j.mu.Lock()
+	defer j.mu.Unlock()
+	if entry, ok := j.entries[uri]; ok {
+		return entry.Jwks
+	}
+	return ""
+}
+
+// Stop stops refreshing the JWKS.
+func (j *jwksManager) Stop() {
+	j.Sync(nil)
+}
+
+// schedule refreshes the entry after the delay. Must be called with mu held.
+func (j *jwksManager) schedule(entry *jwksEntry, delay time.Duration) {
+	if delay < 0 {
+		delay = 0
+	}
+	entry.timer = time.AfterFunc(delay, func() {
+		j.refresh(entry)
+	})
+}
+
+func (j *jwksManager) refresh(entry *jwksEntry) {
+	fetched, err := j.fetch(entry.Uri)
+
+	j.mu.Lock()
+	if j.entries[entry.Uri] != entry {
+		// The uri stopped being managed, or was managed again, meanwhile.
+		j.mu.Unlock()
+		return
+	}
+	if err != nil {
+		glog.Warningf("fail to refresh the JWKS of %v, retrying in %v: %v", entry.Uri, j.retryInterval, err)
+		j.schedule(entry, j.retryInterval)
+		j.mu.Unlock()
+		return
+	}
+	changed := fetched.Jwks != entry.Jwks
+	j.write(fetched)
+	j.entries[entry.Uri] = fetched
+	j.schedule(fetched, time.Until(fetched.Expires))
+	j.mu.Unlock()
+
+	if changed {
+		glog.Infof("the JWKS of %v changed", entry.Uri)
+		j.onChange()
+	}
+}
+
+func (j *jwksManager) fetch(uri string) (*jwksEntry, error) {
+	resp, err := j.client.Get(uri)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	body, err := ioutil.ReadAll(resp.Body)
+	if err != nil {
+		return nil, err
+	}
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("fetching the JWKS returns not 200 OK: %v", resp.Status)
+	}
+
+	// Rejected, such as an error page served with 200 OK, so the last good
+	// JWKS is kept.
+	if err := validateJwks(body); err != nil {
+		return nil, fmt.Errorf("the response is not a JWKS: %v: %.100q", err, body)
+	}
+
+	return &jwksEntry{
+		Uri:     uri,
+		Jwks:    string(body),
+		Expires: time.Now().Add(j.refreshInterval(resp.Header.Get("Cache-Control"))),
+	}, nil
+}
+
+// validateJwks checks the JWKS is one Envoy accepts: a JWKS with keys, or an
+// object of PEM certificates by key id.
+func validateJwks(body []byte) error {
+	var fields map[string]json.RawMessage
+	if err := json.Unmarshal(body, &fields); err != nil {
+		return err
+	}
+
+	if rawKeys, ok := fields["keys"]; ok {
+		var keys []struct {
+			Kty string `json:"kty"`
+		}
+		if err := json.Unmarshal(rawKeys, &keys); err != nil {
+			return fmt.Errorf("invalid keys: %v", err)
+		}
+		if len(keys) == 0 {
+			return fmt.Errorf("no keys")
+		}
+		for i, key := range keys {
+			if key.Kty == "" {
+				return fmt.Errorf("key %d has no kty", i)
+			}
+		}
+		return nil
+	}
+
+	if len(fields) == 0 {
+		return fmt.Errorf("no keys")
+	}
+	for kid, raw := range fields {
+		var cert string
+		if err := json.Unmarshal(raw, &cert); err != nil {
+			return fmt.Errorf("key %q is not a PEM certificate", kid)
+		}
+		if block, _ := pem.Decode([]byte(cert)); block == nil || block.Type != "CERTIFICATE" {
+			return fmt.Errorf("key %q is not a PEM certificate", kid)
+		}
+	}
+	return nil
+}
+
+// refreshInterval returns the interval to fetch the JWKS again, from the
+// max-age of its Cache-Control.
+func (j *jwksManager) refreshInterval(cacheControl string) time.Duration {
+	interval := j.defaultRefreshInterval
+	for _, directive := range strings.Split(cacheControl, ",") {
+		directive = strings.ToLower(strings.TrimSpace(directive))
+		switch {
+		case directive == "no-cache" || directive == "no-store":
+			return j.minRefreshInterval
+		case strings.HasPrefix(directive, "max-age="):
+			if s, err := strconv.Atoi(strings.TrimPrefix(directive, "max-age=")); err == nil {
+				interval = time.Duration(s) * time.Second
+			}
+		}
+	}
+	if interval < j.minRefreshInterval {
+		return j.minRefreshInterval
+	}
+	if interval > jwksMaxRefreshInterval {
+		return jwksMaxRefreshInterval
+	}
+	return interval
+}
+
+func (j *jwksManager) path(uri string) string {
+	sum := sha256.Sum256([]byte(uri))
+	return filepath.Join(j.dir, hex.EncodeToString(sum[:16])+".jwks.json")
+}
+
+func (j *jwksManager) read(uri string) (*jwksEntry, error) {
+	b, err := ioutil.ReadFile(j.path(uri))
+	if err != nil {
+		return nil, err
+	}
+	entry := &jwksEntry{}
+	if err := json.Unmarshal(b, entry); err != nil {
+		return nil, fmt.Errorf("fail to unmarshal the persisted JWKS: %v", err)
+	}
+	if entry.Uri != uri || entry.Jwks == "" {
+		return nil, fmt.Errorf("the persisted JWKS is for %q, not %q", entry.Uri, uri)
+	}
+	return entry, nil
+}
+
+func (j *jwksManager) write(entry *jwksEntry) {
+	b, err := json.Marshal(entry)
+	if err == nil {
+		err = writeFileAtomic(j.path(entry.Uri), b)
+	}
+	if err != nil {
+		glog.Warningf("fail to persist the JWKS of %v: %v", entry.Uri, err)
+	}
+}
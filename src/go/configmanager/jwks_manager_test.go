@@ -0,0 +1,269 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package configmanager
+
+import (
+	"io/ioutil"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+const fakeJwks = `{"keys":[{"kty":"RSA","kid":"1","n":"abc","e":"AQAB"}]}`
+
+func TestJwksManager(t *testing.T) {
+	var down, fetches int32
+	var keys atomic.Value
+	keys.Store(fakeJwks)
+	provider := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		atomic.AddInt32(&fetches, 1)
+		if atomic.LoadInt32(&down) != 0 {
+			w.WriteHeader(http.StatusServiceUnavailable)
+			return
+		}
+		w.Header().Set("Cache-Control", "public, max-age=3600")
+		_, _ = w.Write([]byte(keys.Load().(string)))
+	}))
+	defer provider.Close()
+
+	dir, err := ioutil.TempDir("", "managed_jwks")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	changed := make(chan struct{}, 1)
+	j, err := newJwksManager(dir, provider.Client(), 5*time.Minute, func() { changed <- struct{}{} })
+	if err != nil {
+		t.Fatal(err)
+	}
+	j.Sync([]string{provider.URL})
+	if got := j.Get(provider.URL); got != fakeJwks {
+		t.Fatalf("got jwks: %v, want: %v", got, fakeJwks)
+	}
+	if got := time.Until(j.entries[provider.URL].Expires); got < 59*time.Minute || got > time.Hour {
+		t.Errorf("got the jwks expiring in %v, want the max-age", got)
+	}
+	j.Stop()
+
+	// The provider is down on restart: the persisted jwks is used.
+	atomic.StoreInt32(&down, 1)
+	atomic.StoreInt32(&fetches, 0)
+	restarted, err := newJwksManager(dir, provider.Client(), 5*time.Minute, func() {})
+	if err != nil {
+		t.Fatal(err)
+	}
+	restarted.Sync([]string{provider.URL})
+	defer restarted.Stop()
+	if got := restarted.Get(provider.URL); got != fakeJwks {
+		t.Errorf("got the persisted jwks: %v, want: %v", got, fakeJwks)
+	}
+	if got := atomic.LoadInt32(&fetches); got != 0 {
+		t.Errorf("got %v fetches of the persisted jwks, want 0", got)
+	}
+
+	// A jwks which could not be fetched is retried until it is.
+	empty, err := ioutil.TempDir("", "managed_jwks_empty")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(empty)
+	retried, err := newJwksManager(empty, provider.Client(), 5*time.Minute, func() { changed <- struct{}{} })
+	if err != nil {
+		t.Fatal(err)
+	}
+	retried.retryInterval = 10 * time.Millisecond
+	retried.Sync([]string{provider.URL})
+	defer retried.Stop()
+	if got := retried.Get(provider.URL); got != "" {
+		t.Errorf("got jwks: %v while the provider is down, want none", got)
+	}
+	newJwks := `{"keys":[{"kty":"RSA","kid":"2","n":"def","e":"AQAB"}]}`
+	keys.Store(newJwks)
+	atomic.StoreInt32(&down, 0)
+	select {
+	case <-changed:
+	case <-time.After(5 * time.Second):
+		t.Fatal("the jwks was not fetched once the provider is back")
+	}
+	if got := retried.Get(provider.URL); got != newJwks {
+		t.Errorf("got jwks: %v, want: %v", got, newJwks)
+	}
+}
+
+func TestJwksManagerSyncDoesNotBlockGet(t *testing.T) {
+	release := make(chan struct{})
+	provider := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		<-release
+		_, _ = w.Write([]byte(fakeJwks))
+	}))
+	defer provider.Close()
+
+	dir, err := ioutil.TempDir("", "managed_jwks")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	j, err := newJwksManager(dir, provider.Client(), 5*time.Minute, func() {})
+	if err != nil {
+		t.Fatal(err)
+	}
+	synced := make(chan struct{})
+	go func() {
+		j.Sync([]string{provider.URL})
+		close(synced)
+	}()
+	defer j.Stop()
+
+	got := make(chan string)
+	go func() { got <- j.Get(provider.URL) }()
+	select {
+	case jwks := <-got:
+		if jwks != "" {
+			t.Errorf("got jwks: %v before it was fetched, want none", jwks)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("Get was blocked by the fetch of Sync")
+	}
+
+	close(release)
+	<-synced
+	if got := j.Get(provider.URL); got != fakeJwks {
+		t.Errorf("got jwks: %v, want: %v", got, fakeJwks)
+	}
+}
+
+func TestJwksManagerRejectsInvalidJwks(t *testing.T) {
+	provider := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		_, _ = w.Write([]byte(`{"keys":[]}`))
+	}))
+	defer provider.Close()
+
+	dir, err := ioutil.TempDir("", "managed_jwks")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	j, err := newJwksManager(dir, provider.Client(), 5*time.Minute, func() {})
+	if err != nil {
+		t.Fatal(err)
+	}
+	j.Sync([]string{provider.URL})
+	defer j.Stop()
+	if got := j.Get(provider.URL); got != "" {
+		t.Errorf("got jwks: %v, want none", got)
+	}
+	if _, err := os.Stat(j.path(provider.URL)); !os.IsNotExist(err) {
+		t.Errorf("the invalid jwks was persisted: %v", err)
+	}
+}
+
+func TestValidateJwks(t *testing.T) {
+	testData := []struct {
+		desc    string
+		jwks    string
+		wantErr bool
+	}{
+		{
+			desc: "jwks",
+			jwks: fakeJwks,
+		},
+		{
+			desc: "pem certificates by key id",
+			jwks: `{"1":"-----BEGIN CERTIFICATE-----\nYWJj\n-----END CERTIFICATE-----\n"}`,
+		},
+		{
+			desc:    "error page",
+			jwks:    "<html>maintenance</html>",
+			wantErr: true,
+		},
+		{
+			desc:    "no keys",
+			jwks:    `{"keys":[]}`,
+			wantErr: true,
+		},
+		{
+			desc:    "key without kty",
+			jwks:    `{"keys":[{"kid":"1"}]}`,
+			wantErr: true,
+		},
+		{
+			desc:    "keys not an array",
+			jwks:    `{"keys":"abc"}`,
+			wantErr: true,
+		},
+		{
+			desc:    "empty object",
+			jwks:    `{}`,
+			wantErr: true,
+		},
+		{
+			desc:    "not a pem certificate",
+			jwks:    `{"1":"abc"}`,
+			wantErr: true,
+		},
+	}
+	for _, tc := range testData {
+		if err := validateJwks([]byte(tc.jwks)); (err != nil) != tc.wantErr {
+			t.Errorf("validateJwks(%s) got error: %v, want error: %v", tc.desc, err, tc.wantErr)
+		}
+	}
+}
+
+func TestJwksRefreshInterval(t *testing.T) {
+	j := &jwksManager{
+		defaultRefreshInterval: 5 * time.Minute,
+		minRefreshInterval:     jwksMinRefreshInterval,
+	}
+	testData := []struct {
+		cacheControl string
+		want         time.Duration
+	}{
+		{
+			cacheControl: "",
+			want:         5 * time.Minute,
+		},
+		{
+			cacheControl: "public, max-age=3600, must-revalidate",
+			want:         time.Hour,
+		},
+		{
+			cacheControl: "max-age=1",
+			want:         jwksMinRefreshInterval,
+		},
+		{
+			cacheControl: "max-age=31536000",
+			want:         jwksMaxRefreshInterval,
+		},
+		{
+			cacheControl: "No-Cache",
+			want:         jwksMinRefreshInterval,
+		},
+		{
+			cacheControl: "max-age=invalid",
+			want:         5 * time.Minute,
+		},
+	}
+	for _, tc := range testData {
+		if got := j.refreshInterval(tc.cacheControl); got != tc.want {
+			t.Errorf("refreshInterval(%q) got: %v, want: %v", tc.cacheControl, got, tc.want)
+		}
+	}
+}
@@ -90,6 +90,22 @@ func main() {
 
 	}
 
+	if opts.CheckCachePeers != "" {
+		// Serve the check responses owned by this replica to the peers.
+		secret, err := configmanager.ReadPeerCheckCacheSecret(opts.CheckCachePeerSecretFile)
+		if err != nil {
+			glog.Exitf("fail to read the peer check cache secret: %v", err)
+		}
+		r := configmanager.MakePeerCheckCacheHandler(configmanager.PeerCheckCacheMaxEntries, secret)
+		go func() {
+			addr := net.JoinHostPort(opts.CheckCachePeerAddress, fmt.Sprint(opts.CheckCachePeerPort))
+			err := http.ListenAndServe(addr, r)
+			if err != nil {
+				glog.Errorf("peer check cache fail to serve: %v", err)
+			}
+		}()
+	}
+
 	if err := grpcServer.Serve(lis); err != nil {
 		glog.Exitf("Server fail to serve: %v", err)
 	}
@@ -0,0 +1,250 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package configmanager
+
+import (
+	"bytes"
+	"container/heap"
+	"crypto/hmac"
+	"crypto/sha256"
+	"fmt"
+	"io/ioutil"
+	"net/http"
+	"sync"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"github.com/golang/glog"
+	"github.com/gorilla/mux"
+	"google.golang.org/protobuf/proto"
+
+	scpb "github.com/GoogleCloudPlatform/esp-v2/src/go/proto/api/envoy/v11/http/service_control"
+)
+
+const (
+	// The maximum number of check responses stored, so a burst of distinct
+	// checks does not grow the config manager without bound.
+	PeerCheckCacheMaxEntries = 100000
+	// The maximum ttl of a published check response, whatever the peer asks.
+	peerCheckCacheMaxTtl = 10 * time.Minute
+	// The maximum size of a request body.
+	peerCheckCacheMaxBodyBytes = 1 << 20
+)
+
+type peerCheckCacheEntry struct {
+	key string
+	// The serialized PeerCheckCacheEntry, as it was published.
+	entry   []byte
+	expires time.Time
+	// The index of the entry in the expiry heap.
+	index int
+}
+
+// peerCheckCacheExpiries is a heap of the entries by expiry, implementing
+// heap.Interface.
+type peerCheckCacheExpiries []*peerCheckCacheEntry
+
+func (h peerCheckCacheExpiries) Len() int           { return len(h) }
+func (h peerCheckCacheExpiries) Less(i, j int) bool { return h[i].expires.Before(h[j].expires) }
+func (h peerCheckCacheExpiries) Swap(i, j int) {
+	h[i], h[j] = h[j], h[i]
+	h[i].index = i
+	h[j].index = j
+}
+
+func (h *peerCheckCacheExpiries) Push(x interface{}) {
+	entry := x.(*peerCheckCacheEntry)
+	entry.index = len(*h)
+	*h = append(*h, entry)
+}
+
+func (h *peerCheckCacheExpiries) Pop() interface{} {
+	old := *h
+	entry := old[len(old)-1]
+	old[len(old)-1] = nil
+	*h = old[:len(old)-1]
+	return entry
+}
+
+// peerCheckCache stores the check responses published by the ESPv2 replicas
+// of a service, so a check made by one replica is not made again by the
+// others. Each replica owns the check requests whose keys hash to it, see
+// PeerCheckCacheConfig.
+type peerCheckCache struct {
+	maxEntries int
+	now        func() time.Time
+
+	mu sync.Mutex
+	// By the key of the check request.
+	entries map[string]*peerCheckCacheEntry
+	// The same entries, soonest to expire first, so an insert into a full
+	// cache evicts in O(log n).
+	expiries peerCheckCacheExpiries
+}
+
+func newPeerCheckCache(maxEntries int, now func() time.Time) *peerCheckCache {
+	return &peerCheckCache{
+		maxEntries: maxEntries,
+		now:        now,
+		entries:    make(map[string]*peerCheckCacheEntry),
+	}
+}
+
+// lookup returns the serialized PeerCheckCacheEntry published for the key.
+func (c *peerCheckCache) lookup(key string) ([]byte, bool) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	entry, ok := c.entries[key]
+	if !ok {
+		return nil, false
+	}
+	if !c.now().Before(entry.expires) {
+		c.remove(entry)
+		return nil, false
+	}
+	return entry.entry, true
+}
+
+// publish stores the serialized PeerCheckCacheEntry of the key until it
+// expires, bounded by the max ttl.
+func (c *peerCheckCache) publish(key string, entry []byte, expires time.Time) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	now := c.now()
+	if maxExpires := now.Add(peerCheckCacheMaxTtl); expires.After(maxExpires) {
+		expires = maxExpires
+	}
+	if !now.Before(expires) {
+		return
+	}
+
+	if stored, ok := c.entries[key]; ok {
+		stored.entry = entry
+		stored.expires = expires
+		heap.Fix(&c.expiries, stored.index)
+		return
+	}
+	// The entry evicted is the soonest to expire, which is an expired one if
+	// there is any.
+	if len(c.entries) >= c.maxEntries && len(c.expiries) > 0 {
+		c.remove(c.expiries[0])
+	}
+	stored := &peerCheckCacheEntry{
+		key:     key,
+		entry:   entry,
+		expires: expires,
+	}
+	c.entries[key] = stored
+	heap.Push(&c.expiries, stored)
+}
+
+func (c *peerCheckCache) remove(entry *peerCheckCacheEntry) {
+	heap.Remove(&c.expiries, entry.index)
+	delete(c.entries, entry.key)
+}
+
+// ReadPeerCheckCacheSecret reads the secret shared by the replicas, without
+// its leading and trailing whitespace, as the filter does.
+func ReadPeerCheckCacheSecret(path string) ([]byte, error) {
+	secret, err := ioutil.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	secret = bytes.TrimSpace(secret)
+	if len(secret) == 0 {
+		return nil, fmt.Errorf("empty peer check cache secret in %s", path)
+	}
+	return secret, nil
+}
+
+// peerCheckCacheLookupHmac returns the HMAC of a lookup, see
+// peer_check_cache.proto.
+func peerCheckCacheLookupHmac(secret, key []byte) []byte {
+	mac := hmac.New(sha256.New, secret)
+	fmt.Fprintf(mac, "lookup\n%s", key)
+	return mac.Sum(nil)
+}
+
+// peerCheckCacheEntryHmac returns the HMAC of an entry, see
+// peer_check_cache.proto.
+func peerCheckCacheEntryHmac(secret []byte, entry *scpb.PeerCheckCacheEntry) []byte {
+	mac := hmac.New(sha256.New, secret)
+	fmt.Fprintf(mac, "entry\n%s\n%d\n%s", entry.Key, entry.GetExpireTime().GetSeconds(), entry.CheckResponse)
+	return mac.Sum(nil)
+}
+
+// MakePeerCheckCacheHandler returns the handler of the peer check cache, see
+// peer_check_cache.proto. Requests:
+//
+//	POST /v1/checkCache:lookup with a PeerCheckCacheLookup
+//	POST /v1/checkCache:publish with a PeerCheckCacheEntry
+//
+// A lookup returns the PeerCheckCacheEntry as it was published, or 404 if it
+// is not stored. The requests without a valid HMAC with the secret are
+// rejected with 403.
+func MakePeerCheckCacheHandler(maxEntries int, secret []byte) http.Handler {
+	c := newPeerCheckCache(maxEntries, time.Now)
+	r := mux.NewRouter()
+
+	r.Path(util.PeerCheckCacheLookupPath).Methods("POST").HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		var req scpb.PeerCheckCacheLookup
+		if _, ok := readPeerCheckCacheRequest(w, r, &req); !ok {
+			return
+		}
+		if !hmac.Equal(req.Hmac, peerCheckCacheLookupHmac(secret, req.Key)) {
+			rejectPeerCheckCacheRequest(w, r)
+			return
+		}
+		entry, ok := c.lookup(string(req.Key))
+		if !ok {
+			http.NotFound(w, r)
+			return
+		}
+		_, _ = w.Write(entry)
+	})
+
+	r.Path(util.PeerCheckCachePublishPath).Methods("POST").HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		var req scpb.PeerCheckCacheEntry
+		body, ok := readPeerCheckCacheRequest(w, r, &req)
+		if !ok {
+			return
+		}
+		if !hmac.Equal(req.Hmac, peerCheckCacheEntryHmac(secret, &req)) {
+			rejectPeerCheckCacheRequest(w, r)
+			return
+		}
+		c.publish(string(req.Key), body, req.GetExpireTime().AsTime())
+	})
+
+	return r
+}
+
+func readPeerCheckCacheRequest(w http.ResponseWriter, r *http.Request, req proto.Message) ([]byte, bool) {
+	body, err := ioutil.ReadAll(http.MaxBytesReader(w, r.Body, peerCheckCacheMaxBodyBytes))
+	if err == nil {
+		err = proto.Unmarshal(body, req)
+	}
+	if err != nil {
+		glog.Warningf("peer check cache got an invalid request: %v", err)
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return nil, false
+	}
+	return body, true
+}
+
+func rejectPeerCheckCacheRequest(w http.ResponseWriter, r *http.Request) {
+	glog.Warningf("peer check cache got a request with an invalid HMAC from %s", r.RemoteAddr)
+	http.Error(w, "invalid HMAC", http.StatusForbidden)
+}
@@ -0,0 +1,228 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package configmanager
+
+import (
+	"bytes"
+	"encoding/hex"
+	"fmt"
+	"io/ioutil"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"google.golang.org/protobuf/proto"
+	"google.golang.org/protobuf/types/known/timestamppb"
+
+	scpb "github.com/GoogleCloudPlatform/esp-v2/src/go/proto/api/envoy/v11/http/service_control"
+)
+
+func TestPeerCheckCache(t *testing.T) {
+	now := time.Unix(1000, 0)
+	c := newPeerCheckCache(2, func() time.Time { return now })
+
+	if _, ok := c.lookup("key1"); ok {
+		t.Errorf("lookup before publish: got a hit")
+	}
+
+	c.publish("key1", []byte("entry1"), now.Add(time.Minute))
+	if got, ok := c.lookup("key1"); !ok || string(got) != "entry1" {
+		t.Errorf("lookup after publish: got (%q, %v), want (entry1, true)", got, ok)
+	}
+
+	// An expired entry is not stored.
+	c.publish("key3", []byte("entry3"), now)
+	if _, ok := c.lookup("key3"); ok {
+		t.Errorf("lookup of an expired entry: got a hit")
+	}
+
+	// The ttl is bounded.
+	c.publish("key2", []byte("entry2"), now.Add(time.Hour))
+	now = now.Add(peerCheckCacheMaxTtl)
+	if _, ok := c.lookup("key1"); ok {
+		t.Errorf("lookup after expiry: got a hit")
+	}
+	if _, ok := c.lookup("key2"); ok {
+		t.Errorf("lookup after the max ttl: got a hit")
+	}
+
+	// Over the max entries, the soonest to expire is evicted.
+	c.publish("key1", []byte("entry"), now.Add(2*time.Minute))
+	c.publish("key2", []byte("entry"), now.Add(time.Minute))
+	c.publish("key3", []byte("entry"), now.Add(time.Minute))
+	if len(c.entries) != 2 {
+		t.Errorf("got %d entries, want 2", len(c.entries))
+	}
+	if _, ok := c.lookup("key2"); ok {
+		t.Errorf("lookup of the evicted key: got a hit")
+	}
+	if _, ok := c.lookup("key3"); !ok {
+		t.Errorf("lookup of the last published key: got a miss")
+	}
+}
+
+func TestPeerCheckCacheFull(t *testing.T) {
+	now := time.Unix(1000, 0)
+	c := newPeerCheckCache(PeerCheckCacheMaxEntries, func() time.Time { return now })
+
+	// Filled to the limit with entries none of which is expired, and
+	// republished: each insert evicts the soonest to expire.
+	for i := 0; i < 2*PeerCheckCacheMaxEntries; i++ {
+		c.publish(fmt.Sprintf("key%d", i), []byte("entry"), now.Add(time.Minute+time.Duration(i)*time.Millisecond))
+	}
+	if len(c.entries) != PeerCheckCacheMaxEntries || len(c.expiries) != PeerCheckCacheMaxEntries {
+		t.Fatalf("got %d entries and %d expiries, want %d", len(c.entries), len(c.expiries), PeerCheckCacheMaxEntries)
+	}
+	if _, ok := c.lookup(fmt.Sprintf("key%d", PeerCheckCacheMaxEntries-1)); ok {
+		t.Errorf("lookup of an evicted key: got a hit")
+	}
+	if _, ok := c.lookup(fmt.Sprintf("key%d", PeerCheckCacheMaxEntries)); !ok {
+		t.Errorf("lookup of the oldest key kept: got a miss")
+	}
+
+	// An updated entry moves in the heap.
+	c.publish(fmt.Sprintf("key%d", PeerCheckCacheMaxEntries+1), []byte("entry"), now.Add(time.Hour))
+	c.publish("new", []byte("entry"), now.Add(time.Hour))
+	if _, ok := c.lookup(fmt.Sprintf("key%d", PeerCheckCacheMaxEntries+1)); !ok {
+		t.Errorf("lookup of the updated key: got a miss")
+	}
+	if _, ok := c.lookup(fmt.Sprintf("key%d", PeerCheckCacheMaxEntries)); ok {
+		t.Errorf("lookup of the soonest to expire key: got a hit")
+	}
+}
+
+func TestReadPeerCheckCacheSecret(t *testing.T) {
+	dir, err := ioutil.TempDir("", "peer_check_cache_secret")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+	path := filepath.Join(dir, "secret")
+	if err := ioutil.WriteFile(path, []byte(" secret\n"), 0600); err != nil {
+		t.Fatal(err)
+	}
+	if got, err := ReadPeerCheckCacheSecret(path); err != nil || string(got) != "secret" {
+		t.Errorf("got (%q, %v), want (secret, nil)", got, err)
+	}
+
+	if err := ioutil.WriteFile(path, []byte("\n"), 0600); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := ReadPeerCheckCacheSecret(path); err == nil {
+		t.Errorf("empty secret: got no error")
+	}
+	if _, err := ReadPeerCheckCacheSecret(filepath.Join(dir, "missing")); err == nil {
+		t.Errorf("missing secret: got no error")
+	}
+}
+
+// The HMACs are shared with the filter, see peer_check_cache_test.cc.
+func TestPeerCheckCacheHmac(t *testing.T) {
+	secret := []byte("secret")
+	key := bytes.Repeat([]byte("k"), 32)
+	if got, want := hex.EncodeToString(peerCheckCacheLookupHmac(secret, key)), "178b4bc166cc0c48f0d38ba950906c51495d3aef363db499b124ed1fc4564bef"; got != want {
+		t.Errorf("lookup HMAC: got %s, want %s", got, want)
+	}
+	entry := &scpb.PeerCheckCacheEntry{
+		Key:           key,
+		CheckResponse: []byte("response"),
+		ExpireTime:    timestamppb.New(time.Unix(1000, 0)),
+	}
+	if got, want := hex.EncodeToString(peerCheckCacheEntryHmac(secret, entry)), "53b1594495a4ac7d39d130537399712789e2969e73cbb1874262c3a329a2c878"; got != want {
+		t.Errorf("entry HMAC: got %s, want %s", got, want)
+	}
+}
+
+func TestPeerCheckCacheHandler(t *testing.T) {
+	secret := []byte("secret")
+	s := httptest.NewServer(MakePeerCheckCacheHandler(PeerCheckCacheMaxEntries, secret))
+	defer s.Close()
+
+	post := func(path string, req proto.Message) (int, []byte) {
+		body, err := proto.Marshal(req)
+		if err != nil {
+			t.Fatal(err)
+		}
+		resp, err := http.Post(s.URL+path, "application/x-protobuf", bytes.NewReader(body))
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer resp.Body.Close()
+		respBody, _ := ioutil.ReadAll(resp.Body)
+		return resp.StatusCode, respBody
+	}
+
+	key := []byte("key")
+	lookup := &scpb.PeerCheckCacheLookup{
+		Key:  key,
+		Hmac: peerCheckCacheLookupHmac(secret, key),
+	}
+	if code, _ := post(util.PeerCheckCacheLookupPath, lookup); code != http.StatusNotFound {
+		t.Errorf("lookup before publish: got %d, want 404", code)
+	}
+
+	entry := &scpb.PeerCheckCacheEntry{
+		Key:           key,
+		CheckResponse: []byte("response"),
+		ExpireTime:    timestamppb.New(time.Now().Add(time.Minute)),
+	}
+	entry.Hmac = peerCheckCacheEntryHmac(secret, entry)
+	if code, _ := post(util.PeerCheckCachePublishPath, entry); code != http.StatusOK {
+		t.Errorf("publish: got %d, want 200", code)
+	}
+
+	code, body := post(util.PeerCheckCacheLookupPath, lookup)
+	if code != http.StatusOK {
+		t.Fatalf("lookup after publish: got %d, want 200", code)
+	}
+	var got scpb.PeerCheckCacheEntry
+	if err := proto.Unmarshal(body, &got); err != nil {
+		t.Fatal(err)
+	}
+	if !proto.Equal(&got, entry) {
+		t.Errorf("lookup after publish: got %v, want %v", &got, entry)
+	}
+
+	// Without the secret, the entries can not be forged nor looked up.
+	forged := proto.Clone(entry).(*scpb.PeerCheckCacheEntry)
+	forged.CheckResponse = []byte("forged")
+	if code, _ := post(util.PeerCheckCachePublishPath, forged); code != http.StatusForbidden {
+		t.Errorf("forged publish: got %d, want 403", code)
+	}
+	forged.Hmac = peerCheckCacheEntryHmac([]byte("other secret"), forged)
+	if code, _ := post(util.PeerCheckCachePublishPath, forged); code != http.StatusForbidden {
+		t.Errorf("publish with another secret: got %d, want 403", code)
+	}
+	if code, _ := post(util.PeerCheckCacheLookupPath, &scpb.PeerCheckCacheLookup{Key: key}); code != http.StatusForbidden {
+		t.Errorf("lookup without HMAC: got %d, want 403", code)
+	}
+	_, body = post(util.PeerCheckCacheLookupPath, lookup)
+	if err := proto.Unmarshal(body, &got); err != nil || !proto.Equal(&got, entry) {
+		t.Errorf("lookup after forged publish: got %v, want %v", &got, entry)
+	}
+
+	resp, err := http.Post(s.URL+util.PeerCheckCacheLookupPath, "application/x-protobuf", bytes.NewReader([]byte("invalid")))
+	if err != nil {
+		t.Fatal(err)
+	}
+	resp.Body.Close()
+	if resp.StatusCode != http.StatusBadRequest {
+		t.Errorf("invalid lookup: got %d, want 400", resp.StatusCode)
+	}
+}
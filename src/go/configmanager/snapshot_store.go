@@ -0,0 +1,132 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package configmanager
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"net/url"
+	"os"
+	"path/filepath"
+
+	"github.com/envoyproxy/go-control-plane/pkg/cache/types"
+	"google.golang.org/protobuf/proto"
+	"google.golang.org/protobuf/types/known/anypb"
+
+	rsrc "github.com/envoyproxy/go-control-plane/pkg/resource/v3"
+)
+
+// persistedSnapshot is the on-disk format of the last applied snapshot of a
+// service. Only the last one is kept, so its config id is recorded in it.
+type persistedSnapshot struct {
+	ServiceName string `json:"service_name"`
+	ConfigId    string `json:"config_id"`
+	// Hash of the generator options. A snapshot generated with other flags is
+	// not served.
+	OptionsHash string `json:"options_hash"`
+	// Resources serialized as Any, by xDS type url.
+	Resources map[rsrc.Type][][]byte `json:"resources"`
+}
+
+func snapshotPath(dir, serviceName string) string {
+	return filepath.Join(dir, url.PathEscape(serviceName)+".snapshot.json")
+}
+
+func optionsHash(opts interface{}) (string, error) {
+	b, err := json.Marshal(opts)
+	if err != nil {
+		return "", err
+	}
+	sum := sha256.Sum256(b)
+	return hex.EncodeToString(sum[:]), nil
+}
+
+// writeSnapshot persists the resources of a snapshot. The file is replaced
+// atomically, so a crash never leaves a partial snapshot behind.
+func writeSnapshot(dir string, s *persistedSnapshot, resources map[rsrc.Type][]types.Resource) error {
+	s.Resources = make(map[rsrc.Type][][]byte, len(resources))
+	for typeUrl, rs := range resources {
+		for _, r := range rs {
+			a, err := anypb.New(r)
+			if err != nil {
+				return fmt.Errorf("fail to marshal %s resource: %v", typeUrl, err)
+			}
+			b, err := proto.Marshal(a)
+			if err != nil {
+				return fmt.Errorf("fail to marshal %s resource: %v", typeUrl, err)
+			}
+			s.Resources[typeUrl] = append(s.Resources[typeUrl], b)
+		}
+	}
+
+	b, err := json.Marshal(s)
+	if err != nil {
+		return err
+	}
+	return writeFileAtomic(snapshotPath(dir, s.ServiceName), b)
+}
+
+// writeFileAtomic writes the file through a temporary file in the same
+// directory, renamed over it once complete.
+func writeFileAtomic(path string, b []byte) error {
+	f, err := ioutil.TempFile(filepath.Dir(path), "."+filepath.Base(path)+"-")
+	if err != nil {
+		return err
+	}
+	defer os.Remove(f.Name())
+	if _, err := f.Write(b); err != nil {
+		f.Close()
+		return err
+	}
+	if err := f.Close(); err != nil {
+		return err
+	}
+	return os.Rename(f.Name(), path)
+}
+
+// readSnapshot reads the last applied snapshot of the service and its
+// resources.
+func readSnapshot(dir, serviceName string) (*persistedSnapshot, map[rsrc.Type][]types.Resource, error) {
+	b, err := ioutil.ReadFile(snapshotPath(dir, serviceName))
+	if err != nil {
+		return nil, nil, err
+	}
+	s := &persistedSnapshot{}
+	if err := json.Unmarshal(b, s); err != nil {
+		return nil, nil, fmt.Errorf("fail to unmarshal persisted snapshot: %v", err)
+	}
+	if s.ServiceName != serviceName {
+		return nil, nil, fmt.Errorf("persisted snapshot is for service %q, not %q", s.ServiceName, serviceName)
+	}
+
+	resources := make(map[rsrc.Type][]types.Resource, len(s.Resources))
+	for typeUrl, rs := range s.Resources {
+		for _, r := range rs {
+			a := &anypb.Any{}
+			if err := proto.Unmarshal(r, a); err != nil {
+				return nil, nil, fmt.Errorf("fail to unmarshal %s resource: %v", typeUrl, err)
+			}
+			m, err := a.UnmarshalNew()
+			if err != nil {
+				return nil, nil, fmt.Errorf("fail to unmarshal %s resource: %v", typeUrl, err)
+			}
+			resources[typeUrl] = append(resources[typeUrl], m)
+		}
+	}
+	return s, resources, nil
+}
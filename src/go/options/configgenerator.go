@@ -84,6 +84,10 @@ type ConfigGeneratorOptions struct {
 	ServiceAccountKey string
 	TokenAgentPort    uint
 
+	// Unix domain socket of the node-local token broker. When set, the access
+	// and identity tokens of the metadata server are fetched from the broker.
+	TokenBrokerSocket string
+
 	// Flags for external calls.
 	DisableOidcDiscovery    bool
 	DependencyErrorBehavior string
@@ -135,12 +139,69 @@ type ConfigGeneratorOptions struct {
 	ScQuotaRetries            int
 	ScReportRetries           int
 
+	// The directory used by the service control filter to hand the pending
+	// report and quota requests over to the next epoch during a hot restart.
+	// If empty, the handoff is disabled.
+	HotRestartHandoffDir string
+	// How long the handed off pending state is taken over after the filter is
+	// created. Must cover the parent shutdown time of Envoy. If 0, the default
+	// of the filter is used.
+	HotRestartTakeOverWindow time.Duration
+
+	// If true, the service control filter learns which API keys have no IP or
+	// referer restriction, and caches their check and quota requests once per
+	// API key instead of once per client IP and referer.
+	LearnApiKeyRestrictions bool
+
+	// The peer check cache addresses, as comma-separated host:port, including
+	// this replica. If empty, the peer check cache is disabled.
+	CheckCachePeers string
+	// The address and port the config manager serves the peer check cache on.
+	CheckCachePeerAddress string
+	CheckCachePeerPort    uint
+	// The path to the file of the secret shared by the replicas, which
+	// authenticates the peer check cache calls and entries.
+	CheckCachePeerSecretFile string
+	// How long the owner serves a published check response.
+	CheckCachePeerTtl time.Duration
+	// The timeout of the peer check cache calls.
+	CheckCachePeerTimeout time.Duration
+
+	// Comma separated hex encoded SHA-256 digests of the API keys, and
+	// consumer project numbers, of the priority consumers whose check
+	// responses are pinned. If both are empty, no response is pinned.
+	PinnedCheckApiKeySha256    string
+	PinnedCheckConsumerNumbers string
+	// How long a pinned check response is served.
+	PinnedCheckTtl time.Duration
+
+	// The number of denied reports per worker per interval sent as is, before
+	// the rest are rolled up, and the interval. If 0, the filter defaults of
+	// 100 and 1s are used.
+	DeniedReportRollupThreshold uint
+	DeniedReportRollupInterval  time.Duration
+
 	BackendClusterMaxRequests int
 
 	ComputePlatformOverride     string
 	EnableResponseCompression   bool
 	ClientIPFromForwardedHeader bool
 
+	// Responses smaller than this many bytes are not compressed. If 0, the
+	// Envoy default (30 bytes) is used.
+	ResponseCompressionMinSize uint
+	// Comma separated content types of the responses to compress. If empty,
+	// the Envoy default list of text, json and xml types is used.
+	ResponseCompressionContentTypes string
+	// Semicolon separated per-operation compression policies, in the form of
+	// `selector=policy`. The policy is one of `off`, `gzip` or `br`.
+	ResponseCompressionOperations string
+
+	// Semicolon separated trusted JWT callers of the operations, in the form
+	// of `selector=issuer,audience[,audience...]`. The requests with a verified
+	// JWT from a trusted caller skip the check call.
+	TrustedJwtCallers string
+
 	TranscodingAlwaysPrintPrimitiveFields         bool
 	TranscodingAlwaysPrintEnumsAsInts             bool
 	TranscodingStreamNewLineDelimited             bool
@@ -179,6 +240,11 @@ func DefaultConfigGeneratorOptions() ConfigGeneratorOptions {
 		ListenerAddress:                         "0.0.0.0",
 		ListenerPort:                            8080,
 		TokenAgentPort:                          8791,
+		CheckCachePeerAddress:                   "127.0.0.1",
+		CheckCachePeerPort:                      8792,
+		CheckCachePeerTtl:                       60 * time.Second,
+		CheckCachePeerTimeout:                   100 * time.Millisecond,
+		PinnedCheckTtl:                          5 * time.Minute,
 		DisableOidcDiscovery:                    false,
 		DependencyErrorBehavior:                 commonpb.DependencyErrorBehavior_BLOCK_INIT_ON_ANY_ERROR.String(),
 		SslSidestreamClientRootCertsPath:        util.DefaultRootCAPaths,
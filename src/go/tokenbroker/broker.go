@@ -0,0 +1,304 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package tokenbroker serves the tokens of the metadata server to all the
+// proxies of a node over a unix domain socket. Each token is fetched once for
+// the node instead of once per proxy, and is refreshed by a single timer ahead
+// of the refresh of the proxies.
+package tokenbroker
+
+import (
+	"encoding/json"
+	"fmt"
+	"net"
+	"net/http"
+	"os"
+	"sync"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"github.com/golang/glog"
+)
+
+const (
+	// Tokens are refreshed this long before they expire. It is longer than the
+	// 60s refresh buffer of the proxies, so a proxy is never handed a token it
+	// has to refresh right away.
+	DefaultRefreshMargin = 5 * time.Minute
+
+	// A token no proxy asked for in this long is not refreshed anymore.
+	DefaultIdleTimeout = time.Hour
+
+	// The shortest delay between two refreshes of a token, and the delay
+	// before retrying a failed refresh.
+	defaultMinRefreshDelay = 10 * time.Second
+)
+
+// TokenSource fetches tokens without caching them.
+type TokenSource interface {
+	FetchAccessToken() (string, time.Duration, error)
+	FetchIdentityToken(audience string) (string, time.Duration, error)
+}
+
+type tokenKey struct {
+	// Empty for the access token.
+	audience string
+	identity bool
+}
+
+type tokenEntry struct {
+	token    string
+	expiry   time.Time
+	lastUsed time.Time
+
+	// Closed when the fetch in flight is done. Nil if there is none.
+	fetching chan struct{}
+	// The error of the last fetch.
+	err error
+
+	timer *time.Timer
+}
+
+// Broker caches the tokens of a TokenSource. Concurrent requests for a token
+// share one fetch, and each token is refreshed by one timer.
+type Broker struct {
+	source        TokenSource
+	refreshMargin time.Duration
+	idleTimeout   time.Duration
+	// Overridden by tests.
+	minRefreshDelay time.Duration
+	timeNow         func() time.Time
+
+	mu      sync.Mutex
+	entries map[tokenKey]*tokenEntry
+	closed  bool
+}
+
+func NewBroker(source TokenSource, refreshMargin, idleTimeout time.Duration) *Broker {
+	return &Broker{
+		source:          source,
+		refreshMargin:   refreshMargin,
+		idleTimeout:     idleTimeout,
+		minRefreshDelay: defaultMinRefreshDelay,
+		timeNow:         time.Now,
+		entries:         make(map[tokenKey]*tokenEntry),
+	}
+}
+
+// AccessToken returns the access token and its remaining lifetime.
+func (b *Broker) AccessToken() (string, time.Duration, error) {
+	return b.get(tokenKey{})
+}
+
+// IdentityToken returns the identity token of the audience and its remaining
+// lifetime.
+func (b *Broker) IdentityToken(audience string) (string, time.Duration, error) {
+	return b.get(tokenKey{audience: audience, identity: true})
+}
+
+// Close stops the refresh of all the tokens.
+func (b *Broker) Close() {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	b.closed = true
+	for _, e := range b.entries {
+		if e.timer != nil {
+			e.timer.Stop()
+		}
+	}
+}
+
+func (b *Broker) get(key tokenKey) (string, time.Duration, error) {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	e, ok := b.entries[key]
+	if !ok {
+		e = &tokenEntry{}
+		b.entries[key] = e
+	}
+	now := b.timeNow()
+	e.lastUsed = now
+
+	// A fresh token is served from the cache. Otherwise the token is fetched,
+	// and served even if the source returned it with less than the refresh
+	// margin left. If the fetch fails, the cached token is served until it
+	// expires.
+	if e.token == "" || e.expiry.Sub(now) <= b.refreshMargin {
+		err := b.fetchLocked(key, e)
+		now = b.timeNow()
+		if err != nil {
+			if e.token == "" || !e.expiry.After(now) {
+				return "", 0, err
+			}
+			glog.Warningf("failed to fetch token (audience %q), serving the cached token: %v", key.audience, err)
+		}
+	}
+	if !e.expiry.After(now) {
+		return "", 0, fmt.Errorf("token expired before it was served")
+	}
+	return e.token, e.expiry.Sub(now), nil
+}
+
+// fetchLocked fetches the token of the entry, or waits for the fetch in
+// flight. It is called and returns with b.mu held.
+func (b *Broker) fetchLocked(key tokenKey, e *tokenEntry) error {
+	if e.fetching != nil {
+		done := e.fetching
+		b.mu.Unlock()
+		<-done
+		b.mu.Lock()
+		return e.err
+	}
+
+	done := make(chan struct{})
+	e.fetching = done
+	start := b.timeNow()
+	b.mu.Unlock()
+
+	var token string
+	var expiresIn time.Duration
+	var err error
+	if key.identity {
+		token, expiresIn, err = b.source.FetchIdentityToken(key.audience)
+	} else {
+		token, expiresIn, err = b.source.FetchAccessToken()
+	}
+
+	b.mu.Lock()
+	e.fetching = nil
+	e.err = err
+	if err == nil {
+		e.token = token
+		// The lifetime is counted from the start of the fetch, so it is never
+		// overestimated.
+		e.expiry = start.Add(expiresIn)
+		b.scheduleRefreshLocked(key, e, e.expiry.Sub(b.timeNow())-b.refreshMargin)
+	}
+	close(done)
+	return err
+}
+
+func (b *Broker) scheduleRefreshLocked(key tokenKey, e *tokenEntry, delay time.Duration) {
+	if b.closed {
+		return
+	}
+	if delay < b.minRefreshDelay {
+		delay = b.minRefreshDelay
+	}
+	if e.timer != nil {
+		e.timer.Stop()
+	}
+	e.timer = time.AfterFunc(delay, func() { b.refresh(key, e) })
+}
+
+func (b *Broker) refresh(key tokenKey, e *tokenEntry) {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if b.closed || b.entries[key] != e {
+		return
+	}
+	if b.timeNow().Sub(e.lastUsed) > b.idleTimeout {
+		delete(b.entries, key)
+		return
+	}
+	if err := b.fetchLocked(key, e); err != nil {
+		glog.Warningf("failed to refresh token (audience %q): %v", key.audience, err)
+		b.scheduleRefreshLocked(key, e, b.minRefreshDelay)
+	}
+}
+
+type accessTokenResponse struct {
+	AccessToken string `json:"access_token"`
+	ExpiresIn   int64  `json:"expires_in"`
+}
+
+type identityTokenResponse struct {
+	IdToken   string `json:"id_token"`
+	ExpiresIn int64  `json:"expires_in"`
+}
+
+// Handler serves the access token in the metadata server format, and the
+// identity tokens with their remaining lifetime:
+//
+//	GET /v1/access_token                 {"access_token": ..., "expires_in": ...}
+//	GET /v1/identity_token?audience=aud  {"id_token": ..., "expires_in": ...}
+func (b *Broker) Handler() http.Handler {
+	mux := http.NewServeMux()
+	mux.HandleFunc(util.TokenBrokerAccessTokenPath, func(w http.ResponseWriter, r *http.Request) {
+		if r.Method != http.MethodGet {
+			http.Error(w, "method not allowed", http.StatusMethodNotAllowed)
+			return
+		}
+		token, expiresIn, err := b.AccessToken()
+		if err != nil {
+			glog.Errorf("failed to get access token: %v", err)
+			http.Error(w, err.Error(), http.StatusServiceUnavailable)
+			return
+		}
+		writeJSON(w, accessTokenResponse{
+			AccessToken: token,
+			ExpiresIn:   int64(expiresIn / time.Second),
+		})
+	})
+	mux.HandleFunc(util.TokenBrokerIdentityTokenPath, func(w http.ResponseWriter, r *http.Request) {
+		if r.Method != http.MethodGet {
+			http.Error(w, "method not allowed", http.StatusMethodNotAllowed)
+			return
+		}
+		audience := r.URL.Query().Get("audience")
+		if audience == "" {
+			http.Error(w, "missing audience", http.StatusBadRequest)
+			return
+		}
+		token, expiresIn, err := b.IdentityToken(audience)
+		if err != nil {
+			glog.Errorf("failed to get identity token for audience %q: %v", audience, err)
+			http.Error(w, err.Error(), http.StatusServiceUnavailable)
+			return
+		}
+		writeJSON(w, identityTokenResponse{
+			IdToken:   token,
+			ExpiresIn: int64(expiresIn / time.Second),
+		})
+	})
+	return mux
+}
+
+func writeJSON(w http.ResponseWriter, resp interface{}) {
+	body, err := json.Marshal(resp)
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	w.Write(body)
+}
+
+// ListenUnix listens on the unix domain socket, replacing the socket of a
+// previous broker. The socket is writable by all the proxies of the node.
+func ListenUnix(path string) (net.Listener, error) {
+	if err := os.Remove(path); err != nil && !os.IsNotExist(err) {
+		return nil, fmt.Errorf("fail to remove socket %s: %v", path, err)
+	}
+	lis, err := net.Listen("unix", path)
+	if err != nil {
+		return nil, fmt.Errorf("fail to listen on socket %s: %v", path, err)
+	}
+	if err := os.Chmod(path, 0666); err != nil {
+		lis.Close()
+		return nil, fmt.Errorf("fail to set the mode of socket %s: %v", path, err)
+	}
+	return lis, nil
+}
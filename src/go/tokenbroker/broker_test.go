@@ -0,0 +1,276 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tokenbroker
+
+import (
+	"encoding/json"
+	"fmt"
+	"net/http"
+	"net/http/httptest"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+type fakeSource struct {
+	expiresIn time.Duration
+	delay     time.Duration
+	err       error
+
+	accessCalls   int32
+	identityCalls int32
+}
+
+func (fs *fakeSource) FetchAccessToken() (string, time.Duration, error) {
+	n := atomic.AddInt32(&fs.accessCalls, 1)
+	time.Sleep(fs.delay)
+	if fs.err != nil {
+		return "", 0, fs.err
+	}
+	return fmt.Sprintf("access-token-%d", n), fs.expiresIn, nil
+}
+
+func (fs *fakeSource) FetchIdentityToken(audience string) (string, time.Duration, error) {
+	n := atomic.AddInt32(&fs.identityCalls, 1)
+	time.Sleep(fs.delay)
+	if fs.err != nil {
+		return "", 0, fs.err
+	}
+	return fmt.Sprintf("%s-token-%d", audience, n), fs.expiresIn, nil
+}
+
+func TestBrokerSharesFetches(t *testing.T) {
+	source := &fakeSource{
+		expiresIn: time.Hour,
+		delay:     50 * time.Millisecond,
+	}
+	b := NewBroker(source, DefaultRefreshMargin, DefaultIdleTimeout)
+	defer b.Close()
+
+	var wg sync.WaitGroup
+	for i := 0; i < 20; i++ {
+		wg.Add(2)
+		go func() {
+			defer wg.Done()
+			if token, _, err := b.AccessToken(); err != nil || token != "access-token-1" {
+				t.Errorf("AccessToken() = %q, %v, want access-token-1", token, err)
+			}
+		}()
+		go func() {
+			defer wg.Done()
+			if token, _, err := b.IdentityToken("aud"); err != nil || token != "aud-token-1" {
+				t.Errorf("IdentityToken() = %q, %v, want aud-token-1", token, err)
+			}
+		}()
+	}
+	wg.Wait()
+
+	if token, expiresIn, err := b.AccessToken(); err != nil || token != "access-token-1" || expiresIn > time.Hour {
+		t.Errorf("cached AccessToken() = %q, %v, %v", token, expiresIn, err)
+	}
+	if got := atomic.LoadInt32(&source.accessCalls); got != 1 {
+		t.Errorf("access token fetches: got %d, want 1", got)
+	}
+	if got := atomic.LoadInt32(&source.identityCalls); got != 1 {
+		t.Errorf("identity token fetches: got %d, want 1", got)
+	}
+
+	// Each audience has its own token.
+	if token, _, err := b.IdentityToken("other"); err != nil || token != "other-token-2" {
+		t.Errorf("IdentityToken(other) = %q, %v, want other-token-2", token, err)
+	}
+}
+
+func TestBrokerRefreshesBeforeMargin(t *testing.T) {
+	now := time.Now()
+	source := &fakeSource{expiresIn: time.Hour}
+	b := NewBroker(source, DefaultRefreshMargin, DefaultIdleTimeout)
+	b.minRefreshDelay = time.Hour
+	b.timeNow = func() time.Time { return now }
+	defer b.Close()
+
+	if _, _, err := b.AccessToken(); err != nil {
+		t.Fatal(err)
+	}
+
+	// Still fresh just before the margin.
+	now = now.Add(time.Hour - DefaultRefreshMargin - time.Second)
+	if token, _, _ := b.AccessToken(); token != "access-token-1" {
+		t.Errorf("got %q before the refresh margin, want access-token-1", token)
+	}
+
+	// Within the margin, the token is fetched again.
+	now = now.Add(2 * time.Second)
+	if token, _, _ := b.AccessToken(); token != "access-token-2" {
+		t.Errorf("got %q within the refresh margin, want access-token-2", token)
+	}
+}
+
+func TestBrokerBackgroundRefresh(t *testing.T) {
+	source := &fakeSource{expiresIn: DefaultRefreshMargin}
+	b := NewBroker(source, DefaultRefreshMargin, DefaultIdleTimeout)
+	b.minRefreshDelay = 10 * time.Millisecond
+	defer b.Close()
+
+	// The token is served even though it is within the refresh margin, and is
+	// refreshed in the background without any request.
+	if token, _, err := b.IdentityToken("aud"); err != nil || token != "aud-token-1" {
+		t.Fatalf("IdentityToken() = %q, %v, want aud-token-1", token, err)
+	}
+	deadline := time.Now().Add(5 * time.Second)
+	for atomic.LoadInt32(&source.identityCalls) < 3 {
+		if time.Now().After(deadline) {
+			t.Fatalf("token was not refreshed in the background, fetches: %d", atomic.LoadInt32(&source.identityCalls))
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+}
+
+func TestBrokerStopsRefreshingIdleTokens(t *testing.T) {
+	source := &fakeSource{expiresIn: DefaultRefreshMargin}
+	b := NewBroker(source, DefaultRefreshMargin, 0)
+	b.minRefreshDelay = 10 * time.Millisecond
+	defer b.Close()
+
+	if _, _, err := b.AccessToken(); err != nil {
+		t.Fatal(err)
+	}
+	time.Sleep(200 * time.Millisecond)
+
+	if got := atomic.LoadInt32(&source.accessCalls); got != 1 {
+		t.Errorf("idle token fetches: got %d, want 1", got)
+	}
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if len(b.entries) != 0 {
+		t.Errorf("idle token was not dropped: %v", b.entries)
+	}
+}
+
+func TestBrokerFetchError(t *testing.T) {
+	source := &fakeSource{err: fmt.Errorf("metadata server unavailable")}
+	b := NewBroker(source, DefaultRefreshMargin, DefaultIdleTimeout)
+	defer b.Close()
+
+	if _, _, err := b.AccessToken(); err == nil {
+		t.Errorf("AccessToken() succeeded, want error")
+	}
+
+	// The next request retries the fetch.
+	source.err = nil
+	source.expiresIn = time.Hour
+	if token, _, err := b.AccessToken(); err != nil || token != "access-token-2" {
+		t.Errorf("AccessToken() = %q, %v, want access-token-2", token, err)
+	}
+}
+
+func TestBrokerServesCachedTokenOnFetchError(t *testing.T) {
+	now := time.Now()
+	source := &fakeSource{expiresIn: time.Hour}
+	b := NewBroker(source, DefaultRefreshMargin, DefaultIdleTimeout)
+	b.minRefreshDelay = time.Hour
+	b.timeNow = func() time.Time { return now }
+	defer b.Close()
+
+	if _, _, err := b.AccessToken(); err != nil {
+		t.Fatal(err)
+	}
+
+	// Within the refresh margin, the failed fetch falls back to the cached
+	// token and its remaining lifetime.
+	source.err = fmt.Errorf("metadata server unavailable")
+	now = now.Add(time.Hour - time.Minute)
+	if token, expiresIn, err := b.AccessToken(); err != nil || token != "access-token-1" || expiresIn != time.Minute {
+		t.Errorf("AccessToken() = %q, %v, %v, want access-token-1, 1m0s", token, expiresIn, err)
+	}
+
+	// Once the cached token expires, the error is returned.
+	now = now.Add(time.Minute)
+	if _, _, err := b.AccessToken(); err == nil {
+		t.Errorf("AccessToken() succeeded after the token expired, want error")
+	}
+}
+
+func TestBrokerHandler(t *testing.T) {
+	source := &fakeSource{expiresIn: time.Hour}
+	b := NewBroker(source, DefaultRefreshMargin, DefaultIdleTimeout)
+	defer b.Close()
+	server := httptest.NewServer(b.Handler())
+	defer server.Close()
+
+	testData := []struct {
+		desc         string
+		path         string
+		wantStatus   int
+		wantResponse map[string]interface{}
+	}{
+		{
+			desc:       "access token in the metadata server format",
+			path:       "/v1/access_token",
+			wantStatus: http.StatusOK,
+			wantResponse: map[string]interface{}{
+				"access_token": "access-token-1",
+				"expires_in":   float64(3599),
+			},
+		},
+		{
+			desc:       "identity token with its remaining lifetime",
+			path:       "/v1/identity_token?audience=https://backend.com",
+			wantStatus: http.StatusOK,
+			wantResponse: map[string]interface{}{
+				"id_token":   "https://backend.com-token-1",
+				"expires_in": float64(3599),
+			},
+		},
+		{
+			desc:       "identity token without audience",
+			path:       "/v1/identity_token",
+			wantStatus: http.StatusBadRequest,
+		},
+	}
+
+	for _, tc := range testData {
+		t.Run(tc.desc, func(t *testing.T) {
+			resp, err := http.Get(server.URL + tc.path)
+			if err != nil {
+				t.Fatal(err)
+			}
+			defer resp.Body.Close()
+			if resp.StatusCode != tc.wantStatus {
+				t.Fatalf("got status %d, want %d", resp.StatusCode, tc.wantStatus)
+			}
+			if tc.wantResponse == nil {
+				return
+			}
+			var got map[string]interface{}
+			if err := json.NewDecoder(resp.Body).Decode(&got); err != nil {
+				t.Fatal(err)
+			}
+			for k, want := range tc.wantResponse {
+				// The lifetime is rounded down and may lose a second.
+				if k == "expires_in" {
+					if v, ok := got[k].(float64); !ok || v < want.(float64)-1 {
+						t.Errorf("%s: got %v, want about %v", k, got[k], want)
+					}
+					continue
+				}
+				if got[k] != want {
+					t.Errorf("%s: got %v, want %v", k, got[k], want)
+				}
+			}
+		})
+	}
+}
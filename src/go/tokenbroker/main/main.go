@@ -0,0 +1,52 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The token broker serves the access and identity tokens of the metadata
+// server to all the proxies of a node over a unix domain socket. Run one
+// broker per node and start the proxies with --token_broker_socket.
+package main
+
+import (
+	"flag"
+	"net/http"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/tokenbroker"
+	"github.com/golang/glog"
+)
+
+var (
+	socketPath         = flag.String("socket_path", "/var/run/espv2/token-broker.sock", "Unix domain socket the broker listens on.")
+	metadataURL        = flag.String("metadata_url", "http://169.254.169.254", "URL of the metadata server.")
+	httpRequestTimeout = flag.Duration("http_request_timeout", 30*time.Second, "Timeout of the requests to the metadata server.")
+	refreshMargin      = flag.Duration("refresh_margin", tokenbroker.DefaultRefreshMargin, "How long before they expire the tokens are refreshed. Must be longer than the 60s refresh buffer of the proxies.")
+	idleTimeout        = flag.Duration("idle_timeout", tokenbroker.DefaultIdleTimeout, "Tokens no proxy asked for in this long are not refreshed anymore.")
+)
+
+func main() {
+	flag.Set("alsologtostderr", "true")
+	flag.Parse()
+
+	broker := tokenbroker.NewBroker(tokenbroker.NewMetadataSource(*metadataURL, *httpRequestTimeout), *refreshMargin, *idleTimeout)
+	defer broker.Close()
+
+	lis, err := tokenbroker.ListenUnix(*socketPath)
+	if err != nil {
+		glog.Fatal(err)
+	}
+	glog.Infof("token broker listening on %s", *socketPath)
+	if err := http.Serve(lis, broker.Handler()); err != nil {
+		glog.Fatalf("token broker stopped: %v", err)
+	}
+}
@@ -0,0 +1,80 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tokenbroker
+
+import (
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"net/http"
+	"net/url"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+)
+
+// The metadata server does not return the lifetime of identity tokens.
+const identityTokenExpiry = 3599 * time.Second
+
+// MetadataSource fetches tokens from the metadata server. Unlike
+// metadata.MetadataFetcher it does not cache them, so the broker decides
+// when they are refreshed.
+type MetadataSource struct {
+	client  http.Client
+	baseUrl string
+}
+
+func NewMetadataSource(metadataURL string, timeout time.Duration) *MetadataSource {
+	return &MetadataSource{
+		client: http.Client{
+			Timeout: timeout,
+		},
+		baseUrl: metadataURL,
+	}
+}
+
+func (ms *MetadataSource) get(path string) ([]byte, error) {
+	req, _ := http.NewRequest("GET", ms.baseUrl+path, nil)
+	req.Header.Add("Metadata-Flavor", "Google")
+	resp, err := ms.client.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("failed fetching metadata: %v, status code %v", path, resp.StatusCode)
+	}
+	return ioutil.ReadAll(resp.Body)
+}
+
+func (ms *MetadataSource) FetchAccessToken() (string, time.Duration, error) {
+	body, err := ms.get(util.AccessTokenPath)
+	if err != nil {
+		return "", 0, err
+	}
+	var resp accessTokenResponse
+	if err := json.Unmarshal(body, &resp); err != nil {
+		return "", 0, err
+	}
+	return resp.AccessToken, time.Duration(resp.ExpiresIn) * time.Second, nil
+}
+
+func (ms *MetadataSource) FetchIdentityToken(audience string) (string, time.Duration, error) {
+	body, err := ms.get(util.IdentityTokenPath + "?format=standard&audience=" + url.QueryEscape(audience))
+	if err != nil {
+		return "", 0, err
+	}
+	return string(body), identityTokenExpiry, nil
+}
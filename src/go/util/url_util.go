@@ -162,6 +162,30 @@ func ExtractAddressFromURI(uri string) (string, error) {
 	return fmt.Sprintf("%s:%v", hostname, port), nil
 }
 
+// ParseCheckCachePeers parses the comma-separated host:port addresses of the
+// peer check cache.
+func ParseCheckCachePeers(peers string) ([]string, error) {
+	var addresses []string
+	for _, address := range strings.Split(peers, ",") {
+		address = strings.TrimSpace(address)
+		if address == "" {
+			continue
+		}
+		_, port, err := net.SplitHostPort(address)
+		if err != nil {
+			return nil, fmt.Errorf("invalid check cache peer %q: %v", address, err)
+		}
+		if _, err := strconv.ParseUint(port, 10, 16); err != nil {
+			return nil, fmt.Errorf("invalid check cache peer %q: invalid port", address)
+		}
+		addresses = append(addresses, address)
+	}
+	if len(addresses) == 0 {
+		return nil, fmt.Errorf("no check cache peer in %q", peers)
+	}
+	return addresses, nil
+}
+
 var (
 	FetchRolloutIdURL = func(serviceControlUrl, serviceName string) string {
 		return fmt.Sprintf("%v/v1/services/%s:report",
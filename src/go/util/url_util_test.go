@@ -18,6 +18,7 @@ import (
 	"encoding/json"
 	"net/http"
 	"net/http/httptest"
+	"reflect"
 	"strings"
 	"testing"
 
@@ -481,6 +482,46 @@ func TestExtraAddressFromURI(t *testing.T) {
 	}
 }
 
+func TestParseCheckCachePeers(t *testing.T) {
+	testData := []struct {
+		desc            string
+		peers           string
+		wantedAddresses []string
+		wantedError     string
+	}{
+		{
+			desc:            "Succeeded to parse peers",
+			peers:           "10.0.0.1:8792, esp-1.esp:8792,",
+			wantedAddresses: []string{"10.0.0.1:8792", "esp-1.esp:8792"},
+		},
+		{
+			desc:        "Failed without port",
+			peers:       "10.0.0.1",
+			wantedError: `invalid check cache peer "10.0.0.1"`,
+		},
+		{
+			desc:        "Failed with invalid port",
+			peers:       "10.0.0.1:port",
+			wantedError: "invalid port",
+		},
+		{
+			desc:        "Failed without peer",
+			peers:       " , ",
+			wantedError: "no check cache peer",
+		},
+	}
+
+	for i, tc := range testData {
+		addresses, err := ParseCheckCachePeers(tc.peers)
+		if !reflect.DeepEqual(addresses, tc.wantedAddresses) {
+			t.Errorf("Test Desc(%d): %s, ParseCheckCachePeers got: %v, want: %v", i, tc.desc, addresses, tc.wantedAddresses)
+		}
+		if (err == nil) != (tc.wantedError == "") || err != nil && !strings.Contains(err.Error(), tc.wantedError) {
+			t.Errorf("Test Desc(%d): %s, ParseCheckCachePeers got error: %v, want: %v", i, tc.desc, err, tc.wantedError)
+		}
+	}
+}
+
 func TestFetchConfigRelatedUrl(t *testing.T) {
 	sm := "https://servicemanagement.googleapis.com"
 	sn := "service-name"
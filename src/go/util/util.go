@@ -63,6 +63,17 @@ const (
 	// The path of getting access token from token agent server
 	TokenAgentAccessTokenPath = "/local/access_token"
 
+	// The host and paths of the node-local token broker. The broker is reached
+	// over a unix domain socket, so the host is only sent as the Host header.
+	TokenBrokerURL               = "http://token-broker"
+	TokenBrokerAccessTokenPath   = "/v1/access_token"
+	TokenBrokerIdentityTokenPath = "/v1/identity_token"
+
+	// The paths of the peer check cache served by the config manager, see
+	// peer_check_cache.proto.
+	PeerCheckCacheLookupPath  = "/v1/checkCache:lookup"
+	PeerCheckCachePublishPath = "/v1/checkCache:publish"
+
 	// b/147591854: This string must NOT have a trailing slash
 	OpenIDDiscoveryCfgURLSuffix = "/.well-known/openid-configuration"
 
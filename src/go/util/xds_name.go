@@ -43,10 +43,12 @@ const (
 	AccessFileLogger = "envoy.access_loggers.file"
 	// Upstream protocol options
 	UpstreamProtocolOptions = "envoy.extensions.upstreams.http.v3.HttpProtocolOptions"
-	// Envoy compressor filter name
-	EnvoyCompressorFilter = "envoy.filters.http.compressor"
-	EnvoyBrotliCompressor = "envoy.compression.brotli.compressor"
-	EnvoyGzipCompressor   = "envoy.compression.gzip.compressor"
+	// Envoy compressor filter names, one per compressor library so that each
+	// filter can be disabled per route.
+	EnvoyGzipCompressorFilter   = "envoy.filters.http.compressor.gzip"
+	EnvoyBrotliCompressorFilter = "envoy.filters.http.compressor.brotli"
+	EnvoyBrotliCompressor       = "envoy.compression.brotli.compressor"
+	EnvoyGzipCompressor         = "envoy.compression.gzip.compressor"
 
 	// ESPv2 custom http filters.
 
@@ -65,6 +67,9 @@ const (
 	// The token agent server cluster name.
 	TokenAgentClusterName = "token-agent-cluster"
 
+	// The node-local token broker cluster name.
+	TokenBrokerClusterName = "token-broker-cluster"
+
 	// The iam server cluster name.
 	IamServerClusterName = "iam-cluster"
 
@@ -84,3 +89,8 @@ func JwtProviderClusterName(address string) string {
 func BackendClusterName(address string) string {
 	return fmt.Sprintf("backend-cluster-%s", address)
 }
+
+// Peer check cache cluster's name will be in form of "check-cache-peer-cluster-${PEER_ADDRESS}".
+func CheckCachePeerClusterName(address string) string {
+	return fmt.Sprintf("check-cache-peer-cluster-%s", address)
+}
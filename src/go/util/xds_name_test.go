@@ -45,3 +45,17 @@ func TestBackendClusterName(t *testing.T) {
 		t.Errorf("fail to create backend cluster name, expected: %s, got: %s", testCase.wantedName, gotName)
 	}
 }
+
+func TestCheckCachePeerClusterName(t *testing.T) {
+	testCase := struct {
+		address    string
+		wantedName string
+	}{
+		address:    "10.0.0.1:8792",
+		wantedName: "check-cache-peer-cluster-10.0.0.1:8792",
+	}
+
+	if gotName := CheckCachePeerClusterName(testCase.address); gotName != testCase.wantedName {
+		t.Errorf("fail to create check cache peer cluster name, expected: %s, got: %s", testCase.wantedName, gotName)
+	}
+}
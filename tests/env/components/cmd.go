@@ -15,8 +15,13 @@
 package components
 
 import (
+	"bytes"
+	"fmt"
+	"io/ioutil"
 	"os"
 	"os/exec"
+	"strconv"
+	"strings"
 	"time"
 
 	"github.com/golang/glog"
@@ -25,6 +30,9 @@ import (
 const (
 	startWaitTime = 500 * time.Millisecond
 	stopWaitTime  = 500 * time.Millisecond
+
+	// The unit of the CPU times in /proc/<pid>/stat (USER_HZ).
+	clockTicksPerSecond = 100
 )
 
 type Cmd struct {
@@ -70,3 +78,27 @@ func (c *Cmd) StopAndWait() error {
 	}
 	return nil
 }
+
+// CPUTime returns the user and system CPU time used so far by the running
+// command. Only supported on Linux.
+func (c *Cmd) CPUTime() (time.Duration, error) {
+	stat, err := ioutil.ReadFile(fmt.Sprintf("/proc/%d/stat", c.Process.Pid))
+	if err != nil {
+		return 0, err
+	}
+	// The command name in the second field may contain spaces, so split the
+	// fields after it. The utime and stime are the 14th and 15th fields.
+	fields := strings.Fields(string(stat[bytes.LastIndexByte(stat, ')')+1:]))
+	if len(fields) < 13 {
+		return 0, fmt.Errorf("malformed stat of %v: %q", c.name, stat)
+	}
+	var ticks int64
+	for _, field := range fields[11:13] {
+		n, err := strconv.ParseInt(field, 10, 64)
+		if err != nil {
+			return 0, fmt.Errorf("malformed stat of %v: %v", c.name, err)
+		}
+		ticks += n
+	}
+	return time.Duration(ticks) * time.Second / clockTicksPerSecond, nil
+}
@@ -41,12 +41,15 @@ const (
 
 type FakeJwtService struct {
 	ProviderMap map[string]*MockJwtProvider
+	// Whether the providers respond 503, including the ones setup later.
+	providersDown bool
 }
 
 // MockJwtProvider mocks the Jwt provider.
 type MockJwtProvider struct {
 	s            *httptest.Server
 	cnt          *int32
+	down         int32
 	AuthProvider *scpb.AuthProvider
 }
 
@@ -103,6 +106,8 @@ func (fjs *FakeJwtService) SetupJwt(requestedProviders map[string]bool, ports *p
 			provider.AuthProvider.JwksUri = provider.GetURL()
 		}
 
+		provider.SetDown(fjs.providersDown)
+
 		// Save provider
 		fjs.ProviderMap[config.Id] = provider
 		glog.Infof("Setup JWT provider %v -> %+v", config.Id, provider.AuthProvider)
@@ -184,6 +189,15 @@ func (fjs *FakeJwtService) TearDown() {
 	}
 }
 
+// SetProvidersDown makes the providers respond 503 instead of their keys, or
+// brings them back. It also applies to the providers setup later.
+func (fjs *FakeJwtService) SetProvidersDown(down bool) {
+	fjs.providersDown = down
+	for _, provider := range fjs.ProviderMap {
+		provider.SetDown(down)
+	}
+}
+
 func (fjs *FakeJwtService) ResetReqCnt(provider string) {
 	mockJwtProvider := fjs.ProviderMap[provider]
 	atomic.SwapInt32(mockJwtProvider.cnt, 0)
@@ -200,6 +214,11 @@ func newMockJwtProvider(addr, respKeys string) (*MockJwtProvider, error) {
 	}
 	mockJwtProvider.s = httptest.NewUnstartedServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
 		atomic.AddInt32(mockJwtProvider.cnt, 1)
+		if atomic.LoadInt32(&mockJwtProvider.down) != 0 {
+			glog.Infof("Provider at addr %v responding with: HTTP 503 as it is down", addr)
+			http.Error(w, `{"code": 503, "message": "service not found"}`, 503)
+			return
+		}
 		glog.Infof("Provider at addr %v responding with: %v", addr, respKeys)
 		w.Write([]byte(respKeys))
 	}))
@@ -278,6 +297,16 @@ func (m *MockJwtProvider) GetURL() string {
 	return m.s.URL
 }
 
+// SetDown makes the provider respond 503 instead of its keys, or brings it
+// back. Only the providers created by newMockJwtProvider can be down.
+func (m *MockJwtProvider) SetDown(down bool) {
+	var v int32
+	if down {
+		v = 1
+	}
+	atomic.StoreInt32(&m.down, v)
+}
+
 func (m *MockJwtProvider) GetReqCnt() int {
 	return int(atomic.LoadInt32(m.cnt))
 }
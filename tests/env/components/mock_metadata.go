@@ -46,7 +46,9 @@ var defaultResp = map[string]string{
 type MockMetadataServer struct {
 	s        *httptest.Server
 	reqCache map[string]int
-	mtx      sync.RWMutex
+	// The status codes of the failing paths, see SetPathFailure.
+	pathFailures map[string]int
+	mtx          sync.RWMutex
 
 	// ID Token Subscribers make a call for each audience at the same time.
 	// Debounce multiple requests with this.
@@ -66,6 +68,7 @@ func NewMockMetadata(pathResp map[string]string, wantNumFails int) *MockMetadata
 
 	m := &MockMetadataServer{
 		reqCache:     make(map[string]int),
+		pathFailures: make(map[string]int),
 		retryHandler: NewRetryHandler(wantNumFails),
 	}
 	m.s = httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
@@ -78,8 +81,14 @@ func NewMockMetadata(pathResp map[string]string, wantNumFails int) *MockMetadata
 
 		m.mtx.Lock()
 		m.reqCache[r.URL.Path] += 1
+		failure := m.pathFailures[r.URL.Path]
 		m.mtx.Unlock()
 
+		if failure != 0 {
+			w.WriteHeader(failure)
+			return
+		}
+
 		if r.URL.Path == "" || r.URL.Path == "/" {
 			w.WriteHeader(http.StatusOK)
 			return
@@ -118,6 +127,18 @@ func (m *MockMetadataServer) GetReqCnt(reqPath string) int {
 	return reqCnt
 }
 
+// SetPathFailure makes the requests to the given path fail with the status
+// code, until it is called again with 0. Query params are ignored.
+func (m *MockMetadataServer) SetPathFailure(reqPath string, statusCode int) {
+	m.mtx.Lock()
+	defer m.mtx.Unlock()
+	if statusCode == 0 {
+		delete(m.pathFailures, reqPath)
+		return
+	}
+	m.pathFailures[reqPath] = statusCode
+}
+
 func (m *MockMetadataServer) GetTotalReqCnt() int {
 	m.mtx.RLock()
 	totalCount := 0
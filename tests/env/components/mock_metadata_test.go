@@ -98,3 +98,22 @@ func TestMockMetadata(t *testing.T) {
 		}
 	}
 }
+
+func TestMockMetadataPathFailure(t *testing.T) {
+	s := NewMockMetadata(nil, 0)
+	url := s.GetURL() + util.AccessTokenPath
+
+	s.SetPathFailure(util.AccessTokenPath, http.StatusServiceUnavailable)
+	if status, _, err := doRequest("GET", url); err != nil || status != http.StatusServiceUnavailable {
+		t.Errorf("failing path: got (%v, %v), want 503", status, err)
+	}
+	if status, _, err := doRequest("GET", s.GetURL()+util.ConfigIDPath); err != nil || status != http.StatusOK {
+		t.Errorf("other path: got (%v, %v), want 200", status, err)
+	}
+
+	s.SetPathFailure(util.AccessTokenPath, 0)
+	status, resp, err := doRequest("GET", url)
+	if err != nil || status != http.StatusOK || resp != fakeToken {
+		t.Errorf("recovered path: got (%v, %q, %v), want 200 with the token", status, resp, err)
+	}
+}
@@ -51,6 +51,10 @@ type MockServiceCtrl struct {
 	quotaHandler       http.Handler
 	reportHandler      http.Handler
 	getRequestsTimeout time.Duration
+	// Latency and fault profiles, set with SetFaultProfile or the control API.
+	faults *faults
+	// Set to 1 to not record the requests for GetRequests.
+	skipRecording int32
 }
 
 type serviceHandler struct {
@@ -66,7 +70,13 @@ func (h *serviceHandler) ServeHTTP(w http.ResponseWriter, r *http.Request) {
 	}
 	atomic.AddInt32(h.m.count, 1)
 	req.ReqBody, _ = ioutil.ReadAll(r.Body)
-	h.m.ch <- req
+	if atomic.LoadInt32(&h.m.skipRecording) == 0 {
+		h.m.ch <- req
+	}
+
+	if h.m.faults.inject(w, h.resp.reqType) {
+		return
+	}
 
 	if h.resp.respStatusCode != 0 {
 		w.WriteHeader(h.resp.respStatusCode)
@@ -104,6 +114,7 @@ func NewMockServiceCtrl(serviceName, rolloutId string) *MockServiceCtrl {
 		count:              new(int32),
 		serviceName:        serviceName,
 		getRequestsTimeout: defaultTimeout,
+		faults:             newFaults(),
 	}
 
 	m.checkHandler = &serviceHandler{
@@ -147,6 +158,7 @@ func (m *MockServiceCtrl) Setup() {
 	r.Path(checkPath).Methods("POST").Handler(m.checkHandler)
 	r.Path(quotaPath).Methods("POST").Handler(m.quotaHandler)
 	r.Path(reportPath).Methods("POST").Handler(m.reportHandler)
+	m.setupControlAPI(r)
 
 	glog.Infof("Start mock service control server for service: %s\n", m.serviceName)
 	m.s = httptest.NewUnstartedServer(r)
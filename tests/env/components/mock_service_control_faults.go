@@ -0,0 +1,406 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package components
+
+import (
+	"encoding/json"
+	"fmt"
+	"math"
+	"math/rand"
+	"net/http"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/tests/utils"
+	"github.com/golang/glog"
+	"github.com/gorilla/mux"
+)
+
+// The latency distributions of a LatencyProfile.
+const (
+	FixedLatency     = "fixed"
+	LogNormalLatency = "lognormal"
+	BimodalLatency   = "bimodal"
+	TraceLatency     = "trace"
+)
+
+// LatencyProfile is the distribution of the latency added to the responses of
+// the mock Service Control server.
+type LatencyProfile struct {
+	// One of FixedLatency, LogNormalLatency, BimodalLatency or TraceLatency.
+	// No latency is added if empty.
+	Distribution string `json:"distribution,omitempty"`
+
+	// The latency for FixedLatency, the median for LogNormalLatency, and the
+	// median of the fast mode for BimodalLatency.
+	MedianMs float64 `json:"median_ms,omitempty"`
+	// The standard deviation of the log of the latency, for LogNormalLatency
+	// and both modes of BimodalLatency.
+	Sigma float64 `json:"sigma,omitempty"`
+
+	// The median of the slow mode and the fraction of the requests in it, for
+	// BimodalLatency.
+	SlowMedianMs float64 `json:"slow_median_ms,omitempty"`
+	SlowFraction float64 `json:"slow_fraction,omitempty"`
+
+	// The recorded latencies replayed in order, and then again from the start,
+	// for TraceLatency.
+	TraceMs []float64 `json:"trace_ms,omitempty"`
+}
+
+// FaultProfile configures the latency and the faults injected by the mock
+// Service Control server for one RPC type. The faults are applied in order:
+// a reset connection, then throttling, then the latency, then an error.
+type FaultProfile struct {
+	Latency LatencyProfile `json:"latency"`
+
+	// The fraction of the requests whose connection is reset without response.
+	ResetRate float64 `json:"reset_rate,omitempty"`
+
+	// If not zero, the requests above this rate get a 429 response.
+	ThrottleQps float64 `json:"throttle_qps,omitempty"`
+	// The number of requests allowed in a burst above ThrottleQps. Defaults
+	// to one second of ThrottleQps.
+	ThrottleBurst float64 `json:"throttle_burst,omitempty"`
+
+	// The fraction of the requests that get ErrorStatusCode after the latency.
+	ErrorRate float64 `json:"error_rate,omitempty"`
+	// Defaults to 503.
+	ErrorStatusCode int `json:"error_status_code,omitempty"`
+}
+
+// FaultStats counts the requests of one RPC type and the faults injected.
+type FaultStats struct {
+	Requests  int64 `json:"requests"`
+	Resets    int64 `json:"resets"`
+	Throttled int64 `json:"throttled"`
+	Errors    int64 `json:"errors"`
+	// The total latency added, in milliseconds.
+	LatencyMs float64 `json:"latency_ms"`
+}
+
+func (p *FaultProfile) validate() error {
+	for name, rate := range map[string]float64{
+		"reset_rate":    p.ResetRate,
+		"error_rate":    p.ErrorRate,
+		"slow_fraction": p.Latency.SlowFraction,
+	} {
+		if rate < 0 || rate > 1 {
+			return fmt.Errorf("%s must be in [0, 1], got %v", name, rate)
+		}
+	}
+	if p.ThrottleQps < 0 || p.ThrottleBurst < 0 {
+		return fmt.Errorf("throttle_qps and throttle_burst must be >= 0")
+	}
+	if p.ErrorStatusCode != 0 && (p.ErrorStatusCode < 100 || p.ErrorStatusCode > 599) {
+		return fmt.Errorf("invalid error_status_code %v", p.ErrorStatusCode)
+	}
+
+	l := p.Latency
+	if l.MedianMs < 0 || l.SlowMedianMs < 0 || l.Sigma < 0 {
+		return fmt.Errorf("latency median_ms, slow_median_ms and sigma must be >= 0")
+	}
+	switch l.Distribution {
+	case "", FixedLatency, LogNormalLatency, BimodalLatency:
+	case TraceLatency:
+		if len(l.TraceMs) == 0 {
+			return fmt.Errorf("trace latency needs trace_ms")
+		}
+		for _, ms := range l.TraceMs {
+			if ms < 0 {
+				return fmt.Errorf("trace_ms must be >= 0, got %v", ms)
+			}
+		}
+	default:
+		return fmt.Errorf("unknown latency distribution %q", l.Distribution)
+	}
+	return nil
+}
+
+type faultAction int
+
+const (
+	noFault faultAction = iota
+	resetFault
+	throttleFault
+	errorFault
+)
+
+// faultInjector decides the faults of the requests of one RPC type.
+type faultInjector struct {
+	profile FaultProfile
+
+	mtx        sync.Mutex
+	rnd        *rand.Rand
+	traceIndex int
+	// The token bucket for throttling.
+	tokens     float64
+	lastRefill time.Time
+}
+
+func newFaultInjector(profile FaultProfile) (*faultInjector, error) {
+	if err := profile.validate(); err != nil {
+		return nil, err
+	}
+	if profile.ThrottleBurst == 0 {
+		profile.ThrottleBurst = math.Max(1, profile.ThrottleQps)
+	}
+	if profile.ErrorStatusCode == 0 {
+		profile.ErrorStatusCode = http.StatusServiceUnavailable
+	}
+	return &faultInjector{
+		profile:    profile,
+		rnd:        rand.New(rand.NewSource(time.Now().UnixNano())),
+		tokens:     profile.ThrottleBurst,
+		lastRefill: time.Now(),
+	}, nil
+}
+
+func (f *faultInjector) lognormal(medianMs float64) float64 {
+	return medianMs * math.Exp(f.profile.Latency.Sigma*f.rnd.NormFloat64())
+}
+
+func (f *faultInjector) latency() time.Duration {
+	l := f.profile.Latency
+	var ms float64
+	switch l.Distribution {
+	case FixedLatency:
+		ms = l.MedianMs
+	case LogNormalLatency:
+		ms = f.lognormal(l.MedianMs)
+	case BimodalLatency:
+		if f.rnd.Float64() < l.SlowFraction {
+			ms = f.lognormal(l.SlowMedianMs)
+		} else {
+			ms = f.lognormal(l.MedianMs)
+		}
+	case TraceLatency:
+		ms = l.TraceMs[f.traceIndex]
+		f.traceIndex = (f.traceIndex + 1) % len(l.TraceMs)
+	}
+	return time.Duration(ms * float64(time.Millisecond))
+}
+
+// decide returns the fault and the latency to inject for one request.
+func (f *faultInjector) decide(now time.Time) (faultAction, time.Duration) {
+	f.mtx.Lock()
+	defer f.mtx.Unlock()
+
+	if f.rnd.Float64() < f.profile.ResetRate {
+		return resetFault, 0
+	}
+
+	if f.profile.ThrottleQps > 0 {
+		f.tokens = math.Min(f.profile.ThrottleBurst,
+			f.tokens+now.Sub(f.lastRefill).Seconds()*f.profile.ThrottleQps)
+		f.lastRefill = now
+		if f.tokens < 1 {
+			return throttleFault, 0
+		}
+		f.tokens--
+	}
+
+	latency := f.latency()
+	if f.rnd.Float64() < f.profile.ErrorRate {
+		return errorFault, latency
+	}
+	return noFault, latency
+}
+
+// faults holds the fault profiles and stats of a MockServiceCtrl.
+type faults struct {
+	mtx       sync.Mutex
+	injectors map[utils.ServiceRequestType]*faultInjector
+	stats     map[utils.ServiceRequestType]*FaultStats
+}
+
+func newFaults() *faults {
+	return &faults{
+		injectors: make(map[utils.ServiceRequestType]*faultInjector),
+		stats:     make(map[utils.ServiceRequestType]*FaultStats),
+	}
+}
+
+func (fs *faults) statsFor(reqType utils.ServiceRequestType) *FaultStats {
+	s, ok := fs.stats[reqType]
+	if !ok {
+		s = &FaultStats{}
+		fs.stats[reqType] = s
+	}
+	return s
+}
+
+// inject applies the fault profile of the RPC type to the request. Returns
+// true if the response has been written.
+func (fs *faults) inject(w http.ResponseWriter, reqType utils.ServiceRequestType) bool {
+	fs.mtx.Lock()
+	f := fs.injectors[reqType]
+	stats := fs.statsFor(reqType)
+	stats.Requests++
+	fs.mtx.Unlock()
+	if f == nil {
+		return false
+	}
+
+	action, latency := f.decide(time.Now())
+
+	fs.mtx.Lock()
+	switch action {
+	case resetFault:
+		stats.Resets++
+	case throttleFault:
+		stats.Throttled++
+	case errorFault:
+		stats.Errors++
+	}
+	stats.LatencyMs += float64(latency) / float64(time.Millisecond)
+	fs.mtx.Unlock()
+
+	switch action {
+	case resetFault:
+		// Aborts the response and closes the connection.
+		panic(http.ErrAbortHandler)
+	case throttleFault:
+		w.WriteHeader(http.StatusTooManyRequests)
+		return true
+	}
+
+	time.Sleep(latency)
+	if action == errorFault {
+		w.WriteHeader(f.profile.ErrorStatusCode)
+		return true
+	}
+	return false
+}
+
+var rpcTypes = map[string]utils.ServiceRequestType{
+	"check":  utils.CheckRequest,
+	"quota":  utils.QuotaRequest,
+	"report": utils.ReportRequest,
+}
+
+// SetFaultProfile sets the latency and fault profile of an RPC type, which
+// replaces the previous one.
+func (m *MockServiceCtrl) SetFaultProfile(reqType utils.ServiceRequestType, profile FaultProfile) error {
+	f, err := newFaultInjector(profile)
+	if err != nil {
+		return err
+	}
+	m.faults.mtx.Lock()
+	defer m.faults.mtx.Unlock()
+	m.faults.injectors[reqType] = f
+	return nil
+}
+
+// ClearFaultProfiles removes the latency and fault profiles of all the RPC types.
+func (m *MockServiceCtrl) ClearFaultProfiles() {
+	m.faults.mtx.Lock()
+	defer m.faults.mtx.Unlock()
+	m.faults.injectors = make(map[utils.ServiceRequestType]*faultInjector)
+}
+
+// GetFaultStats returns the request and fault counts of an RPC type.
+func (m *MockServiceCtrl) GetFaultStats(reqType utils.ServiceRequestType) FaultStats {
+	m.faults.mtx.Lock()
+	defer m.faults.mtx.Unlock()
+	return *m.faults.statsFor(reqType)
+}
+
+// ResetFaultStats resets the request and fault counts of all the RPC types.
+func (m *MockServiceCtrl) ResetFaultStats() {
+	m.faults.mtx.Lock()
+	defer m.faults.mtx.Unlock()
+	m.faults.stats = make(map[utils.ServiceRequestType]*FaultStats)
+}
+
+// SetRecordRequests sets whether the requests are kept for GetRequests. The
+// requests must not be recorded when nobody reads them, e.g. in benchmarks,
+// as the server blocks once 100 requests are pending.
+func (m *MockServiceCtrl) SetRecordRequests(record bool) {
+	var skip int32
+	if !record {
+		skip = 1
+	}
+	atomic.StoreInt32(&m.skipRecording, skip)
+}
+
+func writeControlError(w http.ResponseWriter, code int, err error) {
+	glog.Errorf("Mock service control control API: %v", err)
+	http.Error(w, err.Error(), code)
+}
+
+// setupControlAPI adds the HTTP API to script the faults from the benchmarks:
+//
+//	PUT    /control/profiles/{check|quota|report}  FaultProfile in JSON
+//	DELETE /control/profiles/{check|quota|report}
+//	DELETE /control/profiles
+//	GET    /control/stats                          FaultStats by RPC in JSON
+//	DELETE /control/stats
+//	PUT    /control/record_requests?enabled={true|false}
+func (m *MockServiceCtrl) setupControlAPI(r *mux.Router) {
+	r.Path("/control/profiles/{rpc}").Methods("PUT").HandlerFunc(func(w http.ResponseWriter, req *http.Request) {
+		reqType, ok := rpcTypes[mux.Vars(req)["rpc"]]
+		if !ok {
+			writeControlError(w, http.StatusNotFound, fmt.Errorf("unknown rpc %q", mux.Vars(req)["rpc"]))
+			return
+		}
+		var profile FaultProfile
+		decoder := json.NewDecoder(req.Body)
+		decoder.DisallowUnknownFields()
+		if err := decoder.Decode(&profile); err != nil {
+			writeControlError(w, http.StatusBadRequest, err)
+			return
+		}
+		if err := m.SetFaultProfile(reqType, profile); err != nil {
+			writeControlError(w, http.StatusBadRequest, err)
+			return
+		}
+	})
+	r.Path("/control/profiles/{rpc}").Methods("DELETE").HandlerFunc(func(w http.ResponseWriter, req *http.Request) {
+		reqType, ok := rpcTypes[mux.Vars(req)["rpc"]]
+		if !ok {
+			writeControlError(w, http.StatusNotFound, fmt.Errorf("unknown rpc %q", mux.Vars(req)["rpc"]))
+			return
+		}
+		m.faults.mtx.Lock()
+		delete(m.faults.injectors, reqType)
+		m.faults.mtx.Unlock()
+	})
+	r.Path("/control/profiles").Methods("DELETE").HandlerFunc(func(w http.ResponseWriter, req *http.Request) {
+		m.ClearFaultProfiles()
+	})
+	r.Path("/control/stats").Methods("GET").HandlerFunc(func(w http.ResponseWriter, req *http.Request) {
+		stats := make(map[string]FaultStats)
+		for name, reqType := range rpcTypes {
+			stats[name] = m.GetFaultStats(reqType)
+		}
+		w.Header().Set("Content-Type", "application/json")
+		_ = json.NewEncoder(w).Encode(stats)
+	})
+	r.Path("/control/stats").Methods("DELETE").HandlerFunc(func(w http.ResponseWriter, req *http.Request) {
+		m.ResetFaultStats()
+	})
+	r.Path("/control/record_requests").Methods("PUT").HandlerFunc(func(w http.ResponseWriter, req *http.Request) {
+		switch req.URL.Query().Get("enabled") {
+		case "true":
+			m.SetRecordRequests(true)
+		case "false":
+			m.SetRecordRequests(false)
+		default:
+			writeControlError(w, http.StatusBadRequest, fmt.Errorf("enabled must be true or false"))
+		}
+	})
+}
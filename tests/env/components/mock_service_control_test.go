@@ -16,6 +16,7 @@ package components
 
 import (
 	"bytes"
+	"encoding/json"
 	"io/ioutil"
 	"net/http"
 	"testing"
@@ -202,3 +203,218 @@ func TestMockServiceControlReportStatus(t *testing.T) {
 		}
 	}
 }
+
+func callMockServiceControl(s *MockServiceCtrl, method string) (*http.Response, error) {
+	url := s.GetURL() + "/v1/services/mmm:" + method
+	req_body, _ := proto.Marshal(&scpb.CheckRequest{ServiceName: "mmm"})
+	reqq, _ := http.NewRequest("POST", url, bytes.NewReader(req_body))
+	return http.DefaultClient.Do(reqq)
+}
+
+func TestMockServiceControlFaultProfile(t *testing.T) {
+	testdata := []struct {
+		desc           string
+		profile        FaultProfile
+		wantStatusCode []int
+		wantReset      bool
+		wantMinLatency time.Duration
+		wantStats      FaultStats
+	}{
+		{
+			desc:           "no fault",
+			wantStatusCode: []int{200, 200},
+			wantStats:      FaultStats{Requests: 2},
+		},
+		{
+			desc: "errors",
+			profile: FaultProfile{
+				ErrorRate:       1,
+				ErrorStatusCode: http.StatusInternalServerError,
+			},
+			wantStatusCode: []int{500, 500},
+			wantStats:      FaultStats{Requests: 2, Errors: 2},
+		},
+		{
+			desc: "throttling",
+			profile: FaultProfile{
+				ThrottleQps:   0.001,
+				ThrottleBurst: 1,
+			},
+			wantStatusCode: []int{200, 429, 429},
+			wantStats:      FaultStats{Requests: 3, Throttled: 2},
+		},
+		{
+			desc: "connection resets",
+			profile: FaultProfile{
+				ResetRate: 1,
+			},
+			wantReset: true,
+			wantStats: FaultStats{Requests: 1, Resets: 1},
+		},
+		{
+			desc: "trace latency",
+			profile: FaultProfile{
+				Latency: LatencyProfile{
+					Distribution: TraceLatency,
+					TraceMs:      []float64{100, 50},
+				},
+			},
+			wantStatusCode: []int{200, 200, 200},
+			wantMinLatency: 250 * time.Millisecond,
+			wantStats:      FaultStats{Requests: 3, LatencyMs: 250},
+		},
+	}
+
+	for _, tc := range testdata {
+		t.Run(tc.desc, func(t *testing.T) {
+			s := NewMockServiceCtrl("mmm", "test-rollout-id")
+			s.SetRecordRequests(false)
+			s.Setup()
+			if err := s.SetFaultProfile(utils.QuotaRequest, tc.profile); err != nil {
+				t.Fatal(err)
+			}
+
+			start := time.Now()
+			if tc.wantReset {
+				if resp, err := callMockServiceControl(s, "allocateQuota"); err == nil {
+					resp.Body.Close()
+					t.Errorf("expected a connection reset, got status %v", resp.StatusCode)
+				}
+			}
+			for _, wantStatusCode := range tc.wantStatusCode {
+				resp, err := callMockServiceControl(s, "allocateQuota")
+				if err != nil {
+					t.Fatalf("Failed in request: %v", err)
+				}
+				resp.Body.Close()
+				if resp.StatusCode != wantStatusCode {
+					t.Errorf("got status %v, want %v", resp.StatusCode, wantStatusCode)
+				}
+			}
+			if elapsed := time.Since(start); elapsed < tc.wantMinLatency {
+				t.Errorf("got latency %v, want at least %v", elapsed, tc.wantMinLatency)
+			}
+
+			if got := s.GetFaultStats(utils.QuotaRequest); got != tc.wantStats {
+				t.Errorf("got stats %+v, want %+v", got, tc.wantStats)
+			}
+			// The profile only applies to its RPC type.
+			resp, err := callMockServiceControl(s, "check")
+			if err != nil {
+				t.Fatalf("Failed in request: %v", err)
+			}
+			resp.Body.Close()
+			if resp.StatusCode != 200 {
+				t.Errorf("got check status %v, want 200", resp.StatusCode)
+			}
+		})
+	}
+}
+
+func TestMockServiceControlFaultProfileValidation(t *testing.T) {
+	s := NewMockServiceCtrl("mmm", "test-rollout-id")
+	for _, profile := range []FaultProfile{
+		{ErrorRate: 2},
+		{ResetRate: -1},
+		{ThrottleQps: -1},
+		{ErrorStatusCode: 42},
+		{Latency: LatencyProfile{Distribution: "uniform"}},
+		{Latency: LatencyProfile{Distribution: TraceLatency}},
+		{Latency: LatencyProfile{Distribution: BimodalLatency, SlowFraction: 1.5}},
+	} {
+		if err := s.SetFaultProfile(utils.CheckRequest, profile); err == nil {
+			t.Errorf("expected an error for profile %+v", profile)
+		}
+	}
+}
+
+func TestMockServiceControlBimodalLatency(t *testing.T) {
+	f, err := newFaultInjector(FaultProfile{
+		Latency: LatencyProfile{
+			Distribution: BimodalLatency,
+			MedianMs:     1,
+			SlowMedianMs: 1000,
+			SlowFraction: 0.25,
+		},
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	slow := 0
+	for i := 0; i < 10000; i++ {
+		_, latency := f.decide(time.Now())
+		switch latency {
+		case time.Millisecond:
+		case time.Second:
+			slow++
+		default:
+			t.Fatalf("unexpected latency %v", latency)
+		}
+	}
+	if slow < 2000 || slow > 3000 {
+		t.Errorf("got %v slow requests out of 10000, want about 2500", slow)
+	}
+}
+
+func TestMockServiceControlControlAPI(t *testing.T) {
+	s := NewMockServiceCtrl("mmm", "test-rollout-id")
+	s.SetRecordRequests(false)
+	s.Setup()
+
+	control := func(method, path, body string) int {
+		req, _ := http.NewRequest(method, s.GetURL()+path, bytes.NewReader([]byte(body)))
+		resp, err := http.DefaultClient.Do(req)
+		if err != nil {
+			t.Fatalf("Failed in request: %v", err)
+		}
+		resp.Body.Close()
+		return resp.StatusCode
+	}
+
+	if code := control("PUT", "/control/profiles/report", `{"error_rate": 1, "error_status_code": 502}`); code != 200 {
+		t.Fatalf("failed to set the profile: %v", code)
+	}
+	if code := control("PUT", "/control/profiles/report", `{"error_rate": 7}`); code != 400 {
+		t.Errorf("got %v for an invalid profile, want 400", code)
+	}
+	if code := control("PUT", "/control/profiles/unknown", `{}`); code != 404 {
+		t.Errorf("got %v for an unknown rpc, want 404", code)
+	}
+
+	resp, err := callMockServiceControl(s, "report")
+	if err != nil {
+		t.Fatal(err)
+	}
+	resp.Body.Close()
+	if resp.StatusCode != 502 {
+		t.Errorf("got status %v, want 502", resp.StatusCode)
+	}
+
+	resp, err = http.Get(s.GetURL() + "/control/stats")
+	if err != nil {
+		t.Fatal(err)
+	}
+	var stats map[string]FaultStats
+	if err := json.NewDecoder(resp.Body).Decode(&stats); err != nil {
+		t.Fatal(err)
+	}
+	resp.Body.Close()
+	if want := (FaultStats{Requests: 1, Errors: 1}); stats["report"] != want {
+		t.Errorf("got report stats %+v, want %+v", stats["report"], want)
+	}
+
+	control("DELETE", "/control/profiles", "")
+	control("DELETE", "/control/stats", "")
+	resp, err = callMockServiceControl(s, "report")
+	if err != nil {
+		t.Fatal(err)
+	}
+	resp.Body.Close()
+	if resp.StatusCode != 200 {
+		t.Errorf("got status %v after clearing the profiles, want 200", resp.StatusCode)
+	}
+	if got := s.GetFaultStats(utils.ReportRequest); got != (FaultStats{Requests: 1}) {
+		t.Errorf("got stats %+v after the reset", got)
+	}
+}
@@ -383,6 +383,7 @@ func (e *TestEnv) Setup(confArgs []string) error {
 	confArgs = append(confArgs, fmt.Sprintf("--listener_port=%v", e.ports.ListenerPort))
 	confArgs = append(confArgs, fmt.Sprintf("--service=%v", e.fakeServiceConfig.Name))
 	confArgs = append(confArgs, fmt.Sprintf("--token_agent_port=%v", e.ports.TokenAgentPort))
+	confArgs = append(confArgs, fmt.Sprintf("--check_cache_peer_port=%v", e.ports.CheckCachePeerPort))
 
 	// Tracing configuration.
 	if e.enableTracing {
@@ -557,8 +558,16 @@ func (e *TestEnv) StopBackendServer() error {
 	return retErr
 }
 
+// EnvoyCPUTime returns the CPU time used so far by Envoy.
+func (e *TestEnv) EnvoyCPUTime() (time.Duration, error) {
+	if e.envoy == nil {
+		return 0, fmt.Errorf("envoy is not started")
+	}
+	return e.envoy.CPUTime()
+}
+
 // TearDown shutdown the servers.
-func (e *TestEnv) TearDown(t *testing.T) {
+func (e *TestEnv) TearDown(t testing.TB) {
 	glog.Infof("start tearing down...")
 
 	// Run all health checks. If they fail, our test causes a server to crash.
@@ -49,6 +49,8 @@ const (
 	TestBackendPerTryTimeout
 	TestBackendRetry
 	TestCancellationReport
+	TestCompressionBenchmarkBookstore
+	TestCompressionBenchmarkEcho
 	TestCompressionTranscoded
 	TestDeadlinesForDynamicRouting
 	TestDeadlinesForGrpcCatchAllBackend
@@ -91,6 +93,7 @@ const (
 	TestIdleTimeoutsForUnaryRPCs
 	TestInvalidOpenIDConnectDiscovery
 	TestJwtLocations
+	TestManagedJwks
 	TestManagedServiceConfig
 	TestMetadataRequestsPerPlatform
 	TestMetadataRequestsWithBackendAuthPerPlatform
@@ -129,6 +132,8 @@ const (
 	TestServiceControlLogJwtPayloads
 	TestServiceControlNetworkFailFlagForTimeout
 	TestServiceControlNetworkFailFlagForUnavailableCheckResponse
+	TestServiceControlPeerCheckCache
+	TestServiceControlPeerCheckCachePeer
 	TestServiceControlProtocolWithGRPCBackend
 	TestServiceControlProtocolWithHTTPBackend
 	TestServiceControlQuota
@@ -145,6 +150,7 @@ const (
 	TestServiceControlTLSWithValidCert
 	TestServiceManagementWithInvalidCert
 	TestServiceManagementWithValidCert
+	TestSoak
 	TestStartupDuplicatedPathsWithAllowCors
 	TestStatistics
 	TestStatisticsServiceControlCallStatus
@@ -199,6 +205,7 @@ type Ports struct {
 	BackendServerPort         uint16
 	DynamicRoutingBackendPort uint16
 	ListenerPort              uint16
+	CheckCachePeerPort        uint16
 	AdminPort                 uint16
 	FakeStackdriverPort       uint16
 	DnsResolverPort           uint16
@@ -262,6 +269,7 @@ func NewPorts(testId uint16) *Ports {
 		BackendServerPort:         base,
 		DynamicRoutingBackendPort: base + 1,
 		ListenerPort:              base + 2,
+		CheckCachePeerPort:        base + 3,
 		AdminPort:                 base + 4,
 		FakeStackdriverPort:       base + 5,
 		DnsResolverPort:           base + 6,
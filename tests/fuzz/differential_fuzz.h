@@ -0,0 +1,81 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "source/common/common/logger.h"
+
+namespace espv2 {
+namespace tests {
+namespace fuzz {
+
+// Tracks the execution time of one implementation run by a differential fuzz
+// test, and logs the inputs that are much slower than the typical input,
+// e.g. backtracking or quadratic behavior in an optimized hot path.
+//
+// libFuzzer's -timeout only catches inputs that hang, these outliers are
+// still fast enough to pass but point at an unexpected cost.
+class ExecutionTimeTracker {
+ public:
+  explicit ExecutionTimeTracker(std::string name) : name_(std::move(name)) {}
+
+  // Runs and times `fn` for `input`, returning its result.
+  template <class Fn>
+  auto run(absl::string_view input, Fn&& fn) -> decltype(fn()) {
+    const auto start = std::chrono::steady_clock::now();
+    auto result = fn();
+    record(input, std::chrono::steady_clock::now() - start);
+    return result;
+  }
+
+ private:
+  // The number of runs before outliers are reported, to skip the warm up.
+  static constexpr uint64_t kWarmUpRuns = 100;
+  // The factor above the average time for a run to be an outlier.
+  static constexpr double kOutlierFactor = 50;
+  // Runs faster than this are never outliers, to skip timer noise.
+  static constexpr std::chrono::nanoseconds kMinOutlierTime{100000};
+
+  void record(absl::string_view input, std::chrono::nanoseconds elapsed) {
+    const double elapsed_ns = elapsed.count();
+    ++runs_;
+    if (runs_ > kWarmUpRuns && elapsed > kMinOutlierTime &&
+        elapsed_ns > kOutlierFactor * average_ns_) {
+      ENVOY_LOG_MISC(warn,
+                     "{}: slow input ({} ns, {:.1f}x the average of {} runs), "
+                     "input size {}: {}",
+                     name_, elapsed.count(), elapsed_ns / average_ns_, runs_,
+                     input.size(), input.substr(0, 256));
+    }
+    // Outliers are kept out of the average once the warm up is over.
+    if (runs_ <= kWarmUpRuns || elapsed_ns <= kOutlierFactor * average_ns_) {
+      average_ns_ += (elapsed_ns - average_ns_) / std::min(runs_, kWarmUpRuns);
+    }
+  }
+
+  const std::string name_;
+  uint64_t runs_ = 0;
+  double average_ns_ = 0;
+};
+
+}  // namespace fuzz
+}  // namespace tests
+}  // namespace espv2
@@ -16,6 +16,8 @@ package auth_pkey_cache_test
 
 import (
 	"fmt"
+	"io/ioutil"
+	"os"
 	"strings"
 	"testing"
 	"time"
@@ -265,3 +267,87 @@ func TestAuthJwksAsyncFetch(t *testing.T) {
 		}()
 	}
 }
+
+// TestManagedJwks is not parallel, as the tests above alter the hard-coded
+// configuration of the provider.
+func TestManagedJwks(t *testing.T) {
+	provider := testdata.GoogleJwtProvider
+	wantResp := `{"aud":["admin.cloud.goog","bookstore_test_client.cloud.goog"],"exp":4698318999,"iat":1544718999,"iss":"api-proxy-testing@cloud.goog","sub":"api-proxy-testing@cloud.goog"}`
+
+	jwksDir, err := ioutil.TempDir("", "managed_jwks")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(jwksDir)
+	emptyJwksDir, err := ioutil.TempDir("", "managed_jwks_empty")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(emptyJwksDir)
+
+	testData := []struct {
+		desc          string
+		jwksDir       string
+		providersDown bool
+		// The requests to the provider, by the config manager or Envoy.
+		wantRequestsToProvider int
+		wantResp               string
+		wantError              string
+	}{
+		{
+			desc:                   "Success, the config manager fetches and persists the jwks, Envoy does not fetch it",
+			jwksDir:                jwksDir,
+			wantRequestsToProvider: 1,
+			wantResp:               wantResp,
+		},
+		{
+			desc:          "Success, the provider is down at startup but the persisted jwks is used",
+			jwksDir:       jwksDir,
+			providersDown: true,
+			wantResp:      wantResp,
+		},
+		{
+			desc:          "Failure, the provider is down at startup and no jwks was persisted",
+			jwksDir:       emptyJwksDir,
+			providersDown: true,
+			wantError:     `401 Unauthorized, {"code":401,"message":"Jwks remote fetch is failed"}`,
+		},
+	}
+	for _, tc := range testData {
+		func() {
+			args := utils.CommonArgs()
+			args = append(args, "--managed_jwks_dir="+tc.jwksDir)
+			// The jwks fetched by Envoy would be counted on each request otherwise.
+			args = append(args, "--jwt_cache_size=0", "--disable_jwks_async_fetch")
+
+			s := env.NewTestEnv(platform.TestManagedJwks, platform.EchoSidecar)
+			s.FakeJwtService.SetProvidersDown(tc.providersDown)
+			defer s.TearDown(t)
+			if err := s.Setup(args); err != nil {
+				t.Fatalf("fail to setup test env, %v", err)
+			}
+
+			var resp []byte
+			var err error
+			for i := 0; i < 5; i++ {
+				resp, err = client.DoJWT(fmt.Sprintf("http://%v:%v", platform.GetLoopbackAddress(), s.Ports().ListenerPort), "GET", "/auth/info/auth0", "api-key", "", testdata.FakeCloudTokenMultiAudiences)
+			}
+
+			if tc.wantError != "" {
+				if err == nil || !strings.Contains(err.Error(), tc.wantError) {
+					t.Errorf("Test (%s): failed, expected err: %v, got: %v", tc.desc, tc.wantError, err)
+				}
+			} else if err != nil {
+				t.Errorf("Test (%s): failed, got unexpected error: %v", tc.desc, err)
+			} else if !strings.Contains(string(resp), tc.wantResp) {
+				t.Errorf("Test (%s): failed\nexpected: %s\ngot: %s", tc.desc, tc.wantResp, string(resp))
+			}
+
+			if tc.wantRequestsToProvider != 0 {
+				if realCnt := s.FakeJwtService.ProviderMap[provider].GetReqCnt(); realCnt != tc.wantRequestsToProvider {
+					t.Errorf("Test (%s): failed, pubkey of %s shoud be fetched %v times instead of %v times.", tc.desc, provider, tc.wantRequestsToProvider, realCnt)
+				}
+			}
+		}()
+	}
+}
@@ -0,0 +1,176 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package compression_test
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"math/rand"
+	"net/http"
+	"strings"
+	"testing"
+
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env/platform"
+
+	confpb "google.golang.org/genproto/googleapis/api/serviceconfig"
+)
+
+// The benchmarks below measure the Envoy CPU time spent per response against
+// the bytes saved on the wire, for each response encoding and payload size.
+// Run them with:
+//
+//	go test ./tests/integration_test/compression_test -run '^$' -bench .
+//
+// Besides ns/op, they report:
+//   - envoy-cpu-ns/op: the Envoy CPU time per request.
+//   - wire-B/op: the response body size on the wire.
+//   - saved-%: the bytes saved by the encoding, relative to the payload size.
+
+var (
+	benchmarkEncodings    = []string{"identity", "gzip", "br"}
+	benchmarkPayloadSizes = []int{256, 4 << 10, 64 << 10}
+)
+
+// makePayload returns a JSON string value of about size bytes of words, which
+// compresses like typical API response text.
+func makePayload(size int) string {
+	words := []string{"alphabet", "book", "shelf", "endpoints", "proxy",
+		"google", "cloud", "title", "author", "request", "response", "42"}
+	r := rand.New(rand.NewSource(int64(size)))
+	var sb strings.Builder
+	for sb.Len() < size {
+		sb.WriteString(words[r.Intn(len(words))])
+		sb.WriteByte(' ')
+	}
+	return sb.String()[:size]
+}
+
+// postRaw sends the request and returns the size of the response body on the
+// wire and its encoding, without decoding it.
+func postRaw(cli *http.Client, url string, body []byte, acceptEncoding string) (int, string, error) {
+	req, err := http.NewRequest("POST", url, bytes.NewReader(body))
+	if err != nil {
+		return 0, "", err
+	}
+	req.Header.Set("Content-Type", "application/json")
+	// Setting the header disables the transparent decoding of the client.
+	req.Header.Set("Accept-Encoding", acceptEncoding)
+	resp, err := cli.Do(req)
+	if err != nil {
+		return 0, "", fmt.Errorf("http got error: %v", err)
+	}
+	defer resp.Body.Close()
+	content, err := ioutil.ReadAll(resp.Body)
+	if err != nil {
+		return 0, "", err
+	}
+	if resp.StatusCode != http.StatusOK {
+		return 0, "", fmt.Errorf("http response status is not 200 OK: %s, %s", resp.Status, content)
+	}
+	return len(content), resp.Header.Get("Content-Encoding"), nil
+}
+
+// runCompressionBenchmarks runs a sub-benchmark for each encoding and payload
+// size. makeBody returns the request body and the size of the uncompressed
+// response body for a payload.
+func runCompressionBenchmarks(b *testing.B, s *env.TestEnv, path string, makeBody func(payload string) ([]byte, int)) {
+	url := fmt.Sprintf("http://%v:%v%v", platform.GetLoopbackAddress(), s.Ports().ListenerPort, path)
+	cli := &http.Client{}
+	for _, size := range benchmarkPayloadSizes {
+		body, respSize := makeBody(makePayload(size))
+		for _, encoding := range benchmarkEncodings {
+			b.Run(fmt.Sprintf("%v/%vB", encoding, size), func(b *testing.B) {
+				wantEncoding := encoding
+				if encoding == "identity" {
+					wantEncoding = ""
+				}
+				// Warm up the connection and check the encoding.
+				if _, gotEncoding, err := postRaw(cli, url, body, encoding); err != nil {
+					b.Fatal(err)
+				} else if gotEncoding != wantEncoding {
+					b.Fatalf("got encoding %q, want %q", gotEncoding, wantEncoding)
+				}
+
+				startCPU, err := s.EnvoyCPUTime()
+				if err != nil {
+					b.Fatal(err)
+				}
+				b.SetBytes(int64(respSize))
+				b.ResetTimer()
+				wireBytes := 0
+				for i := 0; i < b.N; i++ {
+					n, _, err := postRaw(cli, url, body, encoding)
+					if err != nil {
+						b.Fatal(err)
+					}
+					wireBytes += n
+				}
+				b.StopTimer()
+				endCPU, err := s.EnvoyCPUTime()
+				if err != nil {
+					b.Fatal(err)
+				}
+
+				wirePerOp := float64(wireBytes) / float64(b.N)
+				b.ReportMetric(float64((endCPU-startCPU).Nanoseconds())/float64(b.N), "envoy-cpu-ns/op")
+				b.ReportMetric(wirePerOp, "wire-B/op")
+				b.ReportMetric(100*(1-wirePerOp/float64(respSize)), "saved-%")
+			})
+		}
+	}
+}
+
+func BenchmarkCompressionEcho(b *testing.B) {
+	args := []string{"--service_config_id=test-config-id",
+		"--rollout_strategy=fixed",
+		"--enable_response_compression"}
+
+	s := env.NewTestEnv(platform.TestCompressionBenchmarkEcho, platform.EchoSidecar)
+	defer s.TearDown(b)
+	if err := s.Setup(args); err != nil {
+		b.Fatalf("fail to setup test env, %v", err)
+	}
+
+	runCompressionBenchmarks(b, s, "/echo?key=api-key", func(payload string) ([]byte, int) {
+		body, _ := json.Marshal(map[string]string{"message": payload})
+		// The echo backend responds with the request body.
+		return body, len(body)
+	})
+}
+
+func BenchmarkCompressionBookstore(b *testing.B) {
+	args := []string{"--service_config_id=test-config-id",
+		"--rollout_strategy=fixed",
+		"--enable_response_compression"}
+
+	s := env.NewTestEnv(platform.TestCompressionBenchmarkBookstore, platform.GrpcBookstoreSidecar)
+	s.OverrideAuthentication(&confpb.Authentication{
+		Rules: []*confpb.AuthenticationRule{},
+	})
+	defer s.TearDown(b)
+	if err := s.Setup(args); err != nil {
+		b.Fatalf("fail to setup test env, %v", err)
+	}
+
+	// The response of the transcoded CreateBook is the created book.
+	runCompressionBenchmarks(b, s, "/v1/shelves/100/books?key=api-key", func(payload string) ([]byte, int) {
+		book := map[string]string{"id": "2001", "author": "benchmark", "title": payload}
+		body, _ := json.Marshal(book)
+		return body, len(body)
+	})
+}
@@ -0,0 +1,107 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package service_control_peer_check_cache_test
+
+import (
+	"fmt"
+	"io/ioutil"
+	"os"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/tests/endpoints/echo/client"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env/platform"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/utils"
+)
+
+// Two replicas share the check responses: the check made by the first one is
+// not made again by the second one.
+func TestServiceControlPeerCheckCache(t *testing.T) {
+	t.Parallel()
+
+	s1 := env.NewTestEnv(platform.TestServiceControlPeerCheckCache, platform.EchoSidecar)
+	s2 := env.NewTestEnv(platform.TestServiceControlPeerCheckCachePeer, platform.EchoSidecar)
+	peers := fmt.Sprintf("%v:%v,%v:%v",
+		platform.GetLoopbackAddress(), s1.Ports().CheckCachePeerPort,
+		platform.GetLoopbackAddress(), s2.Ports().CheckCachePeerPort)
+	secretFile, err := ioutil.TempFile("", "peer_check_cache_secret")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.Remove(secretFile.Name())
+	if _, err := secretFile.WriteString("secret\n"); err != nil {
+		t.Fatal(err)
+	}
+	secretFile.Close()
+	args := []string{
+		"--service_config_id=test-config-id",
+		"--rollout_strategy=fixed",
+		"--check_cache_peers=" + peers,
+		"--check_cache_peer_address=" + platform.GetLoopbackAddress(),
+		"--check_cache_peer_secret_file=" + secretFile.Name(),
+	}
+
+	defer s1.TearDown(t)
+	if err := s1.Setup(args); err != nil {
+		t.Fatalf("fail to setup test env, %v", err)
+	}
+	defer s2.TearDown(t)
+	if err := s2.Setup(args); err != nil {
+		t.Fatalf("fail to setup test env, %v", err)
+	}
+
+	wantResp := `{"message":"hello"}`
+	callEcho := func(s *env.TestEnv) {
+		url := fmt.Sprintf("http://%v:%v%v%v", platform.GetLoopbackAddress(), s.Ports().ListenerPort, "/echo", "?key=api-key")
+		resp, err := client.DoPost(url, "hello")
+		if err != nil {
+			t.Fatal(err)
+		}
+		if !strings.Contains(string(resp), wantResp) {
+			t.Errorf("expected: %s, got: %s", wantResp, string(resp))
+		}
+	}
+
+	callEcho(s1)
+	scRequests, err := s1.ServiceControlServer.GetRequests(1)
+	if err != nil {
+		t.Fatalf("GetRequests returns error: %v", err)
+	}
+	utils.CheckScRequest(t, scRequests, []interface{}{
+		&utils.ExpectedCheck{
+			Version:         utils.ESPv2Version(),
+			ServiceName:     "echo-api.endpoints.cloudesf-testing.cloud.goog",
+			ServiceConfigID: "test-config-id",
+			ConsumerID:      "api_key:api-key",
+			OperationName:   "1.echo_api_endpoints_cloudesf_testing_cloud_goog.Echo",
+			CallerIp:        platform.GetLoopbackAddress(),
+		},
+	}, "TestServiceControlPeerCheckCache")
+
+	// The check response is published to its owner after the call returns.
+	time.Sleep(time.Second)
+
+	callEcho(s2)
+	// The second replica only sends its report.
+	scRequests, err = s2.ServiceControlServer.GetRequests(1)
+	if err != nil {
+		t.Fatalf("GetRequests returns error: %v", err)
+	}
+	if scRequests[0].ReqType != utils.ReportRequest {
+		t.Errorf("the second replica sent a %v request, want only a report", scRequests[0].ReqType)
+	}
+}
@@ -0,0 +1,525 @@
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package soak_test
+
+import (
+	"context"
+	"flag"
+	"fmt"
+	"math/rand"
+	"net/http"
+	"os"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/GoogleCloudPlatform/esp-v2/src/go/util"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/endpoints/echo/client"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env/components"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env/platform"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/env/testdata"
+	"github.com/GoogleCloudPlatform/esp-v2/tests/utils"
+)
+
+// The soak test sends hours of mixed traffic through ESPv2 against the mock
+// Service Control server, to find the memory that grows with the traffic. It
+// is skipped unless a duration is given:
+//
+//	make soak-test SOAK_DURATION=4h
+//
+// The traffic runs in cycles of phases: steady, a Service Control outage, a
+// Service Control brownout, failing access token fetches, and a recovery, so
+// the retry and cancel paths are exercised as much as the happy path.
+//
+// Each sample interval, the Envoy heap stats and the ESPv2 gauges are logged:
+// the Service Control calls alive, the check calls in flight and the bytes in
+// the report retry queues. At the end of each cycle, the traffic stops until
+// the calls drain, and a drained sample is taken. The test fails if the calls
+// do not drain, or if the heap grows across the drained samples.
+
+var (
+	soakDuration       = flag.Duration("soak_duration", 0, "The duration of the soak test, which is skipped if 0.")
+	soakPhaseDuration  = flag.Duration("soak_phase_duration", 5*time.Minute, "The duration of each phase of a soak cycle.")
+	soakSampleInterval = flag.Duration("soak_sample_interval", time.Minute, "The interval between two samples of the stats.")
+	soakQps            = flag.Int("soak_qps", 200, "The requests sent per second.")
+	soakConcurrency    = flag.Int("soak_concurrency", 16, "The maximum number of requests in flight.")
+	soakApiKeys        = flag.Int("soak_api_keys", 1000, "The number of distinct API keys sent, to churn the check cache.")
+	soakSamplesFile    = flag.String("soak_samples_file", "", "If set, the samples are written to this file as CSV.")
+)
+
+const (
+	// The access tokens of the mock metadata server expire after this, so
+	// they are refreshed every 30 seconds, and expire during the token
+	// failure phase.
+	soakTokenExpiry = 90 * time.Second
+
+	// The longest wait for the calls to drain at the end of a cycle. The
+	// report retries back off for up to 10 seconds.
+	soakDrainTimeout = time.Minute
+
+	// The heap grows monotonically if it grows in this fraction of the
+	// intervals between the drained samples, and by more than
+	// soakMinHeapGrowth in total. The drained sample of the first cycle is
+	// not used, as the caches are still warming up.
+	soakMinIncreaseFraction = 0.7
+	soakMinHeapGrowth       = 1 << 20
+
+	// The client timeout of the requests cancelled by the client.
+	soakClientTimeout = 500 * time.Millisecond
+
+	statPrefix = "http.ingress_http.service_control."
+)
+
+// soakPhase is one phase of a soak cycle.
+type soakPhase struct {
+	name string
+	// Sets the faults of the phase up, after the faults of the previous phase
+	// are cleared.
+	setUp func(s *env.TestEnv) error
+}
+
+var soakPhases = []soakPhase{
+	{
+		name:  "steady",
+		setUp: func(s *env.TestEnv) error { return nil },
+	},
+	{
+		// All the calls fail and are retried, the reports are queued for a
+		// retry until the queue is full.
+		name: "sc_outage",
+		setUp: func(s *env.TestEnv) error {
+			for _, reqType := range []utils.ServiceRequestType{utils.CheckRequest, utils.QuotaRequest, utils.ReportRequest} {
+				if err := s.ServiceControlServer.SetFaultProfile(reqType, components.FaultProfile{
+					ErrorRate: 1,
+				}); err != nil {
+					return err
+				}
+			}
+			return nil
+		},
+	},
+	{
+		// The slow checks time out, or are cancelled by the clients that
+		// time out first. Some connections are reset, and the reports are
+		// throttled.
+		name: "sc_brownout",
+		setUp: func(s *env.TestEnv) error {
+			if err := s.ServiceControlServer.SetFaultProfile(utils.CheckRequest, components.FaultProfile{
+				Latency: components.LatencyProfile{
+					Distribution: components.LogNormalLatency,
+					MedianMs:     400,
+					Sigma:        1,
+				},
+				ResetRate: 0.1,
+			}); err != nil {
+				return err
+			}
+			return s.ServiceControlServer.SetFaultProfile(utils.ReportRequest, components.FaultProfile{
+				ThrottleQps: 1,
+			})
+		},
+	},
+	{
+		// The access token fetches fail, until the token expires and the
+		// Service Control calls fail without being sent.
+		name: "token_failure",
+		setUp: func(s *env.TestEnv) error {
+			s.MockMetadataServer.SetPathFailure(util.AccessTokenPath, http.StatusServiceUnavailable)
+			return nil
+		},
+	},
+	{
+		name:  "recovery",
+		setUp: func(s *env.TestEnv) error { return nil },
+	},
+}
+
+func clearFaults(s *env.TestEnv) {
+	s.ServiceControlServer.ClearFaultProfiles()
+	s.MockMetadataServer.SetPathFailure(util.AccessTokenPath, 0)
+}
+
+// soakRequest is one kind of request of the mixed traffic.
+type soakRequest struct {
+	name string
+	// The relative frequency of the request.
+	weight int
+	send   func(host, apiKey string) error
+}
+
+var soakRequests = []soakRequest{
+	{
+		// Checked and reported.
+		name:   "echo",
+		weight: 6,
+		send: func(host, apiKey string) error {
+			_, err := client.DoPost(fmt.Sprintf("%v/echo?key=%v", host, apiKey), "hello")
+			return err
+		},
+	},
+	{
+		// Only reported.
+		name:   "echo_nokey",
+		weight: 1,
+		send: func(host, apiKey string) error {
+			_, err := client.DoPost(host+"/echo/nokey", "hello")
+			return err
+		},
+	},
+	{
+		// Authenticated with a JWT, checked and reported.
+		name:   "jwt",
+		weight: 2,
+		send: func(host, apiKey string) error {
+			_, err := client.DoWithHeaders(fmt.Sprintf("%v/auth/info/auth0?key=%v", host, apiKey), "GET", "", map[string]string{
+				"Authorization": "Bearer " + testdata.FakeCloudTokenMultiAudiences,
+			})
+			return err
+		},
+	},
+	{
+		// Cancelled by the client while the check or the backend is pending.
+		name:   "cancelled",
+		weight: 1,
+		send: func(host, apiKey string) error {
+			_, err := client.DoWithHeadersAndTimeout(fmt.Sprintf("%v/sleep?duration=2s&key=%v", host, apiKey), "GET", "", nil, soakClientTimeout)
+			return err
+		},
+	},
+}
+
+// soakCounts counts the requests of each kind sent in a phase.
+type soakCounts struct {
+	sent   []int64
+	failed []int64
+}
+
+func newSoakCounts() *soakCounts {
+	return &soakCounts{
+		sent:   make([]int64, len(soakRequests)),
+		failed: make([]int64, len(soakRequests)),
+	}
+}
+
+func (c *soakCounts) String() string {
+	var parts []string
+	for i, req := range soakRequests {
+		parts = append(parts, fmt.Sprintf("%v: %v sent, %v failed", req.name,
+			atomic.LoadInt64(&c.sent[i]), atomic.LoadInt64(&c.failed[i])))
+	}
+	return strings.Join(parts, "; ")
+}
+
+// runTraffic sends the mixed traffic at the given rate until the context is
+// done, and waits for the requests in flight.
+func runTraffic(ctx context.Context, host string, r *rand.Rand, counts *soakCounts) {
+	totalWeight := 0
+	for _, req := range soakRequests {
+		totalWeight += req.weight
+	}
+
+	// The requests are dropped when all the clients are busy, so a slow
+	// proxy is not sent a growing backlog.
+	type job struct {
+		req    int
+		apiKey string
+	}
+	jobs := make(chan job)
+	var wg sync.WaitGroup
+	for i := 0; i < *soakConcurrency; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for j := range jobs {
+				atomic.AddInt64(&counts.sent[j.req], 1)
+				if err := soakRequests[j.req].send(host, j.apiKey); err != nil {
+					atomic.AddInt64(&counts.failed[j.req], 1)
+				}
+			}
+		}()
+	}
+
+	ticker := time.NewTicker(time.Second / time.Duration(*soakQps))
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ctx.Done():
+			close(jobs)
+			wg.Wait()
+			return
+		case <-ticker.C:
+			pick := r.Intn(totalWeight)
+			req := 0
+			for ; pick >= soakRequests[req].weight; req++ {
+				pick -= soakRequests[req].weight
+			}
+			select {
+			case jobs <- job{req: req, apiKey: fmt.Sprintf("api-key-%v", r.Intn(*soakApiKeys))}:
+			default:
+			}
+		}
+	}
+}
+
+// soakSample is a sample of the Envoy heap stats and the ESPv2 gauges.
+type soakSample struct {
+	time   time.Time
+	phase  string
+	memory *utils.MemoryStats
+	// The Service Control calls alive.
+	httpCallActive int
+	// The check calls in flight.
+	checkPending int
+	// The bytes in the report retry queues.
+	reportRetryQueuedBytes int
+}
+
+// retained is the heap size backed by memory, allocated or not.
+func (s *soakSample) retained() uint64 {
+	return s.memory.HeapSize - s.memory.PageheapUnmapped
+}
+
+// fragmentation is the fraction of the retained heap not allocated.
+func (s *soakSample) fragmentation() float64 {
+	if s.retained() == 0 {
+		return 0
+	}
+	return 1 - float64(s.memory.Allocated)/float64(s.retained())
+}
+
+func (s *soakSample) drained() bool {
+	return s.httpCallActive == 0 && s.checkPending == 0 && s.reportRetryQueuedBytes == 0
+}
+
+const soakSampleHeader = "time,phase,allocated,heap_size,pageheap_unmapped,pageheap_free,total_thread_cache,fragmentation,http_call_active,check_pending,report_retry_queued_bytes"
+
+func (s *soakSample) String() string {
+	return fmt.Sprintf("%v,%v,%v,%v,%v,%v,%v,%.3f,%v,%v,%v",
+		s.time.Format(time.RFC3339), s.phase, s.memory.Allocated, s.memory.HeapSize,
+		s.memory.PageheapUnmapped, s.memory.PageheapFree, s.memory.TotalThreadCache,
+		s.fragmentation(), s.httpCallActive, s.checkPending, s.reportRetryQueuedBytes)
+}
+
+func takeSample(adminPort uint16, phase string) (*soakSample, error) {
+	memory, err := utils.FetchMemoryStats(adminPort)
+	if err != nil {
+		return nil, err
+	}
+	// The gauges are fetched with the counters.
+	stats, _, err := utils.FetchStats(adminPort)
+	if err != nil {
+		return nil, err
+	}
+	return &soakSample{
+		time:                   time.Now(),
+		phase:                  phase,
+		memory:                 memory,
+		httpCallActive:         stats[statPrefix+"http_call_active"],
+		checkPending:           stats[statPrefix+"check_pending"],
+		reportRetryQueuedBytes: stats[statPrefix+"report_retry_queued_bytes"],
+	}, nil
+}
+
+// waitDrained waits for the calls to drain, and returns the last sample.
+func waitDrained(adminPort uint16, phase string) (*soakSample, error) {
+	deadline := time.Now().Add(soakDrainTimeout)
+	for {
+		sample, err := takeSample(adminPort, phase)
+		if err != nil || sample.drained() || time.Now().After(deadline) {
+			return sample, err
+		}
+		time.Sleep(time.Second)
+	}
+}
+
+// detectGrowth returns true if the values grow monotonically: they increase
+// in at least soakMinIncreaseFraction of the intervals, and by more than
+// minGrowth in total. The heap of a healthy proxy plateaus once its caches
+// are warm, while a leak of a few bytes per request grows it at almost every
+// sample.
+func detectGrowth(values []float64, minGrowth float64) bool {
+	if len(values) < 3 {
+		return false
+	}
+	increases := 0
+	for i := 1; i < len(values); i++ {
+		if values[i] > values[i-1] {
+			increases++
+		}
+	}
+	return float64(increases) >= soakMinIncreaseFraction*float64(len(values)-1) &&
+		values[len(values)-1]-values[0] > minGrowth
+}
+
+func TestSoak(t *testing.T) {
+	if *soakDuration == 0 {
+		t.Skip("the soak test is skipped without --soak_duration")
+	}
+
+	s := env.NewTestEnv(platform.TestSoak, platform.EchoSidecar)
+	s.OverrideMockMetadata(map[string]string{
+		util.AccessTokenPath: fmt.Sprintf(`{"access_token": "ya29.new", "expires_in":%v, "token_type":"Bearer"}`,
+			int(soakTokenExpiry.Seconds())),
+	}, 0)
+	defer s.TearDown(t)
+	if err := s.Setup(utils.CommonArgs()); err != nil {
+		t.Fatalf("fail to setup test env, %v", err)
+	}
+	// The requests are not checked, and would block on the request channel.
+	s.ServiceControlServer.SetRecordRequests(false)
+
+	var samplesFile *os.File
+	if *soakSamplesFile != "" {
+		var err error
+		if samplesFile, err = os.Create(*soakSamplesFile); err != nil {
+			t.Fatalf("fail to create the samples file: %v", err)
+		}
+		defer samplesFile.Close()
+		fmt.Fprintln(samplesFile, soakSampleHeader)
+	}
+	var samplesMu sync.Mutex
+	recordSample := func(sample *soakSample) {
+		samplesMu.Lock()
+		defer samplesMu.Unlock()
+		t.Logf("sample: %v", sample)
+		if samplesFile != nil {
+			fmt.Fprintln(samplesFile, sample)
+		}
+	}
+
+	// Samples the stats until the end of the test.
+	adminPort := s.Ports().AdminPort
+	var phase atomic.Value
+	phase.Store("start")
+	samplerCtx, stopSampler := context.WithCancel(context.Background())
+	samplerDone := make(chan struct{})
+	go func() {
+		defer close(samplerDone)
+		ticker := time.NewTicker(*soakSampleInterval)
+		defer ticker.Stop()
+		for {
+			select {
+			case <-samplerCtx.Done():
+				return
+			case <-ticker.C:
+				sample, err := takeSample(adminPort, phase.Load().(string))
+				if err != nil {
+					t.Errorf("fail to sample the stats: %v", err)
+					continue
+				}
+				recordSample(sample)
+			}
+		}
+	}()
+	defer func() {
+		stopSampler()
+		<-samplerDone
+	}()
+
+	host := fmt.Sprintf("http://%v:%v", platform.GetLoopbackAddress(), s.Ports().ListenerPort)
+	r := rand.New(rand.NewSource(time.Now().UnixNano()))
+	var drainedSamples []*soakSample
+	end := time.Now().Add(*soakDuration)
+	for cycle := 1; time.Now().Before(end); cycle++ {
+		for _, p := range soakPhases {
+			clearFaults(s)
+			if err := p.setUp(s); err != nil {
+				t.Fatalf("fail to set up phase %v: %v", p.name, err)
+			}
+			phase.Store(p.name)
+
+			counts := newSoakCounts()
+			ctx, cancel := context.WithTimeout(context.Background(), *soakPhaseDuration)
+			runTraffic(ctx, host, r, counts)
+			cancel()
+			t.Logf("cycle %v, phase %v: %v", cycle, p.name, counts)
+		}
+
+		clearFaults(s)
+		phase.Store("drained")
+		sample, err := waitDrained(adminPort, "drained")
+		if err != nil {
+			t.Fatalf("fail to sample the stats: %v", err)
+		}
+		recordSample(sample)
+		if !sample.drained() {
+			t.Errorf("cycle %v: the calls did not drain in %v, a leak in the retry or cancel paths: %v",
+				cycle, soakDrainTimeout, sample)
+		}
+		if cycle > 1 {
+			drainedSamples = append(drainedSamples, sample)
+		}
+	}
+
+	if len(drainedSamples) < 3 {
+		t.Logf("the heap growth is not checked with %v drained samples after the first cycle, soak for longer", len(drainedSamples))
+		return
+	}
+	var allocated, retained []float64
+	for _, sample := range drainedSamples {
+		allocated = append(allocated, float64(sample.memory.Allocated))
+		retained = append(retained, float64(sample.retained()))
+	}
+	if detectGrowth(allocated, soakMinHeapGrowth) {
+		t.Errorf("the allocated heap grows monotonically across the drained samples: %v", allocated)
+	}
+	if detectGrowth(retained, soakMinHeapGrowth) {
+		t.Errorf("the retained heap grows monotonically across the drained samples, from fragmentation: %v", retained)
+	}
+}
+
+func TestDetectGrowth(t *testing.T) {
+	testData := []struct {
+		desc   string
+		values []float64
+		want   bool
+	}{
+		{
+			desc:   "too few samples",
+			values: []float64{0, 10 << 20},
+		},
+		{
+			desc:   "plateau",
+			values: []float64{10 << 20, 10 << 20, 10 << 20, 10 << 20},
+		},
+		{
+			desc:   "up and down with the traffic",
+			values: []float64{10 << 20, 12 << 20, 10 << 20, 12 << 20, 10 << 20},
+		},
+		{
+			desc:   "monotonic growth",
+			values: []float64{10 << 20, 11 << 20, 12 << 20, 13 << 20},
+			want:   true,
+		},
+		{
+			desc:   "growth with a dip",
+			values: []float64{10 << 20, 11 << 20, 12 << 20, 11 << 20, 13 << 20, 14 << 20, 15 << 20, 16 << 20},
+			want:   true,
+		},
+		{
+			desc:   "monotonic growth under the minimum",
+			values: []float64{10 << 20, 10<<20 + 1, 10<<20 + 2, 10<<20 + 3},
+		},
+	}
+
+	for _, tc := range testData {
+		if got := detectGrowth(tc.values, soakMinHeapGrowth); got != tc.want {
+			t.Errorf("Test (%s): got %v, want %v", tc.desc, got, tc.want)
+		}
+	}
+}
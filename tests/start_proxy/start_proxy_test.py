@@ -94,6 +94,39 @@ class TestStartProxy(unittest.TestCase):
               '--backend_dns_lookup_family', 'v4only',
               '--dns_resolver_addresses', '127.0.0.1:53'
               ]),
+            # Token broker
+            (['--service=echo.gloud.run', '--backend=http://echo:8080',
+              '--version=2019-11-09r0', '--disable_tracing',
+              '--token_broker_socket=/var/run/espv2/token-broker.sock'],
+             ['bin/configmanager', '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://echo:8080', '--v', '0',
+              '--service', 'echo.gloud.run',
+              '--service_config_id', '2019-11-09r0',
+              '--disable_tracing',
+              '--token_broker_socket', '/var/run/espv2/token-broker.sock'
+              ]),
+            # Persisted xDS snapshot
+            (['--service=echo.gloud.run', '--backend=http://echo:8080',
+              '--version=2019-11-09r0', '--disable_tracing',
+              '--xds_snapshot_dir=/var/lib/espv2'],
+             ['bin/configmanager', '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://echo:8080', '--v', '0',
+              '--service', 'echo.gloud.run',
+              '--service_config_id', '2019-11-09r0',
+              '--xds_snapshot_dir', '/var/lib/espv2',
+              '--disable_tracing'
+              ]),
+            # Managed JWKS
+            (['--service=echo.gloud.run', '--backend=http://echo:8080',
+              '--version=2019-11-09r0', '--disable_tracing',
+              '--managed_jwks_dir=/var/lib/espv2/jwks'],
+             ['bin/configmanager', '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://echo:8080', '--v', '0',
+              '--service', 'echo.gloud.run',
+              '--service_config_id', '2019-11-09r0',
+              '--managed_jwks_dir', '/var/lib/espv2/jwks',
+              '--disable_tracing'
+              ]),
             # Default backend
             (['-R=managed','--enable_strict_transport_security',
               '--http_port=8079', '--service_control_quota_retries=3',
@@ -859,6 +892,85 @@ class TestStartProxy(unittest.TestCase):
               '--enable_response_compression',
               '--service_json_path', '/tmp/service_config.json',
               ]),
+            # response_compression with policies.
+            (['--rollout_strategy=fixed',
+              '--service_json_path=/tmp/service_config.json',
+              '--enable_response_compression',
+              '--response_compression_min_size=1024',
+              '--response_compression_content_types=application/json',
+              '--response_compression_operations=a.b.Get=off;a.b.List=br',
+              ],
+             ['bin/configmanager',  '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://127.0.0.1:8082', '--v', '0',
+              '--enable_response_compression',
+              '--response_compression_min_size', '1024',
+              '--response_compression_content_types', 'application/json',
+              '--response_compression_operations', 'a.b.Get=off;a.b.List=br',
+              '--service_json_path', '/tmp/service_config.json',
+              ]),
+            # trusted_jwt_callers
+            (['--rollout_strategy=fixed',
+              '--service_json_path=/tmp/service_config.json',
+              '--trusted_jwt_callers=a.b.Get=https://issuer.example.com,aud',
+              ],
+             ['bin/configmanager',  '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://127.0.0.1:8082', '--v', '0',
+              '--trusted_jwt_callers', 'a.b.Get=https://issuer.example.com,aud',
+              '--service_json_path', '/tmp/service_config.json',
+              ]),
+            # learn_api_key_restrictions
+            (['--rollout_strategy=fixed',
+              '--service_json_path=/tmp/service_config.json',
+              '--learn_api_key_restrictions',
+              ],
+             ['bin/configmanager',  '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://127.0.0.1:8082', '--v', '0',
+              '--learn_api_key_restrictions',
+              '--service_json_path', '/tmp/service_config.json',
+              ]),
+            # check_cache_peers
+            (['--rollout_strategy=fixed',
+              '--service_json_path=/tmp/service_config.json',
+              '--check_cache_peers=10.0.0.1:8792,10.0.0.2:8792',
+              '--check_cache_peer_address=10.0.0.1',
+              '--check_cache_peer_port=8792',
+              '--check_cache_peer_secret_file=/etc/espv2/peer_secret',
+              ],
+             ['bin/configmanager',  '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://127.0.0.1:8082', '--v', '0',
+              '--check_cache_peers', '10.0.0.1:8792,10.0.0.2:8792',
+              '--check_cache_peer_address', '10.0.0.1',
+              '--check_cache_peer_port', '8792',
+              '--check_cache_peer_secret_file', '/etc/espv2/peer_secret',
+              '--service_json_path', '/tmp/service_config.json',
+              ]),
+            # pinned check consumers
+            (['--rollout_strategy=fixed',
+              '--service_json_path=/tmp/service_config.json',
+              '--pinned_check_api_key_sha256=2c70e12b7a0646f92279f427c7b38e7334d8e5389cff167a1dc30e73f826b683',
+              '--pinned_check_consumer_numbers=123,456',
+              '--pinned_check_ttl=10m',
+              ],
+             ['bin/configmanager',  '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://127.0.0.1:8082', '--v', '0',
+              '--pinned_check_api_key_sha256',
+              '2c70e12b7a0646f92279f427c7b38e7334d8e5389cff167a1dc30e73f826b683',
+              '--pinned_check_consumer_numbers', '123,456',
+              '--pinned_check_ttl', '10m',
+              '--service_json_path', '/tmp/service_config.json',
+              ]),
+            # denied report rollup
+            (['--rollout_strategy=fixed',
+              '--service_json_path=/tmp/service_config.json',
+              '--denied_report_rollup_threshold=500',
+              '--denied_report_rollup_interval=10s',
+              ],
+             ['bin/configmanager',  '--logtostderr', '--rollout_strategy', 'fixed',
+              '--backend_address', 'http://127.0.0.1:8082', '--v', '0',
+              '--denied_report_rollup_threshold', '500',
+              '--denied_report_rollup_interval', '10s',
+              '--service_json_path', '/tmp/service_config.json',
+              ]),
             # passing the flag --health_check_grp_backend
             (['--service=test_bookstore.gloud.run',
               '--backend=grpc://127.0.0.1:8000',
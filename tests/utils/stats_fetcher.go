@@ -102,3 +102,35 @@ func FetchStats(adminPort uint16) (StatCounters, StatHistograms, error) {
 	glog.Infof("Fetched stats\n  counters: %v\n  histograms: %v", counters, histograms)
 	return counters, histograms, nil
 }
+
+// MemoryStats is the struct to decode the /memory envoy admin endpoint, see
+// the tcmalloc documentation for the meaning of each field.
+type MemoryStats struct {
+	// The bytes allocated by the application.
+	Allocated uint64 `json:"allocated,string"`
+	// The bytes of the heap, including the freed bytes not released.
+	HeapSize uint64 `json:"heap_size,string"`
+	// The free bytes of the heap released to the OS.
+	PageheapUnmapped uint64 `json:"pageheap_unmapped,string"`
+	// The free bytes of the heap not released to the OS.
+	PageheapFree uint64 `json:"pageheap_free,string"`
+	// The free bytes in the thread caches.
+	TotalThreadCache uint64 `json:"total_thread_cache,string"`
+	// The bytes of the heap backed by physical memory.
+	TotalPhysicalBytes uint64 `json:"total_physical_bytes,string"`
+}
+
+// FetchMemoryStats returns the heap stats of envoy.
+func FetchMemoryStats(adminPort uint16) (*MemoryStats, error) {
+	memoryUrl := fmt.Sprintf("http://localhost:%v/memory", adminPort)
+	_, memoryResp, err := DoWithHeaders(memoryUrl, "GET", "", nil)
+	if err != nil {
+		return nil, fmt.Errorf("failed to fetch envoy memory stats: %v", err)
+	}
+
+	var stats MemoryStats
+	if err := json.Unmarshal(memoryResp, &stats); err != nil {
+		return nil, fmt.Errorf("fail to unmarshal response to MemoryStats: %v", err)
+	}
+	return &stats, nil
+}